@@ -0,0 +1,59 @@
+// Data shared by the cluster renderer's culling passes (lod_select.comp, cluster_cull.comp), matching the Gpu* structs in
+// vk_cluster_renderer.h
+
+#extension GL_EXT_buffer_reference : require
+
+const uint CULL_FRUSTUM = 1u;
+const uint CULL_BACKFACE = 2u;
+const uint CULL_OCCLUSION = 4u;
+
+const uint MAX_LODS = 8u;
+// no level chosen yet for a scene instance
+const uint INVALID_LOD = 0xFFFFFFFFu;
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer CullData {
+	mat4 viewProjection;
+	mat4 previousViewProjection;
+	vec4 frustumPlanes[6];
+	vec4 cameraPosition;
+	vec2 hzbSize;
+	uint hzbMipCount;
+	uint flags;
+	// pixels per mesh unit at a distance of one
+	float lodScale;
+	float lodErrorPixels;
+	// fraction of the pixel budget a coarser level's error has to stay below before switching to it
+	float lodHysteresis;
+	// every instance draws this level (clamped to its chain) if not negative
+	int forcedLod;
+};
+
+struct Lod {
+	float error;
+	uint triangleCount;
+};
+
+// the levels of every drawn mesh, instances index theirs with firstLod
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer LodBuffer {
+	Lod lods[];
+};
+
+// the level each scene instance draws, kept across frames
+layout(buffer_reference, std430, buffer_reference_align = 4) buffer LodStateBuffer {
+	uint lods[];
+};
+
+// ClusterRenderer::GpuStats
+layout(buffer_reference, std430, buffer_reference_align = 4) buffer CullStats {
+	uint frustumCulledClusters;
+	uint backfaceCulledClusters;
+	uint occlusionCulledClusters;
+	uint frustumCulledTriangles;
+	uint backfaceCulledTriangles;
+	uint occlusionCulledTriangles;
+	uint drawnTriangles;
+	uint padding;
+	uint lodInstances[MAX_LODS];
+	uint lodSelectedTriangles[MAX_LODS];
+	uint lodDrawnTriangles[MAX_LODS];
+};
\ No newline at end of file
@@ -0,0 +1,114 @@
+// Clustered forward lighting as ClusteredLighting hands it to shaders (see vk_clustered_lighting.h): the view frustum is cut
+// into froxels, screen tiles split into exponentially spaced depth slices, each listing the point lights that touch it.
+// Depth here is the distance along the view direction, -z in view space
+
+#extension GL_EXT_buffer_reference : require
+
+// ClusteredLighting::GRID_X, GRID_Y, GRID_Z and MAX_LIGHTS_PER_CLUSTER
+const uint GRID_X = 16u;
+const uint GRID_Y = 9u;
+const uint GRID_Z = 24u;
+const uint CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+const uint MAX_LIGHTS_PER_CLUSTER = 128u;
+
+struct PointLight {
+	vec4 positionRadius; // world space position, radius past which the light adds nothing
+	vec4 colorIntensity; // linear color, intensity
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer LightBuffer {
+	PointLight lights[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 4) buffer ClusterCounts {
+	uint counts[];
+};
+
+// MAX_LIGHTS_PER_CLUSTER light indices per froxel, the first counts[froxel] of them valid
+layout(buffer_reference, std430, buffer_reference_align = 4) buffer ClusterIndices {
+	uint indices[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer LightingData {
+	mat4 view;
+	LightBuffer lights;
+	ClusterCounts counts;
+	ClusterIndices indices;
+	// the projection's [0][0] and [1][1], which take view space x and y over depth to NDC
+	vec2 projectionScale;
+	// pixels per screen tile
+	vec2 tileSize;
+	// slice = log(depth) * sliceScale + sliceBias
+	float sliceScale;
+	float sliceBias;
+	float nearPlane;
+	float farPlane;
+	uint lightCount;
+};
+
+// view space box of a froxel, with depth in z
+struct ClusterBounds {
+	vec3 boxMin;
+	vec3 boxMax;
+};
+
+ClusterBounds get_cluster_bounds(LightingData data, uint clusterIndex)
+{
+	uvec3 cell = uvec3(clusterIndex % GRID_X, (clusterIndex / GRID_X) % GRID_Y, clusterIndex / (GRID_X * GRID_Y));
+	float nearDepth = data.nearPlane * pow(data.farPlane / data.nearPlane, float(cell.z) / float(GRID_Z));
+	float farDepth = data.nearPlane * pow(data.farPlane / data.nearPlane, float(cell.z + 1u) / float(GRID_Z));
+
+	// a point at NDC xy and depth d lies at view space xy = ndc * d / projectionScale
+	vec2 ndcMin = vec2(cell.xy) / vec2(GRID_X, GRID_Y) * 2.0 - 1.0;
+	vec2 ndcMax = vec2(cell.xy + 1u) / vec2(GRID_X, GRID_Y) * 2.0 - 1.0;
+	vec2 nearMin = ndcMin * nearDepth / data.projectionScale;
+	vec2 nearMax = ndcMax * nearDepth / data.projectionScale;
+	vec2 farMin = ndcMin * farDepth / data.projectionScale;
+	vec2 farMax = ndcMax * farDepth / data.projectionScale;
+
+	ClusterBounds bounds;
+	bounds.boxMin = vec3(min(min(nearMin, nearMax), min(farMin, farMax)), nearDepth);
+	bounds.boxMax = vec3(max(max(nearMin, nearMax), max(farMin, farMax)), farDepth);
+	return bounds;
+}
+
+// sphere: view space xy, depth, radius
+bool sphere_intersects_box(vec4 sphere, ClusterBounds bounds)
+{
+	vec3 offset = sphere.xyz - clamp(sphere.xyz, bounds.boxMin, bounds.boxMax);
+	return dot(offset, offset) <= sphere.w * sphere.w;
+}
+
+uint get_cluster_index(LightingData data, vec2 fragCoord, float depth)
+{
+	uvec2 tile = min(uvec2(fragCoord / data.tileSize), uvec2(GRID_X - 1u, GRID_Y - 1u));
+	uint slice = uint(clamp(log(max(depth, data.nearPlane)) * data.sliceScale + data.sliceBias, 0.0, float(GRID_Z - 1u)));
+	return tile.x + GRID_X * (tile.y + GRID_Y * slice);
+}
+
+// reaches zero at the light's radius, so a froxel the light was not binned into could not have received anything from it
+float light_falloff(float distance, float radius)
+{
+	float ratio = distance / radius;
+	float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+	return window * window / (distance * distance + 1.0);
+}
+
+// diffuse light of the point lights listed in the froxel a fragment falls in
+vec3 shade_point_lights(LightingData data, vec3 worldPosition, vec3 normal, vec2 fragCoord)
+{
+	float depth = -(data.view * vec4(worldPosition, 1.0)).z;
+	uint clusterIndex = get_cluster_index(data, fragCoord, depth);
+	uint count = min(data.counts.counts[clusterIndex], MAX_LIGHTS_PER_CLUSTER);
+	uint firstIndex = clusterIndex * MAX_LIGHTS_PER_CLUSTER;
+
+	vec3 result = vec3(0.0);
+	for (uint i = 0u; i < count; i++) {
+		PointLight light = data.lights.lights[data.indices.indices[firstIndex + i]];
+		vec3 toLight = light.positionRadius.xyz - worldPosition;
+		float distance = length(toLight);
+		float lambert = max(dot(normal, toLight / max(distance, 1e-4)), 0.0);
+		result += light.colorIntensity.rgb * light.colorIntensity.a * lambert * light_falloff(distance, light.positionRadius.w);
+	}
+	return result;
+}
\ No newline at end of file
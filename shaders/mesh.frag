@@ -0,0 +1,58 @@
+#version 460
+
+// Fragment stage of the cluster renderer's scene pass: surfaces take the base color of their mesh's material, its texture
+// sampled through the texture streamer (which the sampling reports the needed mip level to), and are lit by the sun
+// (through its cascaded shadow maps), a sky/ground hemisphere and the point lights of the froxel the fragment falls in,
+// in linear HDR like the rest of the draw image
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "scene_geometry.glsl"
+#include "clustered_lighting.glsl"
+#include "shadows.glsl"
+
+#define TEXTURE_HEAP_SET 1
+#include "texture_streaming.glsl"
+
+layout(push_constant) uniform Constants {
+	mat4 viewProjection;
+	InstanceBuffer instances;
+	LightingData lighting;
+	vec4 sunDirection;
+	// sky then ground color as six halfs
+	uvec3 hemisphereColors;
+	uint frameNumber;
+	TextureTable textureTable;
+	TextureFeedback textureFeedback;
+} constants;
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec3 inWorldPosition;
+layout(location = 3) flat in uint inInstance;
+
+layout(location = 0) out vec4 outColor;
+
+const uint NO_TEXTURE = 0xFFFFFFFFu;
+
+void main()
+{
+	Instance instance = constants.instances.instances[inInstance];
+	vec3 albedo = unpackUnorm4x8(instance.baseColorFactor).rgb;
+	if (instance.baseColorTexture != NO_TEXTURE) {
+		bool bWriteFeedback = is_feedback_pixel(uvec2(gl_FragCoord.xy), constants.frameNumber);
+		albedo *= sample_streamed(constants.textureTable, constants.textureFeedback, instance.baseColorTexture, inUV, bWriteFeedback).rgb;
+	}
+
+	vec3 normal = normalize(inNormal);
+	vec3 sunDirection = normalize(constants.sunDirection.xyz);
+	float sun = max(dot(normal, sunDirection), 0.0) * constants.sunDirection.w;
+	if (sun > 0.0) {
+		sun *= sample_sun_shadow(inWorldPosition, normal, sunDirection);
+	}
+	vec3 skyColor = vec3(unpackHalf2x16(constants.hemisphereColors.x), unpackHalf2x16(constants.hemisphereColors.y).x);
+	vec3 groundColor = vec3(unpackHalf2x16(constants.hemisphereColors.y).y, unpackHalf2x16(constants.hemisphereColors.z));
+	vec3 ambient = mix(groundColor, skyColor, normal.y * 0.5 + 0.5);
+	vec3 pointLights = shade_point_lights(constants.lighting, inWorldPosition, normal, gl_FragCoord.xy);
+	outColor = vec4(albedo * (ambient + vec3(sun) + pointLights), 1.0);
+}
\ No newline at end of file
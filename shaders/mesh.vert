@@ -0,0 +1,43 @@
+#version 460
+
+// Vertex stage of the cluster renderer's scene pass. Vertices are pulled from the shared vertex pool through the
+// instance's buffer address; the compacted index buffer holds indices relative to the mesh's first vertex, and the
+// indirect draw of each instance carries the instance index as its first instance. The world position goes on to the
+// fragment stage for the point lights, the instance index for the material
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "scene_geometry.glsl"
+#include "clustered_lighting.glsl"
+
+layout(push_constant) uniform Constants {
+	mat4 viewProjection;
+	InstanceBuffer instances;
+	LightingData lighting;
+	// xyz: direction towards the sun, w: intensity
+	vec4 sunDirection;
+	uvec3 hemisphereColors;
+	uint frameNumber;
+	// texture table and feedback addresses, for the fragment stage
+	uvec2 textureTable;
+	uvec2 textureFeedback;
+} constants;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec2 outUV;
+layout(location = 2) out vec3 outWorldPosition;
+layout(location = 3) flat out uint outInstance;
+
+void main()
+{
+	Instance instance = constants.instances.instances[gl_InstanceIndex];
+	DecodedVertex vertex = fetch_vertex(instance.vertices, uint(gl_VertexIndex));
+
+	vec4 worldPosition = instance.model * vec4(vertex.position, 1.0);
+	gl_Position = constants.viewProjection * worldPosition;
+	// the inverse transpose only matters for non-uniform scales, which scene instances rarely have
+	outNormal = mat3(instance.model) * vertex.normal;
+	outUV = vertex.uv;
+	outWorldPosition = worldPosition.xyz;
+	outInstance = uint(gl_InstanceIndex);
+}
\ No newline at end of file
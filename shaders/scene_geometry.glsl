@@ -0,0 +1,80 @@
+// Scene geometry as the cluster renderer hands it to shaders (see vk_cluster_renderer.h): per-instance records pointing
+// at the instance's mesh in the shared vertex, index and meshlet pools, all through buffer device addresses
+
+#extension GL_EXT_buffer_reference : require
+
+// Vertex in vk_geometry.h: position, octahedral normal (snorm16x2), uv (half2); 5 words with no padding
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer VertexBuffer {
+	uint words[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 4) buffer IndexBuffer {
+	uint indices[];
+};
+
+struct Meshlet {
+	vec4 sphere; // mesh space center, radius
+	vec4 cone; // average normal, cutoff
+	uint firstIndex;
+	uint triangleCount;
+	// level of detail of the mesh the meshlet belongs to
+	uint lod;
+	uint padding;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer MeshletBuffer {
+	Meshlet meshlets[];
+};
+
+struct Instance {
+	mat4 model;
+	// world space bounds of the whole mesh: xyz center, w radius
+	vec4 boundingSphere;
+	VertexBuffer vertices;
+	IndexBuffer indices;
+	MeshletBuffer meshlets;
+	// the mesh's levels of detail in the frame's level table
+	uint firstLod;
+	uint lodCount;
+	// where the instance's surviving indices start in the compacted index buffer
+	uint outputFirstIndex;
+	// largest axis scale of model, for transforming bounding spheres
+	float maxScale;
+	// the instance's entity slot, stable across frames (unlike its place among the drawn or stored instances); indexes the
+	// level of detail state
+	uint lodSlot;
+	// the mesh's material: handle of its base color texture in the texture streamer (0xFFFFFFFF for none) and its base
+	// color factor as RGBA8 unorm
+	uint baseColorTexture;
+	uint baseColorFactor;
+	uint padding[3];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer InstanceBuffer {
+	Instance instances[];
+};
+
+struct DecodedVertex {
+	vec3 position;
+	vec3 normal;
+	vec2 uv;
+};
+
+vec3 decode_octahedral(uint packedNormal)
+{
+	vec2 encoded = unpackSnorm2x16(packedNormal);
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+	return normalize(normal);
+}
+
+DecodedVertex fetch_vertex(VertexBuffer vertices, uint index)
+{
+	uint base = index * 5u;
+	DecodedVertex vertex;
+	vertex.position = vec3(uintBitsToFloat(vertices.words[base]), uintBitsToFloat(vertices.words[base + 1u]), uintBitsToFloat(vertices.words[base + 2u]));
+	vertex.normal = decode_octahedral(vertices.words[base + 3u]);
+	vertex.uv = unpackHalf2x16(vertices.words[base + 4u]);
+	return vertex;
+}
\ No newline at end of file
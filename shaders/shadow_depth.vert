@@ -0,0 +1,20 @@
+#version 460
+
+// Vertex stage of the cluster renderer's depth only draws (shadow cascades): positions are pulled like in mesh.vert and
+// taken straight to the view's clip space; there is no fragment stage
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "scene_geometry.glsl"
+
+layout(push_constant) uniform Constants {
+	mat4 viewProjection;
+	InstanceBuffer instances;
+} constants;
+
+void main()
+{
+	Instance instance = constants.instances.instances[gl_InstanceIndex];
+	DecodedVertex vertex = fetch_vertex(instance.vertices, uint(gl_VertexIndex));
+	gl_Position = constants.viewProjection * (instance.model * vec4(vertex.position, 1.0));
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+// Cascaded sun shadows as CascadedShadowMaps hands them to the scene pass (see vk_shadows.h): one layer of a depth array
+// per cascade, each an orthographic view along the sun covering a slice of the camera's view depth. Bound in set 0 of
+// the including shader
+
+// CascadedShadowMaps::CASCADE_COUNT
+const uint CASCADE_COUNT = 4u;
+// how far lookups move along the surface normal, in texels of the cascade, when the sun grazes the surface
+const float NORMAL_OFFSET_TEXELS = 1.5;
+
+layout(set = 0, binding = 0) uniform sampler2DArrayShadow shadowAtlas;
+
+layout(set = 0, binding = 1) uniform ShadowData {
+	mat4 cascadeViewProjections[CASCADE_COUNT];
+	// view depth at which each cascade ends
+	vec4 cascadeSplits;
+	// world units per texel of each cascade
+	vec4 cascadeTexelSizes;
+	// xyz: camera position, w: 1 when shadows are on
+	vec4 cameraPosition;
+	// xyz: camera forward, w: 1 / atlas resolution
+	vec4 cameraForward;
+} shadows;
+
+// fraction of the sun that reaches a surface point, filtered over 3x3 comparisons (each bilinear, so over 4x4 texels)
+float sample_sun_shadow(vec3 worldPosition, vec3 normal, vec3 sunDirection)
+{
+	if (shadows.cameraPosition.w == 0.0) {
+		return 1.0;
+	}
+	float depth = dot(worldPosition - shadows.cameraPosition.xyz, shadows.cameraForward.xyz);
+	if (depth > shadows.cascadeSplits[CASCADE_COUNT - 1u]) {
+		return 1.0;
+	}
+	uint cascade = 0u;
+	while (cascade < CASCADE_COUNT - 1u && depth > shadows.cascadeSplits[cascade]) {
+		cascade++;
+	}
+
+	// grazing surfaces sample further out, where their own depth no longer shadows them
+	float grazing = 1.0 - clamp(dot(normal, sunDirection), 0.0, 1.0);
+	vec3 position = worldPosition + normal * (shadows.cascadeTexelSizes[cascade] * NORMAL_OFFSET_TEXELS * grazing);
+	// orthographic, so w stays 1
+	vec3 shadowPosition = (shadows.cascadeViewProjections[cascade] * vec4(position, 1.0)).xyz;
+	vec2 uv = shadowPosition.xy * 0.5 + 0.5;
+
+	// explicit gradients: the atlas has no mips, and the lookups sit in non-uniform control flow
+	float texelSize = shadows.cameraForward.w;
+	float lit = 0.0;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			lit += textureGrad(shadowAtlas, vec4(uv + vec2(x, y) * texelSize, float(cascade), shadowPosition.z), vec2(0.0), vec2(0.0));
+		}
+	}
+	return lit / 9.0;
+}
\ No newline at end of file
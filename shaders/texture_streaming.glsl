@@ -0,0 +1,44 @@
+// Sampling of textures streamed by TextureStreamer (see vk_texture_streamer.h), for fragment shaders: the feedback relies on
+// implicit derivatives.
+// Define TEXTURE_HEAP_SET before including; the table and feedback buffer addresses of the frame being drawn come from
+// TextureStreamer::get_table_address / get_feedback_address, e.g. through push constants
+
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_buffer_reference : require
+
+layout(set = TEXTURE_HEAP_SET, binding = 0) uniform sampler2D textureHeap[];
+
+struct StreamedTexture {
+	uint descriptor;
+	// finest resident level, which is level 0 of the bound view; 0xFFFFFFFF while the fallback is bound
+	uint residentLevel;
+	uint levelCount;
+	uint padding;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer TextureTable {
+	StreamedTexture textures[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 4) buffer TextureFeedback {
+	uint requestedLevels[];
+};
+
+// one pixel in 16 reports feedback each frame, a different one every frame, which keeps the atomics cheap while every
+// texture on screen still gets reported within a few frames
+bool is_feedback_pixel(uvec2 pixel, uint frameNumber)
+{
+	return ((pixel.x & 3u) | ((pixel.y & 3u) << 2u)) == (frameNumber & 15u);
+}
+
+vec4 sample_streamed(TextureTable table, TextureFeedback feedback, uint textureIndex, vec2 uv, bool bWriteFeedback)
+{
+	StreamedTexture streamed = table.textures[textureIndex];
+	if (bWriteFeedback && streamed.residentLevel != 0xFFFFFFFFu) {
+		// unclamped LOD relative to the bound view; negative means the view's finest level is being magnified
+		float viewLod = textureQueryLod(textureHeap[nonuniformEXT(streamed.descriptor)], uv).x;
+		int level = int(streamed.residentLevel) + int(floor(viewLod));
+		atomicMin(feedback.requestedLevels[textureIndex], uint(max(level, 0)));
+	}
+	return texture(textureHeap[nonuniformEXT(streamed.descriptor)], uv);
+}
\ No newline at end of file
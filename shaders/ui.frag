@@ -0,0 +1,16 @@
+#version 460
+
+// Fragment stage of the UI renderer: vertex color times the draw command's texture (the font atlas unless a window shows
+// an image), written as is to the UNORM swapchain image like ImGui's own Vulkan backend does
+
+layout(set = 0, binding = 0) uniform sampler2D uiTexture;
+
+layout(location = 0) in vec4 inColor;
+layout(location = 1) in vec2 inUV;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	outColor = inColor * texture(uiTexture, inUV);
+}
\ No newline at end of file
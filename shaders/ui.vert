@@ -0,0 +1,31 @@
+#version 460
+
+// Vertex stage of the UI renderer (vk_ui_renderer.h): ImDrawVert is pulled from the frame's UI buffer through its device
+// address rather than bound as a vertex buffer, like scene vertices. The index buffer is bound, so gl_VertexIndex already
+// includes each draw command's vertex offset
+
+#extension GL_EXT_buffer_reference : require
+
+// ImDrawVert: position (float2), uv (float2), color (RGBA8); 5 words with no padding
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer UiVertexBuffer {
+	uint words[];
+};
+
+layout(push_constant) uniform Constants {
+	// ImGui display coordinates to clip space
+	vec2 scale;
+	vec2 translate;
+	UiVertexBuffer vertices;
+} constants;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outUV;
+
+void main()
+{
+	uint base = uint(gl_VertexIndex) * 5u;
+	vec2 position = vec2(uintBitsToFloat(constants.vertices.words[base]), uintBitsToFloat(constants.vertices.words[base + 1u]));
+	outUV = vec2(uintBitsToFloat(constants.vertices.words[base + 2u]), uintBitsToFloat(constants.vertices.words[base + 3u]));
+	outColor = unpackUnorm4x8(constants.vertices.words[base + 4u]);
+	gl_Position = vec4(position * constants.scale + constants.translate, 0.0, 1.0);
+}
\ No newline at end of file
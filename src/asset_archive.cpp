@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "asset_archive.h"
+#include "vk_upload.h"
+#include "vk_utils.h"
+
+namespace {
+    struct ArchiveHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint64_t tocOffset;
+        uint64_t namesOffset;
+        uint64_t namesSize;
+        // hash of the entry table and names, so a truncated or patched archive is rejected on open
+        uint64_t tocHash;
+        uint32_t dataAlignment;
+        uint32_t reserved[3];
+    };
+    static_assert(sizeof(ArchiveHeader) == 64);
+
+    struct ArchiveEntry {
+        uint64_t nameHash;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint64_t dataOffset;
+        uint64_t storedSize;
+        uint64_t size;
+        uint64_t contentHash;
+        uint32_t compression;
+        uint32_t reserved[3];
+    };
+    static_assert(sizeof(ArchiveEntry) == 64);
+
+    constexpr uint64_t TOC_ALIGNMENT = 64;
+
+    uint64_t align_up(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint64_t hash_name(std::string_view name)
+    {
+        return vkutil::hash_bytes(name.data(), name.size());
+    }
+}
+
+bool AssetArchive::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    HANDLE mapping = fileSize.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        std::cout << "failed to map asset archive " << path << std::endl;
+        return false;
+    }
+    mFileHandle = file;
+    mMappingHandle = mapping;
+    mMapping = (const uint8_t*)view;
+    mMappingSize = (size_t)fileSize.QuadPart;
+#else
+    int fileDescriptor = ::open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    void* view = MAP_FAILED;
+    if (fstat(fileDescriptor, &fileStat) == 0 && fileStat.st_size > 0) {
+        view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    }
+    if (view == MAP_FAILED) {
+        ::close(fileDescriptor);
+        std::cout << "failed to map asset archive " << path << std::endl;
+        return false;
+    }
+    mFileDescriptor = fileDescriptor;
+    mMapping = (const uint8_t*)view;
+    mMappingSize = (size_t)fileStat.st_size;
+#endif
+
+    auto fail = [&](const char* reason) {
+        std::cout << "invalid asset archive " << path << ": " << reason << std::endl;
+        close();
+        return false;
+    };
+
+    if (mMappingSize < sizeof(ArchiveHeader)) {
+        return fail("too small");
+    }
+    ArchiveHeader header;
+    std::memcpy(&header, mMapping, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        return fail("bad magic");
+    }
+    if (header.version != VERSION) {
+        return fail("unsupported version");
+    }
+    if (header.tocOffset % TOC_ALIGNMENT != 0 || header.tocOffset + (uint64_t)header.entryCount * sizeof(ArchiveEntry) > mMappingSize
+        || header.namesOffset + header.namesSize > mMappingSize || header.namesOffset < header.tocOffset + (uint64_t)header.entryCount * sizeof(ArchiveEntry)) {
+        return fail("table of contents out of bounds");
+    }
+    if (vkutil::hash_bytes(mMapping + header.tocOffset, header.namesOffset + header.namesSize - header.tocOffset) != header.tocHash) {
+        return fail("table of contents hash mismatch");
+    }
+
+    // the table is aligned in the file, and mappings are page aligned, so it can be read in place
+    const ArchiveEntry* table = (const ArchiveEntry*)(mMapping + header.tocOffset);
+    const char* names = (const char*)(mMapping + header.namesOffset);
+    mEntries.reserve(header.entryCount);
+    mNameHashes.reserve(header.entryCount);
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const ArchiveEntry& stored = table[i];
+        // written so that a huge offset or size cannot wrap around past the check
+        if ((uint64_t)stored.nameOffset + stored.nameLength > header.namesSize || stored.dataOffset > mMappingSize
+            || stored.storedSize > mMappingSize - stored.dataOffset) {
+            return fail("entry out of bounds");
+        }
+        if (stored.compression > (uint32_t)Compression::Lz4) {
+            return fail("entry uses an unsupported compression");
+        }
+        // read copies size bytes of an uncompressed entry straight from the mapping
+        if (stored.compression == (uint32_t)Compression::None && stored.size != stored.storedSize) {
+            return fail("uncompressed entry size mismatch");
+        }
+        if (i > 0 && stored.nameHash < table[i - 1].nameHash) {
+            return fail("entries not sorted");
+        }
+
+        Entry entry;
+        entry.name = std::string_view(names + stored.nameOffset, stored.nameLength);
+        entry.size = stored.size;
+        entry.storedSize = stored.storedSize;
+        entry.contentHash = stored.contentHash;
+        entry.compression = (Compression)stored.compression;
+        entry.storedData = mMapping + stored.dataOffset;
+        mEntries.push_back(entry);
+        mNameHashes.push_back(stored.nameHash);
+    }
+    return true;
+}
+
+void AssetArchive::close()
+{
+    if (!mMapping) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mMapping);
+    CloseHandle(mMappingHandle);
+    CloseHandle(mFileHandle);
+    mMappingHandle = nullptr;
+    mFileHandle = nullptr;
+#else
+    munmap((void*)mMapping, mMappingSize);
+    ::close(mFileDescriptor);
+    mFileDescriptor = -1;
+#endif
+    mMapping = nullptr;
+    mMappingSize = 0;
+    mEntries.clear();
+    mNameHashes.clear();
+}
+
+const AssetArchive::Entry* AssetArchive::find(std::string_view name) const
+{
+    uint64_t nameHash = hash_name(name);
+    auto first = std::lower_bound(mNameHashes.begin(), mNameHashes.end(), nameHash);
+    for (auto it = first; it != mNameHashes.end() && *it == nameHash; it++) {
+        const Entry& entry = mEntries[it - mNameHashes.begin()];
+        if (entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool AssetArchive::read(const Entry& entry, void* destination, bool bVerify) const
+{
+    bool bRead;
+    if (entry.compression == Compression::Lz4) {
+        bRead = lz4::decompress(entry.storedData, entry.storedSize, (uint8_t*)destination, entry.size);
+    }
+    else {
+        std::memcpy(destination, entry.storedData, entry.size);
+        bRead = true;
+    }
+    if (bRead && bVerify) {
+        bRead = vkutil::hash_bytes(destination, entry.size) == entry.contentHash;
+    }
+    if (!bRead) {
+        std::cout << "corrupt asset archive entry " << entry.name << std::endl;
+    }
+    return bRead;
+}
+
+bool AssetArchive::read(const Entry& entry, std::vector<uint8_t>& outBytes, bool bVerify) const
+{
+    outBytes.resize(entry.size);
+    return read(entry, outBytes.data(), bVerify);
+}
+
+bool AssetArchive::verify(const Entry& entry) const
+{
+    if (entry.compression == Compression::None) {
+        return vkutil::hash_bytes(entry.storedData, entry.size) == entry.contentHash;
+    }
+    std::vector<uint8_t> bytes;
+    return read(entry, bytes, true);
+}
+
+void AssetArchive::prefetch(const Entry& entry) const
+{
+#ifndef _WIN32
+    // madvise wants a page aligned start
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)entry.storedData & ~(pageSize - 1);
+    posix_madvise((void*)start, (uintptr_t)entry.storedData + entry.storedSize - start, POSIX_MADV_WILLNEED);
+#else
+    WIN32_MEMORY_RANGE_ENTRY range = { (void*)entry.storedData, (SIZE_T)entry.storedSize };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+}
+
+bool AssetArchive::enqueue_upload(const std::shared_ptr<const AssetArchive>& archive, const Entry& entry, StagingUploader& uploader,
+    VkBuffer dst, VkDeviceSize dstOffset, std::function<void()>&& onComplete)
+{
+    if (const uint8_t* mappedData = archive->get_mapped_data(entry)) {
+        // no intermediate copy: the uploader memcpys from the mapping into its staging chunks
+        archive->prefetch(entry);
+        uploader.enqueue_buffer(dst, dstOffset, mappedData, entry.size, archive, std::move(onComplete));
+        return true;
+    }
+
+    std::shared_ptr<std::vector<uint8_t>> bytes = std::make_shared<std::vector<uint8_t>>();
+    if (!archive->read(entry, *bytes)) {
+        return false;
+    }
+    uploader.enqueue_buffer(dst, dstOffset, bytes->data(), bytes->size(), bytes, std::move(onComplete));
+    return true;
+}
+
+void AssetArchiveWriter::add(const std::string& name, std::vector<uint8_t>&& data, AssetArchive::Compression compression)
+{
+    PendingEntry entry;
+    entry.name = name;
+    entry.size = data.size();
+    entry.contentHash = vkutil::hash_bytes(data.data(), data.size());
+    entry.compression = AssetArchive::Compression::None;
+
+    if (compression == AssetArchive::Compression::Lz4 && !data.empty()) {
+        std::vector<uint8_t> compressed(lz4::compress_bound(data.size()));
+        size_t compressedSize = lz4::compress(data.data(), data.size(), compressed.data(), compressed.size());
+        // decompression is not free, so it has to buy a meaningful reduction
+        if (compressedSize > 0 && compressedSize <= data.size() - data.size() / 8) {
+            compressed.resize(compressedSize);
+            entry.stored = std::move(compressed);
+            entry.compression = AssetArchive::Compression::Lz4;
+        }
+    }
+    if (entry.compression == AssetArchive::Compression::None) {
+        entry.stored = std::move(data);
+    }
+
+    // a later entry of the same name replaces the earlier one
+    std::erase_if(mEntries, [&](const PendingEntry& existing) { return existing.name == name; });
+    mEntries.push_back(std::move(entry));
+}
+
+bool AssetArchiveWriter::write(const std::string& path, uint32_t dataAlignment) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // table order is by name hash, data order follows it so related lookups touch nearby pages
+    std::vector<uint32_t> order(mEntries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<uint64_t> nameHashes(mEntries.size());
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        nameHashes[i] = hash_name(mEntries[i].name);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return nameHashes[a] < nameHashes[b]; });
+
+    std::vector<ArchiveEntry> table;
+    std::string names;
+    uint64_t offset = sizeof(ArchiveHeader);
+    const char padding[256] = {};
+    auto pad_to = [&](uint64_t target) {
+        while (offset < target) {
+            uint64_t count = std::min<uint64_t>(target - offset, sizeof(padding));
+            file.write(padding, (std::streamsize)count);
+            offset += count;
+        }
+    };
+
+    file.write(std::string(sizeof(ArchiveHeader), '\0').data(), sizeof(ArchiveHeader));
+    for (uint32_t index : order) {
+        const PendingEntry& pending = mEntries[index];
+        pad_to(align_up(offset, dataAlignment));
+
+        ArchiveEntry entry = {};
+        entry.nameHash = nameHashes[index];
+        entry.nameOffset = (uint32_t)names.size();
+        entry.nameLength = (uint32_t)pending.name.size();
+        entry.dataOffset = offset;
+        entry.storedSize = pending.stored.size();
+        entry.size = pending.size;
+        entry.contentHash = pending.contentHash;
+        entry.compression = (uint32_t)pending.compression;
+        table.push_back(entry);
+        names += pending.name;
+
+        file.write((const char*)pending.stored.data(), (std::streamsize)pending.stored.size());
+        offset += pending.stored.size();
+    }
+
+    pad_to(align_up(offset, TOC_ALIGNMENT));
+    ArchiveHeader header = {};
+    std::memcpy(header.magic, AssetArchive::MAGIC, sizeof(header.magic));
+    header.version = AssetArchive::VERSION;
+    header.entryCount = (uint32_t)table.size();
+    header.tocOffset = offset;
+    header.namesOffset = offset + table.size() * sizeof(ArchiveEntry);
+    header.namesSize = names.size();
+    header.dataAlignment = dataAlignment;
+
+    std::vector<uint8_t> tocBytes(table.size() * sizeof(ArchiveEntry) + names.size());
+    std::memcpy(tocBytes.data(), table.data(), table.size() * sizeof(ArchiveEntry));
+    std::memcpy(tocBytes.data() + table.size() * sizeof(ArchiveEntry), names.data(), names.size());
+    header.tocHash = vkutil::hash_bytes(tocBytes.data(), tocBytes.size());
+    file.write((const char*)tocBytes.data(), (std::streamsize)tocBytes.size());
+
+    file.seekp(0);
+    file.write((const char*)&header, sizeof(header));
+    return (bool)file;
+}
+
+AssetArchiveWriter::Stats AssetArchiveWriter::get_stats() const
+{
+    Stats stats{};
+    stats.entryCount = (uint32_t)mEntries.size();
+    for (const PendingEntry& entry : mEntries) {
+        stats.size += entry.size;
+        stats.storedSize += entry.stored.size();
+    }
+    return stats;
+}
+
+namespace {
+    constexpr size_t LZ4_MIN_MATCH = 4;
+    // the last match must start at least 12 bytes before the end, and the last 5 bytes are always literals
+    constexpr size_t LZ4_MATCH_FIND_LIMIT = 12;
+    constexpr size_t LZ4_LAST_LITERALS = 5;
+    constexpr size_t LZ4_MAX_OFFSET = 65535;
+    constexpr uint32_t LZ4_HASH_BITS = 16;
+
+    uint32_t read32(const uint8_t* bytes)
+    {
+        uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    uint8_t* write_length(uint8_t* out, size_t length)
+    {
+        while (length >= 255) {
+            *out++ = 255;
+            length -= 255;
+        }
+        *out++ = (uint8_t)length;
+        return out;
+    }
+}
+
+size_t lz4::compress_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t lz4::compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity)
+{
+    if (dstCapacity < compress_bound(srcSize)) {
+        return 0;
+    }
+
+    // greedy parse over a single-entry hash table of 4 byte sequences, like LZ4's fast mode
+    std::vector<uint32_t> hashTable(size_t(1) << LZ4_HASH_BITS, UINT32_MAX);
+    uint8_t* out = dst;
+    size_t anchor = 0;
+    size_t position = 0;
+
+    auto emit_sequence = [&](size_t literalEnd, size_t matchOffset, size_t matchLength) {
+        size_t literalLength = literalEnd - anchor;
+        uint8_t* token = out++;
+        *token = (uint8_t)(std::min<size_t>(literalLength, 15) << 4);
+        if (literalLength >= 15) {
+            out = write_length(out, literalLength - 15);
+        }
+        std::memcpy(out, src + anchor, literalLength);
+        out += literalLength;
+        if (matchLength > 0) {
+            *out++ = (uint8_t)(matchOffset & 0xFF);
+            *out++ = (uint8_t)(matchOffset >> 8);
+            size_t extra = matchLength - LZ4_MIN_MATCH;
+            *token |= (uint8_t)std::min<size_t>(extra, 15);
+            if (extra >= 15) {
+                out = write_length(out, extra - 15);
+            }
+        }
+    };
+
+    if (srcSize > LZ4_MATCH_FIND_LIMIT) {
+        const size_t matchStartLimit = srcSize - LZ4_MATCH_FIND_LIMIT;
+        const size_t matchEndLimit = srcSize - LZ4_LAST_LITERALS;
+        while (position < matchStartLimit) {
+            uint32_t sequence = read32(src + position);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+            uint32_t candidate = hashTable[hash];
+            hashTable[hash] = (uint32_t)position;
+
+            if (candidate == UINT32_MAX || position - candidate > LZ4_MAX_OFFSET || read32(src + candidate) != sequence) {
+                position++;
+                continue;
+            }
+
+            size_t matchLength = LZ4_MIN_MATCH;
+            while (position + matchLength < matchEndLimit && src[candidate + matchLength] == src[position + matchLength]) {
+                matchLength++;
+            }
+            emit_sequence(position, position - candidate, matchLength);
+            position += matchLength;
+            anchor = position;
+        }
+    }
+
+    // the final sequence is literals only
+    emit_sequence(srcSize, 0, 0);
+    return (size_t)(out - dst);
+}
+
+bool lz4::decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+    size_t in = 0;
+    size_t out = 0;
+    auto read_length = [&](size_t& length) {
+        uint8_t byte;
+        do {
+            if (in >= srcSize) {
+                return false;
+            }
+            byte = src[in++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (in < srcSize) {
+        uint8_t token = src[in++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !read_length(literalLength)) {
+            return false;
+        }
+        if (literalLength > srcSize - in || literalLength > dstSize - out) {
+            return false;
+        }
+        std::memcpy(dst + out, src + in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        if (in == srcSize) {
+            break;
+        }
+
+        if (srcSize - in < 2) {
+            return false;
+        }
+        size_t matchOffset = src[in] | (src[in + 1] << 8);
+        in += 2;
+        if (matchOffset == 0 || matchOffset > out) {
+            return false;
+        }
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !read_length(matchLength)) {
+            return false;
+        }
+        matchLength += LZ4_MIN_MATCH;
+        if (matchLength > dstSize - out) {
+            return false;
+        }
+        // matches may overlap their own output (offset < length repeats a pattern), so copy forwards byte by byte
+        const uint8_t* match = dst + out - matchOffset;
+        for (size_t i = 0; i < matchLength; i++) {
+            dst[out + i] = match[i];
+        }
+        out += matchLength;
+    }
+    return out == dstSize;
+}
\ No newline at end of file
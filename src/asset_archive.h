@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <volk.h>
+
+class StagingUploader;
+
+// Packed asset archive (.pak), read through a memory mapping so entries are used in place instead of being read into
+// heap buffers one file at a time. All integers are little endian; the layout is
+//   ArchiveHeader (64 bytes) | entry data, each at a multiple of dataAlignment | ArchiveEntry table (64 byte aligned) | names
+// Entries are sorted by name hash for binary search. contentHash is vkutil::hash_bytes of the uncompressed bytes, the same
+// hash shader modules are keyed on, so shaders from an archive are never hashed at load time
+class AssetArchive {
+public:
+	enum class Compression : uint32_t {
+		None = 0,
+		Lz4 = 1, // LZ4 block format
+		Zstd = 2 // reserved; archives using it are rejected by this build
+	};
+
+	struct Entry {
+		std::string_view name; // points into the mapping
+		uint64_t size; // uncompressed
+		uint64_t storedSize;
+		uint64_t contentHash;
+		Compression compression;
+		const uint8_t* storedData; // points into the mapping
+	};
+
+	static constexpr char MAGIC[8] = { 'S', 'U', 'N', 'A', 'P', 'A', 'K', '\0' };
+	static constexpr uint32_t VERSION = 1;
+
+	AssetArchive() = default;
+	~AssetArchive() { close(); }
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+
+	// maps the file and validates its header and table of contents; returns false (and logs why) if it is not a valid archive
+	bool open(const std::string& path);
+	void close();
+	bool is_open() const { return mMapping != nullptr; }
+
+	// names are '/' separated paths relative to the archive root, e.g. "shaders/background.comp.spv"
+	const Entry* find(std::string_view name) const;
+	const std::vector<Entry>& get_entries() const { return mEntries; }
+
+	// the entry's bytes inside the mapping, valid while the archive is open; nullptr for compressed entries
+	const uint8_t* get_mapped_data(const Entry& entry) const { return entry.compression == Compression::None ? entry.storedData : nullptr; }
+	// decompresses (or copies) the entry into destination, which must hold entry.size bytes
+	bool read(const Entry& entry, void* destination, bool bVerify = false) const;
+	bool read(const Entry& entry, std::vector<uint8_t>& outBytes, bool bVerify = false) const;
+	bool verify(const Entry& entry) const;
+	// asks the OS to start paging the entry in, so a later read or upload does not fault page by page
+	void prefetch(const Entry& entry) const;
+
+	// queues an upload of the entry into dst. Uncompressed entries are copied straight from the mapping into staging memory;
+	// compressed ones are decompressed into a heap buffer first, which the upload owns. The archive is kept open until it completes
+	static bool enqueue_upload(const std::shared_ptr<const AssetArchive>& archive, const Entry& entry, StagingUploader& uploader,
+		VkBuffer dst, VkDeviceSize dstOffset, std::function<void()>&& onComplete = nullptr);
+
+private:
+	const uint8_t* mMapping = nullptr;
+	size_t mMappingSize = 0;
+#ifdef _WIN32
+	void* mFileHandle = nullptr;
+	void* mMappingHandle = nullptr;
+#else
+	int mFileDescriptor = -1;
+#endif
+	std::vector<Entry> mEntries;
+	std::vector<uint64_t> mNameHashes; // parallel to mEntries, sorted
+};
+
+// Builds archives; used by the SunabaPack tool
+class AssetArchiveWriter {
+public:
+	// compression falls back to storing the entry as is when it would not save at least an eighth of its size
+	void add(const std::string& name, std::vector<uint8_t>&& data, AssetArchive::Compression compression);
+	// dataAlignment must be a power of two; 64 keeps every entry on a cache line and suits SPIR-V and staging copies
+	bool write(const std::string& path, uint32_t dataAlignment = 64) const;
+
+	struct Stats {
+		uint32_t entryCount;
+		uint64_t size;
+		uint64_t storedSize;
+	};
+	Stats get_stats() const;
+
+private:
+	struct PendingEntry {
+		std::string name;
+		std::vector<uint8_t> stored;
+		uint64_t size;
+		uint64_t contentHash;
+		AssetArchive::Compression compression;
+	};
+	std::vector<PendingEntry> mEntries;
+};
+
+// LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), compatible with LZ4_compress_default
+// and LZ4_decompress_safe
+namespace lz4 {
+	size_t compress_bound(size_t size);
+	// returns the compressed size, or 0 if dstCapacity is smaller than compress_bound(srcSize)
+	size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+	// fails on malformed input or if the output is not exactly dstSize bytes
+	bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+}
\ No newline at end of file
@@ -0,0 +1,564 @@
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include "bvh.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    // deep enough for a tree of median splits over any object count that fits in 31 bits
+    constexpr uint32_t STACK_SIZE = 256;
+
+    bool overlaps_frustum(const Aabb& bounds, const glm::vec4 planes[6])
+    {
+        for (int plane = 0; plane < 6; plane++) {
+            glm::vec3 positive(planes[plane].x > 0.f ? bounds.max.x : bounds.min.x, planes[plane].y > 0.f ? bounds.max.y : bounds.min.y,
+                planes[plane].z > 0.f ? bounds.max.z : bounds.min.z);
+            if (glm::dot(glm::vec3(planes[plane]), positive) + planes[plane].w < 0.f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // entry distance of the ray into bounds, or a negative value if it misses them within maxDistance
+    float intersect_ray(const Aabb& bounds, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance)
+    {
+        glm::vec3 near = (bounds.min - origin) * inverseDirection;
+        glm::vec3 far = (bounds.max - origin) * inverseDirection;
+        glm::vec3 entries = glm::min(near, far);
+        glm::vec3 exits = glm::max(near, far);
+        float entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.f));
+        float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+        return entry <= exit ? entry : -1.f;
+    }
+
+    glm::vec3 inverse_direction(const glm::vec3& direction)
+    {
+        // axis parallel rays divide by zero into infinities, which the slab test handles unless the origin lies exactly on a slab
+        return glm::vec3(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+    }
+}
+
+Aabb Aabb::transformed(const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform)
+{
+    glm::vec3 center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.f));
+    glm::vec3 halfExtent = (max - min) * 0.5f;
+    glm::vec3 worldHalfExtent = glm::abs(glm::vec3(transform[0])) * halfExtent.x + glm::abs(glm::vec3(transform[1])) * halfExtent.y
+        + glm::abs(glm::vec3(transform[2])) * halfExtent.z;
+    return { center - worldHalfExtent, center + worldHalfExtent };
+}
+
+float Aabb::surface_area() const
+{
+    glm::vec3 extent = glm::max(max - min, glm::vec3(0.f));
+    return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+void extract_frustum_planes(const glm::mat4& viewProjection, glm::vec4 outPlanes[6])
+{
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++) {
+        rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+    }
+    outPlanes[0] = rows[3] + rows[0];
+    outPlanes[1] = rows[3] - rows[0];
+    outPlanes[2] = rows[3] + rows[1];
+    outPlanes[3] = rows[3] - rows[1];
+    outPlanes[4] = rows[2];
+    outPlanes[5] = rows[3] - rows[2];
+    for (int plane = 0; plane < 6; plane++) {
+        outPlanes[plane] /= glm::length(glm::vec3(outPlanes[plane]));
+    }
+}
+
+uint32_t DynamicBvh::insert(const Aabb& bounds, uint32_t userData)
+{
+    uint32_t object;
+    if (!mFreeObjects.empty()) {
+        object = mFreeObjects.back();
+        mFreeObjects.pop_back();
+    }
+    else {
+        object = (uint32_t)mObjects.size();
+        mObjects.emplace_back();
+    }
+    // waiting objects keep their place in the pending list in slot
+    mObjects[object] = { bounds, userData, NO_NODE, (uint32_t)mPendingObjects.size(), true };
+    mPendingObjects.push_back(object);
+    return object;
+}
+
+void DynamicBvh::remove(uint32_t object)
+{
+    Object& record = mObjects[object];
+    if (record.node != NO_NODE) {
+        set_child(mNodes[record.node], record.slot, { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) }, EMPTY_CHILD);
+        mark_dirty(record.node);
+        mTreeObjectCount--;
+    }
+    else {
+        uint32_t moved = mPendingObjects.back();
+        mPendingObjects[record.slot] = moved;
+        mObjects[moved].slot = record.slot;
+        mPendingObjects.pop_back();
+    }
+    record.bAlive = false;
+    record.node = NO_NODE;
+    mFreeObjects.push_back(object);
+}
+
+void DynamicBvh::update(uint32_t object, const Aabb& bounds)
+{
+    Object& record = mObjects[object];
+    record.bounds = bounds;
+    if (record.node != NO_NODE) {
+        set_child(mNodes[record.node], record.slot, bounds, OBJECT_BIT | object);
+        mark_dirty(record.node);
+    }
+}
+
+void DynamicBvh::maintain()
+{
+    uint32_t pendingLimit = (uint32_t)(mTreeObjectCount * REBUILD_PENDING_RATIO);
+    if (mPendingObjects.size() > std::max(pendingLimit, WIDTH)) {
+        rebuild();
+        return;
+    }
+
+    // children always come after their parent, so handling the highest dirty node first sees every node after all of
+    // its children were refit
+    while (!mDirtyNodes.empty()) {
+        std::pop_heap(mDirtyNodes.begin(), mDirtyNodes.end());
+        uint32_t nodeIndex = mDirtyNodes.back();
+        mDirtyNodes.pop_back();
+
+        Node& node = mNodes[nodeIndex];
+        node.bDirty = false;
+        if (node.parent == NO_NODE) {
+            continue;
+        }
+        Aabb bounds = node_bounds(node);
+        Node& parent = mNodes[node.parent];
+        uint32_t slot = node.parentSlot;
+        Aabb previous{ { parent.minX[slot], parent.minY[slot], parent.minZ[slot] }, { parent.maxX[slot], parent.maxY[slot], parent.maxZ[slot] } };
+        mArea += (double)bounds.surface_area() - (double)previous.surface_area();
+        set_child(parent, slot, bounds, nodeIndex);
+        mark_dirty(node.parent);
+    }
+
+    if (mBuiltArea > 0.0 && mArea > mBuiltArea * REBUILD_AREA_RATIO) {
+        rebuild();
+    }
+}
+
+void DynamicBvh::rebuild()
+{
+    std::vector<uint32_t> objects;
+    objects.reserve(mObjects.size() - mFreeObjects.size());
+    for (uint32_t object = 0; object < (uint32_t)mObjects.size(); object++) {
+        if (mObjects[object].bAlive) {
+            objects.push_back(object);
+        }
+    }
+
+    mNodes.clear();
+    mDirtyNodes.clear();
+    mPendingObjects.clear();
+    mArea = 0.0;
+    mTreeObjectCount = (uint32_t)objects.size();
+    mRebuildCount++;
+    if (!objects.empty()) {
+        // a tree of n objects has at most n / (WIDTH - 1) nodes plus the root
+        mNodes.reserve(objects.size() / (WIDTH - 1) + 1);
+        build_node(objects.data(), (uint32_t)objects.size(), NO_NODE, 0);
+    }
+    mBuiltArea = mArea;
+}
+
+uint32_t DynamicBvh::build_node(uint32_t* objects, uint32_t count, uint32_t parent, uint32_t parentSlot)
+{
+    uint32_t nodeIndex = (uint32_t)mNodes.size();
+    mNodes.emplace_back();
+    Node& node = mNodes[nodeIndex];
+    node.parent = parent;
+    node.parentSlot = parentSlot;
+    node.bDirty = false;
+    for (uint32_t slot = 0; slot < WIDTH; slot++) {
+        set_child(node, slot, { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) }, EMPTY_CHILD);
+    }
+
+    // three rounds of splits along the longest axis of the centroids make up to eight groups. Splits are placed so that
+    // all groups but the last hold exactly as many objects as a full subtree of the child's height, which keeps nodes full
+    // (a median split would leave many half empty ones near the leaves)
+    uint32_t groupBegins[WIDTH + 1] = { 0, count };
+    uint32_t groupCount = 1;
+    if (count > WIDTH) {
+        uint32_t childCapacity = 1;
+        while (childCapacity * WIDTH < count) {
+            childCapacity *= WIDTH;
+        }
+        for (int round = 0; round < 3; round++) {
+            uint32_t groupCapacity = childCapacity << (2 - round);
+            uint32_t splitBegins[WIDTH + 1];
+            uint32_t splitCount = 0;
+            for (uint32_t group = 0; group < groupCount; group++) {
+                uint32_t begin = groupBegins[group];
+                uint32_t end = groupBegins[group + 1];
+                splitBegins[splitCount++] = begin;
+                if (end - begin <= groupCapacity) {
+                    continue;
+                }
+
+                glm::vec3 centroidMin(FLT_MAX);
+                glm::vec3 centroidMax(-FLT_MAX);
+                for (uint32_t i = begin; i < end; i++) {
+                    const Aabb& bounds = mObjects[objects[i]].bounds;
+                    glm::vec3 centroid = bounds.min + bounds.max;
+                    centroidMin = glm::min(centroidMin, centroid);
+                    centroidMax = glm::max(centroidMax, centroid);
+                }
+                glm::vec3 extent = centroidMax - centroidMin;
+                int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+                uint32_t middle = begin + groupCapacity;
+                std::nth_element(objects + begin, objects + middle, objects + end, [&](uint32_t a, uint32_t b) {
+                    return mObjects[a].bounds.min[axis] + mObjects[a].bounds.max[axis] < mObjects[b].bounds.min[axis] + mObjects[b].bounds.max[axis];
+                });
+                splitBegins[splitCount++] = middle;
+            }
+            splitBegins[splitCount] = count;
+            std::copy(splitBegins, splitBegins + splitCount + 1, groupBegins);
+            groupCount = splitCount;
+        }
+    }
+    else {
+        for (uint32_t i = 0; i <= count; i++) {
+            groupBegins[i] = i;
+        }
+        groupCount = count;
+    }
+
+    for (uint32_t group = 0; group < groupCount; group++) {
+        uint32_t begin = groupBegins[group];
+        uint32_t groupSize = groupBegins[group + 1] - begin;
+        if (groupSize == 1) {
+            Object& object = mObjects[objects[begin]];
+            object.node = nodeIndex;
+            object.slot = group;
+            set_child(mNodes[nodeIndex], group, object.bounds, OBJECT_BIT | objects[begin]);
+        }
+        else {
+            // the recursion grows mNodes, so the node is only looked up again afterwards
+            uint32_t child = build_node(objects + begin, groupSize, nodeIndex, group);
+            Aabb bounds = node_bounds(mNodes[child]);
+            mArea += bounds.surface_area();
+            set_child(mNodes[nodeIndex], group, bounds, child);
+        }
+    }
+    return nodeIndex;
+}
+
+void DynamicBvh::set_child(Node& node, uint32_t slot, const Aabb& bounds, uint32_t child)
+{
+    node.minX[slot] = bounds.min.x;
+    node.minY[slot] = bounds.min.y;
+    node.minZ[slot] = bounds.min.z;
+    node.maxX[slot] = bounds.max.x;
+    node.maxY[slot] = bounds.max.y;
+    node.maxZ[slot] = bounds.max.z;
+    node.children[slot] = child;
+}
+
+void DynamicBvh::mark_dirty(uint32_t nodeIndex)
+{
+    if (!mNodes[nodeIndex].bDirty) {
+        mNodes[nodeIndex].bDirty = true;
+        mDirtyNodes.push_back(nodeIndex);
+        std::push_heap(mDirtyNodes.begin(), mDirtyNodes.end());
+    }
+}
+
+Aabb DynamicBvh::node_bounds(const Node& node) const
+{
+    Aabb bounds{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    for (uint32_t slot = 0; slot < WIDTH; slot++) {
+        if (node.children[slot] != EMPTY_CHILD) {
+            bounds.min = glm::min(bounds.min, glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]));
+            bounds.max = glm::max(bounds.max, glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]));
+        }
+    }
+    return bounds;
+}
+
+void DynamicBvh::test_frustum(const Node& node, const glm::vec4 planes[6], uint32_t& outIntersecting, uint32_t& outContained) const
+{
+#if defined(__AVX__)
+    if (mUseSimd) {
+        const __m256 minX = _mm256_load_ps(node.minX);
+        const __m256 minY = _mm256_load_ps(node.minY);
+        const __m256 minZ = _mm256_load_ps(node.minZ);
+        const __m256 maxX = _mm256_load_ps(node.maxX);
+        const __m256 maxY = _mm256_load_ps(node.maxY);
+        const __m256 maxZ = _mm256_load_ps(node.maxZ);
+        // empty children have inverted bounds
+        __m256 intersecting = _mm256_cmp_ps(minX, maxX, _CMP_LE_OQ);
+        __m256 contained = intersecting;
+        for (int plane = 0; plane < 6; plane++) {
+            // the corner farthest along the plane normal decides whether a box is outside, the nearest whether it is inside
+            const glm::vec4& p = planes[plane];
+            __m256 nx = _mm256_set1_ps(p.x);
+            __m256 ny = _mm256_set1_ps(p.y);
+            __m256 nz = _mm256_set1_ps(p.z);
+            __m256 w = _mm256_set1_ps(p.w);
+            __m256 farX = p.x > 0.f ? maxX : minX;
+            __m256 farY = p.y > 0.f ? maxY : minY;
+            __m256 farZ = p.z > 0.f ? maxZ : minZ;
+            __m256 nearX = p.x > 0.f ? minX : maxX;
+            __m256 nearY = p.y > 0.f ? minY : maxY;
+            __m256 nearZ = p.z > 0.f ? minZ : maxZ;
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+            __m256 farDistance = _mm256_fmadd_ps(nx, farX, _mm256_fmadd_ps(ny, farY, _mm256_fmadd_ps(nz, farZ, w)));
+            __m256 nearDistance = _mm256_fmadd_ps(nx, nearX, _mm256_fmadd_ps(ny, nearY, _mm256_fmadd_ps(nz, nearZ, w)));
+#else
+            __m256 farDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, farX), _mm256_mul_ps(ny, farY)), _mm256_add_ps(_mm256_mul_ps(nz, farZ), w));
+            __m256 nearDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nearX), _mm256_mul_ps(ny, nearY)), _mm256_add_ps(_mm256_mul_ps(nz, nearZ), w));
+#endif
+            intersecting = _mm256_and_ps(intersecting, _mm256_cmp_ps(farDistance, _mm256_setzero_ps(), _CMP_GE_OQ));
+            contained = _mm256_and_ps(contained, _mm256_cmp_ps(nearDistance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        outIntersecting = (uint32_t)_mm256_movemask_ps(intersecting);
+        outContained = (uint32_t)_mm256_movemask_ps(contained);
+        return;
+    }
+#endif
+    outIntersecting = 0;
+    outContained = 0;
+    for (uint32_t slot = 0; slot < WIDTH; slot++) {
+        if (node.children[slot] == EMPTY_CHILD) {
+            continue;
+        }
+        bool bIntersecting = true;
+        bool bContained = true;
+        for (int plane = 0; plane < 6 && bIntersecting; plane++) {
+            const glm::vec4& p = planes[plane];
+            float farDistance = p.x * (p.x > 0.f ? node.maxX[slot] : node.minX[slot]) + p.y * (p.y > 0.f ? node.maxY[slot] : node.minY[slot])
+                + p.z * (p.z > 0.f ? node.maxZ[slot] : node.minZ[slot]) + p.w;
+            float nearDistance = p.x * (p.x > 0.f ? node.minX[slot] : node.maxX[slot]) + p.y * (p.y > 0.f ? node.minY[slot] : node.maxY[slot])
+                + p.z * (p.z > 0.f ? node.minZ[slot] : node.maxZ[slot]) + p.w;
+            bIntersecting = farDistance >= 0.f;
+            bContained = bContained && nearDistance >= 0.f;
+        }
+        outIntersecting |= bIntersecting ? 1u << slot : 0u;
+        outContained |= bIntersecting && bContained ? 1u << slot : 0u;
+    }
+}
+
+uint32_t DynamicBvh::test_ray(const Node& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance,
+    float outEntries[WIDTH]) const
+{
+#if defined(__AVX__)
+    if (mUseSimd) {
+        // slab test: the ray is inside the box between the latest entry into and the earliest exit out of the three slabs
+        __m256 originX = _mm256_set1_ps(origin.x);
+        __m256 originY = _mm256_set1_ps(origin.y);
+        __m256 originZ = _mm256_set1_ps(origin.z);
+        __m256 inverseX = _mm256_set1_ps(inverseDirection.x);
+        __m256 inverseY = _mm256_set1_ps(inverseDirection.y);
+        __m256 inverseZ = _mm256_set1_ps(inverseDirection.z);
+        __m256 nearX = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minX), originX), inverseX);
+        __m256 farX = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxX), originX), inverseX);
+        __m256 nearY = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minY), originY), inverseY);
+        __m256 farY = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxY), originY), inverseY);
+        __m256 nearZ = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minZ), originZ), inverseZ);
+        __m256 farZ = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxZ), originZ), inverseZ);
+        __m256 entry = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(nearX, farX), _mm256_min_ps(nearY, farY)),
+            _mm256_max_ps(_mm256_min_ps(nearZ, farZ), _mm256_setzero_ps()));
+        __m256 exit = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(nearX, farX), _mm256_max_ps(nearY, farY)),
+            _mm256_min_ps(_mm256_max_ps(nearZ, farZ), _mm256_set1_ps(maxDistance)));
+        _mm256_storeu_ps(outEntries, entry);
+        // empty children have inverted bounds, so their entry lies past their exit on every axis with a finite inverse
+        __m256 valid = _mm256_cmp_ps(_mm256_load_ps(node.minX), _mm256_load_ps(node.maxX), _CMP_LE_OQ);
+        return (uint32_t)_mm256_movemask_ps(_mm256_and_ps(valid, _mm256_cmp_ps(entry, exit, _CMP_LE_OQ)));
+    }
+#endif
+    uint32_t hits = 0;
+    for (uint32_t slot = 0; slot < WIDTH; slot++) {
+        if (node.children[slot] == EMPTY_CHILD) {
+            continue;
+        }
+        Aabb bounds{ { node.minX[slot], node.minY[slot], node.minZ[slot] }, { node.maxX[slot], node.maxY[slot], node.maxZ[slot] } };
+        outEntries[slot] = intersect_ray(bounds, origin, inverseDirection, maxDistance);
+        hits |= outEntries[slot] >= 0.f ? 1u << slot : 0u;
+    }
+    return hits;
+}
+
+void DynamicBvh::collect_subtree(uint32_t child, std::vector<uint32_t>& outUserData) const
+{
+    uint32_t stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = child;
+    while (stackSize > 0) {
+        uint32_t current = stack[--stackSize];
+        if (current & OBJECT_BIT) {
+            outUserData.push_back(mObjects[current & ~OBJECT_BIT].userData);
+            continue;
+        }
+        const Node& node = mNodes[current];
+        for (uint32_t slot = 0; slot < WIDTH; slot++) {
+            if (node.children[slot] != EMPTY_CHILD) {
+                stack[stackSize++] = node.children[slot];
+            }
+        }
+    }
+}
+
+void DynamicBvh::query_frustum(const glm::vec4 planes[6], std::vector<uint32_t>& outUserData) const
+{
+    for (uint32_t object : mPendingObjects) {
+        if (overlaps_frustum(mObjects[object].bounds, planes)) {
+            outUserData.push_back(mObjects[object].userData);
+        }
+    }
+    if (mNodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = mNodes[stack[--stackSize]];
+        uint32_t intersecting;
+        uint32_t contained;
+        test_frustum(node, planes, intersecting, contained);
+        while (intersecting != 0) {
+            uint32_t slot = (uint32_t)std::countr_zero(intersecting);
+            intersecting &= intersecting - 1;
+            uint32_t child = node.children[slot];
+            if (child & OBJECT_BIT) {
+                outUserData.push_back(mObjects[child & ~OBJECT_BIT].userData);
+            }
+            else if (contained & (1u << slot)) {
+                // nothing below a node entirely inside the frustum needs testing
+                collect_subtree(child, outUserData);
+            }
+            else {
+                stack[stackSize++] = child;
+            }
+        }
+    }
+}
+
+void DynamicBvh::query_ray(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& outUserData) const
+{
+    glm::vec3 inverseDirection = inverse_direction(direction);
+    for (uint32_t object : mPendingObjects) {
+        if (intersect_ray(mObjects[object].bounds, origin, inverseDirection, maxDistance) >= 0.f) {
+            outUserData.push_back(mObjects[object].userData);
+        }
+    }
+    if (mNodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    float entries[WIDTH];
+    while (stackSize > 0) {
+        const Node& node = mNodes[stack[--stackSize]];
+        uint32_t hits = test_ray(node, origin, inverseDirection, maxDistance, entries);
+        while (hits != 0) {
+            uint32_t slot = (uint32_t)std::countr_zero(hits);
+            hits &= hits - 1;
+            uint32_t child = node.children[slot];
+            if (child & OBJECT_BIT) {
+                outUserData.push_back(mObjects[child & ~OBJECT_BIT].userData);
+            }
+            else {
+                stack[stackSize++] = child;
+            }
+        }
+    }
+}
+
+bool DynamicBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& outHit) const
+{
+    glm::vec3 inverseDirection = inverse_direction(direction);
+    outHit = { INVALID_OBJECT, maxDistance };
+    for (uint32_t object : mPendingObjects) {
+        float entry = intersect_ray(mObjects[object].bounds, origin, inverseDirection, outHit.distance);
+        if (entry >= 0.f && (outHit.object == INVALID_OBJECT || entry < outHit.distance)) {
+            outHit = { mObjects[object].userData, entry };
+        }
+    }
+    if (mNodes.empty()) {
+        return outHit.object != INVALID_OBJECT;
+    }
+
+    // nearest first, so subtrees behind the closest hit so far are skipped whole
+    struct Entry {
+        uint32_t node;
+        float distance;
+    };
+    Entry stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = { 0, 0.f };
+    float entries[WIDTH];
+    while (stackSize > 0) {
+        Entry current = stack[--stackSize];
+        if (outHit.object != INVALID_OBJECT && current.distance >= outHit.distance) {
+            continue;
+        }
+        const Node& node = mNodes[current.node];
+        uint32_t hits = test_ray(node, origin, inverseDirection, outHit.distance, entries);
+
+        Entry children[WIDTH];
+        uint32_t childCount = 0;
+        while (hits != 0) {
+            uint32_t slot = (uint32_t)std::countr_zero(hits);
+            hits &= hits - 1;
+            uint32_t child = node.children[slot];
+            if (child & OBJECT_BIT) {
+                if (outHit.object == INVALID_OBJECT || entries[slot] < outHit.distance) {
+                    outHit = { mObjects[child & ~OBJECT_BIT].userData, entries[slot] };
+                }
+                continue;
+            }
+            // insertion sort by descending distance, so the nearest child is pushed last and visited first
+            uint32_t position = childCount++;
+            while (position > 0 && children[position - 1].distance < entries[slot]) {
+                children[position] = children[position - 1];
+                position--;
+            }
+            children[position] = { child, entries[slot] };
+        }
+        std::copy(children, children + childCount, stack + stackSize);
+        stackSize += childCount;
+    }
+    return outHit.object != INVALID_OBJECT;
+}
+
+bool DynamicBvh::is_simd_available()
+{
+#if defined(__AVX__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+DynamicBvh::Stats DynamicBvh::get_stats() const
+{
+    Stats stats{};
+    stats.objectCount = (uint32_t)(mObjects.size() - mFreeObjects.size());
+    stats.nodeCount = (uint32_t)mNodes.size();
+    stats.pendingCount = (uint32_t)mPendingObjects.size();
+    stats.rebuildCount = mRebuildCount;
+    stats.areaRatio = mBuiltArea > 0.0 ? (float)(mArea / mBuiltArea) : 1.f;
+    return stats;
+}
\ No newline at end of file
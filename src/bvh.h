@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Aabb {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	// world bounds of a mesh space box placed with an affine transform
+	static Aabb transformed(const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform);
+	float surface_area() const;
+};
+
+// Gribb/Hartmann plane extraction for a [0, 1] depth range; planes face inwards and are normalized so the distance
+// of a sphere's center can be compared with its radius
+void extract_frustum_planes(const glm::mat4& viewProjection, glm::vec4 outPlanes[6]);
+
+// Bounding volume hierarchy over axis aligned boxes for CPU-side visibility: frustum queries (shadow cascades, streaming
+// priorities) and ray casts (picking). Nodes have eight children whose bounds are stored as structure of arrays, so a
+// query tests all eight with one AVX2 instruction per plane or slab (scalar when the engine is built without SUNABA_AVX2).
+// A child is either a node or a single object.
+// The tree is dynamic: moved objects only refit the bounds on their path to the root, inserted ones wait in a list that
+// queries scan as well, and removed ones leave an empty child. Refitting loosens the tree as objects wander off, so
+// maintain() rebuilds it once its summed node area has grown past REBUILD_AREA_RATIO of the freshly built tree's, or
+// once enough objects are waiting to be inserted
+class DynamicBvh {
+public:
+	static constexpr uint32_t WIDTH = 8;
+	static constexpr uint32_t INVALID_OBJECT = UINT32_MAX;
+	static constexpr float REBUILD_AREA_RATIO = 1.5f;
+	// fraction of the objects in the tree that may wait in the insertion list
+	static constexpr float REBUILD_PENDING_RATIO = 0.05f;
+
+	struct RayHit {
+		uint32_t object;
+		// along the normalized ray direction, where it enters the object's bounds (0 if it starts inside)
+		float distance;
+	};
+
+	struct Stats {
+		uint32_t objectCount;
+		uint32_t nodeCount;
+		uint32_t pendingCount;
+		uint32_t rebuildCount;
+		float areaRatio; // summed node area over what it was right after the last rebuild
+	};
+
+	// tests eight children at a time with AVX2 when built for it; false runs the scalar path (for comparison)
+	bool mUseSimd = true;
+
+	// returns a handle that stays valid until remove; userData is what queries report
+	uint32_t insert(const Aabb& bounds, uint32_t userData);
+	void remove(uint32_t object);
+	void update(uint32_t object, const Aabb& bounds);
+
+	// refits the nodes above objects moved since the last call, or rebuilds the whole tree when it has degraded
+	void maintain();
+	void rebuild();
+
+	// appends the userData of every object whose bounds are not fully outside any of the planes (xyz inward normal, w
+	// distance, as extracted from a view projection matrix)
+	void query_frustum(const glm::vec4 planes[6], std::vector<uint32_t>& outUserData) const;
+	// appends the userData of every object whose bounds the ray crosses within maxDistance
+	void query_ray(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& outUserData) const;
+	// the object whose bounds the ray enters first, if any; outHit.object is its userData
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& outHit) const;
+
+	static bool is_simd_available();
+	Stats get_stats() const;
+
+private:
+	static constexpr uint32_t EMPTY_CHILD = UINT32_MAX;
+	// set on child references that are objects rather than nodes
+	static constexpr uint32_t OBJECT_BIT = 0x80000000u;
+	static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+	struct alignas(32) Node {
+		float minX[WIDTH], minY[WIDTH], minZ[WIDTH];
+		float maxX[WIDTH], maxY[WIDTH], maxZ[WIDTH];
+		uint32_t children[WIDTH];
+		uint32_t parent;
+		uint32_t parentSlot;
+		bool bDirty;
+	};
+
+	struct Object {
+		Aabb bounds;
+		uint32_t userData;
+		// where the object sits in the tree, or NO_NODE while it waits for a rebuild (or is free)
+		uint32_t node;
+		uint32_t slot;
+		bool bAlive;
+	};
+
+	uint32_t build_node(uint32_t* objects, uint32_t count, uint32_t parent, uint32_t parentSlot);
+	void set_child(Node& node, uint32_t slot, const Aabb& bounds, uint32_t child);
+	void mark_dirty(uint32_t nodeIndex);
+	Aabb node_bounds(const Node& node) const;
+
+	// masks of the children (bit per slot) possibly inside the frustum, and of those entirely inside it
+	void test_frustum(const Node& node, const glm::vec4 planes[6], uint32_t& outIntersecting, uint32_t& outContained) const;
+	// mask of the children the ray crosses within maxDistance, with their entry distances
+	uint32_t test_ray(const Node& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance,
+		float outEntries[WIDTH]) const;
+	void collect_subtree(uint32_t child, std::vector<uint32_t>& outUserData) const;
+
+	std::vector<Node> mNodes;
+	std::vector<Object> mObjects;
+	std::vector<uint32_t> mFreeObjects;
+	std::vector<uint32_t> mPendingObjects;
+	// max-heap of nodes whose children's bounds changed since the last refit
+	std::vector<uint32_t> mDirtyNodes;
+	// summed surface area of all nodes but the root, now and right after the last rebuild
+	double mArea = 0.0;
+	double mBuiltArea = 0.0;
+	uint32_t mTreeObjectCount = 0;
+	uint32_t mRebuildCount = 0;
+};
\ No newline at end of file
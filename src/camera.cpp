@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <SDL3/SDL.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "camera.h"
+
+void Camera::process_sdl_event(const SDL_Event& event)
+{
+    if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN && event.button.button == SDL_BUTTON_RIGHT) {
+        mLooking = true;
+    }
+    else if (event.type == SDL_EVENT_MOUSE_BUTTON_UP && event.button.button == SDL_BUTTON_RIGHT) {
+        mLooking = false;
+    }
+    else if (event.type == SDL_EVENT_MOUSE_MOTION && mLooking) {
+        mYaw -= event.motion.xrel * mLookSensitivity;
+        // stop just short of straight up or down, where yaw would flip
+        mPitch = std::clamp(mPitch - event.motion.yrel * mLookSensitivity, -1.55f, 1.55f);
+    }
+}
+
+bool Camera::update(float deltaTime)
+{
+    const bool* keys = SDL_GetKeyboardState(nullptr);
+    glm::vec3 move(0.f);
+    move.z -= keys[SDL_SCANCODE_W] ? 1.f : 0.f;
+    move.z += keys[SDL_SCANCODE_S] ? 1.f : 0.f;
+    move.x -= keys[SDL_SCANCODE_A] ? 1.f : 0.f;
+    move.x += keys[SDL_SCANCODE_D] ? 1.f : 0.f;
+    move.y -= keys[SDL_SCANCODE_Q] ? 1.f : 0.f;
+    move.y += keys[SDL_SCANCODE_E] ? 1.f : 0.f;
+    if (move == glm::vec3(0.f)) {
+        return false;
+    }
+    float speed = mMoveSpeed * (keys[SDL_SCANCODE_LSHIFT] ? 4.f : 1.f);
+    mPosition += glm::vec3(get_rotation_matrix() * glm::vec4(glm::normalize(move), 0.f)) * speed * deltaTime;
+    return true;
+}
+
+glm::mat4 Camera::get_view_matrix() const
+{
+    glm::mat4 cameraToWorld = glm::translate(glm::mat4(1.f), mPosition) * get_rotation_matrix();
+    return glm::inverse(cameraToWorld);
+}
+
+glm::mat4 Camera::get_projection_matrix(float aspectRatio) const
+{
+    glm::mat4 projection = glm::perspectiveRH_ZO(mVerticalFov, aspectRatio, mNearPlane, mFarPlane);
+    projection[1][1] *= -1.f;
+    return projection;
+}
+
+glm::mat4 Camera::get_rotation_matrix() const
+{
+    glm::mat4 yaw = glm::rotate(glm::mat4(1.f), mYaw, glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 pitch = glm::rotate(glm::mat4(1.f), mPitch, glm::vec3(1.f, 0.f, 0.f));
+    return yaw * pitch;
+}
\ No newline at end of file
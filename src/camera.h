@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+union SDL_Event;
+
+// Free flying camera: WASD moves along the view, Q/E down and up, dragging with the right mouse button looks around.
+// The engine only forwards input ImGui does not want, so the camera never moves while a UI widget is being used
+class Camera {
+public:
+	glm::vec3 mPosition{ 0.f, 1.f, 5.f };
+	// radians; a yaw of 0 looks down -Z, positive pitch looks up
+	float mYaw = 0.f;
+	float mPitch = 0.f;
+	float mVerticalFov = glm::radians(70.f);
+	float mNearPlane = 0.1f;
+	float mFarPlane = 1000.f;
+	float mMoveSpeed = 5.f; // units per second
+	float mLookSensitivity = 0.003f; // radians per pixel of mouse motion
+
+	void process_sdl_event(const SDL_Event& event);
+	// moves by the keys held this frame; returns whether any were
+	bool update(float deltaTime);
+
+	glm::mat4 get_view_matrix() const;
+	// Vulkan clip space: depth in [0, 1], and Y flipped so +Y in view space is up on screen
+	glm::mat4 get_projection_matrix(float aspectRatio) const;
+
+private:
+	glm::mat4 get_rotation_matrix() const;
+
+	bool mLooking = false;
+};
\ No newline at end of file
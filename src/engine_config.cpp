@@ -0,0 +1,300 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "engine_config.h"
+#include "json.h"
+
+namespace {
+    struct Setting {
+        const char* key;
+        const char* environment;
+        // quoted in config files
+        bool bString;
+    };
+
+    const Setting SETTINGS[] = {
+        { "framesInFlight", "SUNABA_FRAMES_IN_FLIGHT", false },
+        { "windowWidth", "SUNABA_WINDOW_WIDTH", false },
+        { "windowHeight", "SUNABA_WINDOW_HEIGHT", false },
+        { "drawFormat", "SUNABA_DRAW_FORMAT", true },
+        { "renderScale", "SUNABA_RENDER_SCALE", false },
+        { "presentMode", "SUNABA_PRESENT_MODE", true },
+        { "descriptorGrowthFactor", "SUNABA_DESCRIPTOR_GROWTH_FACTOR", false },
+        { "descriptorPoolSetCap", "SUNABA_DESCRIPTOR_POOL_SET_CAP", false },
+        { "uploadBudgetMB", "SUNABA_UPLOAD_BUDGET_MB", false },
+    };
+
+    struct PresentModeName {
+        const char* name;
+        VkPresentModeKHR presentMode;
+    };
+
+    const PresentModeName PRESENT_MODES[] = {
+        { "fifo", VK_PRESENT_MODE_FIFO_KHR },
+        { "fifo_relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+        { "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+        { "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR },
+    };
+
+    struct DrawFormatName {
+        const char* name;
+        VkFormat format;
+    };
+
+    // the formats the shaders storing into the draw image are compiled for (see src/CMakeLists.txt)
+    const DrawFormatName DRAW_FORMATS[] = {
+        { "rgba16f", VK_FORMAT_R16G16B16A16_SFLOAT },
+        { "rgba32f", VK_FORMAT_R32G32B32A32_SFLOAT },
+    };
+
+    bool parse_uint(std::string_view text, uint32_t min, uint32_t max, uint32_t& out)
+    {
+        std::string value(text);
+        char* end = nullptr;
+        unsigned long long parsed = std::strtoull(value.c_str(), &end, 10);
+        if (value.empty() || value[0] == '-' || *end != '\0' || parsed < min || parsed > max) {
+            return false;
+        }
+        out = (uint32_t)parsed;
+        return true;
+    }
+
+    bool parse_float(std::string_view text, float min, float max, float& out)
+    {
+        std::string value(text);
+        char* end = nullptr;
+        float parsed = std::strtof(value.c_str(), &end);
+        // written this way round so NaN fails too
+        if (value.empty() || *end != '\0' || !(parsed >= min && parsed <= max)) {
+            return false;
+        }
+        out = parsed;
+        return true;
+    }
+
+    // without trailing zeros
+    template <typename T>
+    std::string format_number(T value)
+    {
+        std::ostringstream stream;
+        stream << value;
+        return stream.str();
+    }
+}
+
+bool EngineConfig::load(int argc, char* argv[])
+{
+    bool bValid = true;
+
+    // the file first, so that the environment and the command line override it
+    const char* path = std::getenv("SUNABA_CONFIG");
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::strcmp(argv[i], "--config") == 0) {
+            path = argv[++i];
+        }
+    }
+    if (path && *path && !load_file(path)) {
+        bValid = false;
+    }
+
+    for (const Setting& setting : SETTINGS) {
+        const char* value = std::getenv(setting.environment);
+        if (value && *value && !set(setting.key, value)) {
+            bValid = false;
+        }
+    }
+
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::strcmp(argv[i], "--set") != 0) {
+            continue;
+        }
+        std::string_view assignment = argv[++i];
+        size_t equals = assignment.find('=');
+        if (equals == std::string_view::npos) {
+            std::cout << "--set expects <key>=<value>, got " << assignment << std::endl;
+            bValid = false;
+        }
+        else if (!set(assignment.substr(0, equals), assignment.substr(equals + 1))) {
+            bValid = false;
+        }
+    }
+    return bValid;
+}
+
+bool EngineConfig::load_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "failed to open config file " << path << std::endl;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    JsonValue json;
+    if (!JsonValue::parse(text.str(), json) || !json.is_object()) {
+        std::cout << "config file " << path << " is not a JSON object" << std::endl;
+        return false;
+    }
+
+    bool bValid = true;
+    for (const auto& [key, value] : json.object) {
+        std::string valueText;
+        if (value.type == JsonValue::Type::String) {
+            valueText = value.string;
+        }
+        else if (value.type == JsonValue::Type::Number) {
+            // whole numbers as integers, which the stream would print in exponent notation from a million on
+            valueText = value.number == (double)(int64_t)value.number ? format_number((int64_t)value.number) : format_number(value.number);
+        }
+        if (valueText.empty()) {
+            std::cout << "ignored " << key << " in config file " << path << ": neither a number nor a string" << std::endl;
+            bValid = false;
+        }
+        else if (!set(key, valueText)) {
+            bValid = false;
+        }
+    }
+    return bValid;
+}
+
+bool EngineConfig::save_file(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    file << "{\n";
+    const size_t settingCount = sizeof(SETTINGS) / sizeof(SETTINGS[0]);
+    for (size_t i = 0; i < settingCount; i++) {
+        const Setting& setting = SETTINGS[i];
+        std::string value = get(setting.key);
+        file << "\t\"" << setting.key << "\": " << (setting.bString ? "\"" + value + "\"" : value) << (i + 1 < settingCount ? ",\n" : "\n");
+    }
+    file << "}\n";
+    return file.good();
+}
+
+bool EngineConfig::set(std::string_view key, std::string_view value)
+{
+    bool bValid = false;
+    bool bKnown = true;
+    if (key == "framesInFlight") {
+        bValid = parse_uint(value, 1, MAX_FRAMES_IN_FLIGHT, framesInFlight);
+    }
+    else if (key == "windowWidth") {
+        bValid = parse_uint(value, 1, 16384, windowWidth);
+    }
+    else if (key == "windowHeight") {
+        bValid = parse_uint(value, 1, 16384, windowHeight);
+    }
+    else if (key == "drawFormat") {
+        for (const DrawFormatName& format : DRAW_FORMATS) {
+            if (value == format.name) {
+                drawFormat = format.format;
+                bValid = true;
+            }
+        }
+    }
+    else if (key == "renderScale") {
+        bValid = parse_float(value, 0.1f, 1.f, renderScale);
+    }
+    else if (key == "presentMode") {
+        for (const PresentModeName& mode : PRESENT_MODES) {
+            if (value == mode.name) {
+                presentMode = mode.presentMode;
+                bValid = true;
+            }
+        }
+    }
+    else if (key == "descriptorGrowthFactor") {
+        bValid = parse_float(value, 1.f, 8.f, descriptorGrowthFactor);
+    }
+    else if (key == "descriptorPoolSetCap") {
+        bValid = parse_uint(value, 1, 1u << 20, descriptorPoolSetCap);
+    }
+    else if (key == "uploadBudgetMB") {
+        // below a megabyte, a large mesh would take thousands of frames to stream in
+        bValid = parse_uint(value, 1, 4096, uploadBudgetMB);
+    }
+    else {
+        bKnown = false;
+    }
+
+    if (!bKnown) {
+        std::cout << "unknown engine setting " << key << std::endl;
+    }
+    else if (!bValid) {
+        std::cout << "invalid value " << value << " for engine setting " << key << std::endl;
+    }
+    return bValid;
+}
+
+std::string EngineConfig::get(std::string_view key) const
+{
+    if (key == "framesInFlight") {
+        return format_number(framesInFlight);
+    }
+    if (key == "windowWidth") {
+        return format_number(windowWidth);
+    }
+    if (key == "windowHeight") {
+        return format_number(windowHeight);
+    }
+    if (key == "drawFormat") {
+        return get_draw_format_name(drawFormat);
+    }
+    if (key == "renderScale") {
+        return format_number(renderScale);
+    }
+    if (key == "presentMode") {
+        return get_present_mode_name(presentMode);
+    }
+    if (key == "descriptorGrowthFactor") {
+        return format_number(descriptorGrowthFactor);
+    }
+    if (key == "descriptorPoolSetCap") {
+        return format_number(descriptorPoolSetCap);
+    }
+    if (key == "uploadBudgetMB") {
+        return format_number(uploadBudgetMB);
+    }
+    return std::string();
+}
+
+std::string EngineConfig::to_string() const
+{
+    std::string text;
+    for (const Setting& setting : SETTINGS) {
+        if (!text.empty()) {
+            text += ' ';
+        }
+        text += setting.key;
+        text += '=';
+        text += get(setting.key);
+    }
+    return text;
+}
+
+const char* EngineConfig::get_present_mode_name(VkPresentModeKHR presentMode)
+{
+    for (const PresentModeName& mode : PRESENT_MODES) {
+        if (mode.presentMode == presentMode) {
+            return mode.name;
+        }
+    }
+    return "other";
+}
+
+const char* EngineConfig::get_draw_format_name(VkFormat format)
+{
+    for (const DrawFormatName& entry : DRAW_FORMATS) {
+        if (entry.format == format) {
+            return entry.name;
+        }
+    }
+    return "other";
+}
\ No newline at end of file
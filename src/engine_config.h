@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <volk.h>
+
+// Engine settings that are not compiled in, so scripts can sweep them (e.g. A/B performance runs) without rebuilding.
+// Each starts at its default below and is overridden, in this order, by a JSON config file (the one --config names, or
+// SUNABA_CONFIG), by SUNABA_<KEY> environment variables (framesInFlight: SUNABA_FRAMES_IN_FLIGHT) and by --set <key>=<value>
+// on the command line. Startup settings are fixed once the engine is initialized; runtime ones can be changed later
+// through VulkanEngine::apply_config, as the Tuning window does.
+//   framesInFlight          1 to MAX_FRAMES_IN_FLIGHT                            startup
+//   windowWidth/Height      initial window size, and the size of the draw image  startup
+//   drawFormat              rgba16f or rgba32f                                   startup
+//   renderScale             0.1 to 1, scene resolution relative to the output    runtime
+//   presentMode             fifo, fifo_relaxed, mailbox or immediate             runtime (recreates the swapchain)
+//   descriptorGrowthFactor  1 to 8, set count growth of new descriptor pools     runtime (pools created from then on)
+//   descriptorPoolSetCap    largest set count of a descriptor pool               runtime (pools created from then on)
+//   uploadBudgetMB          asset data staged per frame at most                  runtime
+struct EngineConfig {
+	inline static const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+	uint32_t framesInFlight = 2;
+	uint32_t windowWidth = 1700;
+	uint32_t windowHeight = 900;
+	VkFormat drawFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+	float renderScale = 1.f;
+	// falls back to FIFO, which every device supports, when the surface does not support it
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	float descriptorGrowthFactor = 2.f;
+	uint32_t descriptorPoolSetCap = 4092;
+	uint32_t uploadBudgetMB = 32;
+
+	// applies the config file, then the environment, then the --set arguments of argv (which may hold others, which are
+	// skipped); false if anything was invalid, after printing what. Valid settings are applied regardless
+	bool load(int argc, char* argv[]);
+	bool load_file(const std::string& path);
+	// writes every setting, for load_file
+	bool save_file(const std::string& path) const;
+
+	// one setting by its key; false (printing why) if there is no such key or the value is invalid or out of range
+	bool set(std::string_view key, std::string_view value);
+	// the value of the setting with that key as set accepts it, empty if there is no such key
+	std::string get(std::string_view key) const;
+	// every setting as space separated key=value pairs, for logs and benchmark output
+	std::string to_string() const;
+
+	static const char* get_present_mode_name(VkPresentModeKHR presentMode);
+	static const char* get_draw_format_name(VkFormat format);
+};
\ No newline at end of file
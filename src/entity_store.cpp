@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+#include "entity_store.h"
+#include "job_system.h"
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#endif
+
+namespace {
+    constexpr uint32_t UNKNOWN_DEPTH = UINT32_MAX;
+
+    // out = a * b for column major glm matrices; out must not alias either input. glm's own operator is scalar unless it is
+    // built with GLM_FORCE_INTRINSICS, and matrices are not guaranteed 16 byte aligned, hence unaligned loads
+    void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+    {
+#if defined(__AVX__)
+        // two result columns per iteration: every 128 bit lane holds one column of b, and a's columns are repeated in both
+        const __m256 a0 = _mm256_broadcast_ps((const __m128*)&a[0][0]);
+        const __m256 a1 = _mm256_broadcast_ps((const __m128*)&a[1][0]);
+        const __m256 a2 = _mm256_broadcast_ps((const __m128*)&a[2][0]);
+        const __m256 a3 = _mm256_broadcast_ps((const __m128*)&a[3][0]);
+        for (int column = 0; column < 4; column += 2) {
+            __m256 bColumns = _mm256_loadu_ps(&b[column][0]);
+            __m256 result = _mm256_mul_ps(a0, _mm256_permute_ps(bColumns, 0x00));
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+            result = _mm256_fmadd_ps(a1, _mm256_permute_ps(bColumns, 0x55), result);
+            result = _mm256_fmadd_ps(a2, _mm256_permute_ps(bColumns, 0xAA), result);
+            result = _mm256_fmadd_ps(a3, _mm256_permute_ps(bColumns, 0xFF), result);
+#else
+            result = _mm256_add_ps(result, _mm256_mul_ps(a1, _mm256_permute_ps(bColumns, 0x55)));
+            result = _mm256_add_ps(result, _mm256_mul_ps(a2, _mm256_permute_ps(bColumns, 0xAA)));
+            result = _mm256_add_ps(result, _mm256_mul_ps(a3, _mm256_permute_ps(bColumns, 0xFF)));
+#endif
+            _mm256_storeu_ps(&out[column][0], result);
+        }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+        const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+        const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+        const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+        for (int column = 0; column < 4; column++) {
+            __m128 bColumn = _mm_loadu_ps(&b[column][0]);
+            __m128 result = _mm_mul_ps(a0, _mm_shuffle_ps(bColumn, bColumn, 0x00));
+            result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_shuffle_ps(bColumn, bColumn, 0x55)));
+            result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_shuffle_ps(bColumn, bColumn, 0xAA)));
+            result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_shuffle_ps(bColumn, bColumn, 0xFF)));
+            _mm_storeu_ps(&out[column][0], result);
+        }
+#else
+        out = a * b;
+#endif
+    }
+}
+
+Entity EntityStore::create(Entity parent)
+{
+    uint32_t slotIndex;
+    if (!mFreeSlots.empty()) {
+        slotIndex = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+    else {
+        slotIndex = (uint32_t)mSlots.size();
+        mSlots.push_back({ 0, 0, false });
+    }
+    Slot& slot = mSlots[slotIndex];
+    slot.denseIndex = (uint32_t)mEntities.size();
+    slot.bAlive = true;
+    Entity entity{ ((uint32_t)slot.generation << Entity::INDEX_BITS) | slotIndex };
+
+    uint32_t parentIndex = is_alive(parent) ? mSlots[parent.index()].denseIndex : NO_PARENT;
+    uint32_t depth = parentIndex != NO_PARENT ? mDepths[parentIndex] + 1 : 0;
+    mEntities.push_back(entity);
+    mParents.push_back(parentIndex);
+    mDepths.push_back(depth);
+    mLocalTransforms.push_back(glm::mat4(1.f));
+    mWorldTransforms.push_back(glm::mat4(1.f));
+    mMeshIndices.push_back(NO_MESH);
+    mDirtyFlags.push_back(DIRTY_LOCAL);
+
+    // appending keeps parents before children, and the depth ranges too if the entity extends the last one or opens the
+    // next; anything else waits for the next sort
+    if (!mOrderStale) {
+        uint32_t depthCount = mDepthOffsets.empty() ? 0 : (uint32_t)mDepthOffsets.size() - 1;
+        if (depthCount > 0 && depth == depthCount - 1) {
+            mDepthOffsets.back()++;
+        }
+        else if (depth == depthCount) {
+            if (mDepthOffsets.empty()) {
+                mDepthOffsets.push_back(slot.denseIndex);
+            }
+            mDepthOffsets.push_back(slot.denseIndex + 1);
+        }
+        else {
+            mOrderStale = true;
+        }
+    }
+    return entity;
+}
+
+void EntityStore::destroy(Entity entity)
+{
+    if (!is_alive(entity)) {
+        return;
+    }
+    // descendants are found in one pass once every parent comes before its children
+    if (mOrderStale) {
+        sort();
+    }
+
+    const uint32_t count = size();
+    std::vector<uint32_t> newIndices(count);
+    std::vector<uint8_t> bRemoved(count, 0);
+    bRemoved[mSlots[entity.index()].denseIndex] = 1;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        bRemoved[i] |= mParents[i] != NO_PARENT && bRemoved[mParents[i]];
+        if (bRemoved[i]) {
+            Slot& slot = mSlots[mEntities[i].index()];
+            slot.bAlive = false;
+            slot.generation++;
+            mFreeSlots.push_back(mEntities[i].index());
+            continue;
+        }
+        // compaction keeps the order, so every parent is already moved
+        newIndices[i] = kept;
+        mEntities[kept] = mEntities[i];
+        mParents[kept] = mParents[i] != NO_PARENT ? newIndices[mParents[i]] : NO_PARENT;
+        mDepths[kept] = mDepths[i];
+        mLocalTransforms[kept] = mLocalTransforms[i];
+        mWorldTransforms[kept] = mWorldTransforms[i];
+        mMeshIndices[kept] = mMeshIndices[i];
+        mDirtyFlags[kept] = mDirtyFlags[i];
+        mSlots[mEntities[kept].index()].denseIndex = kept;
+        kept++;
+    }
+    mEntities.resize(kept);
+    mParents.resize(kept);
+    mDepths.resize(kept);
+    mLocalTransforms.resize(kept);
+    mWorldTransforms.resize(kept);
+    mMeshIndices.resize(kept);
+    mDirtyFlags.resize(kept);
+
+    mDepthOffsets.clear();
+    for (uint32_t i = 0; i < kept; i++) {
+        if (i == 0 || mDepths[i] != mDepths[i - 1]) {
+            mDepthOffsets.push_back(i);
+        }
+    }
+    if (kept > 0) {
+        mDepthOffsets.push_back(kept);
+    }
+}
+
+bool EntityStore::is_alive(Entity entity) const
+{
+    if (!entity.is_valid() || entity.index() >= mSlots.size()) {
+        return false;
+    }
+    const Slot& slot = mSlots[entity.index()];
+    return slot.bAlive && slot.generation == (uint8_t)entity.generation();
+}
+
+void EntityStore::set_parent(Entity entity, Entity parent)
+{
+    if (!is_alive(entity)) {
+        return;
+    }
+    uint32_t index = mSlots[entity.index()].denseIndex;
+    uint32_t parentIndex = is_alive(parent) ? mSlots[parent.index()].denseIndex : NO_PARENT;
+    for (uint32_t ancestor = parentIndex; ancestor != NO_PARENT; ancestor = mParents[ancestor]) {
+        if (ancestor == index) {
+            return;
+        }
+    }
+    if (mParents[index] == parentIndex) {
+        return;
+    }
+    mParents[index] = parentIndex;
+    // the whole subtree moves to other depths; its world transforms follow the entity's through the update
+    mark_dirty(index);
+    mOrderStale = true;
+}
+
+Entity EntityStore::get_parent(Entity entity) const
+{
+    uint32_t parentIndex = mParents[mSlots[entity.index()].denseIndex];
+    return parentIndex != NO_PARENT ? mEntities[parentIndex] : Entity();
+}
+
+void EntityStore::set_local_transform(Entity entity, const glm::mat4& transform)
+{
+    uint32_t index = mSlots[entity.index()].denseIndex;
+    mLocalTransforms[index] = transform;
+    mark_dirty(index);
+}
+
+void EntityStore::set_local_transform(Entity entity, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+    glm::mat4 transform = glm::mat4_cast(rotation);
+    transform[0] *= scale.x;
+    transform[1] *= scale.y;
+    transform[2] *= scale.z;
+    transform[3] = glm::vec4(translation, 1.f);
+    set_local_transform(entity, transform);
+}
+
+void EntityStore::sort()
+{
+    const uint32_t count = size();
+
+    // reparenting can put a parent after its children, so depths are resolved along parent chains, each entity once
+    std::vector<uint32_t> depths(count, UNKNOWN_DEPTH);
+    std::vector<uint32_t> chain;
+    uint32_t depthCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t current = i;
+        while (current != NO_PARENT && depths[current] == UNKNOWN_DEPTH) {
+            chain.push_back(current);
+            current = mParents[current];
+        }
+        uint32_t depth = current != NO_PARENT ? depths[current] + 1 : 0;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            depths[*it] = depth++;
+        }
+        chain.clear();
+        depthCount = std::max(depthCount, depths[i] + 1);
+    }
+
+    // counting sort, stable so entities keep their relative order within a depth
+    mDepthOffsets.assign(depthCount + 1, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        mDepthOffsets[depths[i] + 1]++;
+    }
+    for (uint32_t depth = 0; depth < depthCount; depth++) {
+        mDepthOffsets[depth + 1] += mDepthOffsets[depth];
+    }
+    std::vector<uint32_t> newIndices(count);
+    std::vector<uint32_t> next(mDepthOffsets.begin(), mDepthOffsets.end() - 1);
+    for (uint32_t i = 0; i < count; i++) {
+        newIndices[i] = next[depths[i]]++;
+    }
+
+    auto permute = [&](auto& component) {
+        std::remove_reference_t<decltype(component)> sorted(count);
+        for (uint32_t i = 0; i < count; i++) {
+            sorted[newIndices[i]] = component[i];
+        }
+        component = std::move(sorted);
+    };
+    for (uint32_t& parent : mParents) {
+        parent = parent != NO_PARENT ? newIndices[parent] : NO_PARENT;
+    }
+    mDepths = std::move(depths);
+    permute(mEntities);
+    permute(mParents);
+    permute(mDepths);
+    permute(mLocalTransforms);
+    permute(mWorldTransforms);
+    permute(mMeshIndices);
+    permute(mDirtyFlags);
+    for (uint32_t i = 0; i < count; i++) {
+        mSlots[mEntities[i].index()].denseIndex = i;
+    }
+    mOrderStale = false;
+}
+
+void EntityStore::update(JobSystem* jobSystem)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    mStats.bSorted = mOrderStale;
+    if (mOrderStale) {
+        sort();
+    }
+
+    // a depth only reads the world transforms and flags of the one before it, so its entities are independent
+    std::atomic<uint32_t> updatedTransforms{ 0 };
+    for (size_t depth = 0; depth + 1 < mDepthOffsets.size(); depth++) {
+        uint32_t begin = mDepthOffsets[depth];
+        uint32_t count = mDepthOffsets[depth + 1] - begin;
+        if (jobSystem && count >= PARALLEL_MIN_ENTITIES) {
+            jobSystem->parallel_for(count, PARALLEL_BATCH_SIZE, [&](uint32_t batchBegin, uint32_t batchEnd) {
+                updatedTransforms += update_range(begin + batchBegin, begin + batchEnd);
+            });
+        }
+        else {
+            updatedTransforms += update_range(begin, begin + count);
+        }
+    }
+
+    mStats.entityCount = size();
+    mStats.depthCount = mDepthOffsets.empty() ? 0 : (uint32_t)mDepthOffsets.size() - 1;
+    mStats.updatedTransforms = updatedTransforms;
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    mStats.updateTime = elapsed.count() / 1000.f;
+}
+
+uint32_t EntityStore::update_range(uint32_t begin, uint32_t end)
+{
+    uint32_t updated = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t parent = mParents[i];
+        bool bParentChanged = parent != NO_PARENT && (mDirtyFlags[parent] & DIRTY_WORLD);
+        if (!(mDirtyFlags[i] & DIRTY_LOCAL) && !bParentChanged) {
+            // also clears a DIRTY_WORLD left from the previous update
+            mDirtyFlags[i] = 0;
+            continue;
+        }
+        if (parent == NO_PARENT) {
+            mWorldTransforms[i] = mLocalTransforms[i];
+        }
+        else {
+            multiply(mWorldTransforms[parent], mLocalTransforms[i], mWorldTransforms[i]);
+        }
+        mDirtyFlags[i] = DIRTY_WORLD;
+        updated++;
+    }
+    return updated;
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class JobSystem;
+
+// a handle to an entity: slot index in the low 24 bits, the slot's generation in the high 8, so a handle kept after its
+// entity was destroyed is recognized as stale even once the slot is reused
+struct Entity {
+	static constexpr uint32_t INDEX_BITS = 24;
+	static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+
+	uint32_t id = UINT32_MAX;
+
+	uint32_t index() const { return id & INDEX_MASK; }
+	uint32_t generation() const { return id >> INDEX_BITS; }
+	bool is_valid() const { return id != UINT32_MAX; }
+	bool operator==(const Entity& other) const = default;
+};
+
+// Entities and their components, stored as structure of arrays: every component is a dense array indexed the same way,
+// so a pass over one component streams through memory without touching the others. The dense order is sorted by hierarchy
+// depth, so parents always come before their children and each depth is one contiguous range whose world transforms only
+// depend on the range before it. The world transform update walks the ranges in order, recomputes only what changed
+// (a dirty local transform, or a parent whose world transform changed this update), splits large ranges across the job
+// system and multiplies with SSE (or AVX when the engine is built with SUNABA_AVX2).
+// Slots map handles to dense indices; structural changes (create, destroy, set_parent) only mark the order as stale,
+// and the next update sorts once for all of them
+class EntityStore {
+public:
+	static constexpr uint32_t NO_MESH = UINT32_MAX;
+	// ranges smaller than this are updated on the calling thread; below it the job round trip costs more than it saves
+	static constexpr uint32_t PARALLEL_MIN_ENTITIES = 4096;
+	static constexpr uint32_t PARALLEL_BATCH_SIZE = 1024;
+
+	// of the most recent update
+	struct Stats {
+		uint32_t entityCount;
+		uint32_t depthCount;
+		uint32_t updatedTransforms;
+		bool bSorted;
+		float updateTime; // ms
+	};
+
+	// parent, if given, must be alive; the entity starts with an identity local transform and no mesh
+	Entity create(Entity parent = Entity());
+	// destroys the entity and every descendant
+	void destroy(Entity entity);
+	bool is_alive(Entity entity) const;
+	uint32_t size() const { return (uint32_t)mEntities.size(); }
+
+	// reparents entity (to the root if parent is invalid); ignored if parent is entity itself or one of its descendants
+	void set_parent(Entity entity, Entity parent);
+	Entity get_parent(Entity entity) const;
+
+	void set_local_transform(Entity entity, const glm::mat4& transform);
+	void set_local_transform(Entity entity, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+	const glm::mat4& get_local_transform(Entity entity) const { return mLocalTransforms[mSlots[entity.index()].denseIndex]; }
+	// as of the last update
+	const glm::mat4& get_world_transform(Entity entity) const { return mWorldTransforms[mSlots[entity.index()].denseIndex]; }
+
+	void set_mesh(Entity entity, uint32_t meshIndex) { mMeshIndices[mSlots[entity.index()].denseIndex] = meshIndex; }
+	uint32_t get_mesh(Entity entity) const { return mMeshIndices[mSlots[entity.index()].denseIndex]; }
+
+	// brings every world transform up to date; with a job system, large depth ranges are split across its workers
+	void update(JobSystem* jobSystem = nullptr);
+
+	// dense components in depth order, valid until the next structural change or update. World transforms are contiguous
+	// matrices, so they can be copied as they are into a GPU buffer
+	std::span<const Entity> get_entities() const { return mEntities; }
+	std::span<const glm::mat4> get_world_transforms() const { return mWorldTransforms; }
+	std::span<const uint32_t> get_mesh_indices() const { return mMeshIndices; }
+	// whether the last update recomputed the world transform at denseIndex (an index into the spans above)
+	bool is_world_updated(uint32_t denseIndex) const { return mDirtyFlags[denseIndex] & DIRTY_WORLD; }
+
+	Stats get_stats() const { return mStats; }
+
+private:
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	struct Slot {
+		uint32_t denseIndex;
+		uint8_t generation;
+		bool bAlive;
+	};
+
+	// restores depth order after structural changes and rebuilds the depth ranges
+	void sort();
+	// returns how many world transforms it recomputed
+	uint32_t update_range(uint32_t begin, uint32_t end);
+	void mark_dirty(uint32_t denseIndex) { mDirtyFlags[denseIndex] |= DIRTY_LOCAL; }
+
+	static constexpr uint8_t DIRTY_LOCAL = 1; // local transform changed since the last update
+	static constexpr uint8_t DIRTY_WORLD = 2; // world transform changed in the current update
+
+	// dense components
+	std::vector<Entity> mEntities;
+	std::vector<uint32_t> mParents; // dense index, or NO_PARENT
+	std::vector<uint32_t> mDepths;
+	std::vector<glm::mat4> mLocalTransforms;
+	std::vector<glm::mat4> mWorldTransforms;
+	std::vector<uint32_t> mMeshIndices;
+	std::vector<uint8_t> mDirtyFlags;
+
+	std::vector<Slot> mSlots;
+	std::vector<uint32_t> mFreeSlots;
+	// first dense index of every depth, plus the end; only valid while the order is not stale
+	std::vector<uint32_t> mDepthOffsets;
+	bool mOrderStale = false;
+
+	Stats mStats{};
+};
\ No newline at end of file
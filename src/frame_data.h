@@ -3,12 +3,24 @@
 #include <volk.h>
 #include "deletion_queue.h"
 #include "vk_descriptors.h"
+#include "vk_types.h"
 
 struct FrameData {
 	VkCommandPool mCommandPool;
 	VkCommandBuffer mMainCommandBuffer;
+	// recorded after the async compute passes when they run on their own queue (compositing, UI and present transitions)
+	VkCommandBuffer mCompositeCommandBuffer;
+	// pool on the compute queue family; unused when compute falls back to the graphics queue
+	VkCommandPool mComputeCommandPool;
+	VkCommandBuffer mComputeCommandBuffer;
 	VkSemaphore mSwapchainSemaphore, mRenderSemaphore;
+	// scene done on graphics -> compute passes may start, compute passes done -> compositing may start
+	VkSemaphore mSceneSemaphore, mComputeSemaphore;
 	VkFence mRenderFence;
+	// each frame draws into its own image, so the next frame's scene can start while this frame's post passes still use it
+	AllocatedImage mDrawImage;
+	// the background's storage image binding of mDrawImage
+	VkDescriptorSet mBackgroundSet;
 	DeletionQueue mDeletionQueue;
 	DescriptorAllocatorGrowable mFrameDescriptors;
 };
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cmath>
+#include "frame_governor.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+    // CPU time of the whole process (every thread), user and kernel, in seconds
+    double get_process_cpu_time()
+    {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+            return 0.0;
+        }
+        auto to_ticks = [](const FILETIME& time) { return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime; };
+        // 100 ns ticks
+        return (to_ticks(kernel) + to_ticks(user)) * 1e-7;
+#else
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0.0;
+        }
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+    }
+}
+
+void FrameGovernor::init()
+{
+    Clock::time_point now = Clock::now();
+    mLastActivity = now;
+    mLastFrame = now - std::chrono::hours(1);
+    mWindowStart = now;
+    mWindowCpuStart = get_process_cpu_time();
+    mWindowGoverned = mSettings.bEnabled;
+    mStats.mode = Mode::Active;
+}
+
+void FrameGovernor::notify_activity()
+{
+    mLastActivity = Clock::now();
+    mFramesSinceActivity = 0;
+}
+
+void FrameGovernor::set_animating(bool bAnimating)
+{
+    // the settle time counts from when the animation stops
+    if (mAnimating && !bAnimating) {
+        notify_activity();
+    }
+    mAnimating = bAnimating;
+}
+
+void FrameGovernor::set_focused(bool bFocused)
+{
+    if (bFocused != mFocused) {
+        mFocused = bFocused;
+        notify_activity();
+    }
+}
+
+void FrameGovernor::set_visible(bool bVisible)
+{
+    if (bVisible != mVisible) {
+        mVisible = bVisible;
+        notify_activity();
+    }
+}
+
+FrameGovernor::Mode FrameGovernor::get_mode() const
+{
+    if (!mVisible) {
+        return Mode::Hidden;
+    }
+    if (!mSettings.bEnabled) {
+        return Mode::Active;
+    }
+    std::chrono::duration<float> sinceActivity = Clock::now() - mLastActivity;
+    bool bSettled = sinceActivity.count() > std::max(mSettings.settleTime, mSettleSeconds) && mFramesSinceActivity >= mSettleFrames;
+    if (!mAnimating && bSettled) {
+        return Mode::Idle;
+    }
+    return mFocused ? Mode::Active : Mode::Throttled;
+}
+
+int32_t FrameGovernor::get_wait_timeout() const
+{
+    switch (get_mode()) {
+    case Mode::Active:
+        return 0;
+    case Mode::Throttled: {
+        std::chrono::duration<double, std::milli> sinceFrame = Clock::now() - mLastFrame;
+        double interval = 1000.0 / std::max(mSettings.unfocusedFrameRate, 0.1f);
+        return (int32_t)std::ceil(std::max(interval - sinceFrame.count(), 0.0));
+    }
+    default:
+        return -1;
+    }
+}
+
+bool FrameGovernor::begin_frame()
+{
+    Clock::time_point now = Clock::now();
+    update_utilization(now);
+
+    mStats.mode = get_mode();
+    bool bDue = mStats.mode == Mode::Active;
+    if (mStats.mode == Mode::Throttled) {
+        std::chrono::duration<double> sinceFrame = now - mLastFrame;
+        bDue = sinceFrame.count() >= 1.0 / std::max(mSettings.unfocusedFrameRate, 0.1f);
+    }
+    if (bDue) {
+        mLastFrame = now;
+        mFramesSinceActivity++;
+    }
+    return bDue;
+}
+
+void FrameGovernor::end_frame(float gpuBusyTime)
+{
+    mWindowGpuTime += gpuBusyTime;
+    mWindowFrames++;
+}
+
+void FrameGovernor::update_utilization(Clock::time_point now)
+{
+    if (mSettings.bEnabled != mWindowGoverned) {
+        mWindowMixed = true;
+    }
+    std::chrono::duration<double> elapsed = now - mWindowStart;
+    if (elapsed.count() < 1.0) {
+        return;
+    }
+
+    double cpuTime = get_process_cpu_time();
+    Utilization utilization;
+    utilization.cpu = (float)((cpuTime - mWindowCpuStart) / elapsed.count());
+    utilization.gpu = (float)std::min(mWindowGpuTime / 1000.0 / elapsed.count(), 1.0);
+    utilization.frameRate = (float)(mWindowFrames / elapsed.count());
+    mStats.current = utilization;
+    if (!mWindowMixed) {
+        (mWindowGoverned ? mStats.governed : mStats.ungoverned) = utilization;
+    }
+
+    mWindowStart = now;
+    mWindowCpuStart = cpuTime;
+    mWindowGpuTime = 0.0;
+    mWindowFrames = 0;
+    mWindowGoverned = mSettings.bEnabled;
+    mWindowMixed = false;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Decides when the main loop renders. While something changes on screen (input, a moving camera, assets streaming in, a
+// capture) and until temporal effects converged after it stops, frames run at the display's rate: for settleTime, and for
+// as long and as many frames as set_settling asks for (auto-exposure adapts over time, TAA history over frames), so the
+// last frame is never left half adapted however slowly frames render. After that the loop renders on demand only: it
+// blocks in the event queue until input wakes it, which it does at once. Without focus, frames are capped at
+// unfocusedFrameRate, and a hidden or fully occluded window renders nothing.
+// CPU (process time, all threads) and GPU (graphics queue busy time) utilization are averaged over one second windows and
+// kept separately for time spent with and without the governor, to compare the two
+class FrameGovernor {
+public:
+	enum class Mode : uint32_t { Active, Throttled, Idle, Hidden };
+
+	struct Settings {
+		bool bEnabled = true;
+		float unfocusedFrameRate = 10.f;
+		// seconds of full rate rendering after the last change
+		float settleTime = 2.f;
+	};
+
+	struct Utilization {
+		float cpu; // fraction of one core
+		float gpu; // fraction of the time the graphics queue was busy
+		float frameRate;
+	};
+
+	struct Stats {
+		Mode mode;
+		// of the last complete window
+		Utilization current;
+		// of the last complete window spent with the governor enabled, and disabled
+		Utilization governed;
+		Utilization ungoverned;
+	};
+
+	Settings mSettings;
+
+	void init();
+
+	// input, or anything else that changes what is on screen: renders at full rate again, from the next frame on
+	void notify_activity();
+	// whether anything is changing on its own right now (streaming, camera motion, ...); reported once per frame
+	void set_animating(bool bAnimating);
+	// how long (s) and how many frames temporal effects need after the last change to converge, on top of settleTime
+	void set_settling(float seconds, uint32_t frames) { mSettleSeconds = seconds; mSettleFrames = frames; }
+	void set_focused(bool bFocused);
+	// false while the window is minimized, hidden or fully occluded
+	void set_visible(bool bVisible);
+
+	// how long the loop may block waiting for events before the next frame is due, in ms: -1 until an event arrives, 0 not at all
+	int32_t get_wait_timeout() const;
+	// whether a frame is due now; if so it is counted as started
+	bool begin_frame();
+	// gpuBusyTime: graphics queue time of the most recent frame whose timings were read back, in ms
+	void end_frame(float gpuBusyTime);
+
+	Mode get_mode() const;
+	Stats get_stats() const { return mStats; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	void update_utilization(Clock::time_point now);
+
+	Clock::time_point mLastActivity;
+	Clock::time_point mLastFrame;
+	// rendered since the last activity
+	uint32_t mFramesSinceActivity = 0;
+	float mSettleSeconds = 0.f;
+	uint32_t mSettleFrames = 0;
+	bool mAnimating = false;
+	bool mFocused = true;
+	bool mVisible = true;
+
+	// the current utilization window
+	Clock::time_point mWindowStart;
+	double mWindowCpuStart = 0.0;
+	double mWindowGpuTime = 0.0; // ms
+	uint32_t mWindowFrames = 0;
+	// whether the governor was enabled for the whole window; windows that toggled it count for neither side
+	bool mWindowGoverned = true;
+	bool mWindowMixed = false;
+
+	Stats mStats{};
+};
\ No newline at end of file
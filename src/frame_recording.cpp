@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <type_traits>
+#include "frame_recording.h"
+
+namespace {
+    constexpr char MAGIC[4] = { 'S', 'N', 'B', 'R' };
+    constexpr uint32_t FORMAT_VERSION = 1;
+
+    enum class RecordType : uint8_t {
+        Config = 1,
+        Load = 2,
+        Lights = 3,
+        Frame = 4,
+        Cost = 5
+    };
+
+    // Load record flags
+    constexpr uint8_t LOAD_TEXTURE = 1;
+    constexpr uint8_t LOAD_RESIDENT = 2;
+
+    class PayloadWriter {
+    public:
+        template <typename T>
+        void put(T value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            size_t offset = mBytes.size();
+            mBytes.resize(offset + sizeof(T));
+            std::memcpy(mBytes.data() + offset, &value, sizeof(T));
+        }
+
+        void put_bool(bool value) { put<uint8_t>(value ? 1 : 0); }
+        void put_vec3(const glm::vec3& value) { put(value.x); put(value.y); put(value.z); }
+        void put_vec4(const glm::vec4& value) { put(value.x); put(value.y); put(value.z); put(value.w); }
+
+        void put_string(const std::string& text)
+        {
+            put((uint32_t)text.size());
+            mBytes.insert(mBytes.end(), text.begin(), text.end());
+        }
+
+        const std::vector<uint8_t>& get_bytes() const { return mBytes; }
+
+    private:
+        std::vector<uint8_t> mBytes;
+    };
+
+    // reads fields in the order they were written; once the payload is used up (the field is newer than the recording),
+    // reads leave the value they are given as it is, i.e. at its default
+    class PayloadReader {
+    public:
+        PayloadReader(const uint8_t* data, size_t size) : mCursor(data), mEnd(data + size) {}
+
+        template <typename T>
+        void get(T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if ((size_t)(mEnd - mCursor) < sizeof(T)) {
+                mCursor = mEnd;
+                return;
+            }
+            std::memcpy(&value, mCursor, sizeof(T));
+            mCursor += sizeof(T);
+        }
+
+        void get_bool(bool& value)
+        {
+            uint8_t byte = value ? 1 : 0;
+            get(byte);
+            value = byte != 0;
+        }
+
+        void get_vec3(glm::vec3& value) { get(value.x); get(value.y); get(value.z); }
+        void get_vec4(glm::vec4& value) { get(value.x); get(value.y); get(value.z); get(value.w); }
+
+        void get_string(std::string& text)
+        {
+            uint32_t length = 0;
+            get(length);
+            length = (uint32_t)std::min<size_t>(length, mEnd - mCursor);
+            text.assign((const char*)mCursor, length);
+            mCursor += length;
+        }
+
+    private:
+        const uint8_t* mCursor;
+        const uint8_t* mEnd;
+    };
+
+    // read_frame must mirror this; new fields go at the end of both
+    void write_frame(PayloadWriter& writer, const RecordedFrame& frame)
+    {
+        writer.put(frame.frameIndex);
+        writer.put(frame.deltaTime);
+        writer.put(frame.outputWidth);
+        writer.put(frame.outputHeight);
+        writer.put(frame.renderScale);
+
+        writer.put_vec3(frame.cameraPosition);
+        writer.put(frame.cameraYaw);
+        writer.put(frame.cameraPitch);
+        writer.put(frame.cameraVerticalFov);
+        writer.put(frame.cameraNearPlane);
+        writer.put(frame.cameraFarPlane);
+        writer.put_vec3(frame.sunDirection);
+        for (const glm::vec4& value : frame.background) {
+            writer.put_vec4(value);
+        }
+
+        const PostProcessSettings& post = frame.postProcess;
+        writer.put_bool(post.bEnabled);
+        writer.put_bool(post.bAutoExposure);
+        writer.put_bool(post.bBloom);
+        writer.put((int32_t)post.tonemapper);
+        writer.put(post.exposureCompensation);
+        writer.put(post.manualExposure);
+        writer.put(post.adaptationSpeed);
+        writer.put(post.minLogLuminance);
+        writer.put(post.maxLogLuminance);
+        writer.put(post.bloomIntensity);
+        writer.put(post.bloomThreshold);
+        writer.put(post.bloomKnee);
+        writer.put(post.bloomFilterRadius);
+        writer.put((int32_t)post.bloomMipCount);
+
+        const TemporalAntiAliasing::Settings& taa = frame.temporalAA;
+        writer.put_bool(taa.bEnabled);
+        writer.put(taa.currentWeight);
+        writer.put(taa.clipGamma);
+        writer.put_bool(taa.bSharpHistory);
+
+        const CascadedShadowMaps::Settings& shadows = frame.shadows;
+        writer.put_bool(shadows.bEnabled);
+        writer.put(shadows.maxDistance);
+        writer.put(shadows.splitLambda);
+        writer.put_bool(shadows.bStabilize);
+        writer.put_bool(shadows.bCacheStatic);
+        writer.put_bool(shadows.bParallelRecording);
+        writer.put(shadows.casterDistance);
+        writer.put(shadows.depthBiasConstant);
+        writer.put(shadows.depthBiasSlope);
+
+        writer.put((uint8_t)frame.lighting.binning);
+
+        const ClusterRenderer::Settings& clusters = frame.clusters;
+        writer.put_bool(clusters.bFrustumCulling);
+        writer.put_bool(clusters.bBackfaceCulling);
+        writer.put_bool(clusters.bOcclusionCulling);
+        writer.put(clusters.lodErrorPixels);
+        writer.put(clusters.lodHysteresis);
+        writer.put((int32_t)clusters.forcedLod);
+
+        writer.put_bool(frame.staticPasses.bEnabled);
+        writer.put(frame.visibleNodesFirst);
+        writer.put(frame.visibleNodesCount);
+    }
+
+    void read_frame(PayloadReader& reader, RecordedFrame& frame)
+    {
+        reader.get(frame.frameIndex);
+        reader.get(frame.deltaTime);
+        reader.get(frame.outputWidth);
+        reader.get(frame.outputHeight);
+        reader.get(frame.renderScale);
+
+        reader.get_vec3(frame.cameraPosition);
+        reader.get(frame.cameraYaw);
+        reader.get(frame.cameraPitch);
+        reader.get(frame.cameraVerticalFov);
+        reader.get(frame.cameraNearPlane);
+        reader.get(frame.cameraFarPlane);
+        reader.get_vec3(frame.sunDirection);
+        for (glm::vec4& value : frame.background) {
+            reader.get_vec4(value);
+        }
+
+        PostProcessSettings& post = frame.postProcess;
+        int32_t tonemapper = post.tonemapper;
+        int32_t bloomMipCount = post.bloomMipCount;
+        reader.get_bool(post.bEnabled);
+        reader.get_bool(post.bAutoExposure);
+        reader.get_bool(post.bBloom);
+        reader.get(tonemapper);
+        reader.get(post.exposureCompensation);
+        reader.get(post.manualExposure);
+        reader.get(post.adaptationSpeed);
+        reader.get(post.minLogLuminance);
+        reader.get(post.maxLogLuminance);
+        reader.get(post.bloomIntensity);
+        reader.get(post.bloomThreshold);
+        reader.get(post.bloomKnee);
+        reader.get(post.bloomFilterRadius);
+        reader.get(bloomMipCount);
+        post.tonemapper = tonemapper;
+        post.bloomMipCount = bloomMipCount;
+
+        TemporalAntiAliasing::Settings& taa = frame.temporalAA;
+        reader.get_bool(taa.bEnabled);
+        reader.get(taa.currentWeight);
+        reader.get(taa.clipGamma);
+        reader.get_bool(taa.bSharpHistory);
+
+        CascadedShadowMaps::Settings& shadows = frame.shadows;
+        reader.get_bool(shadows.bEnabled);
+        reader.get(shadows.maxDistance);
+        reader.get(shadows.splitLambda);
+        reader.get_bool(shadows.bStabilize);
+        reader.get_bool(shadows.bCacheStatic);
+        reader.get_bool(shadows.bParallelRecording);
+        reader.get(shadows.casterDistance);
+        reader.get(shadows.depthBiasConstant);
+        reader.get(shadows.depthBiasSlope);
+
+        uint8_t binning = (uint8_t)frame.lighting.binning;
+        reader.get(binning);
+        frame.lighting.binning = (ClusteredLighting::BinningMode)binning;
+
+        ClusterRenderer::Settings& clusters = frame.clusters;
+        int32_t forcedLod = clusters.forcedLod;
+        reader.get_bool(clusters.bFrustumCulling);
+        reader.get_bool(clusters.bBackfaceCulling);
+        reader.get_bool(clusters.bOcclusionCulling);
+        reader.get(clusters.lodErrorPixels);
+        reader.get(clusters.lodHysteresis);
+        reader.get(forcedLod);
+        clusters.forcedLod = forcedLod;
+
+        reader.get_bool(frame.staticPasses.bEnabled);
+        reader.get(frame.visibleNodesFirst);
+        reader.get(frame.visibleNodesCount);
+    }
+
+    void write_cost(PayloadWriter& writer, const RecordedFrameCost& cost)
+    {
+        writer.put(cost.frameIndex);
+        writer.put(cost.cpuFrameTime);
+        writer.put(cost.recordTime);
+        writer.put(cost.graphicsBusyTime);
+        writer.put(cost.computeBusyTime);
+        writer.put(cost.overlapTime);
+        writer.put(cost.instanceCount);
+        writer.put(cost.clusterCount);
+        writer.put(cost.totalTriangles);
+        writer.put(cost.drawnTriangles);
+        writer.put((uint32_t)cost.scopes.size());
+        for (const GpuProfiler::ScopeResult& scope : cost.scopes) {
+            writer.put_string(scope.name);
+            writer.put((uint8_t)scope.queue);
+            writer.put(scope.begin);
+            writer.put(scope.end);
+        }
+    }
+
+    void read_cost(PayloadReader& reader, RecordedFrameCost& cost)
+    {
+        reader.get(cost.frameIndex);
+        reader.get(cost.cpuFrameTime);
+        reader.get(cost.recordTime);
+        reader.get(cost.graphicsBusyTime);
+        reader.get(cost.computeBusyTime);
+        reader.get(cost.overlapTime);
+        reader.get(cost.instanceCount);
+        reader.get(cost.clusterCount);
+        reader.get(cost.totalTriangles);
+        reader.get(cost.drawnTriangles);
+        uint32_t scopeCount = 0;
+        reader.get(scopeCount);
+        // far more scopes than any frame records, should the count be garbage
+        cost.scopes.resize(std::min(scopeCount, 1024u));
+        for (GpuProfiler::ScopeResult& scope : cost.scopes) {
+            uint8_t queue = 0;
+            scope.begin = 0.0;
+            scope.end = 0.0;
+            reader.get_string(scope.name);
+            reader.get(queue);
+            reader.get(scope.begin);
+            reader.get(scope.end);
+            scope.queue = queue == (uint8_t)GpuQueueTrack::Compute ? GpuQueueTrack::Compute : GpuQueueTrack::Graphics;
+        }
+    }
+}
+
+bool FrameRecording::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "failed to open recording " << path << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (bytes.size() < 8 || std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        std::cout << path << " is not a frame recording" << std::endl;
+        return false;
+    }
+    // newer versions only append fields and records, which are skipped, so any version is read
+
+    *this = FrameRecording();
+    lightSets.emplace_back();
+    size_t offset = 8;
+    while (offset + 5 <= bytes.size()) {
+        uint8_t type = bytes[offset];
+        uint32_t size;
+        std::memcpy(&size, bytes.data() + offset + 1, sizeof(size));
+        offset += 5;
+        if (size > bytes.size() - offset) {
+            // e.g. the recording process died mid-write; everything before the cut is still good
+            std::cout << "recording " << path << " is truncated" << std::endl;
+            break;
+        }
+
+        PayloadReader reader(bytes.data() + offset, size);
+        switch ((RecordType)type) {
+        case RecordType::Config:
+            reader.get_string(config);
+            break;
+        case RecordType::Load: {
+            Load load{};
+            uint8_t flags = 0;
+            reader.get(load.frameIndex);
+            reader.get(flags);
+            reader.get_string(load.path);
+            load.bTexture = (flags & LOAD_TEXTURE) != 0;
+            load.bResident = (flags & LOAD_RESIDENT) != 0;
+            loads.push_back(std::move(load));
+            break;
+        }
+        case RecordType::Lights: {
+            uint32_t count = 0;
+            reader.get(count);
+            std::vector<PointLight>& lights = lightSets.emplace_back(std::min<size_t>(count, size / sizeof(PointLight)));
+            for (PointLight& light : lights) {
+                reader.get_vec4(light.positionRadius);
+                reader.get_vec4(light.colorIntensity);
+            }
+            break;
+        }
+        case RecordType::Frame: {
+            RecordedFrame& frame = frames.emplace_back();
+            read_frame(reader, frame);
+            frame.lightSet = (uint32_t)lightSets.size() - 1;
+            break;
+        }
+        case RecordType::Cost:
+            read_cost(reader, costs.emplace_back());
+            break;
+        default:
+            break;
+        }
+        offset += size;
+    }
+
+    std::stable_sort(costs.begin(), costs.end(), [](const RecordedFrameCost& a, const RecordedFrameCost& b) {
+        return a.frameIndex < b.frameIndex;
+    });
+    return true;
+}
+
+bool FrameRecorder::start(const std::string& path, const std::string& config, uint32_t frameCount,
+    const std::vector<std::string>& loadedScenes, const std::vector<std::string>& loadedTextures)
+{
+    // a recording still waiting for its last costs is cut short
+    destroy();
+
+    mFile.open(path, std::ios::binary | std::ios::trunc);
+    if (!mFile) {
+        std::cout << "failed to create recording " << path << std::endl;
+        return false;
+    }
+    mPath = path;
+    mFramesRemaining = frameCount;
+    mContinuous = frameCount == 0;
+    mRecordedFrames = 0;
+    mPendingFrames.clear();
+    mLastFrameSlot = UINT32_MAX;
+    mLastLights.clear();
+    mLightsWritten = false;
+
+    mFile.write(MAGIC, sizeof(MAGIC));
+    mFile.write((const char*)&FORMAT_VERSION, sizeof(FORMAT_VERSION));
+
+    PayloadWriter configPayload;
+    configPayload.put_string(config);
+    write_record((uint8_t)RecordType::Config, configPayload.get_bytes());
+
+    for (bool bTexture : { false, true }) {
+        for (const std::string& loadedPath : bTexture ? loadedTextures : loadedScenes) {
+            PayloadWriter loadPayload;
+            loadPayload.put(0u);
+            loadPayload.put<uint8_t>(LOAD_RESIDENT | (bTexture ? LOAD_TEXTURE : 0));
+            loadPayload.put_string(loadedPath);
+            write_record((uint8_t)RecordType::Load, loadPayload.get_bytes());
+        }
+    }
+    std::cout << "recording " << (mContinuous ? std::string("frames") : std::to_string(frameCount) + " frames") << " into " << path << std::endl;
+    return true;
+}
+
+void FrameRecorder::stop()
+{
+    mFramesRemaining = 0;
+    mContinuous = false;
+    close_if_done();
+}
+
+void FrameRecorder::destroy()
+{
+    if (mFile.is_open()) {
+        mFile.close();
+    }
+    mFramesRemaining = 0;
+    mContinuous = false;
+}
+
+void FrameRecorder::record_load(const std::string& path, bool bTexture)
+{
+    if (!is_recording()) {
+        return;
+    }
+    PayloadWriter payload;
+    payload.put(mRecordedFrames);
+    payload.put<uint8_t>(bTexture ? LOAD_TEXTURE : 0);
+    payload.put_string(path);
+    write_record((uint8_t)RecordType::Load, payload.get_bytes());
+}
+
+void FrameRecorder::begin_frame(uint32_t frameSlot, float previousFrameTime, float previousRecordTime, const GpuProfiler& profiler,
+    const ClusterRenderer::Stats& clusterStats)
+{
+    if (!is_active()) {
+        return;
+    }
+
+    // the frame drawn last is done on the CPU, first of all when there is a single frame in flight, whose slot this is
+    if (mLastFrameSlot < mPendingFrames.size()) {
+        PendingFrame& last = mPendingFrames[mLastFrameSlot];
+        if (last.bPending && !last.bCpuTimeKnown) {
+            last.cost.cpuFrameTime = previousFrameTime;
+            last.cost.recordTime = previousRecordTime;
+            last.bCpuTimeKnown = true;
+        }
+        mLastFrameSlot = UINT32_MAX;
+    }
+
+    if (frameSlot < mPendingFrames.size() && mPendingFrames[frameSlot].bPending) {
+        PendingFrame& pending = mPendingFrames[frameSlot];
+        RecordedFrameCost& cost = pending.cost;
+        cost.graphicsBusyTime = profiler.get_queue_busy_time(GpuQueueTrack::Graphics);
+        cost.computeBusyTime = profiler.get_queue_busy_time(GpuQueueTrack::Compute);
+        cost.overlapTime = profiler.get_overlap_time();
+        cost.scopes = profiler.get_results();
+        cost.instanceCount = clusterStats.instanceCount;
+        cost.clusterCount = clusterStats.clusterCount;
+        cost.totalTriangles = clusterStats.totalTriangles;
+        cost.drawnTriangles = clusterStats.drawnTriangles;
+
+        PayloadWriter payload;
+        write_cost(payload, cost);
+        write_record((uint8_t)RecordType::Cost, payload.get_bytes());
+        pending = PendingFrame();
+    }
+
+    close_if_done();
+}
+
+void FrameRecorder::record_frame(uint32_t frameSlot, RecordedFrame frame, const std::vector<PointLight>& lights)
+{
+    if (!is_recording()) {
+        return;
+    }
+
+    // lights are written whole, but only when they changed; scenes usually keep theirs for many frames
+    bool bLightsChanged = !mLightsWritten || lights.size() != mLastLights.size()
+        || (!lights.empty() && std::memcmp(lights.data(), mLastLights.data(), lights.size() * sizeof(PointLight)) != 0);
+    if (bLightsChanged) {
+        PayloadWriter lightPayload;
+        lightPayload.put((uint32_t)lights.size());
+        for (const PointLight& light : lights) {
+            lightPayload.put_vec4(light.positionRadius);
+            lightPayload.put_vec4(light.colorIntensity);
+        }
+        write_record((uint8_t)RecordType::Lights, lightPayload.get_bytes());
+        mLastLights = lights;
+        mLightsWritten = true;
+    }
+
+    frame.frameIndex = mRecordedFrames++;
+    PayloadWriter payload;
+    write_frame(payload, frame);
+    write_record((uint8_t)RecordType::Frame, payload.get_bytes());
+
+    if (mPendingFrames.size() <= frameSlot) {
+        mPendingFrames.resize(frameSlot + 1);
+    }
+    PendingFrame& pending = mPendingFrames[frameSlot];
+    pending = PendingFrame();
+    pending.bPending = true;
+    pending.cost.frameIndex = frame.frameIndex;
+    mLastFrameSlot = frameSlot;
+
+    if (!mContinuous) {
+        mFramesRemaining--;
+    }
+}
+
+void FrameRecorder::write_record(uint8_t type, const std::vector<uint8_t>& payload)
+{
+    uint32_t size = (uint32_t)payload.size();
+    mFile.put((char)type);
+    mFile.write((const char*)&size, sizeof(size));
+    mFile.write((const char*)payload.data(), payload.size());
+}
+
+void FrameRecorder::close_if_done()
+{
+    if (!mFile.is_open() || is_recording()) {
+        return;
+    }
+    for (const PendingFrame& pending : mPendingFrames) {
+        if (pending.bPending) {
+            return;
+        }
+    }
+    mFile.close();
+    std::cout << "recorded " << mRecordedFrames << " frames into " << mPath << (mFile.fail() ? " (write failed)" : "") << std::endl;
+}
\ No newline at end of file
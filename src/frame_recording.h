@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "vk_cluster_renderer.h"
+#include "vk_clustered_lighting.h"
+#include "vk_command_cache.h"
+#include "vk_post_process.h"
+#include "vk_profiler.h"
+#include "vk_shadows.h"
+#include "vk_temporal_aa.h"
+
+// Engine level recording of a window of frames, for reproducing slow frames offline (see tools/replay.cpp).
+// Rather than Vulkan calls, a recording holds what the engine derives every frame's work from: the engine settings, the
+// scenes and textures loaded (before the window as well as during it), the light list whenever it changed, and per frame
+// the camera, sun, output extent, render scale and pass settings (culling, level of detail, shadows, post processing, ...)
+// along with the visible scene nodes. Each frame is followed, once its GPU timestamps are back, by what it cost: CPU frame
+// and recording time, per pass GPU scopes and queue busy times, and the instances, clusters and triangles it culled and drew.
+// Entities placed or moved by the application rather than loaded with a scene are not recorded.
+//
+// The stream is a header ("SNBR", format version) followed by records: a one byte type, a four byte payload size and the
+// payload, little endian. Fields are only ever appended to a record's payload and readers skip unknown records and fill
+// fields missing from older recordings with their defaults, so recordings stay replayable across engine revisions, which
+// is what bisecting a regression needs
+struct RecordedFrame {
+	uint32_t frameIndex = 0;
+	float deltaTime = 0.f;
+	// output resolution (swapchain or draw image) and the render scale the frame used, dynamic resolution included
+	uint32_t outputWidth = 0;
+	uint32_t outputHeight = 0;
+	float renderScale = 1.f;
+
+	glm::vec3 cameraPosition{ 0.f };
+	float cameraYaw = 0.f;
+	float cameraPitch = 0.f;
+	float cameraVerticalFov = 1.f;
+	float cameraNearPlane = 0.1f;
+	float cameraFarPlane = 1000.f;
+	glm::vec3 sunDirection{ 0.f, 1.f, 0.f };
+	// BackgroundSettings (see vk_engine.h)
+	glm::vec4 background[4]{};
+
+	PostProcessSettings postProcess;
+	TemporalAntiAliasing::Settings temporalAA;
+	CascadedShadowMaps::Settings shadows;
+	ClusteredLighting::Settings lighting;
+	ClusterRenderer::Settings clusters;
+	StaticCommandCache::Settings staticPasses;
+	uint32_t visibleNodesFirst = 0;
+	uint32_t visibleNodesCount = UINT32_MAX;
+	// into FrameRecording::lightSets; not stored, the frame uses the light record before it
+	uint32_t lightSet = 0;
+};
+
+// what a recorded frame cost
+struct RecordedFrameCost {
+	uint32_t frameIndex = 0;
+	float cpuFrameTime = 0.f; // ms
+	float recordTime = 0.f;
+	double graphicsBusyTime = 0.0;
+	double computeBusyTime = 0.0;
+	double overlapTime = 0.0;
+	uint32_t instanceCount = 0;
+	uint32_t clusterCount = 0;
+	uint64_t totalTriangles = 0;
+	uint64_t drawnTriangles = 0;
+	std::vector<GpuProfiler::ScopeResult> scopes;
+
+	// both queues together, counting time they were busy at once only once
+	double get_gpu_time() const { return graphicsBusyTime + computeBusyTime - overlapTime; }
+};
+
+// a recording read back into memory
+struct FrameRecording {
+	struct Load {
+		// the index of the first frame drawn after the load started
+		uint32_t frameIndex;
+		bool bTexture;
+		// loaded before the recording started, so already resident in its first frame
+		bool bResident;
+		std::string path;
+	};
+
+	// EngineConfig::to_string of the recording engine
+	std::string config;
+	std::vector<Load> loads;
+	std::vector<RecordedFrame> frames;
+	// costs by frame, in frame order; frames whose cost never came back are missing
+	std::vector<RecordedFrameCost> costs;
+	// the first is empty, for frames before any light record
+	std::vector<std::vector<PointLight>> lightSets;
+
+	// false, after printing why, if the file cannot be read or is not a recording
+	bool load(const std::string& path);
+};
+
+// Writes recordings. The engine hands it every frame's state while recording and the slot's results whenever it comes
+// back to a frame slot, which finishes a frame's record once its GPU work is done; the file is closed once every
+// recorded frame has its costs
+class FrameRecorder {
+public:
+	// records the next frameCount frames (0: until stopped) into path. config is EngineConfig::to_string, loadedScenes and
+	// loadedTextures what was loaded so far; false if the file cannot be created
+	bool start(const std::string& path, const std::string& config, uint32_t frameCount, const std::vector<std::string>& loadedScenes,
+		const std::vector<std::string>& loadedTextures);
+	// records no more frames; those recorded already still get their costs
+	void stop();
+	// closes the file right away, e.g. on shutdown, dropping the costs that did not come back yet
+	void destroy();
+
+	// frames are being recorded
+	bool is_recording() const { return mFile.is_open() && (mFramesRemaining > 0 || mContinuous); }
+	// frames are being recorded, or waiting for their costs
+	bool is_active() const { return mFile.is_open(); }
+	uint32_t get_recorded_frames() const { return mRecordedFrames; }
+	const std::string& get_path() const { return mPath; }
+
+	void record_load(const std::string& path, bool bTexture);
+	// call once the frame slot's fence has been waited on and the profiler and cluster renderer collected its results;
+	// previousFrameTime and previousRecordTime are the CPU times of the frame drawn last
+	void begin_frame(uint32_t frameSlot, float previousFrameTime, float previousRecordTime, const GpuProfiler& profiler,
+		const ClusterRenderer::Stats& clusterStats);
+	// records the state of the frame being drawn in frameSlot (its frameIndex is filled in here), and lights if they changed
+	void record_frame(uint32_t frameSlot, RecordedFrame frame, const std::vector<PointLight>& lights);
+
+private:
+	struct PendingFrame {
+		bool bPending = false;
+		RecordedFrameCost cost;
+		bool bCpuTimeKnown = false;
+	};
+
+	void write_record(uint8_t type, const std::vector<uint8_t>& payload);
+	// closes the file once recording stopped and no frame waits for its costs anymore
+	void close_if_done();
+
+	std::ofstream mFile;
+	std::string mPath;
+	uint32_t mFramesRemaining = 0;
+	bool mContinuous = false;
+	uint32_t mRecordedFrames = 0;
+	std::vector<PendingFrame> mPendingFrames;
+	// the slot of the frame recorded last, whose CPU times come with the next begin_frame
+	uint32_t mLastFrameSlot = UINT32_MAX;
+	std::vector<PointLight> mLastLights;
+	bool mLightsWritten = false;
+};
\ No newline at end of file
@@ -0,0 +1,882 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "asset_archive.h"
+#include "gltf_loader.h"
+#include "json.h"
+#include "mesh_optimizer.h"
+#include "vk_texture_streamer.h"
+
+struct GltfLoader::LoadContext {
+    std::string path;
+    std::chrono::steady_clock::time_point startTime;
+
+    // written by the parse job, read by the mesh jobs it schedules
+    bool bFailed = false;
+    JsonValue document;
+    // views of the glTF buffers, either into storage or into the mapping of the archive they were found in
+    std::vector<std::span<const uint8_t>> buffers;
+    std::vector<std::vector<uint8_t>> storage;
+    std::shared_ptr<const AssetArchive> archive;
+    uint64_t sourceBytes = 0;
+    uint32_t meshCount = 0;
+    // mesh and parent indices are local to the file until update() rebases them
+    std::vector<SceneNode> nodes;
+    // per glTF material: base color factor and the path of its .ktx2 base color texture (empty for none)
+    std::vector<glm::vec4> materialFactors;
+    std::vector<std::string> materialTexturePaths;
+    std::atomic<uint32_t> meshesConverting{ 0 };
+    std::atomic<uint64_t> workerMicroseconds{ 0 };
+
+    // render thread only
+    uint32_t meshBase = 0;
+    std::vector<TextureHandle> materialTextures;
+    uint32_t meshesRemaining = 0;
+    uint64_t geometryBytes = 0;
+    double acmrBeforeSum = 0.0;
+    double acmrAfterSum = 0.0;
+    uint64_t triangleCount = 0;
+};
+
+struct GltfLoader::MeshData {
+    std::shared_ptr<LoadContext> context;
+    uint32_t meshIndex;
+    std::string name;
+    // glTF material of the first surface, -1 for the default material
+    int64_t material = -1;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshSurface> surfaces;
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshLod> lods;
+    glm::vec3 boundsMin{ 0.f };
+    glm::vec3 boundsMax{ 0.f };
+    float acmrBefore = 0.f;
+    float acmrAfter = 0.f;
+    // render thread only: vertex, index and meshlet uploads still in flight
+    uint32_t pendingUploads = 0;
+};
+
+namespace {
+    constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+    constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+    constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+    // glTF component types
+    constexpr int64_t COMPONENT_BYTE = 5120;
+    constexpr int64_t COMPONENT_UNSIGNED_BYTE = 5121;
+    constexpr int64_t COMPONENT_SHORT = 5122;
+    constexpr int64_t COMPONENT_UNSIGNED_SHORT = 5123;
+    constexpr int64_t COMPONENT_UNSIGNED_INT = 5125;
+    constexpr int64_t COMPONENT_FLOAT = 5126;
+    constexpr int64_t MODE_TRIANGLES = 4;
+
+    // simplification stops once a level of detail could be off by this fraction of the mesh's bounding radius: coarser
+    // levels only ever cover a few pixels, where a plain draw of the last level costs next to nothing anyway
+    constexpr float LOD_MAX_RELATIVE_ERROR = 0.1f;
+
+    bool read_file(const std::filesystem::path& path, std::vector<uint8_t>& outBytes)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            return false;
+        }
+        outBytes.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read((char*)outBytes.data(), outBytes.size());
+        return (bool)file;
+    }
+
+    bool decode_base64(std::string_view text, std::vector<uint8_t>& outBytes)
+    {
+        auto decode_character = [](char character) -> int {
+            if (character >= 'A' && character <= 'Z') return character - 'A';
+            if (character >= 'a' && character <= 'z') return character - 'a' + 26;
+            if (character >= '0' && character <= '9') return character - '0' + 52;
+            if (character == '+' || character == '-') return 62;
+            if (character == '/' || character == '_') return 63;
+            return -1;
+        };
+
+        outBytes.clear();
+        outBytes.reserve(text.size() / 4 * 3);
+        uint32_t bits = 0;
+        int bitCount = 0;
+        for (char character : text) {
+            if (character == '=') {
+                break;
+            }
+            int value = decode_character(character);
+            if (value < 0) {
+                return false;
+            }
+            bits = (bits << 6) | (uint32_t)value;
+            bitCount += 6;
+            if (bitCount >= 8) {
+                bitCount -= 8;
+                outBytes.push_back((uint8_t)(bits >> bitCount));
+            }
+        }
+        return true;
+    }
+
+    std::string decode_uri(const std::string& uri)
+    {
+        // relative file URIs may percent-encode characters such as spaces
+        std::string decoded;
+        for (size_t i = 0; i < uri.size(); i++) {
+            if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit((unsigned char)uri[i + 1]) && std::isxdigit((unsigned char)uri[i + 2])) {
+                decoded.push_back((char)std::strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+                i += 2;
+            }
+            else {
+                decoded.push_back(uri[i]);
+            }
+        }
+        return decoded;
+    }
+
+    uint32_t component_size(int64_t componentType)
+    {
+        switch (componentType) {
+        case COMPONENT_BYTE: case COMPONENT_UNSIGNED_BYTE: return 1;
+        case COMPONENT_SHORT: case COMPONENT_UNSIGNED_SHORT: return 2;
+        case COMPONENT_UNSIGNED_INT: case COMPONENT_FLOAT: return 4;
+        default: return 0;
+        }
+    }
+
+    uint32_t component_count(const std::string& type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4" || type == "MAT2") return 4;
+        if (type == "MAT3") return 9;
+        if (type == "MAT4") return 16;
+        return 0;
+    }
+
+    // a non-negative integer member of at most limit (0 when missing); false for anything else, before it is cast to a size
+    bool get_size(const JsonValue& object, std::string_view key, size_t limit, size_t& outValue)
+    {
+        double number = object.get_number(key, 0.0);
+        if (!(number >= 0.0 && number <= (double)limit) || number != std::floor(number)) {
+            return false;
+        }
+        outValue = (size_t)number;
+        return true;
+    }
+
+    // a validated view of an accessor's elements inside its buffer
+    struct AccessorView {
+        const uint8_t* data = nullptr; // null for accessors without a buffer view, which read as zeros
+        size_t count = 0;
+        size_t stride = 0;
+        int64_t componentType = 0;
+        uint32_t componentCount = 0;
+        bool bNormalized = false;
+    };
+
+    bool get_accessor(const JsonValue& document, const std::vector<std::span<const uint8_t>>& buffers, int64_t accessorIndex, AccessorView& outView)
+    {
+        const std::vector<JsonValue>& accessors = document.get_array("accessors");
+        if (accessorIndex < 0 || accessorIndex >= (int64_t)accessors.size()) {
+            return false;
+        }
+        const JsonValue& accessor = accessors[accessorIndex];
+        if (accessor.find("sparse")) {
+            std::cout << "glTF: sparse accessors are not supported, reading accessor " << accessorIndex << " without its sparse values" << std::endl;
+        }
+
+        // no accessor can have more elements than its buffer has bytes; with the stride limited as well, the bounds check
+        // below cannot overflow
+        size_t largestBuffer = 0;
+        for (std::span<const uint8_t> buffer : buffers) {
+            largestBuffer = std::max(largestBuffer, buffer.size());
+        }
+        if (!get_size(accessor, "count", largestBuffer, outView.count)) {
+            return false;
+        }
+        outView.componentType = accessor.get_int("componentType");
+        outView.componentCount = component_count(accessor.get_string("type"));
+        outView.bNormalized = accessor.get_bool("normalized");
+        const size_t elementSize = (size_t)component_size(outView.componentType) * outView.componentCount;
+        if (elementSize == 0) {
+            return false;
+        }
+        outView.stride = elementSize;
+
+        const JsonValue* bufferViewIndex = accessor.find("bufferView");
+        if (!bufferViewIndex) {
+            outView.data = nullptr;
+            return true;
+        }
+        const std::vector<JsonValue>& bufferViews = document.get_array("bufferViews");
+        if (bufferViewIndex->number < 0 || bufferViewIndex->number >= bufferViews.size()) {
+            return false;
+        }
+        const JsonValue& bufferView = bufferViews[(size_t)bufferViewIndex->number];
+        int64_t bufferIndex = bufferView.get_int("buffer", -1);
+        if (bufferIndex < 0 || bufferIndex >= (int64_t)buffers.size()) {
+            return false;
+        }
+        std::span<const uint8_t> buffer = buffers[bufferIndex];
+
+        // glTF limits byteStride to 252
+        size_t viewOffset, accessorOffset, viewLength, byteStride;
+        if (!get_size(bufferView, "byteOffset", buffer.size(), viewOffset) || !get_size(bufferView, "byteLength", buffer.size() - viewOffset, viewLength)
+            || !get_size(accessor, "byteOffset", viewLength, accessorOffset) || !get_size(bufferView, "byteStride", 252, byteStride)) {
+            return false;
+        }
+        size_t offset = viewOffset + accessorOffset;
+        outView.stride = std::max(byteStride, elementSize);
+        size_t accessedBytes = outView.count == 0 ? 0 : outView.stride * (outView.count - 1) + elementSize;
+        if (accessedBytes > viewLength - accessorOffset) {
+            return false;
+        }
+        outView.data = buffer.data() + offset;
+        return true;
+    }
+
+    // reads element i of an accessor as floats, applying normalization of integer components
+    void read_element(const AccessorView& view, size_t i, float* out, uint32_t outCount)
+    {
+        for (uint32_t component = 0; component < outCount; component++) {
+            out[component] = 0.f;
+        }
+        if (!view.data) {
+            return;
+        }
+
+        const uint8_t* element = view.data + i * view.stride;
+        for (uint32_t component = 0; component < std::min(outCount, view.componentCount); component++) {
+            float value = 0.f;
+            switch (view.componentType) {
+            case COMPONENT_FLOAT: { float raw; std::memcpy(&raw, element + component * 4, 4); value = raw; break; }
+            case COMPONENT_UNSIGNED_INT: { uint32_t raw; std::memcpy(&raw, element + component * 4, 4); value = (float)raw; break; }
+            case COMPONENT_UNSIGNED_SHORT: {
+                uint16_t raw; std::memcpy(&raw, element + component * 2, 2);
+                value = view.bNormalized ? raw / 65535.f : (float)raw;
+                break;
+            }
+            case COMPONENT_SHORT: {
+                int16_t raw; std::memcpy(&raw, element + component * 2, 2);
+                value = view.bNormalized ? std::max(raw / 32767.f, -1.f) : (float)raw;
+                break;
+            }
+            case COMPONENT_UNSIGNED_BYTE: {
+                uint8_t raw = element[component];
+                value = view.bNormalized ? raw / 255.f : (float)raw;
+                break;
+            }
+            case COMPONENT_BYTE: {
+                int8_t raw = (int8_t)element[component];
+                value = view.bNormalized ? std::max(raw / 127.f, -1.f) : (float)raw;
+                break;
+            }
+            }
+            out[component] = value;
+        }
+    }
+
+    uint32_t read_index(const AccessorView& view, size_t i)
+    {
+        const uint8_t* element = view.data + i * view.stride;
+        switch (view.componentType) {
+        case COMPONENT_UNSIGNED_BYTE: return element[0];
+        case COMPONENT_UNSIGNED_SHORT: { uint16_t index; std::memcpy(&index, element, 2); return index; }
+        default: { uint32_t index; std::memcpy(&index, element, 4); return index; }
+        }
+    }
+
+    glm::mat4 node_transform(const JsonValue& node)
+    {
+        const std::vector<JsonValue>& matrix = node.get_array("matrix");
+        if (matrix.size() == 16) {
+            // column major, like glm
+            float values[16];
+            for (int i = 0; i < 16; i++) {
+                values[i] = (float)matrix[i].number;
+            }
+            return glm::make_mat4(values);
+        }
+
+        glm::vec3 translation(0.f), scale(1.f);
+        glm::quat rotation(1.f, 0.f, 0.f, 0.f);
+        const std::vector<JsonValue>& translationValues = node.get_array("translation");
+        const std::vector<JsonValue>& rotationValues = node.get_array("rotation");
+        const std::vector<JsonValue>& scaleValues = node.get_array("scale");
+        if (translationValues.size() == 3) {
+            translation = glm::vec3(translationValues[0].number, translationValues[1].number, translationValues[2].number);
+        }
+        if (rotationValues.size() == 4) {
+            // glTF stores xyzw, glm's constructor takes wxyz
+            rotation = glm::quat((float)rotationValues[3].number, (float)rotationValues[0].number, (float)rotationValues[1].number, (float)rotationValues[2].number);
+        }
+        if (scaleValues.size() == 3) {
+            scale = glm::vec3(scaleValues[0].number, scaleValues[1].number, scaleValues[2].number);
+        }
+        return glm::translate(glm::mat4(1.f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.f), scale);
+    }
+
+    // depth first, so parents come before their children; a node referenced from several parents is instanced under each
+    void collect_nodes(const std::vector<JsonValue>& nodes, int64_t nodeIndex, uint32_t parent, uint32_t depth,
+        std::vector<SceneNode>& outNodes)
+    {
+        // valid files are acyclic; the depth limit only protects against broken ones
+        if (nodeIndex < 0 || nodeIndex >= (int64_t)nodes.size() || depth > 64) {
+            return;
+        }
+        const JsonValue& node = nodes[nodeIndex];
+        const JsonValue* mesh = node.find("mesh");
+        uint32_t index = (uint32_t)outNodes.size();
+        outNodes.push_back({ parent, mesh ? (uint32_t)mesh->number : SceneNode::NO_MESH, node_transform(node) });
+        for (const JsonValue& child : node.get_array("children")) {
+            collect_nodes(nodes, (int64_t)child.number, index, depth + 1, outNodes);
+        }
+    }
+}
+
+void GltfLoader::init(JobSystem* jobSystem, StagingUploader* uploader, GeometryBufferPool* vertexPool, GeometryBufferPool* indexPool,
+    GeometryBufferPool* meshletPool, TextureStreamer* textureStreamer)
+{
+    mJobSystem = jobSystem;
+    mUploader = uploader;
+    mVertexPool = vertexPool;
+    mIndexPool = indexPool;
+    mMeshletPool = meshletPool;
+    mTextureStreamer = textureStreamer;
+}
+
+void GltfLoader::destroy()
+{
+    mJobSystem->wait(mJobCounter);
+
+    for (std::unique_ptr<MeshAsset>& mesh : mMeshes) {
+        mVertexPool->free(mesh->vertices);
+        mIndexPool->free(mesh->indices);
+        mMeshletPool->free(mesh->meshlets);
+    }
+    mMeshes.clear();
+    mNodes.clear();
+    mActiveLoads.clear();
+    mParsedLoads.clear();
+    mConvertedMeshes.clear();
+}
+
+void GltfLoader::load(const std::string& path)
+{
+    std::shared_ptr<LoadContext> context = std::make_shared<LoadContext>();
+    context->path = path;
+    context->archive = mArchive;
+    context->startTime = std::chrono::steady_clock::now();
+    mActiveLoads.push_back(context);
+
+    mJobSystem->schedule([this, context]() { parse(context); }, &mJobCounter);
+}
+
+void GltfLoader::update()
+{
+    std::vector<std::shared_ptr<LoadContext>> parsedLoads;
+    std::vector<std::shared_ptr<MeshData>> convertedMeshes;
+    {
+        // both lists are taken at once: a load is always parsed before any of its meshes is converted
+        std::lock_guard<std::mutex> lock(mFinishedMutex);
+        parsedLoads.swap(mParsedLoads);
+        convertedMeshes.swap(mConvertedMeshes);
+    }
+
+    for (std::shared_ptr<LoadContext>& context : parsedLoads) {
+        if (context->bFailed) {
+            std::cout << "failed to load " << context->path << std::endl;
+            std::erase(mActiveLoads, context);
+            continue;
+        }
+
+        // every texture file is loaded once per scene, however many materials use it
+        context->materialTextures.assign(context->materialTexturePaths.size(), INVALID_TEXTURE_HANDLE);
+        for (size_t material = 0; material < context->materialTexturePaths.size(); material++) {
+            const std::string& path = context->materialTexturePaths[material];
+            if (path.empty()) {
+                continue;
+            }
+            auto loaded = std::find(context->materialTexturePaths.begin(), context->materialTexturePaths.begin() + material, path);
+            size_t first = loaded - context->materialTexturePaths.begin();
+            context->materialTextures[material] = first < material ? context->materialTextures[first] : mTextureStreamer->load(path);
+        }
+
+        // meshes get their final slots now, so nodes can refer to them before they are converted
+        context->meshBase = (uint32_t)mMeshes.size();
+        context->meshesRemaining = context->meshCount;
+        for (uint32_t i = 0; i < context->meshCount; i++) {
+            mMeshes.push_back(std::make_unique<MeshAsset>());
+        }
+        const uint32_t nodeBase = (uint32_t)mNodes.size();
+        for (SceneNode node : context->nodes) {
+            node.parent = node.parent != SceneNode::NO_PARENT ? node.parent + nodeBase : SceneNode::NO_PARENT;
+            node.meshIndex = node.meshIndex < context->meshCount ? node.meshIndex + context->meshBase : SceneNode::NO_MESH;
+            mNodes.push_back(node);
+        }
+        if (context->meshCount == 0) {
+            finish_load(*context);
+        }
+    }
+
+    for (std::shared_ptr<MeshData>& meshData : convertedMeshes) {
+        place_mesh(std::move(meshData));
+    }
+}
+
+GltfLoader::Stats GltfLoader::get_stats() const
+{
+    Stats stats = mLastLoad;
+    stats.activeLoads = (uint32_t)mActiveLoads.size();
+    stats.totalMeshes = (uint32_t)mMeshes.size();
+    stats.residentMeshes = (uint32_t)std::count_if(mMeshes.begin(), mMeshes.end(),
+        [](const std::unique_ptr<MeshAsset>& mesh) { return mesh->bResident; });
+    return stats;
+}
+
+void GltfLoader::parse(std::shared_ptr<LoadContext> context)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto publish = [&]() {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        context->workerMicroseconds += elapsed.count();
+        std::lock_guard<std::mutex> lock(mFinishedMutex);
+        mParsedLoads.push_back(context);
+    };
+    auto fail = [&](const char* reason) {
+        std::cout << "glTF " << context->path << ": " << reason << std::endl;
+        context->bFailed = true;
+        publish();
+    };
+
+    // files in the asset archive are used in place when stored uncompressed, anything else is read into storage
+    auto acquire_file = [&](const std::filesystem::path& path, std::span<const uint8_t>& outBytes) {
+        const AssetArchive::Entry* entry = context->archive ? context->archive->find(path.lexically_normal().generic_string()) : nullptr;
+        if (entry && context->archive->get_mapped_data(*entry)) {
+            context->archive->prefetch(*entry);
+            outBytes = std::span<const uint8_t>(entry->storedData, entry->size);
+            return true;
+        }
+        context->storage.emplace_back();
+        std::vector<uint8_t>& bytes = context->storage.back();
+        if (entry ? !context->archive->read(*entry, bytes) : !read_file(path, bytes)) {
+            return false;
+        }
+        outBytes = bytes;
+        return true;
+    };
+
+    std::span<const uint8_t> fileBytes;
+    if (!acquire_file(context->path, fileBytes)) {
+        return fail("could not read file");
+    }
+    context->sourceBytes += fileBytes.size();
+
+    // .glb: 12 byte header, then a JSON chunk and an optional binary chunk that stands in for buffer 0
+    std::string_view jsonText((const char*)fileBytes.data(), fileBytes.size());
+    std::span<const uint8_t> binaryChunk;
+    bool bHasBinaryChunk = false;
+    uint32_t magic = 0;
+    if (fileBytes.size() >= 12) {
+        std::memcpy(&magic, fileBytes.data(), 4);
+    }
+    if (magic == GLB_MAGIC) {
+        size_t offset = 12;
+        jsonText = {};
+        while (offset + 8 <= fileBytes.size()) {
+            uint32_t chunkLength, chunkType;
+            std::memcpy(&chunkLength, fileBytes.data() + offset, 4);
+            std::memcpy(&chunkType, fileBytes.data() + offset + 4, 4);
+            offset += 8;
+            if (offset + chunkLength > fileBytes.size()) {
+                return fail("truncated GLB chunk");
+            }
+            if (chunkType == GLB_CHUNK_JSON) {
+                jsonText = std::string_view((const char*)fileBytes.data() + offset, chunkLength);
+            }
+            else if (chunkType == GLB_CHUNK_BIN && !bHasBinaryChunk) {
+                binaryChunk = fileBytes.subspan(offset, chunkLength);
+                bHasBinaryChunk = true;
+            }
+            // chunks are 4 byte aligned
+            offset += (chunkLength + 3) & ~3u;
+        }
+    }
+
+    if (!JsonValue::parse(jsonText, context->document) || !context->document.is_object()) {
+        return fail("invalid JSON");
+    }
+
+    const std::filesystem::path baseDirectory = std::filesystem::path(context->path).parent_path();
+    for (const JsonValue& buffer : context->document.get_array("buffers")) {
+        context->buffers.emplace_back();
+        std::span<const uint8_t>& bytes = context->buffers.back();
+        const std::string& uri = buffer.get_string("uri");
+        if (uri.empty()) {
+            if (!bHasBinaryChunk) {
+                return fail("buffer without uri outside of a GLB");
+            }
+            bytes = binaryChunk;
+            bHasBinaryChunk = false;
+        }
+        else if (uri.rfind("data:", 0) == 0) {
+            size_t dataStart = uri.find(";base64,");
+            context->storage.emplace_back();
+            if (dataStart == std::string::npos || !decode_base64(std::string_view(uri).substr(dataStart + 8), context->storage.back())) {
+                return fail("unsupported data URI");
+            }
+            bytes = context->storage.back();
+        }
+        else {
+            if (!acquire_file(baseDirectory / decode_uri(uri), bytes)) {
+                return fail("could not read buffer file");
+            }
+            context->sourceBytes += bytes.size();
+        }
+        if (bytes.size() < (size_t)buffer.get_int("byteLength")) {
+            return fail("buffer shorter than its byteLength");
+        }
+    }
+
+    // the node hierarchy of the default scene (or under every root node if there is none)
+    const std::vector<JsonValue>& nodes = context->document.get_array("nodes");
+    const std::vector<JsonValue>& scenes = context->document.get_array("scenes");
+    int64_t sceneIndex = context->document.get_int("scene", 0);
+    if (sceneIndex >= 0 && sceneIndex < (int64_t)scenes.size()) {
+        for (const JsonValue& root : scenes[sceneIndex].get_array("nodes")) {
+            collect_nodes(nodes, (int64_t)root.number, SceneNode::NO_PARENT, 0, context->nodes);
+        }
+    }
+    else {
+        std::vector<bool> bIsChild(nodes.size(), false);
+        for (const JsonValue& node : nodes) {
+            for (const JsonValue& child : node.get_array("children")) {
+                if (child.number >= 0 && child.number < nodes.size()) {
+                    bIsChild[(size_t)child.number] = true;
+                }
+            }
+        }
+        for (size_t node = 0; node < nodes.size(); node++) {
+            if (!bIsChild[node]) {
+                collect_nodes(nodes, (int64_t)node, SceneNode::NO_PARENT, 0, context->nodes);
+            }
+        }
+    }
+
+    // base colors of the materials; textures are only referenced here and loaded by update() on the render thread
+    const std::vector<JsonValue>& textures = context->document.get_array("textures");
+    const std::vector<JsonValue>& images = context->document.get_array("images");
+    uint32_t skippedTextures = 0;
+    for (const JsonValue& material : context->document.get_array("materials")) {
+        glm::vec4 factor(1.f);
+        std::string texturePath;
+        if (const JsonValue* pbr = material.find("pbrMetallicRoughness")) {
+            const std::vector<JsonValue>& factorValues = pbr->get_array("baseColorFactor");
+            for (size_t component = 0; component < 4 && component < factorValues.size(); component++) {
+                factor[(glm::length_t)component] = (float)factorValues[component].number;
+            }
+            if (const JsonValue* baseColorTexture = pbr->find("baseColorTexture")) {
+                int64_t textureIndex = baseColorTexture->get_int("index", -1);
+                int64_t imageIndex = -1;
+                if (textureIndex >= 0 && textureIndex < (int64_t)textures.size()) {
+                    // KTX2 images are referenced through KHR_texture_basisu, with source left for a fallback image
+                    const JsonValue* extensions = textures[textureIndex].find("extensions");
+                    const JsonValue* basisu = extensions ? extensions->find("KHR_texture_basisu") : nullptr;
+                    imageIndex = basisu ? basisu->get_int("source", -1) : textures[textureIndex].get_int("source", -1);
+                }
+                const std::string uri = imageIndex >= 0 && imageIndex < (int64_t)images.size() ? images[imageIndex].get_string("uri") : std::string();
+                std::filesystem::path imagePath = decode_uri(uri);
+                if (!uri.empty() && uri.rfind("data:", 0) != 0 && imagePath.extension() == ".ktx2") {
+                    texturePath = (baseDirectory / imagePath).lexically_normal().generic_string();
+                }
+                else {
+                    skippedTextures++;
+                }
+            }
+        }
+        context->materialFactors.push_back(factor);
+        context->materialTexturePaths.push_back(texturePath);
+    }
+    if (skippedTextures > 0) {
+        std::cout << "glTF " << context->path << ": " << skippedTextures << " base color textures are not .ktx2 files, drawing their materials untextured" << std::endl;
+    }
+
+    context->meshCount = (uint32_t)context->document.get_array("meshes").size();
+    context->meshesConverting = context->meshCount;
+
+    // published before the mesh jobs exist, so update() always sees the load before its meshes
+    publish();
+
+    for (uint32_t mesh = 0; mesh < context->meshCount; mesh++) {
+        mJobSystem->schedule([this, context, mesh]() { convert_mesh(context, mesh); }, &mJobCounter);
+    }
+}
+
+void GltfLoader::convert_mesh(std::shared_ptr<LoadContext> context, uint32_t meshIndex)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<MeshData> meshData = std::make_shared<MeshData>();
+    meshData->context = context;
+    meshData->meshIndex = meshIndex;
+
+    const JsonValue& document = context->document;
+    const JsonValue& mesh = document.get_array("meshes")[meshIndex];
+    meshData->name = mesh.get_string("name");
+    if (meshData->name.empty()) {
+        meshData->name = "mesh " + std::to_string(meshIndex);
+    }
+
+    for (const JsonValue& primitive : mesh.get_array("primitives")) {
+        if (primitive.get_int("mode", MODE_TRIANGLES) != MODE_TRIANGLES) {
+            continue;
+        }
+
+        const JsonValue* attributes = primitive.find("attributes");
+        AccessorView positions, normals, uvs, indices;
+        if (!attributes || !attributes->find("POSITION") ||
+            !get_accessor(document, context->buffers, attributes->get_int("POSITION", -1), positions) || positions.componentCount != 3) {
+            std::cout << "glTF " << context->path << ": skipping a primitive of " << meshData->name << " without valid positions" << std::endl;
+            continue;
+        }
+        bool bHasNormals = attributes->find("NORMAL") && get_accessor(document, context->buffers, attributes->get_int("NORMAL", -1), normals)
+            && normals.count == positions.count;
+        bool bHasUVs = attributes->find("TEXCOORD_0") && get_accessor(document, context->buffers, attributes->get_int("TEXCOORD_0", -1), uvs)
+            && uvs.count == positions.count;
+        bool bHasIndices = primitive.find("indices") && get_accessor(document, context->buffers, primitive.get_int("indices", -1), indices)
+            && indices.data && indices.componentCount == 1 && indices.componentType != COMPONENT_FLOAT;
+
+        const uint32_t firstVertex = (uint32_t)meshData->vertices.size();
+        MeshSurface surface;
+        surface.firstIndex = (uint32_t)meshData->indices.size();
+
+        // non-indexed primitives index their vertices in order
+        size_t indexCount = bHasIndices ? indices.count : positions.count;
+        indexCount -= indexCount % 3;
+        bool bIndicesValid = true;
+        for (size_t i = 0; i < indexCount; i++) {
+            uint32_t index = bHasIndices ? read_index(indices, i) : (uint32_t)i;
+            bIndicesValid &= index < positions.count;
+            meshData->indices.push_back(firstVertex + index);
+        }
+        if (!bIndicesValid) {
+            std::cout << "glTF " << context->path << ": skipping a primitive of " << meshData->name << " with out of range indices" << std::endl;
+            meshData->indices.resize(surface.firstIndex);
+            continue;
+        }
+        surface.indexCount = (uint32_t)indexCount;
+
+        std::vector<glm::vec3> vertexNormals(positions.count, glm::vec3(0.f));
+        meshData->vertices.resize(firstVertex + positions.count);
+        for (size_t i = 0; i < positions.count; i++) {
+            Vertex& vertex = meshData->vertices[firstVertex + i];
+            read_element(positions, i, &vertex.position.x, 3);
+            if (bHasNormals) {
+                read_element(normals, i, &vertexNormals[i].x, 3);
+            }
+            glm::vec2 uv(0.f);
+            if (bHasUVs) {
+                read_element(uvs, i, &uv.x, 2);
+            }
+            vertex.uv = vkutil::pack_uv(uv);
+        }
+
+        // without normals, smooth ones are accumulated from the area weighted face normals
+        if (!bHasNormals) {
+            for (size_t i = surface.firstIndex; i < surface.firstIndex + indexCount; i += 3) {
+                uint32_t a = meshData->indices[i] - firstVertex, b = meshData->indices[i + 1] - firstVertex, c = meshData->indices[i + 2] - firstVertex;
+                const glm::vec3& p0 = meshData->vertices[firstVertex + a].position;
+                glm::vec3 faceNormal = glm::cross(meshData->vertices[firstVertex + b].position - p0, meshData->vertices[firstVertex + c].position - p0);
+                vertexNormals[a] += faceNormal;
+                vertexNormals[b] += faceNormal;
+                vertexNormals[c] += faceNormal;
+            }
+        }
+        for (size_t i = 0; i < positions.count; i++) {
+            float length = glm::length(vertexNormals[i]);
+            meshData->vertices[firstVertex + i].normal = vkutil::pack_normal(length > 0.f ? vertexNormals[i] / length : glm::vec3(0.f, 0.f, 1.f));
+        }
+
+        if (surface.indexCount > 0) {
+            if (meshData->surfaces.empty()) {
+                meshData->material = primitive.get_int("material", -1);
+            }
+            meshData->surfaces.push_back(surface);
+        }
+    }
+
+    // optimization is per surface, since surfaces are drawn separately
+    uint64_t triangleCount = meshData->indices.size() / 3;
+    double acmrBefore = 0.0, acmrAfter = 0.0;
+    for (const MeshSurface& surface : meshData->surfaces) {
+        uint32_t* surfaceIndices = meshData->indices.data() + surface.firstIndex;
+        acmrBefore += meshutil::compute_acmr(surfaceIndices, surface.indexCount, meshData->vertices.size()) * (surface.indexCount / 3);
+
+        std::vector<uint32_t> clusters;
+        meshutil::optimize_vertex_cache(surfaceIndices, surface.indexCount, meshData->vertices.size(), &clusters);
+        meshutil::optimize_overdraw(surfaceIndices, surface.indexCount, meshData->vertices.data(), meshData->vertices.size(), clusters);
+
+        acmrAfter += meshutil::compute_acmr(surfaceIndices, surface.indexCount, meshData->vertices.size()) * (surface.indexCount / 3);
+    }
+    meshData->acmrBefore = triangleCount > 0 ? (float)(acmrBefore / triangleCount) : 0.f;
+    meshData->acmrAfter = triangleCount > 0 ? (float)(acmrAfter / triangleCount) : 0.f;
+
+    if (!meshData->indices.empty()) {
+        meshData->boundsMin = meshData->boundsMax = meshData->vertices[meshData->indices[0]].position;
+        for (uint32_t index : meshData->indices) {
+            meshData->boundsMin = glm::min(meshData->boundsMin, meshData->vertices[index].position);
+            meshData->boundsMax = glm::max(meshData->boundsMax, meshData->vertices[index].position);
+        }
+    }
+
+    // levels of detail, each simplified from the previous one surface by surface and appended to the index buffer, so they
+    // share the full detail mesh's vertices and keep its surfaces apart. Errors add up along the chain, since every level is
+    // measured against the one it was made from
+    meshData->lods.push_back({ 0, (uint32_t)meshData->indices.size(), 0, 0, 0.f });
+    std::vector<std::vector<MeshSurface>> lodSurfaces{ meshData->surfaces };
+    const float maxLodError = glm::length(meshData->boundsMax - meshData->boundsMin) * 0.5f * LOD_MAX_RELATIVE_ERROR;
+    std::vector<uint32_t> simplified;
+    while (meshData->lods.size() < MAX_MESH_LODS && meshData->lods.back().indexCount / 3 > meshutil::MESHLET_MAX_TRIANGLES) {
+        const MeshLod previous = meshData->lods.back();
+        MeshLod lod{ (uint32_t)meshData->indices.size(), 0, 0, 0, previous.error };
+        std::vector<MeshSurface> surfaces;
+        for (const MeshSurface& surface : lodSurfaces.back()) {
+            simplified.resize(surface.indexCount);
+            float error = 0.f;
+            size_t indexCount = meshutil::simplify(simplified.data(), meshData->indices.data() + surface.firstIndex, surface.indexCount,
+                meshData->vertices.data(), meshData->vertices.size(), surface.indexCount / 2, maxLodError - previous.error, &error);
+            meshutil::optimize_vertex_cache(simplified.data(), indexCount, meshData->vertices.size());
+            surfaces.push_back({ (uint32_t)meshData->indices.size(), (uint32_t)indexCount });
+            meshData->indices.insert(meshData->indices.end(), simplified.begin(), simplified.begin() + indexCount);
+            lod.error = std::max(lod.error, previous.error + error);
+        }
+        lod.indexCount = (uint32_t)meshData->indices.size() - lod.firstIndex;
+        // stuck against the error limit, or on borders and seams: another level would cost memory and save little
+        if (lod.indexCount > previous.indexCount * 0.85f) {
+            meshData->indices.resize(lod.firstIndex);
+            break;
+        }
+        meshData->lods.push_back(lod);
+        lodSurfaces.push_back(std::move(surfaces));
+    }
+
+    meshutil::optimize_vertex_fetch(meshData->vertices, meshData->indices.data(), meshData->indices.size());
+    // meshlets never straddle surfaces (or levels), so a culled cluster always belongs to a single draw range
+    for (uint32_t level = 0; level < meshData->lods.size(); level++) {
+        MeshLod& lod = meshData->lods[level];
+        lod.firstMeshlet = (uint32_t)meshData->meshlets.size();
+        for (const MeshSurface& surface : lodSurfaces[level]) {
+            meshutil::build_meshlets(meshData->indices.data() + surface.firstIndex, surface.indexCount, surface.firstIndex,
+                meshData->vertices.data(), meshData->vertices.size(), meshData->meshlets);
+        }
+        lod.meshletCount = (uint32_t)meshData->meshlets.size() - lod.firstMeshlet;
+        for (uint32_t meshlet = lod.firstMeshlet; meshlet < lod.firstMeshlet + lod.meshletCount; meshlet++) {
+            meshData->meshlets[meshlet].lod = level;
+        }
+    }
+
+    // the last mesh releases the source data; only the converted meshes are kept until uploaded
+    if (--context->meshesConverting == 0) {
+        context->buffers = {};
+        context->storage = {};
+        context->archive.reset();
+        context->document = JsonValue();
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    context->workerMicroseconds += elapsed.count();
+
+    std::lock_guard<std::mutex> lock(mFinishedMutex);
+    mConvertedMeshes.push_back(std::move(meshData));
+}
+
+void GltfLoader::place_mesh(std::shared_ptr<MeshData> meshData)
+{
+    LoadContext& context = *meshData->context;
+    MeshAsset* mesh = mMeshes[context.meshBase + meshData->meshIndex].get();
+    mesh->name = meshData->name;
+    mesh->surfaces = meshData->surfaces;
+    mesh->boundsMin = meshData->boundsMin;
+    mesh->boundsMax = meshData->boundsMax;
+    mesh->vertexCount = (uint32_t)meshData->vertices.size();
+    mesh->indexCount = (uint32_t)meshData->indices.size();
+    mesh->meshletCount = (uint32_t)meshData->meshlets.size();
+    mesh->lods = meshData->lods;
+    if (meshData->material >= 0 && meshData->material < (int64_t)context.materialFactors.size()) {
+        mesh->baseColorFactor = context.materialFactors[meshData->material];
+        mesh->baseColorTexture = context.materialTextures[meshData->material];
+    }
+
+    // at full detail; the levels of detail only add index memory
+    uint64_t triangleCount = mesh->lods[0].indexCount / 3;
+    context.acmrBeforeSum += meshData->acmrBefore * triangleCount;
+    context.acmrAfterSum += meshData->acmrAfter * triangleCount;
+    context.triangleCount += triangleCount;
+
+    if (mesh->indexCount == 0) {
+        // nothing to draw, and nothing to upload
+        mesh->bResident = true;
+        if (--context.meshesRemaining == 0) {
+            finish_load(context);
+        }
+        return;
+    }
+
+    VkDeviceSize vertexBytes = meshData->vertices.size() * sizeof(Vertex);
+    VkDeviceSize indexBytes = meshData->indices.size() * sizeof(uint32_t);
+    VkDeviceSize meshletBytes = meshData->meshlets.size() * sizeof(Meshlet);
+    mesh->vertices = mVertexPool->allocate(vertexBytes);
+    mesh->indices = mIndexPool->allocate(indexBytes);
+    mesh->meshlets = mMeshletPool->allocate(meshletBytes);
+    context.geometryBytes += vertexBytes + indexBytes + meshletBytes;
+
+    // the mesh data owns the memory being uploaded, so every upload keeps it alive until they have all landed
+    meshData->pendingUploads = 3;
+    auto onUploaded = [this, mesh, meshData]() {
+        if (--meshData->pendingUploads > 0) {
+            return;
+        }
+        mesh->bResident = true;
+        LoadContext& context = *meshData->context;
+        if (--context.meshesRemaining == 0) {
+            finish_load(context);
+        }
+    };
+    mUploader->enqueue_buffer(mVertexPool->get_buffer(mesh->vertices.page), mesh->vertices.offset,
+        meshData->vertices.data(), vertexBytes, meshData, onUploaded);
+    mUploader->enqueue_buffer(mIndexPool->get_buffer(mesh->indices.page), mesh->indices.offset,
+        meshData->indices.data(), indexBytes, meshData, onUploaded);
+    mUploader->enqueue_buffer(mMeshletPool->get_buffer(mesh->meshlets.page), mesh->meshlets.offset,
+        meshData->meshlets.data(), meshletBytes, meshData, std::move(onUploaded));
+}
+
+void GltfLoader::finish_load(LoadContext& context)
+{
+    Stats& stats = mLastLoad;
+    stats.sourceBytes = context.sourceBytes;
+    stats.geometryBytes = context.geometryBytes;
+    stats.loadTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - context.startTime).count();
+    stats.workerTime = context.workerMicroseconds.load() / 1e6f;
+    stats.sourceThroughput = stats.loadTime > 0.f ? (float)(context.sourceBytes / (1024.0 * 1024.0)) / stats.loadTime : 0.f;
+    stats.acmrBefore = context.triangleCount > 0 ? (float)(context.acmrBeforeSum / context.triangleCount) : 0.f;
+    stats.acmrAfter = context.triangleCount > 0 ? (float)(context.acmrAfterSum / context.triangleCount) : 0.f;
+
+    std::cout << "loaded " << context.path << ": " << context.meshCount << " meshes, " << context.triangleCount << " triangles, "
+        << context.sourceBytes / (1024.0 * 1024.0) << " MB in " << stats.loadTime << " s (" << stats.sourceThroughput << " MB/s), ACMR "
+        << stats.acmrBefore << " -> " << stats.acmrAfter << std::endl;
+
+    std::erase_if(mActiveLoads, [&](const std::shared_ptr<LoadContext>& active) { return active.get() == &context; });
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "job_system.h"
+#include "vk_geometry.h"
+#include "vk_upload.h"
+
+class AssetArchive;
+class TextureStreamer;
+
+// Loads glTF 2.0 scenes (.gltf with external or embedded buffers, and .glb) without blocking the render loop.
+// A worker reads and parses the file, then every mesh is converted to the packed Vertex layout and optimized
+// (vertex cache, overdraw, vertex fetch order) and split into meshlets for cluster culling in a job of its own. update()
+// then places finished meshes in the shared geometry pools and streams them through the staging uploader, a bounded amount
+// per frame.
+// Only triangle lists are loaded. Of materials only the base color is: its factor, and its texture when that is a .ktx2
+// file, which the texture streamer loads (images embedded in buffers or in other formats are left out). A mesh is drawn
+// with the material of its first surface. Skins and animations are ignored
+class GltfLoader {
+public:
+	struct Stats {
+		uint32_t activeLoads;
+		uint32_t residentMeshes;
+		uint32_t totalMeshes; // including meshes still being converted or uploaded
+		// of the last load that finished
+		uint64_t sourceBytes; // .gltf/.glb and buffer files as read from disk
+		uint64_t geometryBytes; // packed vertices, indices and meshlets uploaded
+		float loadTime; // seconds from load() until the last upload landed
+		float workerTime; // seconds of parsing and conversion summed over all workers
+		float sourceThroughput; // MB/s of source data over loadTime
+		// average cache miss ratio before and after optimization, weighted by triangles
+		float acmrBefore;
+		float acmrAfter;
+	};
+
+	void init(JobSystem* jobSystem, StagingUploader* uploader, GeometryBufferPool* vertexPool, GeometryBufferPool* indexPool,
+		GeometryBufferPool* meshletPool, TextureStreamer* textureStreamer);
+	// waits for running jobs; the uploader must have been flushed or destroyed already, since its callbacks refer to meshes
+	void destroy();
+
+	// files found in the archive (by their path as given to load, e.g. "assets/scene.glb") are read from it instead of the
+	// file system; takes effect for loads started afterwards
+	void set_archive(std::shared_ptr<const AssetArchive> archive) { mArchive = std::move(archive); }
+	// starts loading a scene in the background; its meshes and nodes are appended to those of earlier loads
+	void load(const std::string& path);
+	// render thread, once per frame before the uploader's update
+	void update();
+	// blocks until parsing and conversion of every load started so far are done (uploads may still be pending)
+	void wait_for_workers() { mJobSystem->wait(mJobCounter); }
+	bool is_idle() const { return get_stats().activeLoads == 0; }
+
+	const std::vector<std::unique_ptr<MeshAsset>>& get_meshes() const { return mMeshes; }
+	// only ever appended to, with every node after its parent, so new nodes can be picked up by index
+	const std::vector<SceneNode>& get_nodes() const { return mNodes; }
+	Stats get_stats() const;
+
+private:
+	struct LoadContext;
+	struct MeshData;
+
+	// worker side
+	void parse(std::shared_ptr<LoadContext> context);
+	void convert_mesh(std::shared_ptr<LoadContext> context, uint32_t meshIndex);
+
+	// render thread side
+	void place_mesh(std::shared_ptr<MeshData> meshData);
+	void finish_load(LoadContext& context);
+
+	JobSystem* mJobSystem;
+	StagingUploader* mUploader;
+	GeometryBufferPool* mVertexPool;
+	GeometryBufferPool* mIndexPool;
+	GeometryBufferPool* mMeshletPool;
+	TextureStreamer* mTextureStreamer;
+	std::shared_ptr<const AssetArchive> mArchive;
+	JobSystem::Counter mJobCounter;
+
+	// handed from the workers to update()
+	std::mutex mFinishedMutex;
+	std::vector<std::shared_ptr<LoadContext>> mParsedLoads;
+	std::vector<std::shared_ptr<MeshData>> mConvertedMeshes;
+
+	std::vector<std::shared_ptr<LoadContext>> mActiveLoads;
+	std::vector<std::unique_ptr<MeshAsset>> mMeshes;
+	std::vector<SceneNode> mNodes;
+	Stats mLastLoad{};
+};
\ No newline at end of file
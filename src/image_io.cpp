@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "image_io.h"
+
+namespace {
+    // CRC-32 (ISO 3309) as required by PNG chunks
+    uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> result{};
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                }
+                result[i] = value;
+            }
+            return result;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void append_u32_big_endian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back((uint8_t)(value >> 24));
+        out.push_back((uint8_t)(value >> 16));
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    template<typename T>
+    void append_little_endian(std::vector<uint8_t>& out, T value)
+    {
+        for (size_t i = 0; i < sizeof(T); i++) {
+            out.push_back((uint8_t)((uint64_t)value >> (8 * i)));
+        }
+    }
+
+    void append_png_chunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data)
+    {
+        append_u32_big_endian(out, (uint32_t)data.size());
+        size_t typeOffset = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        // the CRC covers the chunk type and data, not the length
+        append_u32_big_endian(out, crc32(out.data() + typeOffset, out.size() - typeOffset));
+    }
+
+    // EXR header attribute: name, type, size, value
+    void append_exr_attribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value)
+    {
+        out.insert(out.end(), name, name + std::strlen(name) + 1);
+        out.insert(out.end(), type, type + std::strlen(type) + 1);
+        append_little_endian<int32_t>(out, (int32_t)value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    bool write_file(const char* filePath, const void* data, size_t size)
+    {
+        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write((const char*)data, size);
+        return file.good();
+    }
+}
+
+bool imageio::write_png(const char* filePath, uint32_t width, uint32_t height, const uint8_t* rgba)
+{
+    // every row is prefixed with its filter type (0, none)
+    const size_t rowSize = (size_t)width * 4;
+    std::vector<uint8_t> scanlines;
+    scanlines.reserve((rowSize + 1) * height);
+    for (uint32_t y = 0; y < height; y++) {
+        scanlines.push_back(0);
+        scanlines.insert(scanlines.end(), rgba + y * rowSize, rgba + (y + 1) * rowSize);
+    }
+
+    // zlib stream made of stored deflate blocks (at most 65535 bytes each)
+    std::vector<uint8_t> zlib;
+    zlib.reserve(scanlines.size() + scanlines.size() / 65535 * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t offset = 0;
+    do {
+        uint16_t blockSize = (uint16_t)std::min<size_t>(scanlines.size() - offset, 65535);
+        bool bFinalBlock = offset + blockSize == scanlines.size();
+        zlib.push_back(bFinalBlock ? 1 : 0);
+        append_little_endian<uint16_t>(zlib, blockSize);
+        append_little_endian<uint16_t>(zlib, (uint16_t)~blockSize);
+        zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+        offset += blockSize;
+    } while (offset < scanlines.size());
+
+    // adler-32 of the uncompressed data, processed in runs short enough not to overflow
+    uint32_t a = 1, b = 0;
+    for (size_t start = 0; start < scanlines.size(); start += 5552) {
+        size_t end = std::min(start + 5552, scanlines.size());
+        for (size_t i = start; i < end; i++) {
+            a += scanlines[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    append_u32_big_endian(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> header;
+    append_u32_big_endian(header, width);
+    append_u32_big_endian(header, height);
+    // bit depth 8, color type 6 (RGBA), default compression, filtering and no interlacing
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    png.reserve(zlib.size() + 64);
+    append_png_chunk(png, "IHDR", header);
+    append_png_chunk(png, "IDAT", zlib);
+    append_png_chunk(png, "IEND", {});
+
+    return write_file(filePath, png.data(), png.size());
+}
+
+bool imageio::write_exr(const char* filePath, uint32_t width, uint32_t height, const uint16_t* rgbaHalf)
+{
+    std::vector<uint8_t> exr;
+    // magic number, then version 2 with no flags (single part scanline file)
+    append_little_endian<uint32_t>(exr, 20000630);
+    append_little_endian<uint32_t>(exr, 2);
+
+    // channels have to be listed in alphabetical order, which is also the order they are stored in within a scanline
+    static const char* channelNames[4] = { "A", "B", "G", "R" };
+    static const int channelSources[4] = { 3, 2, 1, 0 };
+    std::vector<uint8_t> channels;
+    for (const char* name : channelNames) {
+        channels.insert(channels.end(), name, name + std::strlen(name) + 1);
+        append_little_endian<int32_t>(channels, 1); // HALF
+        channels.insert(channels.end(), { 0, 0, 0, 0 }); // pLinear and reserved
+        append_little_endian<int32_t>(channels, 1); // x sampling
+        append_little_endian<int32_t>(channels, 1); // y sampling
+    }
+    channels.push_back(0);
+    append_exr_attribute(exr, "channels", "chlist", channels);
+
+    append_exr_attribute(exr, "compression", "compression", { 0 }); // NO_COMPRESSION
+
+    std::vector<uint8_t> window;
+    append_little_endian<int32_t>(window, 0);
+    append_little_endian<int32_t>(window, 0);
+    append_little_endian<int32_t>(window, (int32_t)width - 1);
+    append_little_endian<int32_t>(window, (int32_t)height - 1);
+    append_exr_attribute(exr, "dataWindow", "box2i", window);
+    append_exr_attribute(exr, "displayWindow", "box2i", window);
+
+    append_exr_attribute(exr, "lineOrder", "lineOrder", { 0 }); // INCREASING_Y
+
+    std::vector<uint8_t> one;
+    append_little_endian<uint32_t>(one, 0x3F800000); // 1.0f
+    append_exr_attribute(exr, "pixelAspectRatio", "float", one);
+    append_exr_attribute(exr, "screenWindowCenter", "v2f", std::vector<uint8_t>(8, 0));
+    append_exr_attribute(exr, "screenWindowWidth", "float", one);
+    exr.push_back(0);
+
+    // offset table (one entry per scanline), then the scanlines: y, byte count, then each channel's row of halves
+    const uint32_t lineDataSize = width * 4 * sizeof(uint16_t);
+    const uint64_t firstLineOffset = exr.size() + (uint64_t)height * sizeof(uint64_t);
+    exr.reserve(firstLineOffset + (uint64_t)height * (lineDataSize + 8));
+    for (uint32_t y = 0; y < height; y++) {
+        append_little_endian<uint64_t>(exr, firstLineOffset + (uint64_t)y * (lineDataSize + 8));
+    }
+
+    for (uint32_t y = 0; y < height; y++) {
+        append_little_endian<int32_t>(exr, (int32_t)y);
+        append_little_endian<uint32_t>(exr, lineDataSize);
+        const uint16_t* row = rgbaHalf + (size_t)y * width * 4;
+        for (int channel : channelSources) {
+            for (uint32_t x = 0; x < width; x++) {
+                append_little_endian<uint16_t>(exr, row[x * 4 + channel]);
+            }
+        }
+    }
+
+    return write_file(filePath, exr.data(), exr.size());
+}
+
+bool imageio::write_raw(const char* filePath, const void* data, size_t size)
+{
+    return write_file(filePath, data, size);
+}
+
+bool imageio::read_png(const char* filePath, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba)
+{
+    std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<uint8_t> png((size_t)file.tellg());
+    file.seekg(0);
+    file.read((char*)png.data(), png.size());
+
+    auto read_u32 = [&](size_t offset) {
+        return ((uint32_t)png[offset] << 24) | ((uint32_t)png[offset + 1] << 16) | ((uint32_t)png[offset + 2] << 8) | png[offset + 3];
+    };
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (png.size() < 8 || std::memcmp(png.data(), signature, 8) != 0) {
+        return false;
+    }
+
+    // gather the header and the (possibly split) zlib stream
+    std::vector<uint8_t> zlib;
+    bool bHeaderRead = false;
+    for (size_t offset = 8; offset + 12 <= png.size();) {
+        uint32_t length = read_u32(offset);
+        if (offset + 12 + (size_t)length > png.size()) {
+            return false;
+        }
+        const uint8_t* type = png.data() + offset + 4;
+        const uint8_t* data = type + 4;
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            // only 8 bit RGBA without interlacing
+            if (length != 13 || data[8] != 8 || data[9] != 6 || data[12] != 0) {
+                return false;
+            }
+            width = read_u32(offset + 8);
+            height = read_u32(offset + 12);
+            bHeaderRead = true;
+        }
+        else if (std::memcmp(type, "IDAT", 4) == 0) {
+            zlib.insert(zlib.end(), data, data + length);
+        }
+        else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        offset += 12 + (size_t)length;
+    }
+    if (!bHeaderRead || zlib.size() < 2) {
+        return false;
+    }
+
+    // walk the stored deflate blocks; any compressed block means the file did not come from write_png
+    std::vector<uint8_t> scanlines;
+    size_t offset = 2;
+    bool bFinalBlock = false;
+    while (!bFinalBlock) {
+        if (offset + 5 > zlib.size() || (zlib[offset] & 0x06) != 0) {
+            return false;
+        }
+        bFinalBlock = zlib[offset] & 1;
+        uint16_t blockSize = (uint16_t)(zlib[offset + 1] | (zlib[offset + 2] << 8));
+        offset += 5;
+        if (offset + blockSize > zlib.size()) {
+            return false;
+        }
+        scanlines.insert(scanlines.end(), zlib.begin() + offset, zlib.begin() + offset + blockSize);
+        offset += blockSize;
+    }
+
+    const size_t rowSize = (size_t)width * 4;
+    if (scanlines.size() != (rowSize + 1) * height) {
+        return false;
+    }
+
+    // undo the per-row filters
+    rgba.resize(rowSize * height);
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t filter = scanlines[y * (rowSize + 1)];
+        const uint8_t* source = scanlines.data() + y * (rowSize + 1) + 1;
+        uint8_t* row = rgba.data() + y * rowSize;
+        const uint8_t* previousRow = y > 0 ? row - rowSize : nullptr;
+        for (size_t x = 0; x < rowSize; x++) {
+            int left = x >= 4 ? row[x - 4] : 0;
+            int up = previousRow ? previousRow[x] : 0;
+            int upLeft = (previousRow && x >= 4) ? previousRow[x - 4] : 0;
+            int predictor = 0;
+            switch (filter) {
+            case 0: predictor = 0; break;
+            case 1: predictor = left; break;
+            case 2: predictor = up; break;
+            case 3: predictor = (left + up) / 2; break;
+            case 4: {
+                int estimate = left + up - upLeft;
+                int distanceLeft = std::abs(estimate - left);
+                int distanceUp = std::abs(estimate - up);
+                int distanceUpLeft = std::abs(estimate - upLeft);
+                predictor = (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) ? left : (distanceUp <= distanceUpLeft ? up : upLeft);
+                break;
+            }
+            default: return false;
+            }
+            row[x] = (uint8_t)(source[x] + predictor);
+        }
+    }
+    return true;
+}
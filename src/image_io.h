@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Minimal image file writers with no dependencies beyond the standard library, meant for frame captures.
+// All of them take tightly packed rows, top row first, and return false if the file could not be written
+namespace imageio {
+	// 8 bit RGBA. The zlib stream uses stored (uncompressed) deflate blocks: files are large, but encoding is
+	// a memcpy plus checksums, which keeps capture workers ahead of the render loop
+	bool write_png(const char* filePath, uint32_t width, uint32_t height, const uint8_t* rgba);
+	// half float RGBA, uncompressed scanlines; the raw bits of an RGBA16F image can be passed straight through
+	bool write_exr(const char* filePath, uint32_t width, uint32_t height, const uint16_t* rgbaHalf);
+	// the bytes as they are, without any header (e.g. for ffmpeg -f rawvideo)
+	bool write_raw(const char* filePath, const void* data, size_t size);
+
+	// reads 8 bit RGBA PNGs whose image data uses stored deflate blocks, i.e. what write_png produces (e.g. golden images);
+	// returns false for anything else, including PNGs that were re-saved by an image editor
+	bool read_png(const char* filePath, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba);
+}
\ No newline at end of file
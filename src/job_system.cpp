@@ -0,0 +1,116 @@
+#include <algorithm>
+#include "job_system.h"
+
+void JobSystem::init(uint32_t workerCount)
+{
+	if (workerCount == 0) {
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	mStopWorkers = false;
+	for (uint32_t i = 0; i < workerCount; i++) {
+		mWorkers.emplace_back([this]() { worker_loop(); });
+	}
+}
+
+void JobSystem::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(mJobsMutex);
+		mStopWorkers = true;
+	}
+	mJobsAvailable.notify_all();
+
+	for (std::thread& worker : mWorkers) {
+		worker.join();
+	}
+	mWorkers.clear();
+	mJobs.clear();
+}
+
+void JobSystem::schedule(std::function<void()>&& job, Counter* counter)
+{
+	if (counter) {
+		counter->pending.fetch_add(1);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mJobsMutex);
+		mJobs.push_back(Job{ std::move(job), counter });
+	}
+	mJobsAvailable.notify_one();
+}
+
+void JobSystem::parallel_for(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& function)
+{
+	if (count == 0) {
+		return;
+	}
+	batchSize = std::max(batchSize, 1u);
+
+	// small workloads are not worth the queue round trip
+	if (count <= batchSize || mWorkers.empty()) {
+		function(0, count);
+		return;
+	}
+
+	Counter counter;
+	for (uint32_t begin = 0; begin < count; begin += batchSize) {
+		uint32_t end = std::min(begin + batchSize, count);
+		schedule([&function, begin, end]() { function(begin, end); }, &counter);
+	}
+
+	wait(counter);
+}
+
+void JobSystem::wait(Counter& counter)
+{
+	while (counter.pending.load() != 0) {
+		// help with our own jobs instead of idling; if none are queued, other threads are finishing them
+		if (!try_run_one(counter)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::worker_loop()
+{
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mJobsMutex);
+			mJobsAvailable.wait(lock, [this]() { return mStopWorkers || !mJobs.empty(); });
+			if (mStopWorkers && mJobs.empty()) {
+				return;
+			}
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+
+		job.function();
+		if (job.counter) {
+			job.counter->pending.fetch_sub(1);
+		}
+	}
+}
+
+bool JobSystem::try_run_one(Counter& counter)
+{
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(mJobsMutex);
+		auto it = std::find_if(mJobs.begin(), mJobs.end(), [&counter](const Job& queued) { return queued.counter == &counter; });
+		if (it == mJobs.end()) {
+			return false;
+		}
+		job = std::move(*it);
+		mJobs.erase(it);
+	}
+
+	job.function();
+	if (job.counter) {
+		job.counter->pending.fetch_sub(1);
+	}
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small fixed-size worker pool for CPU work that must not block the render loop
+// (pipeline compilation, asset decoding, image encoding, ...)
+class JobSystem {
+public:
+	// tracks completion of a group of jobs; wait on it to block until every job in the group is done
+	struct Counter {
+		std::atomic<uint32_t> pending{ 0 };
+	};
+
+	// spawns max(1, hardware threads - 1) workers when workerCount is 0 (the main thread keeps a core for itself)
+	void init(uint32_t workerCount = 0);
+	void shutdown();
+
+	// queues a job; if a counter is given, it is incremented now and decremented when the job finishes
+	void schedule(std::function<void()>&& job, Counter* counter = nullptr);
+
+	// splits [0, count) into batches of batchSize and runs function(begin, end) for each batch across the workers
+	// the calling thread also executes batches, and the call returns once every batch is done
+	void parallel_for(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& function);
+
+	// blocks until all jobs tracked by the counter are done; the calling thread helps out with the counter's own queued jobs
+	// meanwhile, never with unrelated ones, so a frame waiting on its parallel_for does not pick up a pipeline compile
+	void wait(Counter& counter);
+
+	uint32_t worker_count() const { return (uint32_t)mWorkers.size(); }
+
+private:
+	struct Job {
+		std::function<void()> function;
+		Counter* counter;
+	};
+
+	void worker_loop();
+	// runs the oldest queued job tracked by the counter on the calling thread, returns false if there was none
+	bool try_run_one(Counter& counter);
+
+	std::vector<std::thread> mWorkers;
+	std::deque<Job> mJobs;
+	std::mutex mJobsMutex;
+	std::condition_variable mJobsAvailable;
+	bool mStopWorkers = false;
+};
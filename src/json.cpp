@@ -0,0 +1,257 @@
+#include <charconv>
+#include "json.h"
+
+namespace {
+    class JsonParser {
+    public:
+        explicit JsonParser(std::string_view text) : mCursor(text.data()), mEnd(text.data() + text.size()) {}
+
+        bool parse_document(JsonValue& out)
+        {
+            // a UTF-8 byte order mark is tolerated
+            if (mEnd - mCursor >= 3 && (uint8_t)mCursor[0] == 0xEF && (uint8_t)mCursor[1] == 0xBB && (uint8_t)mCursor[2] == 0xBF) {
+                mCursor += 3;
+            }
+            if (!parse_value(out, 0)) {
+                return false;
+            }
+            skip_whitespace();
+            return mCursor == mEnd;
+        }
+
+    private:
+        // deeper documents are rejected rather than overflowing the stack
+        static constexpr int MAX_DEPTH = 256;
+
+        void skip_whitespace()
+        {
+            while (mCursor < mEnd && (*mCursor == ' ' || *mCursor == '\t' || *mCursor == '\n' || *mCursor == '\r')) {
+                mCursor++;
+            }
+        }
+
+        bool consume(char expected)
+        {
+            skip_whitespace();
+            if (mCursor < mEnd && *mCursor == expected) {
+                mCursor++;
+                return true;
+            }
+            return false;
+        }
+
+        bool consume_literal(std::string_view literal)
+        {
+            if ((size_t)(mEnd - mCursor) >= literal.size() && std::string_view(mCursor, literal.size()) == literal) {
+                mCursor += literal.size();
+                return true;
+            }
+            return false;
+        }
+
+        static void append_utf8(std::string& out, uint32_t codePoint)
+        {
+            if (codePoint < 0x80) {
+                out.push_back((char)codePoint);
+            }
+            else if (codePoint < 0x800) {
+                out.push_back((char)(0xC0 | (codePoint >> 6)));
+                out.push_back((char)(0x80 | (codePoint & 0x3F)));
+            }
+            else if (codePoint < 0x10000) {
+                out.push_back((char)(0xE0 | (codePoint >> 12)));
+                out.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (codePoint & 0x3F)));
+            }
+            else {
+                out.push_back((char)(0xF0 | (codePoint >> 18)));
+                out.push_back((char)(0x80 | ((codePoint >> 12) & 0x3F)));
+                out.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (codePoint & 0x3F)));
+            }
+        }
+
+        bool parse_hex4(uint32_t& out)
+        {
+            if (mEnd - mCursor < 4) {
+                return false;
+            }
+            out = 0;
+            for (int i = 0; i < 4; i++) {
+                char digit = *mCursor++;
+                out <<= 4;
+                if (digit >= '0' && digit <= '9') out |= digit - '0';
+                else if (digit >= 'a' && digit <= 'f') out |= digit - 'a' + 10;
+                else if (digit >= 'A' && digit <= 'F') out |= digit - 'A' + 10;
+                else return false;
+            }
+            return true;
+        }
+
+        bool parse_string(std::string& out)
+        {
+            if (!consume('"')) {
+                return false;
+            }
+            while (mCursor < mEnd && *mCursor != '"') {
+                char character = *mCursor++;
+                if (character != '\\') {
+                    out.push_back(character);
+                    continue;
+                }
+                if (mCursor >= mEnd) {
+                    return false;
+                }
+                char escape = *mCursor++;
+                switch (escape) {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '/': out.push_back('/'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    uint32_t codePoint;
+                    if (!parse_hex4(codePoint)) {
+                        return false;
+                    }
+                    // surrogate pairs encode code points above the basic multilingual plane
+                    if (codePoint >= 0xD800 && codePoint < 0xDC00 && consume_literal("\\u")) {
+                        uint32_t lowSurrogate;
+                        if (!parse_hex4(lowSurrogate)) {
+                            return false;
+                        }
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+                    }
+                    append_utf8(out, codePoint);
+                    break;
+                }
+                default:
+                    return false;
+                }
+            }
+            if (mCursor >= mEnd) {
+                return false;
+            }
+            mCursor++;
+            return true;
+        }
+
+        bool parse_value(JsonValue& out, int depth)
+        {
+            skip_whitespace();
+            if (mCursor >= mEnd || depth > MAX_DEPTH) {
+                return false;
+            }
+
+            switch (*mCursor) {
+            case '{':
+                mCursor++;
+                out.type = JsonValue::Type::Object;
+                if (consume('}')) {
+                    return true;
+                }
+                do {
+                    out.object.emplace_back();
+                    skip_whitespace();
+                    if (!parse_string(out.object.back().first) || !consume(':') || !parse_value(out.object.back().second, depth + 1)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume('}');
+            case '[':
+                mCursor++;
+                out.type = JsonValue::Type::Array;
+                if (consume(']')) {
+                    return true;
+                }
+                do {
+                    out.array.emplace_back();
+                    if (!parse_value(out.array.back(), depth + 1)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume(']');
+            case '"':
+                out.type = JsonValue::Type::String;
+                return parse_string(out.string);
+            case 't':
+                out.type = JsonValue::Type::Bool;
+                out.boolean = true;
+                return consume_literal("true");
+            case 'f':
+                out.type = JsonValue::Type::Bool;
+                out.boolean = false;
+                return consume_literal("false");
+            case 'n':
+                out.type = JsonValue::Type::Null;
+                return consume_literal("null");
+            default: {
+                // from_chars is locale independent, unlike strtod
+                const char* numberStart = mCursor;
+                if (mCursor < mEnd && *mCursor == '-') {
+                    mCursor++;
+                }
+                auto [numberEnd, error] = std::from_chars(mCursor, mEnd, out.number);
+                if (error != std::errc() || numberEnd == mCursor) {
+                    return false;
+                }
+                if (*numberStart == '-') {
+                    out.number = -out.number;
+                }
+                out.type = JsonValue::Type::Number;
+                mCursor = numberEnd;
+                return true;
+            }
+            }
+        }
+
+        const char* mCursor;
+        const char* mEnd;
+    };
+
+    const std::string EMPTY_STRING;
+    const std::vector<JsonValue> EMPTY_ARRAY;
+}
+
+bool JsonValue::parse(std::string_view text, JsonValue& out)
+{
+    out = JsonValue();
+    return JsonParser(text).parse_document(out);
+}
+
+const JsonValue* JsonValue::find(std::string_view key) const
+{
+    for (const auto& [name, value] : object) {
+        if (name == key) {
+            return &value;
+        }
+    }
+    return nullptr;
+}
+
+double JsonValue::get_number(std::string_view key, double fallback) const
+{
+    const JsonValue* value = find(key);
+    return (value && value->type == Type::Number) ? value->number : fallback;
+}
+
+bool JsonValue::get_bool(std::string_view key, bool fallback) const
+{
+    const JsonValue* value = find(key);
+    return (value && value->type == Type::Bool) ? value->boolean : fallback;
+}
+
+const std::string& JsonValue::get_string(std::string_view key) const
+{
+    const JsonValue* value = find(key);
+    return (value && value->type == Type::String) ? value->string : EMPTY_STRING;
+}
+
+const std::vector<JsonValue>& JsonValue::get_array(std::string_view key) const
+{
+    const JsonValue* value = find(key);
+    return (value && value->type == Type::Array) ? value->array : EMPTY_ARRAY;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A small JSON DOM for the formats the engine reads (glTF, tool results). Objects keep their members in file order
+// and are searched linearly, which is fine for the member counts these formats have
+class JsonValue {
+public:
+	enum class Type : uint8_t { Null, Bool, Number, String, Array, Object };
+
+	// returns false (leaving out in an unspecified state) if text is not valid JSON
+	static bool parse(std::string_view text, JsonValue& out);
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	bool is_object() const { return type == Type::Object; }
+	bool is_array() const { return type == Type::Array; }
+
+	// member lookup; nullptr if this is not an object or has no such member
+	const JsonValue* find(std::string_view key) const;
+
+	// typed member getters returning fallback when the member is missing or of another type
+	double get_number(std::string_view key, double fallback = 0.0) const;
+	int64_t get_int(std::string_view key, int64_t fallback = 0) const { return (int64_t)get_number(key, (double)fallback); }
+	bool get_bool(std::string_view key, bool fallback = false) const;
+	const std::string& get_string(std::string_view key) const;
+	// returns an empty array when missing, so callers can iterate unconditionally
+	const std::vector<JsonValue>& get_array(std::string_view key) const;
+};
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "ktx2.h"
+
+namespace {
+    constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    struct Ktx2Header {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        // index of the data format descriptor, key/value data and supercompression global data; not needed for upload
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+    static_assert(sizeof(Ktx2Header) == 80);
+
+    struct Ktx2LevelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+}
+
+bool ktx2::get_block_info(VkFormat format, uint32_t& outBlockBytes, uint32_t& outBlockDimension)
+{
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+        outBlockBytes = 8;
+        outBlockDimension = 4;
+        return true;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        outBlockBytes = 16;
+        outBlockDimension = 4;
+        return true;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        outBlockBytes = 4;
+        outBlockDimension = 1;
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint32_t ktx2::get_level_dimension(uint32_t baseDimension, uint32_t level)
+{
+    return std::max(baseDimension >> level, 1u);
+}
+
+uint64_t ktx2::get_level_size(const TextureInfo& info, uint32_t level)
+{
+    uint32_t blockBytes, blockDimension;
+    if (!get_block_info(info.format, blockBytes, blockDimension)) {
+        return 0;
+    }
+    // partial blocks at the edges of small levels still take a whole block
+    uint64_t blocksX = (get_level_dimension(info.width, level) + blockDimension - 1) / blockDimension;
+    uint64_t blocksY = (get_level_dimension(info.height, level) + blockDimension - 1) / blockDimension;
+    return blocksX * blocksY * blockBytes;
+}
+
+bool ktx2::parse(std::span<const uint8_t> bytes, TextureInfo& outInfo)
+{
+    auto fail = [](const char* reason) {
+        std::cout << "KTX2: " << reason << std::endl;
+        return false;
+    };
+
+    Ktx2Header header;
+    if (bytes.size() < sizeof(header)) {
+        return fail("file too small");
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        return fail("not a KTX 2.0 file");
+    }
+    if (header.supercompressionScheme != 0) {
+        return fail("supercompressed files are not supported");
+    }
+    if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelWidth == 0 || header.pixelHeight == 0) {
+        return fail("only single 2D images are supported");
+    }
+
+    outInfo.format = (VkFormat)header.vkFormat;
+    outInfo.width = header.pixelWidth;
+    outInfo.height = header.pixelHeight;
+    uint32_t blockBytes, blockDimension;
+    if (!get_block_info(outInfo.format, blockBytes, blockDimension)) {
+        return fail("unsupported format (BC1-BC7 or RGBA8 expected)");
+    }
+
+    // a level count of 0 asks the loader to generate mips, which block compressed data cannot have done to it anyway
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    uint32_t fullChainLength = 1;
+    while ((std::max(outInfo.width, outInfo.height) >> fullChainLength) > 0) {
+        fullChainLength++;
+    }
+    if (levelCount > fullChainLength) {
+        return fail("more levels than the image has");
+    }
+    if (sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex) > bytes.size()) {
+        return fail("truncated level index");
+    }
+
+    outInfo.levels.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        Ktx2LevelIndex index;
+        std::memcpy(&index, bytes.data() + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex), sizeof(index));
+        if (index.byteOffset > bytes.size() || index.byteLength > bytes.size() - index.byteOffset) {
+            return fail("level out of bounds");
+        }
+        if (index.byteLength != get_level_size(outInfo, level)) {
+            return fail("level size does not match its format and dimensions");
+        }
+        outInfo.levels[level] = { index.byteOffset, index.byteLength };
+    }
+    return true;
+}
\ No newline at end of file
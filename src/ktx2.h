@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <volk.h>
+
+// Reader for KTX 2.0 containers (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html) holding a single 2D image
+// with its mip chain. Supported are the BC1-BC7 block compressed formats plus RGBA8 for uncompressed content; supercompressed
+// files (Basis Universal, zstd, zlib) and arrays, cube maps and 3D textures are rejected
+namespace ktx2 {
+	struct Level {
+		uint64_t offset; // from the start of the file
+		uint64_t size;
+	};
+
+	struct TextureInfo {
+		VkFormat format;
+		uint32_t width;
+		uint32_t height;
+		// levels[0] is the full resolution image, each following level halves both sides (down to 1)
+		std::vector<Level> levels;
+	};
+
+	// validates the header and level index against the size of bytes; logs why a file is rejected
+	bool parse(std::span<const uint8_t> bytes, TextureInfo& outInfo);
+
+	// texel block footprint of a format: 4x4 blocks for BCn, single texels otherwise; false for unsupported formats
+	bool get_block_info(VkFormat format, uint32_t& outBlockBytes, uint32_t& outBlockDimension);
+	uint32_t get_level_dimension(uint32_t baseDimension, uint32_t level);
+	// tightly packed size of a level in bytes, as stored in the file and as uploaded
+	uint64_t get_level_size(const TextureInfo& info, uint32_t level);
+}
\ No newline at end of file
@@ -1,12 +1,143 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "render_server.h"
 #include "vk_engine.h"
 
-int main()
+int main(int argc, char* argv[])
 {
+	// --headless <frames>: render that many frames without a window, then exit
+	// --capture <directory> [png|exr|raw]: write every rendered frame into directory (with --headless) or the first one
+	// --scene <file.gltf|file.glb>: load a scene in the background (headless runs wait for it before rendering)
+	// --texture <file.ktx2>: load a streamed texture, may be given several times
+	// --serve-socket <path>, --serve-dir <directory>: run headless as a render server, taking jobs from a Unix socket
+	// and/or a watched directory (see render_server.h); --exit-when-idle makes it return once no jobs are left
+	// --record <file> [frames]: record what frames are made of and what they cost for SunabaReplay, every frame drawn or the
+	// first ones (see frame_recording.h)
+	// --config <file.json>, --set <key>=<value>: engine settings (see engine_config.h), also read from SUNABA_CONFIG and
+	// SUNABA_<KEY>; headless runs print the settings and the mean frame time, for comparing them from scripts
+	// environment: SUNABA_DEVICE=<index|name> picks the device, SUNABA_VULKAN_LIBRARY=<path> the Vulkan loader
+	bool bHeadless = false;
+	uint32_t headlessFrames = 0;
+	const char* captureDirectory = nullptr;
+	CaptureFormat captureFormat = CaptureFormat::Png;
+	const char* scenePath = nullptr;
+	const char* recordingPath = nullptr;
+	uint32_t recordingFrames = 0;
+	std::vector<const char*> texturePaths;
+	RenderServer::Settings serverSettings;
+	EngineConfig config;
+	if (!config.load(argc, argv)) {
+		return 1;
+	}
+	for (int i = 1; i < argc; i++) {
+		if ((std::strcmp(argv[i], "--config") == 0 || std::strcmp(argv[i], "--set") == 0) && i + 1 < argc) {
+			// read by EngineConfig::load
+			i++;
+		}
+		else if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+			bHeadless = true;
+			headlessFrames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+			scenePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--texture") == 0 && i + 1 < argc) {
+			texturePaths.push_back(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--serve-socket") == 0 && i + 1 < argc) {
+			serverSettings.socketPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--serve-dir") == 0 && i + 1 < argc) {
+			serverSettings.watchDirectory = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--exit-when-idle") == 0) {
+			serverSettings.bExitWhenIdle = true;
+		}
+		else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			recordingPath = argv[++i];
+			if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+				recordingFrames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+		}
+		else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+			captureDirectory = argv[++i];
+			if (i + 1 < argc && std::strcmp(argv[i + 1], "exr") == 0) {
+				captureFormat = CaptureFormat::Exr;
+				i++;
+			}
+			else if (i + 1 < argc && std::strcmp(argv[i + 1], "raw") == 0) {
+				captureFormat = CaptureFormat::Raw;
+				i++;
+			}
+			else if (i + 1 < argc && std::strcmp(argv[i + 1], "png") == 0) {
+				i++;
+			}
+		}
+	}
+
+	const bool bServer = !serverSettings.socketPath.empty() || !serverSettings.watchDirectory.empty();
+
 	VulkanEngine engine;
 
-	engine.init();
+	engine.init(bHeadless || bServer, config);
+	std::cout << "engine config: " << engine.get_config().to_string() << std::endl;
+	// no display or no device to present with (e.g. a CPU-only render node): render a single frame headless instead
+	if (!bHeadless && engine.is_headless()) {
+		bHeadless = true;
+		headlessFrames = 1;
+	}
+
+	if (scenePath) {
+		engine.load_scene(scenePath);
+	}
+	for (const char* texturePath : texturePaths) {
+		engine.load_texture(texturePath);
+	}
+	if (bHeadless && (scenePath || !texturePaths.empty())) {
+		engine.wait_for_assets();
+	}
+
+	if (bServer) {
+		// jobs bring their own scenes, cameras and outputs
+		RenderServer server;
+		bool bServing = server.init(&engine, serverSettings);
+		if (bServing) {
+			server.run();
+		}
+		server.destroy();
+		engine.cleanup();
+		return bServing ? 0 : 1;
+	}
+
+	if (captureDirectory) {
+		engine.start_capture(captureDirectory, captureFormat, bHeadless ? headlessFrames : 1);
+	}
+
+	// after the loads above, which the recording then starts with
+	if (recordingPath && !engine.start_recording(recordingPath, bHeadless && recordingFrames == 0 ? headlessFrames : recordingFrames)) {
+		engine.cleanup();
+		return 1;
+	}
 
-	engine.run();
+	if (bHeadless) {
+		auto start = std::chrono::steady_clock::now();
+		engine.run_headless(headlessFrames);
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "rendered " << headlessFrames << " frames in " << elapsed << " ms, " << elapsed / std::max(headlessFrames, 1u)
+			<< " ms per frame" << std::endl;
+		if (recordingPath) {
+			// the costs of the last recorded frames come back once their frame slots are used again
+			engine.stop_recording();
+			engine.run_headless(engine.get_config().framesInFlight);
+		}
+	}
+	else {
+		engine.run();
+	}
 
 	engine.cleanup();
 }
@@ -0,0 +1,553 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "mesh_optimizer.h"
+
+namespace {
+    constexpr uint32_t INVALID_VERTEX = UINT32_MAX;
+
+    // FIFO cache simulation with timestamps: a vertex is a hit if it was inserted fewer than VERTEX_CACHE_SIZE misses ago
+    struct CacheSimulation {
+        std::vector<uint32_t> insertionTimes;
+        uint32_t time = meshutil::VERTEX_CACHE_SIZE + 1;
+
+        explicit CacheSimulation(size_t vertexCount) : insertionTimes(vertexCount, 0) {}
+
+        // returns the number of misses of the triangle
+        uint32_t add_triangle(const uint32_t* triangle)
+        {
+            uint32_t misses = 0;
+            for (int i = 0; i < 3; i++) {
+                if (time - insertionTimes[triangle[i]] > meshutil::VERTEX_CACHE_SIZE) {
+                    insertionTimes[triangle[i]] = time++;
+                    misses++;
+                }
+            }
+            return misses;
+        }
+
+        void reset() { time += meshutil::VERTEX_CACHE_SIZE + 1; }
+    };
+
+    // sum of squared distances to a set of planes, as the symmetric 4x4 matrix of their (n, d) outer products
+    struct Quadric {
+        float a00 = 0.f, a01 = 0.f, a02 = 0.f, a03 = 0.f;
+        float a11 = 0.f, a12 = 0.f, a13 = 0.f;
+        float a22 = 0.f, a23 = 0.f;
+        float a33 = 0.f;
+
+        void add_plane(const glm::vec3& n, float d)
+        {
+            a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z; a03 += n.x * d;
+            a11 += n.y * n.y; a12 += n.y * n.z; a13 += n.y * d;
+            a22 += n.z * n.z; a23 += n.z * d;
+            a33 += d * d;
+        }
+
+        void add(const Quadric& other)
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+            a11 += other.a11; a12 += other.a12; a13 += other.a13;
+            a22 += other.a22; a23 += other.a23;
+            a33 += other.a33;
+        }
+
+        float evaluate(const glm::vec3& p) const
+        {
+            float error = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z + a33
+                + 2.f * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z + a03 * p.x + a13 * p.y + a23 * p.z);
+            // rounding can take a sum of squares slightly below zero
+            return std::max(error, 0.f);
+        }
+    };
+}
+
+void meshutil::optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* outClusters)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (outClusters) {
+        outClusters->assign(1, 0);
+    }
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // vertex -> triangle adjacency in one flat array; liveCounts tracks how many triangles of each vertex are not emitted yet
+    std::vector<uint32_t> liveCounts(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        liveCounts[indices[i]]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+        adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveCounts[vertex];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fillCursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        adjacency[fillCursors[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<uint32_t> cacheTimes(vertexCount, 0);
+    uint32_t time = VERTEX_CACHE_SIZE + 1;
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEndStack;
+    deadEndStack.reserve(triangleCount * 3);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+
+    uint32_t fanningVertex = indices[0];
+    uint32_t inputCursor = 0;
+    while (fanningVertex != INVALID_VERTEX) {
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t k = adjacencyOffsets[fanningVertex]; k < adjacencyOffsets[fanningVertex + 1]; k++) {
+            uint32_t triangle = adjacency[k];
+            if (emitted[triangle]) {
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++) {
+                uint32_t vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                deadEndStack.push_back(vertex);
+                candidates.push_back(vertex);
+                liveCounts[vertex]--;
+                if (time - cacheTimes[vertex] > VERTEX_CACHE_SIZE) {
+                    cacheTimes[vertex] = time++;
+                }
+            }
+            emitted[triangle] = 1;
+        }
+
+        // next fan: the candidate that will still be in the cache after its own triangles went through, oldest first
+        uint32_t nextVertex = INVALID_VERTEX;
+        int bestPriority = -1;
+        for (uint32_t vertex : candidates) {
+            if (liveCounts[vertex] == 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - cacheTimes[vertex] + 2 * liveCounts[vertex] <= VERTEX_CACHE_SIZE) {
+                priority = (int)(time - cacheTimes[vertex]);
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                nextVertex = vertex;
+            }
+        }
+
+        if (nextVertex == INVALID_VERTEX) {
+            // dead end: back up to a recently used vertex with triangles left, or scan ahead in the input
+            while (!deadEndStack.empty() && nextVertex == INVALID_VERTEX) {
+                uint32_t vertex = deadEndStack.back();
+                deadEndStack.pop_back();
+                if (liveCounts[vertex] > 0) {
+                    nextVertex = vertex;
+                }
+            }
+            while (nextVertex == INVALID_VERTEX && inputCursor < vertexCount) {
+                if (liveCounts[inputCursor] > 0) {
+                    nextVertex = inputCursor;
+                }
+                inputCursor++;
+            }
+
+            uint32_t boundary = (uint32_t)(output.size() / 3);
+            if (outClusters && nextVertex != INVALID_VERTEX && outClusters->back() != boundary) {
+                outClusters->push_back(boundary);
+            }
+        }
+        fanningVertex = nextVertex;
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void meshutil::optimize_overdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    const std::vector<uint32_t>& clusters, float threshold)
+{
+    const uint32_t triangleCount = (uint32_t)(indexCount / 3);
+    if (triangleCount == 0 || clusters.empty()) {
+        return;
+    }
+
+    // split the dead end runs further wherever the run so far has a miss ratio at most threshold times the mesh's,
+    // so the clusters become small enough for sorting to matter while keeping most of the cache ordering
+    const float missThreshold = threshold * compute_acmr(indices, indexCount, vertexCount);
+    std::vector<uint32_t> softClusters;
+    CacheSimulation cache(vertexCount);
+    for (size_t hard = 0; hard < clusters.size(); hard++) {
+        uint32_t end = hard + 1 < clusters.size() ? clusters[hard + 1] : triangleCount;
+        uint32_t start = clusters[hard];
+        uint32_t misses = 0;
+        softClusters.push_back(start);
+        cache.reset();
+        for (uint32_t triangle = start; triangle < end; triangle++) {
+            misses += cache.add_triangle(indices + triangle * 3);
+            uint32_t clusterTriangles = triangle - softClusters.back() + 1;
+            if (triangle + 1 < end && (float)misses <= missThreshold * clusterTriangles) {
+                softClusters.push_back(triangle + 1);
+                misses = 0;
+                cache.reset();
+            }
+        }
+    }
+
+    glm::vec3 meshCentroid(0.f);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+        meshCentroid += vertices[vertex].position;
+    }
+    meshCentroid /= (float)std::max<size_t>(vertexCount, 1);
+
+    // sort key: how far the cluster's area weighted centroid lies in the direction of its average normal
+    std::vector<float> sortKeys(softClusters.size());
+    for (size_t cluster = 0; cluster < softClusters.size(); cluster++) {
+        uint32_t end = cluster + 1 < softClusters.size() ? softClusters[cluster + 1] : triangleCount;
+        glm::vec3 centroid(0.f), normal(0.f);
+        float totalArea = 0.f;
+        for (uint32_t triangle = softClusters[cluster]; triangle < end; triangle++) {
+            const glm::vec3& p0 = vertices[indices[triangle * 3 + 0]].position;
+            const glm::vec3& p1 = vertices[indices[triangle * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[triangle * 3 + 2]].position;
+            glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(triangleNormal);
+            centroid += (p0 + p1 + p2) * (area / 3.f);
+            normal += triangleNormal;
+            totalArea += area;
+        }
+        float normalLength = glm::length(normal);
+        if (totalArea > 0.f && normalLength > 0.f) {
+            sortKeys[cluster] = glm::dot(centroid / totalArea - meshCentroid, normal / normalLength);
+        }
+        else {
+            sortKeys[cluster] = 0.f;
+        }
+    }
+
+    std::vector<uint32_t> order(softClusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(triangleCount * 3);
+    for (uint32_t cluster : order) {
+        uint32_t end = cluster + 1 < softClusters.size() ? softClusters[cluster + 1] : triangleCount;
+        sorted.insert(sorted.end(), indices + softClusters[cluster] * 3, indices + end * 3);
+    }
+    std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+size_t meshutil::simplify(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    size_t targetIndexCount, float targetError, float* outError)
+{
+    indexCount -= indexCount % 3;
+    if (outIndices != indices) {
+        std::copy(indices, indices + indexCount, outIndices);
+    }
+
+    // vertices sharing a position (split for their normal or uv) are one point of the surface: positionIds maps each
+    // vertex to the first of them, and a position referenced through more than one vertex is an attribute seam
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    auto position_less = [&](uint32_t a, uint32_t b) {
+        const glm::vec3& pa = vertices[a].position;
+        const glm::vec3& pb = vertices[b].position;
+        return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+    };
+    std::sort(order.begin(), order.end(), position_less);
+    std::vector<uint32_t> positionIds(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        bool bSameAsPrevious = i > 0 && vertices[order[i]].position == vertices[order[i - 1]].position;
+        positionIds[order[i]] = bSameAsPrevious ? positionIds[order[i - 1]] : order[i];
+    }
+
+    std::vector<uint8_t> bReferenced(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++) {
+        bReferenced[outIndices[i]] = 1;
+    }
+    std::vector<uint32_t> positionVertices(vertexCount, 0);
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+        positionVertices[positionIds[vertex]] += bReferenced[vertex];
+    }
+    std::vector<uint8_t> bLockedPositions(vertexCount, 0);
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+        bLockedPositions[positionIds[vertex]] |= positionVertices[positionIds[vertex]] > 1;
+    }
+
+    // an edge not shared by exactly two triangles is an open border (or non-manifold); its ends stay put
+    std::vector<uint64_t> edges;
+    edges.reserve(indexCount);
+    for (size_t i = 0; i < indexCount; i += 3) {
+        for (int corner = 0; corner < 3; corner++) {
+            uint32_t a = positionIds[outIndices[i + corner]];
+            uint32_t b = positionIds[outIndices[i + (corner + 1) % 3]];
+            edges.push_back(((uint64_t)std::min(a, b) << 32) | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t first = 0; first < edges.size();) {
+        size_t last = first;
+        while (last < edges.size() && edges[last] == edges[first]) {
+            last++;
+        }
+        if (last - first != 2) {
+            bLockedPositions[edges[first] >> 32] = 1;
+            bLockedPositions[edges[first] & UINT32_MAX] = 1;
+        }
+        first = last;
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indexCount; i += 3) {
+        const glm::vec3& p0 = vertices[outIndices[i]].position;
+        glm::vec3 normal = glm::cross(vertices[outIndices[i + 1]].position - p0, vertices[outIndices[i + 2]].position - p0);
+        float length = glm::length(normal);
+        if (length == 0.f) {
+            continue;
+        }
+        normal /= length;
+        for (int corner = 0; corner < 3; corner++) {
+            quadrics[positionIds[outIndices[i + corner]]].add_plane(normal, -glm::dot(normal, p0));
+        }
+    }
+
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        float cost;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> triangleOffsets;
+    std::vector<uint32_t> vertexTriangles;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> bTouched(vertexCount);
+    float maxCost = 0.f;
+
+    // passes of independent collapses: every pass collapses the cheapest edges whose neighbourhoods do not overlap, so the
+    // flip test of each holds no matter what else the pass collapses
+    while (indexCount > targetIndexCount) {
+        triangleOffsets.assign(vertexCount + 1, 0);
+        for (size_t i = 0; i < indexCount; i++) {
+            triangleOffsets[outIndices[i] + 1]++;
+        }
+        std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+        vertexTriangles.resize(indexCount);
+        std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; i++) {
+            vertexTriangles[fill[outIndices[i]]++] = (uint32_t)(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < indexCount; i += 3) {
+            for (int corner = 0; corner < 3; corner++) {
+                uint32_t a = outIndices[i + corner];
+                uint32_t b = outIndices[i + (corner + 1) % 3];
+                Quadric quadric = quadrics[positionIds[a]];
+                quadric.add(quadrics[positionIds[b]]);
+                if (!bLockedPositions[positionIds[a]]) {
+                    collapses.push_back({ a, b, quadric.evaluate(vertices[b].position) });
+                }
+                if (!bLockedPositions[positionIds[b]]) {
+                    collapses.push_back({ b, a, quadric.evaluate(vertices[a].position) });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        // would moving from onto to turn any of from's remaining triangles over (or flatten it)?
+        auto flips = [&](const Collapse& collapse) {
+            for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++) {
+                const uint32_t* corners = outIndices + vertexTriangles[t] * 3;
+                if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) {
+                    continue; // collapses away
+                }
+                glm::vec3 before[3], after[3];
+                for (int corner = 0; corner < 3; corner++) {
+                    before[corner] = vertices[corners[corner]].position;
+                    after[corner] = corners[corner] == collapse.from ? vertices[collapse.to].position : before[corner];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+                if (lengths == 0.f || glm::dot(normalBefore, normalAfter) < 1e-2f * lengths) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        // an interior collapse removes two triangles
+        size_t collapseBudget = (indexCount - targetIndexCount) / 6 + 1;
+        size_t collapseCount = 0;
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::fill(bTouched.begin(), bTouched.end(), 0);
+        for (const Collapse& collapse : collapses) {
+            if (collapseCount == collapseBudget || collapse.cost > targetError * targetError) {
+                break;
+            }
+            if (bTouched[collapse.from] || bTouched[collapse.to] || flips(collapse)) {
+                continue;
+            }
+            remap[collapse.from] = collapse.to;
+            quadrics[positionIds[collapse.to]].add(quadrics[positionIds[collapse.from]]);
+            maxCost = std::max(maxCost, collapse.cost);
+            for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++) {
+                const uint32_t* corners = outIndices + vertexTriangles[t] * 3;
+                bTouched[corners[0]] = bTouched[corners[1]] = bTouched[corners[2]] = 1;
+            }
+            collapseCount++;
+        }
+        if (collapseCount == 0) {
+            break;
+        }
+
+        size_t writeIndex = 0;
+        for (size_t i = 0; i < indexCount; i += 3) {
+            uint32_t a = remap[outIndices[i]], b = remap[outIndices[i + 1]], c = remap[outIndices[i + 2]];
+            if (a != b && b != c && c != a) {
+                outIndices[writeIndex++] = a;
+                outIndices[writeIndex++] = b;
+                outIndices[writeIndex++] = c;
+            }
+        }
+        indexCount = writeIndex;
+    }
+
+    if (outError) {
+        *outError = std::sqrt(maxCost);
+    }
+    return indexCount;
+}
+
+void meshutil::optimize_vertex_fetch(std::vector<Vertex>& vertices, uint32_t* indices, size_t indexCount)
+{
+    std::vector<uint32_t> remap(vertices.size(), INVALID_VERTEX);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t& newIndex = remap[indices[i]];
+        if (newIndex == INVALID_VERTEX) {
+            newIndex = (uint32_t)reordered.size();
+            reordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = newIndex;
+    }
+    vertices = std::move(reordered);
+}
+
+void meshutil::build_meshlets(const uint32_t* indices, size_t indexCount, uint32_t firstIndex, const Vertex* vertices, size_t vertexCount,
+    std::vector<Meshlet>& outMeshlets)
+{
+    // a vertex counts towards the current meshlet if it was last seen in it; stamps avoid clearing a set per meshlet
+    std::vector<uint32_t> lastMeshlet(vertexCount, UINT32_MAX);
+    uint32_t meshletIndex = 0;
+    size_t meshletStart = 0;
+    uint32_t meshletVertices = 0;
+
+    auto emit = [&](size_t end) {
+        Meshlet meshlet{};
+        meshlet.firstIndex = firstIndex + (uint32_t)meshletStart;
+        meshlet.triangleCount = (uint32_t)((end - meshletStart) / 3);
+        compute_meshlet_bounds(indices + meshletStart, end - meshletStart, vertices, meshlet);
+        outMeshlets.push_back(meshlet);
+        meshletIndex++;
+        meshletStart = end;
+        meshletVertices = 0;
+    };
+
+    // vertices of a triangle not in the current meshlet yet; a triangle may repeat a vertex, which counts once
+    auto count_new_vertices = [&](const uint32_t* corners) {
+        uint32_t count = 0;
+        for (int corner = 0; corner < 3; corner++) {
+            bool bRepeated = (corner > 0 && corners[corner] == corners[0]) || (corner > 1 && corners[corner] == corners[1]);
+            count += lastMeshlet[corners[corner]] != meshletIndex && !bRepeated;
+        }
+        return count;
+    };
+
+    const size_t triangleCount = indexCount / 3;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        const uint32_t* corners = indices + triangle * 3;
+        uint32_t newVertices = count_new_vertices(corners);
+        size_t meshletTriangles = (triangle * 3 - meshletStart) / 3;
+        if (meshletVertices + newVertices > MESHLET_MAX_VERTICES || meshletTriangles == MESHLET_MAX_TRIANGLES) {
+            emit(triangle * 3);
+            newVertices = count_new_vertices(corners);
+        }
+        for (int corner = 0; corner < 3; corner++) {
+            lastMeshlet[corners[corner]] = meshletIndex;
+        }
+        meshletVertices += newVertices;
+    }
+    if (meshletStart < triangleCount * 3) {
+        emit(triangleCount * 3);
+    }
+}
+
+void meshutil::compute_meshlet_bounds(const uint32_t* indices, size_t indexCount, const Vertex* vertices, Meshlet& outMeshlet)
+{
+    if (indexCount == 0) {
+        outMeshlet.sphere = glm::vec4(0.f);
+        outMeshlet.cone = glm::vec4(0.f, 0.f, 1.f, 1.f);
+        return;
+    }
+
+    glm::vec3 boundsMin = vertices[indices[0]].position;
+    glm::vec3 boundsMax = boundsMin;
+    for (size_t i = 1; i < indexCount; i++) {
+        boundsMin = glm::min(boundsMin, vertices[indices[i]].position);
+        boundsMax = glm::max(boundsMax, vertices[indices[i]].position);
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radiusSquared = 0.f;
+    for (size_t i = 0; i < indexCount; i++) {
+        glm::vec3 offset = vertices[indices[i]].position - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    outMeshlet.sphere = glm::vec4(center, std::sqrt(radiusSquared));
+
+    // the cone axis is the average face normal; the cutoff follows from the normal farthest from it
+    std::vector<glm::vec3> normals;
+    normals.reserve(indexCount / 3);
+    glm::vec3 axis(0.f);
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        const glm::vec3& p0 = vertices[indices[i]].position;
+        glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+        float length = glm::length(normal);
+        if (length > 0.f) {
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+    }
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength == 0.f) {
+        outMeshlet.cone = glm::vec4(0.f, 0.f, 1.f, 1.f);
+        return;
+    }
+    axis /= axisLength;
+    float minDot = 1.f;
+    for (const glm::vec3& normal : normals) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    }
+    // normals spread over (nearly) a hemisphere leave no direction from which the whole cluster is back facing
+    if (minDot <= 0.1f) {
+        outMeshlet.cone = glm::vec4(axis, 1.f);
+        return;
+    }
+    outMeshlet.cone = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+}
+
+float meshutil::compute_acmr(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return 0.f;
+    }
+
+    CacheSimulation cache(vertexCount);
+    uint64_t misses = 0;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        misses += cache.add_triangle(indices + triangle * 3);
+    }
+    return (float)misses / (float)triangleCount;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vk_geometry.h"
+
+// Index and vertex reordering run on meshes as they are loaded (on worker threads, so every function is reentrant).
+// The usual order is optimize_vertex_cache -> optimize_overdraw -> simplify (per level of detail) -> optimize_vertex_fetch ->
+// build_meshlets
+namespace meshutil {
+	// the post-transform cache size the orderings are tuned for; real hardware behaves roughly like a FIFO of this size
+	constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+	// meshlet limits: 64 unique vertices and 124 triangles is the size mesh shading hardware is built around, and keeps a
+	// cluster's index copy within two passes of a 64 thread workgroup
+	constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+	constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+	// reorders triangles for post-transform cache reuse (Tipsify, Sander et al. 2007), in linear time.
+	// outClusters, if given, receives the first triangle of every run that starts after a dead end; optimize_overdraw
+	// may only reorder whole runs without losing the cache ordering within them
+	void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* outClusters = nullptr);
+
+	// reorders the clusters of a cache optimized index buffer so outward facing ones come first, which lets early depth
+	// testing reject more of what is drawn behind them. Clusters are split further where that costs at most threshold
+	// times the mesh's cache miss ratio (1.05: up to 5% more vertex shading in exchange for the reordering)
+	void optimize_overdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+		const std::vector<uint32_t>& clusters, float threshold = 1.05f);
+
+	// reduces a range of triangles towards targetIndexCount by collapsing edges in order of quadric error (Garland and Heckbert
+	// 1997), writing the result to outIndices (which may alias indices) and returning its index count. Only indices change, so
+	// every level of detail can share the mesh's vertices: a vertex collapses onto a neighbour rather than to a new position.
+	// Vertices on open borders and attribute seams (several vertices at one position) stay put, so levels keep their outline
+	// and do not tear along uv or normal discontinuities. Collapses that would flip a triangle are skipped, and the reduction
+	// stops early once nothing can collapse without moving the surface more than targetError (in mesh units).
+	// outError, if given, receives the largest such distance the result has, as the quadrics estimate it
+	size_t simplify(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+		size_t targetIndexCount, float targetError, float* outError = nullptr);
+
+	// renumbers vertices in order of first use so vertex fetches walk memory linearly, and drops unreferenced vertices.
+	// vertices is reordered and shrunk, indices rewritten
+	void optimize_vertex_fetch(std::vector<Vertex>& vertices, uint32_t* indices, size_t indexCount);
+
+	// splits indices (a cache optimized range of a mesh's index buffer) into meshlets of consecutive triangles, so the index
+	// buffer stays as it is and a meshlet is just a range of it. A meshlet ends where the next triangle would exceed either limit.
+	// Meshlets are appended to outMeshlets with firstIndex offset by firstIndex; bounds are computed with compute_meshlet_bounds
+	void build_meshlets(const uint32_t* indices, size_t indexCount, uint32_t firstIndex, const Vertex* vertices, size_t vertexCount,
+		std::vector<Meshlet>& outMeshlets);
+
+	// bounding sphere (center of the vertices' box, radius to the farthest vertex) and normal cone of a range of triangles.
+	// Degenerate triangles are ignored; if the normals spread over more than a hemisphere (or there are none), the cone is
+	// left wide open so the meshlet is never rejected as back facing
+	void compute_meshlet_bounds(const uint32_t* indices, size_t indexCount, const Vertex* vertices, Meshlet& outMeshlet);
+
+	// average transformed vertices per triangle on a FIFO cache of VERTEX_CACHE_SIZE (0.5 is ideal, 3 is no reuse at all)
+	float compute_acmr(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+}
\ No newline at end of file
@@ -0,0 +1,530 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "camera.h"
+#include "json.h"
+#include "render_server.h"
+#include "vk_engine.h"
+
+namespace {
+    std::string escape(const std::string& text)
+    {
+        std::string escaped;
+        for (char character : text) {
+            if (character == '"' || character == '\\') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(character);
+        }
+        return escaped;
+    }
+
+    float seconds_between(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+    {
+        return std::chrono::duration<float>(end - begin).count();
+    }
+}
+
+bool RenderServer::init(VulkanEngine* engine, const Settings& settings)
+{
+    mEngine = engine;
+    mSettings = settings;
+    if (!mEngine->is_headless()) {
+        std::cout << "render server: the engine must be headless" << std::endl;
+        return false;
+    }
+
+    if (!mSettings.socketPath.empty()) {
+#ifdef _WIN32
+        std::cout << "render server: sockets are not supported on this platform" << std::endl;
+        return false;
+#else
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (mSettings.socketPath.size() >= sizeof(address.sun_path)) {
+            std::cout << "render server: socket path too long: " << mSettings.socketPath << std::endl;
+            return false;
+        }
+        std::memcpy(address.sun_path, mSettings.socketPath.c_str(), mSettings.socketPath.size() + 1);
+
+        // a socket left behind by a server that did not shut down cleanly; anything else at the path is kept
+        struct stat pathStat;
+        if (stat(mSettings.socketPath.c_str(), &pathStat) == 0 && S_ISSOCK(pathStat.st_mode)) {
+            unlink(mSettings.socketPath.c_str());
+        }
+
+        mListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (mListenSocket < 0 || bind(mListenSocket, (const sockaddr*)&address, sizeof(address)) != 0 || listen(mListenSocket, 16) != 0) {
+            std::cout << "render server: failed to listen on " << mSettings.socketPath << ": " << std::strerror(errno) << std::endl;
+            if (mListenSocket >= 0) {
+                close(mListenSocket);
+                mListenSocket = -1;
+            }
+            return false;
+        }
+        fcntl(mListenSocket, F_SETFL, fcntl(mListenSocket, F_GETFL) | O_NONBLOCK);
+#endif
+    }
+
+    if (!mSettings.watchDirectory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(mSettings.watchDirectory, error);
+        if (error) {
+            std::cout << "render server: failed to create " << mSettings.watchDirectory << ": " << error.message() << std::endl;
+            destroy();
+            return false;
+        }
+    }
+
+    // reproducible images: auto-exposure adapts as if the engine ran at a steady 60 fps, however fast jobs render
+    mEngine->set_fixed_delta_time(1.f / 60.f);
+    // the first frame requests the pipeline permutations every later frame uses, so no image is rendered with a fallback
+    mEngine->run_headless(1);
+    mEngine->wait_for_pipelines();
+    return true;
+}
+
+void RenderServer::destroy()
+{
+#ifndef _WIN32
+    for (Client& client : mClients) {
+        close(client.socket);
+    }
+    if (mListenSocket >= 0) {
+        close(mListenSocket);
+        unlink(mSettings.socketPath.c_str());
+        mListenSocket = -1;
+    }
+#endif
+    mClients.clear();
+
+    // jobs claimed from the directory go back, so another server can pick them up
+    for (const std::shared_ptr<Job>& job : mQueuedJobs) {
+        if (!job->claimedFile.empty()) {
+            std::error_code error;
+            std::filesystem::rename(job->claimedFile, job->claimedFile.parent_path() / job->claimedFile.stem(), error);
+        }
+    }
+    mQueuedJobs.clear();
+}
+
+void RenderServer::run()
+{
+    std::cout << "render server ready";
+    if (!mSettings.socketPath.empty()) {
+        std::cout << ", listening on " << mSettings.socketPath;
+    }
+    if (!mSettings.watchDirectory.empty()) {
+        std::cout << ", watching " << mSettings.watchDirectory;
+    }
+    std::cout << std::endl;
+
+    auto serveStart = std::chrono::steady_clock::now();
+    while (true) {
+        // sources are only checked without waiting while there is work, so they never hold up rendering
+        poll_directory(false);
+        poll_socket(0);
+        finish_jobs();
+
+        if (!mCurrentJob && !mQueuedJobs.empty()) {
+            mCurrentJob = std::move(mQueuedJobs.front());
+            mQueuedJobs.pop_front();
+            if (!begin_job(*mCurrentJob)) {
+                report(*mCurrentJob);
+                mCurrentJob.reset();
+                continue;
+            }
+        }
+        if (mCurrentJob) {
+            render_frame();
+            continue;
+        }
+
+        if (!mWritingJobs.empty()) {
+            // nothing left to render: the last frames' readbacks only go to the encoders once the GPU is done with them
+            mEngine->wait_for_captures();
+            continue;
+        }
+
+        poll_directory(true);
+        if (!is_idle()) {
+            continue;
+        }
+        if (mShutdownRequested || mSettings.bExitWhenIdle) {
+            break;
+        }
+        if (mListenSocket >= 0) {
+            poll_socket(mSettings.pollInterval);
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(mSettings.pollInterval));
+        }
+    }
+
+    std::cout << "render server: " << mStats.completedJobs << " jobs done, " << mStats.failedJobs << " failed, " << mStats.images
+        << " images (" << mStats.frames << " frames) in " << seconds_between(serveStart, std::chrono::steady_clock::now()) << " s"
+        << std::endl;
+}
+
+void RenderServer::poll_socket(uint32_t timeout)
+{
+#ifndef _WIN32
+    if (mListenSocket < 0) {
+        return;
+    }
+
+    std::vector<pollfd> descriptors;
+    descriptors.push_back({ mListenSocket, POLLIN, 0 });
+    for (const Client& client : mClients) {
+        descriptors.push_back({ client.socket, POLLIN, 0 });
+    }
+    if (poll(descriptors.data(), (nfds_t)descriptors.size(), (int)timeout) <= 0) {
+        return;
+    }
+
+    if (descriptors[0].revents & POLLIN) {
+        int clientSocket;
+        while ((clientSocket = accept(mListenSocket, nullptr, nullptr)) >= 0) {
+            fcntl(clientSocket, F_SETFL, fcntl(clientSocket, F_GETFL) | O_NONBLOCK);
+            mClients.push_back({ clientSocket, ++mNextClientId, std::string(), 0 });
+        }
+    }
+
+    // clients accepted above were not polled yet and are read next time
+    for (size_t i = 1; i < descriptors.size(); i++) {
+        if (!(descriptors[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+        Client& client = mClients[i - 1];
+        char buffer[4096];
+        ssize_t received;
+        while ((received = recv(client.socket, buffer, sizeof(buffer), 0)) > 0) {
+            client.pending.append(buffer, (size_t)received);
+        }
+        bool bClosed = received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+
+        size_t lineEnd;
+        while ((lineEnd = client.pending.find('\n')) != std::string::npos) {
+            std::string line = client.pending.substr(0, lineEnd);
+            client.pending.erase(0, lineEnd + 1);
+            if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                accept_job(line, "job-" + std::to_string(client.id) + "-" + std::to_string(client.jobCount++), client.id, {});
+            }
+        }
+        if (bClosed) {
+            // its jobs still render; their results have nowhere to go
+            close(client.socket);
+            client.socket = -1;
+        }
+    }
+    std::erase_if(mClients, [](const Client& client) { return client.socket < 0; });
+#else
+    (void)timeout;
+#endif
+}
+
+void RenderServer::poll_directory(bool bForce)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (mSettings.watchDirectory.empty()
+        || (!bForce && now - mLastDirectoryPoll < std::chrono::milliseconds(mSettings.pollInterval))) {
+        return;
+    }
+    mLastDirectoryPoll = now;
+
+    std::error_code error;
+    std::vector<std::filesystem::path> files;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(mSettings.watchDirectory, error)) {
+        std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && name.ends_with(".json") && !name.ends_with(".result.json")) {
+            files.push_back(entry.path());
+        }
+    }
+    // oldest first, as far as names tell
+    std::sort(files.begin(), files.end());
+
+    for (const std::filesystem::path& file : files) {
+        // renaming is atomic, so of several servers watching the directory only one gets the job
+        std::filesystem::path claimedFile = file;
+        claimedFile += ".running";
+        std::filesystem::rename(file, claimedFile, error);
+        if (error) {
+            continue;
+        }
+
+        std::ifstream stream(claimedFile);
+        std::stringstream text;
+        text << stream.rdbuf();
+        accept_job(text.str(), file.stem().string(), 0, claimedFile);
+    }
+}
+
+void RenderServer::accept_job(const std::string& text, const std::string& defaultId, uint32_t client, const std::filesystem::path& claimedFile)
+{
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->id = defaultId;
+    job->client = client;
+    job->claimedFile = claimedFile;
+    job->arrival = std::chrono::steady_clock::now();
+
+    JsonValue json;
+    if (!JsonValue::parse(text, json) || !json.is_object()) {
+        job->error = "not a JSON object";
+    }
+    else if (json.get_string("command") == "shutdown") {
+        std::cout << "render server: shutting down once the queued jobs are done" << std::endl;
+        mShutdownRequested = true;
+        if (!claimedFile.empty()) {
+            std::error_code error;
+            std::filesystem::path doneFile = claimedFile.parent_path() / claimedFile.stem();
+            doneFile += ".done";
+            std::filesystem::rename(claimedFile, doneFile, error);
+        }
+        return;
+    }
+    else if (mShutdownRequested) {
+        job->error = "the server is shutting down";
+    }
+    else {
+        parse_job(json, *job);
+    }
+
+    if (!job->error.empty()) {
+        report(*job);
+        return;
+    }
+    mQueuedJobs.push_back(std::move(job));
+}
+
+bool RenderServer::parse_job(const JsonValue& json, Job& job)
+{
+    if (const JsonValue* id = json.find("id"); id && id->type == JsonValue::Type::String) {
+        job.id = id->string;
+    }
+    job.scene = json.get_string("scene");
+    job.outputDirectory = json.get_string("output");
+
+    const std::string& format = json.get_string("format");
+    if (format == "exr") {
+        job.format = CaptureFormat::Exr;
+    }
+    else if (format == "raw") {
+        job.format = CaptureFormat::Raw;
+    }
+    else if (!format.empty() && format != "png") {
+        job.error = "unknown format " + format;
+        return false;
+    }
+
+    job.warmupFrames = (uint32_t)std::max<int64_t>(json.get_int("warmupFrames", 0), 0);
+    job.framesPerImage = (uint32_t)std::max<int64_t>(json.get_int("framesPerImage", 1), 1);
+
+    // missing members keep the engine camera's defaults
+    const Camera defaults;
+    for (const JsonValue& camera : json.get_array("cameras")) {
+        JobCamera jobCamera;
+        const std::vector<JsonValue>& position = camera.get_array("position");
+        jobCamera.position = position.size() == 3 ? glm::vec3((float)position[0].number, (float)position[1].number, (float)position[2].number)
+            : defaults.mPosition;
+        jobCamera.yaw = glm::radians((float)camera.get_number("yaw", glm::degrees(defaults.mYaw)));
+        jobCamera.pitch = glm::radians((float)camera.get_number("pitch", glm::degrees(defaults.mPitch)));
+        jobCamera.verticalFov = glm::radians((float)camera.get_number("fov", glm::degrees(defaults.mVerticalFov)));
+        job.cameras.push_back(jobCamera);
+    }
+
+    if (job.outputDirectory.empty()) {
+        job.error = "no output directory";
+    }
+    else if (job.cameras.empty()) {
+        job.error = "no cameras";
+    }
+    return job.error.empty();
+}
+
+bool RenderServer::begin_job(Job& job)
+{
+    std::error_code error;
+    std::filesystem::create_directories(job.outputDirectory, error);
+    if (error) {
+        job.error = "failed to create " + job.outputDirectory + ": " + error.message();
+        return false;
+    }
+
+    if (!job.scene.empty()) {
+        auto scene = mLoadedScenes.find(job.scene);
+        if (scene == mLoadedScenes.end()) {
+            // stalls rendering, but only for the first job of each scene; frames of earlier jobs keep going on the GPU
+            uint32_t firstNode = mEngine->get_scene_node_count();
+            mEngine->load_scene(job.scene);
+            mEngine->wait_for_assets();
+            SceneNodes nodes = { firstNode, mEngine->get_scene_node_count() - firstNode };
+            if (nodes.count == 0) {
+                job.error = "failed to load " + job.scene;
+                return false;
+            }
+            scene = mLoadedScenes.emplace(job.scene, nodes).first;
+        }
+        mEngine->set_visible_scene_nodes(scene->second.first, scene->second.count);
+    }
+    else {
+        mEngine->set_visible_scene_nodes(0, UINT32_MAX);
+    }
+
+    // a job's frames never blend with the previous job's, which saw another camera (and maybe scene)
+    mEngine->reset_temporal_history();
+    job.start = std::chrono::steady_clock::now();
+    return true;
+}
+
+void RenderServer::render_frame()
+{
+    Job& job = *mCurrentJob;
+    const uint32_t frame = job.renderedFrames;
+    const uint32_t imageFrame = frame < job.warmupFrames ? 0 : frame - job.warmupFrames;
+    const uint32_t cameraIndex = imageFrame / job.framesPerImage;
+
+    const JobCamera& jobCamera = job.cameras[cameraIndex];
+    Camera& camera = mEngine->get_camera();
+    camera.mPosition = jobCamera.position;
+    camera.mYaw = jobCamera.yaw;
+    camera.mPitch = jobCamera.pitch;
+    camera.mVerticalFov = jobCamera.verticalFov;
+
+    // a request the capture ring had no free readback for is still queued; it takes the next frame of the same camera
+    const bool bImageFrame = frame >= job.warmupFrames && imageFrame % job.framesPerImage == job.framesPerImage - 1;
+    if (bImageFrame && mEngine->get_pending_capture_requests() == 0) {
+        static const char* extensions[] = { "png", "exr", "raw" };
+        char fileName[64];
+        std::snprintf(fileName, sizeof(fileName), "image_%06u.%s", cameraIndex, extensions[(int)job.format]);
+        std::string path = (std::filesystem::path(job.outputDirectory) / fileName).string();
+
+        // runs on a capture worker; the time is stored before the count, so a complete count always comes with its time
+        std::shared_ptr<Job> writingJob = mCurrentJob;
+        mEngine->capture_frame(path, job.format, [writingJob](bool bWritten) {
+            int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+            int64_t last = writingJob->lastWrite.load();
+            while (now > last && !writingJob->lastWrite.compare_exchange_weak(last, now)) {
+            }
+            if (bWritten) {
+                writingJob->writtenImages++;
+            }
+            else {
+                writingJob->failedImages++;
+            }
+        });
+    }
+
+    mEngine->run_headless(1);
+    mStats.frames++;
+    if (bImageFrame && mEngine->get_pending_capture_requests() > 0) {
+        return;
+    }
+    job.renderedFrames++;
+
+    // the next job starts with the next frame, while this one's last images are still in flight or being written
+    if (job.renderedFrames == job.total_frames()) {
+        mWritingJobs.push_back(std::move(mCurrentJob));
+        mCurrentJob.reset();
+    }
+}
+
+void RenderServer::finish_jobs()
+{
+    std::erase_if(mWritingJobs, [this](const std::shared_ptr<Job>& job) {
+        if (job->writtenImages.load() + job->failedImages.load() < (uint32_t)job->cameras.size()) {
+            return false;
+        }
+        report(*job);
+        return true;
+    });
+}
+
+void RenderServer::report(const Job& job)
+{
+    const uint32_t writtenImages = job.writtenImages.load();
+    const uint32_t failedImages = job.failedImages.load();
+    const bool bFailed = !job.error.empty() || failedImages > 0;
+
+    // a job that never rendered ends now; one that did, with its last write
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    float queueTime = 0.f;
+    float renderTime = 0.f;
+    if (job.renderedFrames > 0) {
+        end = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(job.lastWrite.load()));
+        queueTime = seconds_between(job.arrival, job.start);
+        renderTime = seconds_between(job.start, end);
+    }
+    const float latency = seconds_between(job.arrival, end);
+    const float imagesPerSecond = renderTime > 0.f ? writtenImages / renderTime : 0.f;
+    const float framesPerSecond = renderTime > 0.f ? job.renderedFrames / renderTime : 0.f;
+
+    if (bFailed) {
+        mStats.failedJobs++;
+        std::cout << "job " << job.id << " failed: " << (job.error.empty() ? std::to_string(failedImages) + " images not written" : job.error)
+            << std::endl;
+    }
+    else {
+        mStats.completedJobs++;
+        std::cout << "job " << job.id << ": " << writtenImages << " images (" << job.renderedFrames << " frames) in " << renderTime << " s, "
+            << imagesPerSecond << " images/s, " << framesPerSecond << " fps; latency " << latency << " s (queued " << queueTime << " s)"
+            << std::endl;
+    }
+    mStats.images += writtenImages;
+
+    std::ostringstream result;
+    result << "{\"id\": \"" << escape(job.id) << "\", \"status\": \"" << (bFailed ? "failed" : "done") << "\"";
+    if (!job.error.empty()) {
+        result << ", \"error\": \"" << escape(job.error) << "\"";
+    }
+    result << ", \"output\": \"" << escape(job.outputDirectory) << "\", \"images\": " << writtenImages << ", \"failedImages\": " << failedImages
+        << ", \"frames\": " << job.renderedFrames << ", \"queueTime\": " << queueTime << ", \"renderTime\": " << renderTime
+        << ", \"latency\": " << latency << ", \"imagesPerSecond\": " << imagesPerSecond << ", \"framesPerSecond\": " << framesPerSecond << "}";
+
+#ifndef _WIN32
+    if (job.client != 0) {
+        for (const Client& client : mClients) {
+            if (client.id == job.client) {
+                std::string line = result.str() + "\n";
+#ifdef MSG_NOSIGNAL
+                const int flags = MSG_NOSIGNAL;
+#else
+                const int flags = 0;
+#endif
+                // results are short, so a client that reads them is never too far behind for the socket buffer
+                send(client.socket, line.data(), line.size(), flags);
+            }
+        }
+    }
+#endif
+
+    if (!job.claimedFile.empty()) {
+        // <name>.json.running: the result goes next to it as <name>.result.json, the job itself becomes <name>.json.done
+        std::filesystem::path jobFile = job.claimedFile.parent_path() / job.claimedFile.stem();
+        std::filesystem::path resultFile = jobFile.parent_path() / jobFile.stem();
+        resultFile += ".result.json";
+        std::ofstream file(resultFile, std::ios::trunc);
+        file << result.str() << "\n";
+
+        std::filesystem::path doneFile = jobFile;
+        doneFile += ".done";
+        std::error_code error;
+        std::filesystem::rename(job.claimedFile, doneFile, error);
+    }
+}
+
+bool RenderServer::is_idle() const
+{
+    return mQueuedJobs.empty() && !mCurrentJob && mWritingJobs.empty();
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "vk_capture.h"
+
+class JsonValue;
+class VulkanEngine;
+
+// Offline batch rendering: runs a headless engine as a render worker that takes jobs from a local Unix socket and/or a
+// watched directory and writes their images to disk.
+// Jobs render one after the other without draining the GPU in between: the next job's first frame is recorded while the
+// last frames of the one before are still in flight, and images are written by the capture workers while rendering goes
+// on. A job is done once its last image is on disk; its latency (arrival to last write, queueing included) and throughput
+// (images and frames per second from its first frame to its last write) are then printed and sent back to whoever
+// submitted it.
+//
+// A job is a JSON object:
+//   "id": "shot-12"                      optional; the file name for watched directories, "job-<client>-<n>" for the socket
+//   "scene": "assets/city.glb"           optional; loaded on first use and kept for later jobs, but only the job's own
+//                                        scene is drawn (without one, all of them are)
+//   "output": "renders/shot-12"          directory the images go to, as image_000000.png, ...
+//   "format": "png"                      png, exr or raw
+//   "warmupFrames": 8                    frames before the first image, for exposure and TAA to settle
+//   "framesPerImage": 1                  frames rendered from each camera; the image is the last of them
+//   "cameras": [ { "position": [0, 1, 5], "yaw": 0, "pitch": 0, "fov": 70 } ]   one image each, angles in degrees
+// {"command": "shutdown"} makes the server stop once every job that arrived before it is done.
+//
+// Socket clients send jobs one per line and get one result line per job back on the same connection (POSIX only).
+// In the watched directory, <name>.json is claimed by renaming it to <name>.json.running, which is renamed to
+// <name>.json.done next to a <name>.result.json once the job is done. Write jobs under another name and rename them into
+// place, so a half written file is never picked up; several servers may watch the same directory
+class RenderServer {
+public:
+	struct Settings {
+		std::string socketPath; // empty: no socket
+		std::string watchDirectory; // empty: no directory
+		// return from run once nothing is queued, rendering or waiting in the directory, rather than wait for more jobs
+		bool bExitWhenIdle = false;
+		// how long an idle server waits for the sources before polling them again
+		uint32_t pollInterval = 50; // ms
+	};
+
+	// since init
+	struct Stats {
+		uint32_t completedJobs;
+		uint32_t failedJobs;
+		uint32_t images;
+		uint64_t frames;
+	};
+
+	// the engine must be initialized headless; false if a source could not be opened
+	bool init(VulkanEngine* engine, const Settings& settings);
+	// serves jobs until shut down (or idle, with bExitWhenIdle)
+	void run();
+	// closes the sources; jobs still queued are dropped without a result
+	void destroy();
+
+	Stats get_stats() const { return mStats; }
+
+private:
+	struct JobCamera {
+		glm::vec3 position;
+		float yaw; // radians
+		float pitch;
+		float verticalFov;
+	};
+
+	struct Job {
+		std::string id;
+		std::string scene;
+		std::string outputDirectory;
+		CaptureFormat format = CaptureFormat::Png;
+		uint32_t warmupFrames = 0;
+		uint32_t framesPerImage = 1;
+		std::vector<JobCamera> cameras;
+		// set when the job was rejected or could not start; it is then reported without rendering
+		std::string error;
+
+		// where the result goes: a socket client (0: none), or the claimed file in the watched directory
+		uint32_t client = 0;
+		std::filesystem::path claimedFile;
+
+		uint32_t renderedFrames = 0;
+		std::chrono::steady_clock::time_point arrival;
+		std::chrono::steady_clock::time_point start;
+		// written by the capture workers
+		std::atomic<uint32_t> writtenImages{ 0 };
+		std::atomic<uint32_t> failedImages{ 0 };
+		std::atomic<int64_t> lastWrite{ 0 }; // steady clock ticks
+
+		uint32_t total_frames() const { return warmupFrames + (uint32_t)cameras.size() * framesPerImage; }
+	};
+
+	struct Client {
+		int socket;
+		// unlike the socket, never reused by a later client
+		uint32_t id;
+		// received bytes not yet ending in a newline
+		std::string pending;
+		uint32_t jobCount;
+	};
+
+	// nodes of a loaded scene, see VulkanEngine::set_visible_scene_nodes
+	struct SceneNodes {
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// waits up to timeout (ms) for connections and jobs
+	void poll_socket(uint32_t timeout);
+	// at most once per poll interval, unless forced
+	void poll_directory(bool bForce);
+	// queues the job (or the shutdown) text describes
+	void accept_job(const std::string& text, const std::string& defaultId, uint32_t client, const std::filesystem::path& claimedFile);
+	bool parse_job(const JsonValue& json, Job& job);
+
+	// loads the scene, shows it and resets the temporal history; false (with the job's error set) if it cannot start
+	bool begin_job(Job& job);
+	void render_frame();
+	// reports and drops jobs whose images are all written (or failed)
+	void finish_jobs();
+	void report(const Job& job);
+	bool is_idle() const;
+
+	VulkanEngine* mEngine;
+	Settings mSettings;
+	Stats mStats{};
+
+	int mListenSocket = -1;
+	std::vector<Client> mClients;
+	uint32_t mNextClientId = 0;
+	std::chrono::steady_clock::time_point mLastDirectoryPoll;
+
+	std::deque<std::shared_ptr<Job>> mQueuedJobs;
+	// the job frames are recorded for, and jobs whose frames are all recorded but whose images are not all written yet
+	std::shared_ptr<Job> mCurrentJob;
+	std::vector<std::shared_ptr<Job>> mWritingJobs;
+	std::map<std::string, SceneNodes> mLoadedScenes;
+	bool mShutdownRequested = false;
+};
\ No newline at end of file
@@ -0,0 +1,241 @@
+// Scene BVH benchmark.
+//
+// Scatters boxes of assorted sizes through a cube (scaled with the object count, so density stays the same) and for each
+// object count measures:
+// - a full build, and a refit after moving a tenth of the objects a little
+// - frustum queries through a camera placed at random, with the AVX2 path, the scalar path and a brute force loop
+// - nearest hit ray casts the same three ways
+// Results of the three ways are compared, and any difference fails the run (exit code 1). The AVX2 path only exists in
+// builds configured with SUNABA_AVX2; otherwise its columns repeat the scalar ones.
+//
+// usage: SunabaBvhBenchmark [--counts 10000,100000,1000000] [--queries 200] [--seed 1]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bvh.h"
+
+namespace {
+	struct Options {
+		std::vector<uint32_t> objectCounts = { 10000, 100000, 1000000 };
+		uint32_t queryCount = 200;
+		uint32_t seed = 1;
+	};
+
+	struct Query {
+		glm::vec4 planes[6];
+		glm::vec3 origin;
+		glm::vec3 direction;
+	};
+
+	using Clock = std::chrono::high_resolution_clock;
+
+	double milliseconds_since(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		for (int i = 1; i < argc; i++) {
+			std::string argument = argv[i];
+			bool bHasValue = i + 1 < argc;
+			if (bHasValue && argument == "--counts") {
+				options.objectCounts.clear();
+				std::stringstream list(argv[++i]);
+				std::string count;
+				while (std::getline(list, count, ',')) {
+					options.objectCounts.push_back(std::max(1u, (uint32_t)std::strtoul(count.c_str(), nullptr, 10)));
+				}
+			}
+			else if (bHasValue && argument == "--queries") {
+				options.queryCount = std::max(1u, (uint32_t)std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if (bHasValue && argument == "--seed") {
+				options.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else {
+				std::cout << "usage: SunabaBvhBenchmark [--counts 10000,100000,1000000] [--queries 200] [--seed 1]" << std::endl;
+				return false;
+			}
+		}
+		return !options.objectCounts.empty();
+	}
+
+	bool overlaps(const Aabb& bounds, const glm::vec4 planes[6])
+	{
+		for (int plane = 0; plane < 6; plane++) {
+			glm::vec3 positive(planes[plane].x > 0.f ? bounds.max.x : bounds.min.x, planes[plane].y > 0.f ? bounds.max.y : bounds.min.y,
+				planes[plane].z > 0.f ? bounds.max.z : bounds.min.z);
+			if (glm::dot(glm::vec3(planes[plane]), positive) + planes[plane].w < 0.f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// entry distance, or a negative value for a miss
+	float intersect(const Aabb& bounds, const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+	{
+		glm::vec3 inverseDirection = 1.f / direction;
+		glm::vec3 near = (bounds.min - origin) * inverseDirection;
+		glm::vec3 far = (bounds.max - origin) * inverseDirection;
+		glm::vec3 entries = glm::min(near, far);
+		glm::vec3 exits = glm::max(near, far);
+		float entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.f));
+		float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+		return entry <= exit ? entry : -1.f;
+	}
+
+	// returns false if any way of answering the queries disagrees with the others
+	bool run(uint32_t objectCount, const Options& options)
+	{
+		std::mt19937 random(options.seed);
+		// about one object per 8 cubic units, whatever the count
+		float halfSize = 0.5f * std::cbrt(8.f * objectCount);
+		std::uniform_real_distribution<float> position(-halfSize, halfSize);
+		std::uniform_real_distribution<float> size(0.2f, 3.f);
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+		std::vector<Aabb> bounds(objectCount);
+		for (Aabb& box : bounds) {
+			glm::vec3 center(position(random), position(random), position(random));
+			glm::vec3 halfExtent = 0.5f * glm::vec3(size(random), size(random), size(random));
+			box = { center - halfExtent, center + halfExtent };
+		}
+
+		std::vector<Query> queries(options.queryCount);
+		float viewDistance = std::min(halfSize, 200.f);
+		for (Query& query : queries) {
+			query.origin = glm::vec3(position(random), position(random), position(random));
+			do {
+				query.direction = glm::vec3(unit(random), unit(random), unit(random));
+			} while (glm::length(query.direction) < 0.1f);
+			query.direction = glm::normalize(query.direction);
+			glm::mat4 view = glm::lookAt(query.origin, query.origin + query.direction, glm::vec3(0.f, 1.f, 0.f));
+			glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(70.f), 16.f / 9.f, 0.1f, viewDistance);
+			extract_frustum_planes(projection * view, query.planes);
+		}
+
+		DynamicBvh bvh;
+		auto start = Clock::now();
+		std::vector<uint32_t> handles(objectCount);
+		for (uint32_t object = 0; object < objectCount; object++) {
+			handles[object] = bvh.insert(bounds[object], object);
+		}
+		bvh.rebuild();
+		double buildTime = milliseconds_since(start);
+
+		std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+		for (uint32_t object = 0; object < objectCount; object += 10) {
+			glm::vec3 move(offset(random), offset(random), offset(random));
+			bounds[object] = { bounds[object].min + move, bounds[object].max + move };
+		}
+		start = Clock::now();
+		for (uint32_t object = 0; object < objectCount; object += 10) {
+			bvh.update(handles[object], bounds[object]);
+		}
+		bvh.maintain();
+		double refitTime = milliseconds_since(start);
+
+		DynamicBvh::Stats stats = bvh.get_stats();
+		std::cout << objectCount << " objects: " << stats.nodeCount << " nodes, build " << buildTime << " ms, refit of "
+			<< (objectCount + 9) / 10 << " moved " << refitTime << " ms (" << stats.rebuildCount - 1 << " rebuilds, area ratio "
+			<< stats.areaRatio << ")" << std::endl;
+
+		// every way runs through all queries before the next starts, so none pays for the cache misses of another
+		double frustumTimes[3] = {};
+		double rayTimes[3] = {};
+		uint64_t visibleCounts[3] = {};
+		std::vector<std::vector<uint32_t>> visible[3];
+		std::vector<DynamicBvh::RayHit> hits[3];
+		for (int method = 0; method < 3; method++) {
+			bvh.mUseSimd = method == 0;
+			visible[method].resize(queries.size());
+			for (size_t query = 0; query < queries.size(); query++) {
+				std::vector<uint32_t>& result = visible[method][query];
+				start = Clock::now();
+				if (method < 2) {
+					bvh.query_frustum(queries[query].planes, result);
+				}
+				else {
+					for (uint32_t object = 0; object < objectCount; object++) {
+						if (overlaps(bounds[object], queries[query].planes)) {
+							result.push_back(object);
+						}
+					}
+				}
+				frustumTimes[method] += milliseconds_since(start);
+				visibleCounts[method] += result.size();
+				std::sort(result.begin(), result.end());
+			}
+
+			hits[method].resize(queries.size());
+			for (size_t query = 0; query < queries.size(); query++) {
+				DynamicBvh::RayHit& hit = hits[method][query];
+				start = Clock::now();
+				if (method < 2) {
+					if (!bvh.raycast(queries[query].origin, queries[query].direction, viewDistance, hit)) {
+						hit.object = DynamicBvh::INVALID_OBJECT;
+					}
+				}
+				else {
+					hit = { DynamicBvh::INVALID_OBJECT, viewDistance };
+					for (uint32_t object = 0; object < objectCount; object++) {
+						float distance = intersect(bounds[object], queries[query].origin, queries[query].direction, hit.distance);
+						if (distance >= 0.f && (hit.object == DynamicBvh::INVALID_OBJECT || distance < hit.distance)) {
+							hit = { object, distance };
+						}
+					}
+				}
+				rayTimes[method] += milliseconds_since(start);
+			}
+		}
+
+		bool bConsistent = true;
+		for (size_t query = 0; query < queries.size(); query++) {
+			const DynamicBvh::RayHit& expected = hits[2][query];
+			for (int method = 0; method < 2; method++) {
+				// equally near boxes may be reported in either order, so only distances are compared
+				const DynamicBvh::RayHit& hit = hits[method][query];
+				bConsistent = bConsistent && visible[method][query] == visible[2][query]
+					&& (hit.object == DynamicBvh::INVALID_OBJECT) == (expected.object == DynamicBvh::INVALID_OBJECT)
+					&& (expected.object == DynamicBvh::INVALID_OBJECT || std::abs(hit.distance - expected.distance) <= 1e-4f * viewDistance);
+			}
+		}
+
+		const char* methods[3] = { DynamicBvh::is_simd_available() ? "avx2" : "scalar*", "scalar", "brute force" };
+		std::cout << std::fixed << std::setprecision(4);
+		for (int method = 0; method < 3; method++) {
+			std::cout << "  " << std::setw(12) << methods[method] << ": frustum " << frustumTimes[method] / queries.size() << " ms ("
+				<< visibleCounts[method] / queries.size() << " visible), raycast " << rayTimes[method] / queries.size() << " ms" << std::endl;
+		}
+		std::cout << std::defaultfloat;
+		if (!bConsistent) {
+			std::cout << "  MISMATCH between the BVH and brute force results" << std::endl;
+		}
+		return bConsistent;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parse_options(argc, argv, options)) {
+		return 2;
+	}
+
+	bool bPassed = true;
+	for (uint32_t objectCount : options.objectCounts) {
+		bPassed = run(objectCount, options) && bPassed;
+	}
+	return bPassed ? 0 : 1;
+}
\ No newline at end of file
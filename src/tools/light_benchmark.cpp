@@ -0,0 +1,237 @@
+// Clustered lighting benchmark.
+//
+// For each light count, scatters point lights through a box in front of a fixed camera and:
+// - bins them on the CPU on one thread and over the job system, and checks both against testing every light against
+//   every froxel; any difference fails the run (exit code 1)
+// - with --gpu, renders the same lights headless (with a scene from --scene, if given, so there are pixels to shade) with
+//   GPU and with CPU binning, and reports the frame time and the GPU time of binning and of the scene pass
+//
+// usage: SunabaLightBenchmark [--counts 0,256,1024,4096,16384] [--frames 100] [--radius 2] [--seed 1] [--gpu] [--scene path]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "job_system.h"
+#include "vk_clustered_lighting.h"
+#include "vk_engine.h"
+
+namespace {
+	struct Options {
+		std::vector<uint32_t> lightCounts = { 0, 256, 1024, 4096, 16384 };
+		uint32_t frameCount = 100;
+		float radius = 2.f;
+		uint32_t seed = 1;
+		bool bGpu = false;
+		std::string scenePath;
+	};
+
+	using Clock = std::chrono::high_resolution_clock;
+
+	// where the lights are scattered; the camera sits at the origin looking down -Z into it
+	const glm::vec3 LIGHTS_MIN(-40.f, -10.f, -80.f);
+	const glm::vec3 LIGHTS_MAX(40.f, 20.f, -1.f);
+
+	double milliseconds_since(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		for (int i = 1; i < argc; i++) {
+			std::string argument = argv[i];
+			bool bHasValue = i + 1 < argc;
+			if (bHasValue && argument == "--counts") {
+				options.lightCounts.clear();
+				std::stringstream list(argv[++i]);
+				std::string count;
+				while (std::getline(list, count, ',')) {
+					options.lightCounts.push_back((uint32_t)std::strtoul(count.c_str(), nullptr, 10));
+				}
+			}
+			else if (bHasValue && argument == "--frames") {
+				options.frameCount = std::max(1u, (uint32_t)std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if (bHasValue && argument == "--radius") {
+				options.radius = std::max(0.01f, std::strtof(argv[++i], nullptr));
+			}
+			else if (bHasValue && argument == "--seed") {
+				options.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (bHasValue && argument == "--scene") {
+				options.scenePath = argv[++i];
+			}
+			else if (argument == "--gpu") {
+				options.bGpu = true;
+			}
+			else {
+				std::cout << "usage: SunabaLightBenchmark [--counts 0,256,1024,4096,16384] [--frames 100] [--radius 2] [--seed 1] [--gpu] "
+					"[--scene path]" << std::endl;
+				return false;
+			}
+		}
+		return !options.lightCounts.empty();
+	}
+
+	// the engine camera's defaults, at the origin
+	ClusteredLighting::ViewParameters get_view()
+	{
+		glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(70.f), 16.f / 9.f, 0.1f, 1000.f);
+		projection[1][1] *= -1.f;
+
+		ClusteredLighting::ViewParameters view;
+		view.view = glm::mat4(1.f);
+		view.projectionScale = glm::vec2(projection[0][0], projection[1][1]);
+		view.nearPlane = 0.1f;
+		view.farPlane = 1000.f;
+		return view;
+	}
+
+	// every light against every froxel, with the froxel bounds from the binning itself run on a single light
+	bool matches_brute_force(const ClusteredLighting::ViewParameters& view, const std::vector<PointLight>& lights,
+		const std::vector<uint32_t>& counts, const std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> expectedCounts(ClusteredLighting::CLUSTER_COUNT, 0);
+		std::vector<uint32_t> singleCounts(ClusteredLighting::CLUSTER_COUNT);
+		std::vector<uint32_t> singleIndices(ClusteredLighting::CLUSTER_COUNT * ClusteredLighting::MAX_LIGHTS_PER_CLUSTER);
+		for (uint32_t light = 0; light < lights.size(); light++) {
+			ClusteredLighting::bin_lights(view, std::span<const PointLight>(&lights[light], 1), nullptr, singleCounts.data(), singleIndices.data());
+			for (uint32_t cluster = 0; cluster < ClusteredLighting::CLUSTER_COUNT; cluster++) {
+				if (singleCounts[cluster] == 0) {
+					continue;
+				}
+				uint32_t& expected = expectedCounts[cluster];
+				if (expected < ClusteredLighting::MAX_LIGHTS_PER_CLUSTER) {
+					if (expected >= counts[cluster] || indices[cluster * ClusteredLighting::MAX_LIGHTS_PER_CLUSTER + expected] != light) {
+						return false;
+					}
+				}
+				expected++;
+			}
+		}
+		for (uint32_t cluster = 0; cluster < ClusteredLighting::CLUSTER_COUNT; cluster++) {
+			if (std::min(expectedCounts[cluster], ClusteredLighting::MAX_LIGHTS_PER_CLUSTER) != counts[cluster]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool run_cpu(const Options& options, JobSystem& jobSystem)
+	{
+		ClusteredLighting::ViewParameters view = get_view();
+		std::vector<uint32_t> counts(ClusteredLighting::CLUSTER_COUNT);
+		std::vector<uint32_t> indices(ClusteredLighting::CLUSTER_COUNT * ClusteredLighting::MAX_LIGHTS_PER_CLUSTER);
+		std::vector<uint32_t> parallelCounts(counts.size());
+		std::vector<uint32_t> parallelIndices(indices.size());
+
+		bool bPassed = true;
+		std::cout << "CPU binning (" << jobSystem.worker_count() + 1 << " threads):" << std::endl;
+		for (uint32_t lightCount : options.lightCounts) {
+			std::vector<PointLight> lights = ClusteredLighting::generate_random_lights(lightCount, LIGHTS_MIN, LIGHTS_MAX, options.radius, 4.f,
+				options.seed);
+
+			// best of a few runs, so a page fault or a descheduled worker does not count
+			double singleTime = 1e30;
+			double parallelTime = 1e30;
+			ClusteredLighting::BinningStats stats{};
+			for (int run = 0; run < 5; run++) {
+				auto start = Clock::now();
+				stats = ClusteredLighting::bin_lights(view, lights, nullptr, counts.data(), indices.data());
+				singleTime = std::min(singleTime, milliseconds_since(start));
+
+				start = Clock::now();
+				ClusteredLighting::bin_lights(view, lights, &jobSystem, parallelCounts.data(), parallelIndices.data());
+				parallelTime = std::min(parallelTime, milliseconds_since(start));
+			}
+
+			bool bMatches = counts == parallelCounts && matches_brute_force(view, lights, counts, indices);
+			for (uint32_t cluster = 0; bMatches && cluster < ClusteredLighting::CLUSTER_COUNT; cluster++) {
+				uint32_t first = cluster * ClusteredLighting::MAX_LIGHTS_PER_CLUSTER;
+				bMatches = std::equal(indices.begin() + first, indices.begin() + first + counts[cluster], parallelIndices.begin() + first);
+			}
+			bPassed = bPassed && bMatches;
+
+			std::cout << "  " << lightCount << " lights: single thread " << singleTime << " ms, job system " << parallelTime << " ms, "
+				<< stats.lightReferences << " references, fullest froxel " << stats.maxLightsPerCluster << " (" << stats.droppedReferences
+				<< " dropped)" << (bMatches ? "" : " MISMATCH") << std::endl;
+		}
+		return bPassed;
+	}
+
+	double get_scope_time(const GpuProfiler& profiler, const char* name)
+	{
+		for (const GpuProfiler::ScopeResult& scope : profiler.get_results()) {
+			if (scope.name == name) {
+				return scope.end - scope.begin;
+			}
+		}
+		return 0.0;
+	}
+
+	void run_gpu(const Options& options)
+	{
+		VulkanEngine engine;
+		engine.init(true);
+		engine.set_fixed_delta_time(1.f / 60.f);
+		if (!options.scenePath.empty()) {
+			engine.load_scene(options.scenePath);
+			engine.wait_for_assets();
+		}
+		engine.get_camera().mPosition = glm::vec3(0.f);
+		engine.get_camera().mYaw = 0.f;
+		engine.get_camera().mPitch = 0.f;
+
+		std::cout << "Rendering (" << options.frameCount << " frames each, averages in ms):" << std::endl;
+		for (uint32_t lightCount : options.lightCounts) {
+			engine.get_lights() = ClusteredLighting::generate_random_lights(lightCount, LIGHTS_MIN, LIGHTS_MAX, options.radius, 4.f, options.seed);
+
+			for (ClusteredLighting::BinningMode mode : { ClusteredLighting::BinningMode::Gpu, ClusteredLighting::BinningMode::Cpu }) {
+				engine.get_lighting_settings().binning = mode;
+				engine.run_headless(1);
+				engine.wait_for_pipelines();
+				engine.run_headless(engine.get_config().framesInFlight * 2);
+
+				double frameTime = 0.0;
+				double binningTime = 0.0;
+				double sceneTime = 0.0;
+				for (uint32_t frame = 0; frame < options.frameCount; frame++) {
+					engine.run_headless(1);
+					frameTime += engine.engineStatistics.frametime;
+					sceneTime += get_scope_time(engine.get_gpu_profiler(), "Scene");
+					binningTime += mode == ClusteredLighting::BinningMode::Gpu ? get_scope_time(engine.get_gpu_profiler(), "Light binning")
+						: engine.get_lighting_statistics().cpuBinningTime;
+				}
+				std::cout << "  " << lightCount << " lights, " << (mode == ClusteredLighting::BinningMode::Gpu ? "GPU" : "CPU")
+					<< " binning: frame " << frameTime / options.frameCount << ", binning " << binningTime / options.frameCount
+					<< ", GPU scene pass " << sceneTime / options.frameCount << std::endl;
+			}
+		}
+
+		engine.cleanup();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parse_options(argc, argv, options)) {
+		return 2;
+	}
+
+	JobSystem jobSystem;
+	jobSystem.init();
+	bool bPassed = run_cpu(options, jobSystem);
+	jobSystem.shutdown();
+
+	if (options.bGpu) {
+		run_gpu(options);
+	}
+	return bPassed ? 0 : 1;
+}
\ No newline at end of file
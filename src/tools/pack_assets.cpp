@@ -0,0 +1,97 @@
+// Asset archive packer.
+//
+// Packs files into a .pak the engine maps at startup (see AssetArchive). Each input is <prefix>:<path>; a directory is
+// added recursively with entry names <prefix>/<path relative to the directory>, a single file as <prefix>/<file name>.
+// --lz4 and --store select the compression of the inputs that follow them (default: --store)
+//
+// usage: SunabaPack <output.pak> [--align 64] [--lz4 | --store] <prefix>:<directory or file> ...
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "asset_archive.h"
+
+static bool add_file(AssetArchiveWriter& writer, const std::filesystem::path& path, const std::string& name, AssetArchive::Compression compression)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		std::cout << "could not read " << path.string() << std::endl;
+		return false;
+	}
+	std::vector<uint8_t> bytes((size_t)file.tellg());
+	file.seekg(0);
+	file.read((char*)bytes.data(), bytes.size());
+	writer.add(name, std::move(bytes), compression);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::cout << "usage: SunabaPack <output.pak> [--align 64] [--lz4 | --store] <prefix>:<directory or file> ..." << std::endl;
+		return 2;
+	}
+
+	AssetArchiveWriter writer;
+	AssetArchive::Compression compression = AssetArchive::Compression::None;
+	uint32_t alignment = 64;
+	for (int i = 2; i < argc; i++) {
+		if (std::strcmp(argv[i], "--align") == 0 && i + 1 < argc) {
+			alignment = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			if (alignment < 4 || (alignment & (alignment - 1)) != 0) {
+				std::cout << "alignment must be a power of two of at least 4" << std::endl;
+				return 2;
+			}
+			continue;
+		}
+		if (std::strcmp(argv[i], "--lz4") == 0) {
+			compression = AssetArchive::Compression::Lz4;
+			continue;
+		}
+		if (std::strcmp(argv[i], "--store") == 0) {
+			compression = AssetArchive::Compression::None;
+			continue;
+		}
+
+		std::string input = argv[i];
+		size_t separator = input.find(':');
+		// a single character before the colon is a drive letter, not a prefix
+		if (separator == std::string::npos || separator < 2) {
+			std::cout << "expected <prefix>:<path>, got " << input << std::endl;
+			return 2;
+		}
+		std::string prefix = input.substr(0, separator);
+		std::filesystem::path root = input.substr(separator + 1);
+
+		std::error_code error;
+		if (std::filesystem::is_directory(root, error)) {
+			for (const auto& file : std::filesystem::recursive_directory_iterator(root, error)) {
+				if (file.is_regular_file() && !add_file(writer, file.path(), prefix + "/" + file.path().lexically_relative(root).generic_string(), compression)) {
+					return 1;
+				}
+			}
+		}
+		else if (!add_file(writer, root, prefix + "/" + root.filename().generic_string(), compression)) {
+			return 1;
+		}
+		if (error) {
+			std::cout << "could not list " << root.string() << ": " << error.message() << std::endl;
+			return 1;
+		}
+	}
+
+	if (!writer.write(argv[1], alignment)) {
+		std::cout << "could not write " << argv[1] << std::endl;
+		return 1;
+	}
+
+	AssetArchiveWriter::Stats stats = writer.get_stats();
+	std::cout << "packed " << stats.entryCount << " entries into " << argv[1] << ": " << stats.size / 1024 << " KB -> "
+		<< stats.storedSize / 1024 << " KB stored" << std::endl;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,519 @@
+// Golden-image and performance regression runner.
+//
+// Boots VulkanEngine headless (on lavapipe unless told otherwise), renders a fixed list of scripted scenes and for each:
+// - compares one captured frame against <golden dir>/<scene>.png with a per-channel tolerance
+// - records frame time percentiles, CPU heap allocations per frame, GPU allocations and descriptor pool growth
+// Everything is written to a JSON file. Against the baseline (the JSON of a blessed run), slower frames or higher memory
+// use beyond the allowed margins fail the run, as does any image mismatch (exit code 1). A missing golden image, a missing
+// baseline or a scene the baseline does not know are failures too, so a run can only pass once there is something to
+// compare against.
+//
+// usage: SunabaRegression [--output results.json] [--baseline baseline.json] [--golden-dir dir] [--capture-dir dir] [--bless]
+//                         [--warmup-frames 60] [--frames 200] [--tolerance 2] [--max-mismatch 0.001]
+//                         [--max-slowdown 0.10] [--max-memory-growth 0.05] [--icd lvp_icd.json | --any-device]
+//
+// --bless accepts this run as the reference: every scene's captured frame replaces its golden image and the results are
+// written to the baseline as well, without comparing against either. Golden images are the engine's own captures (see
+// imageio::read_png) and depend on the warmup frame count, since auto-exposure adapts over the warmup; bless again
+// whenever rendering or performance changes on purpose, on the machine the checks run on
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "image_io.h"
+#include "json.h"
+#include "vk_engine.h"
+
+#ifndef SUNABA_GOLDEN_DIR
+#define SUNABA_GOLDEN_DIR "tests/golden/"
+#endif
+#ifndef SUNABA_BASELINE_PATH
+#define SUNABA_BASELINE_PATH "tests/baseline.json"
+#endif
+
+// every heap allocation of the process (all threads) is counted, so per-frame allocation churn shows up in the results
+static std::atomic<uint64_t> gHeapAllocations{ 0 };
+
+void* operator new(size_t size)
+{
+	gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size ? size : 1)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+
+namespace {
+	struct Options {
+		std::string outputPath = "regression_results.json";
+		std::string baselinePath = SUNABA_BASELINE_PATH;
+		std::string goldenDirectory = SUNABA_GOLDEN_DIR;
+		std::string captureDirectory = "regression_captures";
+		std::string icdPath;
+		bool bAnyDevice = false;
+		bool bBless = false;
+		uint32_t warmupFrames = 60;
+		uint32_t measuredFrames = 200;
+		int tolerance = 2; // per channel, in 8 bit steps
+		double maxMismatch = 0.001; // fraction of pixels allowed outside the tolerance
+		double maxSlowdown = 0.10;
+		double maxMemoryGrowth = 0.05;
+	};
+
+	// a scene is a script of engine settings; the frames themselves are rendered by the engine as usual
+	struct Scene {
+		const char* name;
+		std::function<void(BackgroundSettings&, PostProcessSettings&)> setup;
+	};
+
+	struct SceneResult {
+		std::string name;
+		double meanFrameTime, p50FrameTime, p90FrameTime, p99FrameTime, maxFrameTime;
+		double heapAllocationsPerFrame;
+		VulkanEngine::ResourceStats resourcesBefore, resourcesAfter;
+		bool bGoldenFound = false;
+		uint64_t mismatchedPixels = 0;
+		int maxDifference = 0;
+		bool bImagePassed = false;
+		bool bImageBlessed = false;
+		std::vector<std::string> regressions;
+	};
+
+	const std::vector<Scene>& get_scenes()
+	{
+		static const std::vector<Scene> scenes = {
+			{ "post_disabled", [](BackgroundSettings& background, PostProcessSettings& post) {
+				background.sun.w = 1.f;
+				post.bEnabled = false;
+			} },
+			{ "aces_bloom_auto_exposure", [](BackgroundSettings&, PostProcessSettings&) {
+				// engine defaults
+			} },
+			{ "filmic_manual_exposure", [](BackgroundSettings&, PostProcessSettings& post) {
+				post.tonemapper = PostProcessChain::Filmic;
+				post.bAutoExposure = false;
+				post.manualExposure = 0.6f;
+			} },
+			{ "reinhard_no_bloom", [](BackgroundSettings&, PostProcessSettings& post) {
+				post.tonemapper = PostProcessChain::Reinhard;
+				post.bBloom = false;
+			} },
+			{ "bright_sun_wide_bloom", [](BackgroundSettings& background, PostProcessSettings& post) {
+				background.sun = { 0.5f, 0.5f, 0.08f, 500.f };
+				post.bloomIntensity = 0.2f;
+				post.bloomMipCount = PostProcessChain::MAX_BLOOM_MIPS;
+			} },
+		};
+		return scenes;
+	}
+
+	void set_environment(const char* name, const char* value)
+	{
+#ifdef _WIN32
+		_putenv_s(name, value);
+#else
+		setenv(name, value, 1);
+#endif
+	}
+
+	// points the Vulkan loader at lavapipe only, so results do not depend on whichever GPU the machine has
+	void select_driver(const Options& options)
+	{
+		if (options.bAnyDevice || std::getenv("VK_DRIVER_FILES") || std::getenv("VK_ICD_FILENAMES")) {
+			return;
+		}
+
+		std::string icd = options.icdPath;
+		if (icd.empty()) {
+			static const char* candidates[] = {
+				"/usr/share/vulkan/icd.d/lvp_icd.x86_64.json",
+				"/usr/share/vulkan/icd.d/lvp_icd.aarch64.json",
+				"/usr/share/vulkan/icd.d/lvp_icd.json",
+				"/usr/local/share/vulkan/icd.d/lvp_icd.x86_64.json",
+				"/etc/vulkan/icd.d/lvp_icd.x86_64.json",
+			};
+			for (const char* candidate : candidates) {
+				if (std::filesystem::exists(candidate)) {
+					icd = candidate;
+					break;
+				}
+			}
+		}
+
+		if (icd.empty()) {
+			std::cout << "lavapipe ICD not found; using the default Vulkan driver (pass --icd or --any-device to silence this)" << std::endl;
+			return;
+		}
+		// VK_DRIVER_FILES is the current name, older loaders only know VK_ICD_FILENAMES
+		set_environment("VK_DRIVER_FILES", icd.c_str());
+		set_environment("VK_ICD_FILENAMES", icd.c_str());
+		std::cout << "using Vulkan driver " << icd << std::endl;
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		for (int i = 1; i < argc; i++) {
+			std::string argument = argv[i];
+			bool bHasValue = i + 1 < argc;
+			if (argument == "--bless") {
+				options.bBless = true;
+			}
+			else if (argument == "--any-device") {
+				options.bAnyDevice = true;
+			}
+			else if (bHasValue && argument == "--output") {
+				options.outputPath = argv[++i];
+			}
+			else if (bHasValue && argument == "--baseline") {
+				options.baselinePath = argv[++i];
+			}
+			else if (bHasValue && argument == "--golden-dir") {
+				options.goldenDirectory = argv[++i];
+			}
+			else if (bHasValue && argument == "--capture-dir") {
+				options.captureDirectory = argv[++i];
+			}
+			else if (bHasValue && argument == "--icd") {
+				options.icdPath = argv[++i];
+			}
+			else if (bHasValue && argument == "--warmup-frames") {
+				options.warmupFrames = std::max(1u, (uint32_t)std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if (bHasValue && argument == "--frames") {
+				options.measuredFrames = std::max(1u, (uint32_t)std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if (bHasValue && argument == "--tolerance") {
+				options.tolerance = std::atoi(argv[++i]);
+			}
+			else if (bHasValue && argument == "--max-mismatch") {
+				options.maxMismatch = std::atof(argv[++i]);
+			}
+			else if (bHasValue && argument == "--max-slowdown") {
+				options.maxSlowdown = std::atof(argv[++i]);
+			}
+			else if (bHasValue && argument == "--max-memory-growth") {
+				options.maxMemoryGrowth = std::atof(argv[++i]);
+			}
+			else {
+				std::cout << "unknown argument " << argument << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	double percentile(const std::vector<double>& sortedValues, double fraction)
+	{
+		size_t index = (size_t)std::ceil(fraction * sortedValues.size());
+		return sortedValues[std::clamp<size_t>(index, 1, sortedValues.size()) - 1];
+	}
+
+	void compare_against_golden(const Options& options, const std::string& capturePath, SceneResult& result)
+	{
+		std::string goldenPath = (std::filesystem::path(options.goldenDirectory) / (result.name + ".png")).string();
+
+		uint32_t width, height, goldenWidth, goldenHeight;
+		std::vector<uint8_t> image, golden;
+		if (!imageio::read_png(capturePath.c_str(), width, height, image)) {
+			std::cout << "  could not read the captured frame " << capturePath << std::endl;
+			return;
+		}
+
+		if (options.bBless) {
+			std::filesystem::create_directories(options.goldenDirectory);
+			std::filesystem::copy_file(capturePath, goldenPath, std::filesystem::copy_options::overwrite_existing);
+			std::cout << "  blessed " << goldenPath << std::endl;
+			result.bImagePassed = true;
+			result.bImageBlessed = true;
+			return;
+		}
+
+		result.bGoldenFound = imageio::read_png(goldenPath.c_str(), goldenWidth, goldenHeight, golden);
+		if (!result.bGoldenFound) {
+			std::cout << "  no golden image at " << goldenPath << " (run with --bless to create it)" << std::endl;
+			return;
+		}
+		if (width != goldenWidth || height != goldenHeight) {
+			std::cout << "  golden image is " << goldenWidth << "x" << goldenHeight << ", the frame is " << width << "x" << height << std::endl;
+			result.mismatchedPixels = (uint64_t)width * height;
+			return;
+		}
+
+		// mismatching pixels are marked red on a darkened copy of the golden image
+		std::vector<uint8_t> difference(image.size());
+		for (size_t pixel = 0; pixel < (size_t)width * height; pixel++) {
+			int pixelDifference = 0;
+			for (int channel = 0; channel < 4; channel++) {
+				pixelDifference = std::max(pixelDifference, std::abs(image[pixel * 4 + channel] - golden[pixel * 4 + channel]));
+			}
+			result.maxDifference = std::max(result.maxDifference, pixelDifference);
+
+			bool bMismatch = pixelDifference > options.tolerance;
+			if (bMismatch) {
+				result.mismatchedPixels++;
+			}
+			for (int channel = 0; channel < 3; channel++) {
+				difference[pixel * 4 + channel] = bMismatch ? (channel == 0 ? 255 : 0) : golden[pixel * 4 + channel] / 4;
+			}
+			difference[pixel * 4 + 3] = 255;
+		}
+
+		double mismatchFraction = (double)result.mismatchedPixels / ((double)width * height);
+		result.bImagePassed = mismatchFraction <= options.maxMismatch;
+		if (!result.bImagePassed) {
+			std::string differencePath = (std::filesystem::path(options.captureDirectory) / (result.name + "_difference.png")).string();
+			imageio::write_png(differencePath.c_str(), width, height, difference.data());
+			std::cout << "  image mismatch: " << result.mismatchedPixels << " pixels (max difference " << result.maxDifference
+				<< "), see " << differencePath << std::endl;
+		}
+	}
+
+	SceneResult run_scene(VulkanEngine& engine, const Scene& scene, const Options& options)
+	{
+		SceneResult result;
+		result.name = scene.name;
+		std::cout << scene.name << std::endl;
+
+		// every scene starts from the same settings and history, so its frames do not depend on the scenes before it
+		engine.get_background_settings() = BackgroundSettings{};
+		engine.get_post_process_settings() = PostProcessSettings{};
+		scene.setup(engine.get_background_settings(), engine.get_post_process_settings());
+		engine.reset_temporal_history();
+
+		result.resourcesBefore = engine.get_resource_statistics();
+
+		// the first frame requests the scene's pipeline permutations; nothing after it may render with a fallback
+		engine.run_headless(1);
+		engine.wait_for_pipelines();
+		engine.reset_temporal_history();
+		engine.run_headless(options.warmupFrames);
+
+		std::string sceneCaptureDirectory = (std::filesystem::path(options.captureDirectory) / scene.name).string();
+		engine.start_capture(sceneCaptureDirectory, CaptureFormat::Png, 1);
+		engine.run_headless(1);
+		engine.wait_for_captures();
+		compare_against_golden(options, (std::filesystem::path(sceneCaptureDirectory) / "frame_000000.png").string(), result);
+
+		// frame times are wall clock times of whole frames, including the wait for the frame slot's fence,
+		// so they reflect GPU throughput once the frames in flight are saturated
+		std::vector<double> frameTimes;
+		frameTimes.reserve(options.measuredFrames);
+		uint64_t heapAllocationsBefore = gHeapAllocations.load();
+		for (uint32_t frame = 0; frame < options.measuredFrames; frame++) {
+			auto start = std::chrono::steady_clock::now();
+			engine.run_headless(1);
+			frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		uint64_t heapAllocations = gHeapAllocations.load() - heapAllocationsBefore;
+		result.heapAllocationsPerFrame = (double)heapAllocations / options.measuredFrames;
+
+		result.resourcesAfter = engine.get_resource_statistics();
+
+		std::sort(frameTimes.begin(), frameTimes.end());
+		double total = 0.0;
+		for (double frameTime : frameTimes) {
+			total += frameTime;
+		}
+		result.meanFrameTime = total / frameTimes.size();
+		result.p50FrameTime = percentile(frameTimes, 0.50);
+		result.p90FrameTime = percentile(frameTimes, 0.90);
+		result.p99FrameTime = percentile(frameTimes, 0.99);
+		result.maxFrameTime = frameTimes.back();
+
+		std::printf("  frame time: mean %.3f ms, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+			result.meanFrameTime, result.p50FrameTime, result.p90FrameTime, result.p99FrameTime, result.maxFrameTime);
+		std::printf("  heap allocations per frame: %.2f, GPU: %u allocations in %u blocks (%.1f MiB), descriptor pools: %u -> %u\n",
+			result.heapAllocationsPerFrame, result.resourcesAfter.allocationCount, result.resourcesAfter.blockCount,
+			result.resourcesAfter.blockBytes / (1024.0 * 1024.0), result.resourcesBefore.descriptorPools, result.resourcesAfter.descriptorPools);
+		return result;
+	}
+
+	// compares against the same scene of a previous run; every regression is recorded with a readable reason
+	void check_baseline(const JsonValue& baselineScene, const Options& options, SceneResult& result)
+	{
+		auto check = [&](const char* metric, double value, double baselineValue, double allowedGrowth, double slack) {
+			double limit = baselineValue * (1.0 + allowedGrowth) + slack;
+			if (value > limit) {
+				std::ostringstream reason;
+				reason << metric << " " << value << " exceeds baseline " << baselineValue << " (limit " << limit << ")";
+				result.regressions.push_back(reason.str());
+			}
+		};
+
+		if (const JsonValue* frameTime = baselineScene.find("frameTimeMs")) {
+			check("p50 frame time", result.p50FrameTime, frameTime->get_number("p50"), options.maxSlowdown, 0.0);
+			check("p90 frame time", result.p90FrameTime, frameTime->get_number("p90"), options.maxSlowdown, 0.0);
+		}
+		// allocations get one allocation of slack so a baseline of 0 does not fail on rounding
+		check("heap allocations per frame", result.heapAllocationsPerFrame, baselineScene.get_number("heapAllocationsPerFrame"), options.maxMemoryGrowth, 1.0);
+		if (const JsonValue* gpu = baselineScene.find("gpu")) {
+			check("GPU allocation bytes", (double)result.resourcesAfter.allocationBytes, gpu->get_number("allocationBytes"), options.maxMemoryGrowth, 0.0);
+			check("GPU block bytes", (double)result.resourcesAfter.blockBytes, gpu->get_number("blockBytes"), options.maxMemoryGrowth, 0.0);
+			check("GPU allocation count", (double)result.resourcesAfter.allocationCount, gpu->get_number("allocationCount"), options.maxMemoryGrowth, 0.0);
+		}
+		if (const JsonValue* descriptors = baselineScene.find("descriptorPools")) {
+			check("descriptor pool growth", (double)result.resourcesAfter.descriptorPools - result.resourcesBefore.descriptorPools,
+				descriptors->get_number("growth"), 0.0, 0.0);
+		}
+
+		for (const std::string& regression : result.regressions) {
+			std::cout << "  regression: " << regression << std::endl;
+		}
+	}
+
+	std::string escape(const std::string& text)
+	{
+		std::string escaped;
+		for (char character : text) {
+			if (character == '"' || character == '\\') {
+				escaped.push_back('\\');
+			}
+			escaped.push_back(character);
+		}
+		return escaped;
+	}
+
+	bool write_results(const std::string& path, const std::vector<SceneResult>& results, bool bPassed)
+	{
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		file << "{\n  \"passed\": " << (bPassed ? "true" : "false") << ",\n  \"scenes\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const SceneResult& result = results[i];
+			file << "    {\n";
+			file << "      \"name\": \"" << escape(result.name) << "\",\n";
+			file << "      \"frameTimeMs\": { \"mean\": " << result.meanFrameTime << ", \"p50\": " << result.p50FrameTime
+				<< ", \"p90\": " << result.p90FrameTime << ", \"p99\": " << result.p99FrameTime << ", \"max\": " << result.maxFrameTime << " },\n";
+			file << "      \"heapAllocationsPerFrame\": " << result.heapAllocationsPerFrame << ",\n";
+			file << "      \"gpu\": { \"allocationCount\": " << result.resourcesAfter.allocationCount
+				<< ", \"allocationBytes\": " << result.resourcesAfter.allocationBytes
+				<< ", \"blockCount\": " << result.resourcesAfter.blockCount
+				<< ", \"blockBytes\": " << result.resourcesAfter.blockBytes << " },\n";
+			file << "      \"descriptorPools\": { \"before\": " << result.resourcesBefore.descriptorPools
+				<< ", \"after\": " << result.resourcesAfter.descriptorPools
+				<< ", \"growth\": " << (int64_t)result.resourcesAfter.descriptorPools - (int64_t)result.resourcesBefore.descriptorPools << " },\n";
+			file << "      \"image\": { \"goldenFound\": " << (result.bGoldenFound ? "true" : "false")
+				<< ", \"mismatchedPixels\": " << result.mismatchedPixels
+				<< ", \"maxDifference\": " << result.maxDifference
+				<< ", \"passed\": " << (result.bImagePassed ? "true" : "false")
+				<< ", \"blessed\": " << (result.bImageBlessed ? "true" : "false") << " },\n";
+			file << "      \"regressions\": [";
+			for (size_t r = 0; r < result.regressions.size(); r++) {
+				file << (r > 0 ? ", " : "") << "\"" << escape(result.regressions[r]) << "\"";
+			}
+			file << "]\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n}\n";
+		return file.good();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parse_options(argc, argv, options)) {
+		return 2;
+	}
+
+	// a baseline that does not exist yet fails the run below (unless this run blesses one), an unreadable one is an error
+	JsonValue baseline;
+	bool bBaselineFound = !options.bBless && std::filesystem::exists(options.baselinePath);
+	if (bBaselineFound) {
+		std::ifstream baselineFile(options.baselinePath);
+		std::stringstream baselineText;
+		baselineText << baselineFile.rdbuf();
+		if (!baselineFile.is_open() || !JsonValue::parse(baselineText.str(), baseline) || baseline.type != JsonValue::Type::Object) {
+			std::cout << "could not read baseline " << options.baselinePath << std::endl;
+			return 2;
+		}
+	}
+
+	select_driver(options);
+
+	VulkanEngine engine;
+	engine.init(true);
+	// reproducible frames: auto-exposure adapts as if the engine ran at a steady 60 fps
+	engine.set_fixed_delta_time(1.f / 60.f);
+
+	std::vector<SceneResult> results;
+	for (const Scene& scene : get_scenes()) {
+		results.push_back(run_scene(engine, scene, options));
+	}
+
+	engine.cleanup();
+
+	bool bPassed = true;
+	for (SceneResult& result : results) {
+		if (!options.bBless) {
+			const JsonValue* baselineScene = nullptr;
+			if (const JsonValue* baselineScenes = baseline.find("scenes")) {
+				for (const JsonValue& candidate : baselineScenes->array) {
+					const JsonValue* name = candidate.find("name");
+					if (name && name->string == result.name) {
+						baselineScene = &candidate;
+					}
+				}
+			}
+
+			std::cout << result.name << " against baseline" << std::endl;
+			if (baselineScene) {
+				check_baseline(*baselineScene, options, result);
+			}
+			else {
+				result.regressions.push_back(bBaselineFound ? "not in the baseline" : "no baseline");
+				std::cout << "  regression: " << result.regressions.back() << std::endl;
+			}
+		}
+		bPassed = bPassed && result.bImagePassed && result.regressions.empty();
+	}
+
+	if (!write_results(options.outputPath, results, bPassed)) {
+		std::cout << "could not write " << options.outputPath << std::endl;
+		return 2;
+	}
+	if (options.bBless) {
+		std::filesystem::path baselinePath(options.baselinePath);
+		if (baselinePath.has_parent_path()) {
+			std::filesystem::create_directories(baselinePath.parent_path());
+		}
+		if (!write_results(options.baselinePath, results, bPassed)) {
+			std::cout << "could not write " << options.baselinePath << std::endl;
+			return 2;
+		}
+	}
+
+	std::cout << (bPassed ? "PASSED" : "FAILED") << " (results in " << options.outputPath;
+	if (options.bBless) {
+		std::cout << ", blessed as " << options.baselinePath << " and the goldens in " << options.goldenDirectory;
+	}
+	else if (!bBaselineFound) {
+		std::cout << ", no baseline at " << options.baselinePath << ": run with --bless to create it";
+	}
+	std::cout << ")" << std::endl;
+	return bPassed ? 0 : 1;
+}
\ No newline at end of file
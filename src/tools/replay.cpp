@@ -0,0 +1,449 @@
+// Replays a frame recording (see frame_recording.h) headless and compares what its frames cost against what they cost
+// when they were recorded.
+//
+// The engine is set up with the recording's settings (over which --config and --set still apply, e.g. to try another
+// draw format), the scenes and textures that were loaded when recording started are loaded and waited for, and after a
+// warmup on the first frame's state every recorded frame is drawn again with its camera, sun, lights, output size, render
+// scale and pass settings, dynamic resolution off. Scenes and textures loaded while recording are loaded before the frame
+// they were recorded at and waited for, unless --async-loads lets them stream in over the following frames as they did.
+// With --passes N the window is replayed N times and each frame keeps its fastest pass.
+//
+// Printed: CPU and GPU frame time (mean, median, max) recorded and replayed, the slowest frames and the mean time of every
+// GPU scope. Recorded CPU times of windowed runs include the UI and event handling, those of headless runs (Sunaba
+// --headless <frames> --record <file>) only draw like the replay; GPU times compare either way. With --max-slowdown the
+// exit code is 1 when the replayed median GPU time exceeds the recorded one by more than that fraction, so a recording
+// taken on a good build bisects a regression on the same device (git bisect run SunabaReplay ...).
+//
+// usage: SunabaReplay <recording> [--warmup-frames 30] [--passes 1] [--async-loads] [--slowest 5] [--csv frames.csv]
+//                     [--max-slowdown 0.10] [--icd lvp_icd.json] [--config file.json] [--set key=value]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "frame_recording.h"
+#include "vk_engine.h"
+
+namespace {
+	struct Options {
+		std::string recordingPath;
+		std::string csvPath;
+		std::string icdPath;
+		uint32_t warmupFrames = 30;
+		uint32_t passes = 1;
+		uint32_t slowestFrames = 5;
+		bool bAsyncLoads = false;
+		double maxSlowdown = -1.0; // negative: never fail
+	};
+
+	struct Summary {
+		double mean = 0.0;
+		double median = 0.0;
+		double max = 0.0;
+	};
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		for (int i = 1; i < argc; i++) {
+			std::string argument = argv[i];
+			bool bHasValue = i + 1 < argc;
+			if (argument == "--async-loads") {
+				options.bAsyncLoads = true;
+			}
+			else if (bHasValue && (argument == "--config" || argument == "--set")) {
+				// read by EngineConfig::load
+				i++;
+			}
+			else if (bHasValue && argument == "--warmup-frames") {
+				options.warmupFrames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (bHasValue && argument == "--passes") {
+				options.passes = std::max(1u, (uint32_t)std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if (bHasValue && argument == "--slowest") {
+				options.slowestFrames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (bHasValue && argument == "--csv") {
+				options.csvPath = argv[++i];
+			}
+			else if (bHasValue && argument == "--max-slowdown") {
+				options.maxSlowdown = std::atof(argv[++i]);
+			}
+			else if (bHasValue && argument == "--icd") {
+				options.icdPath = argv[++i];
+			}
+			else if (argument.rfind("--", 0) != 0 && options.recordingPath.empty()) {
+				options.recordingPath = argument;
+			}
+			else {
+				std::cout << "unknown argument " << argument << std::endl;
+				return false;
+			}
+		}
+		if (options.recordingPath.empty()) {
+			std::cout << "usage: SunabaReplay <recording> [--warmup-frames 30] [--passes 1] [--async-loads] [--slowest 5] [--csv frames.csv]"
+				" [--max-slowdown 0.10] [--icd lvp_icd.json] [--config file.json] [--set key=value]" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void set_environment(const char* name, const char* value)
+	{
+#ifdef _WIN32
+		_putenv_s(name, value);
+#else
+		setenv(name, value, 1);
+#endif
+	}
+
+	// the recording's settings, sized to its first frame's output, then whatever the command line overrides
+	bool build_config(const FrameRecording& recording, int argc, char* argv[], EngineConfig& config)
+	{
+		std::istringstream pairs(recording.config);
+		std::string pair;
+		while (pairs >> pair) {
+			size_t equals = pair.find('=');
+			// settings this build does not know (or no longer accepts) are reported by set and left at their defaults
+			if (equals != std::string::npos) {
+				config.set(pair.substr(0, equals), pair.substr(equals + 1));
+			}
+		}
+		if (!recording.frames.empty()) {
+			config.windowWidth = std::max(recording.frames[0].outputWidth, 1u);
+			config.windowHeight = std::max(recording.frames[0].outputHeight, 1u);
+		}
+		return config.load(argc, argv);
+	}
+
+	void apply_frame(VulkanEngine& engine, const RecordedFrame& frame)
+	{
+		Camera& camera = engine.get_camera();
+		camera.mPosition = frame.cameraPosition;
+		camera.mYaw = frame.cameraYaw;
+		camera.mPitch = frame.cameraPitch;
+		camera.mVerticalFov = frame.cameraVerticalFov;
+		camera.mNearPlane = frame.cameraNearPlane;
+		camera.mFarPlane = frame.cameraFarPlane;
+		engine.get_sun_direction() = frame.sunDirection;
+
+		BackgroundSettings& background = engine.get_background_settings();
+		background.topColor = frame.background[0];
+		background.bottomColor = frame.background[1];
+		background.sun = frame.background[2];
+		background.data = frame.background[3];
+
+		engine.get_post_process_settings() = frame.postProcess;
+		engine.get_taa_settings() = frame.temporalAA;
+		engine.get_shadow_settings() = frame.shadows;
+		engine.get_lighting_settings() = frame.lighting;
+		engine.get_cluster_settings() = frame.clusters;
+		engine.get_static_pass_settings() = frame.staticPasses;
+
+		// the recorded scale already is the one dynamic resolution picked for the frame
+		VulkanEngine::ResolutionSettings& resolution = engine.get_resolution_settings();
+		resolution.bDynamic = false;
+		resolution.renderScale = frame.renderScale;
+		// a frame recorded without a fixed time step advances by the time it took back then
+		engine.set_fixed_delta_time(frame.deltaTime > 0.f ? frame.deltaTime : 1.f / 60.f);
+	}
+
+	// GPU results the engine collected when it came back to a frame slot, i.e. of the frame drawn framesInFlight before
+	void collect_gpu_cost(const VulkanEngine& engine, RecordedFrameCost& cost)
+	{
+		const GpuProfiler& profiler = engine.get_gpu_profiler();
+		cost.graphicsBusyTime = profiler.get_queue_busy_time(GpuQueueTrack::Graphics);
+		cost.computeBusyTime = profiler.get_queue_busy_time(GpuQueueTrack::Compute);
+		cost.overlapTime = profiler.get_overlap_time();
+		cost.scopes = profiler.get_results();
+		ClusterRenderer::Stats clusterStats = engine.get_cluster_statistics();
+		cost.instanceCount = clusterStats.instanceCount;
+		cost.clusterCount = clusterStats.clusterCount;
+		cost.totalTriangles = clusterStats.totalTriangles;
+		cost.drawnTriangles = clusterStats.drawnTriangles;
+	}
+
+	// draws every recorded frame once; costs come back by position in the recording
+	std::vector<RecordedFrameCost> replay_pass(VulkanEngine& engine, const FrameRecording& recording, const Options& options, bool bIssueLoads)
+	{
+		const std::vector<RecordedFrame>& frames = recording.frames;
+		const uint32_t framesInFlight = engine.get_config().framesInFlight;
+		std::vector<RecordedFrameCost> costs(frames.size());
+
+		// every pass starts from the same history, settled on the first frame
+		apply_frame(engine, frames[0]);
+		engine.get_lights() = recording.lightSets[frames[0].lightSet];
+		engine.set_visible_scene_nodes(frames[0].visibleNodesFirst, frames[0].visibleNodesCount);
+		engine.reset_temporal_history();
+		engine.run_headless(1);
+		engine.wait_for_pipelines();
+		engine.reset_temporal_history();
+		engine.run_headless(options.warmupFrames);
+
+		uint32_t lightSet = frames[0].lightSet;
+		uint32_t visibleFirst = frames[0].visibleNodesFirst;
+		uint32_t visibleCount = frames[0].visibleNodesCount;
+		size_t nextLoad = 0;
+		// past the window, its last frame is drawn again until the results of every frame in it are back
+		for (size_t i = 0; i < frames.size() + framesInFlight; i++) {
+			const RecordedFrame& frame = frames[std::min(i, frames.size() - 1)];
+
+			bool bLoaded = false;
+			while (bIssueLoads && nextLoad < recording.loads.size() && recording.loads[nextLoad].frameIndex <= frame.frameIndex) {
+				const FrameRecording::Load& load = recording.loads[nextLoad++];
+				if (load.bResident) {
+					continue;
+				}
+				if (load.bTexture) {
+					engine.load_texture(load.path);
+				}
+				else {
+					engine.load_scene(load.path);
+				}
+				bLoaded = true;
+			}
+			if (bLoaded && !options.bAsyncLoads) {
+				engine.wait_for_assets();
+			}
+
+			apply_frame(engine, frame);
+			if (frame.lightSet != lightSet) {
+				engine.get_lights() = recording.lightSets[frame.lightSet];
+				lightSet = frame.lightSet;
+			}
+			if (frame.visibleNodesFirst != visibleFirst || frame.visibleNodesCount != visibleCount) {
+				engine.set_visible_scene_nodes(frame.visibleNodesFirst, frame.visibleNodesCount);
+				visibleFirst = frame.visibleNodesFirst;
+				visibleCount = frame.visibleNodesCount;
+			}
+
+			engine.run_headless(1);
+
+			if (i < frames.size()) {
+				costs[i].frameIndex = frame.frameIndex;
+				costs[i].cpuFrameTime = engine.engineStatistics.frametime;
+				costs[i].recordTime = engine.engineStatistics.recordTime;
+			}
+			if (i >= framesInFlight && i - framesInFlight < frames.size()) {
+				collect_gpu_cost(engine, costs[i - framesInFlight]);
+			}
+		}
+		return costs;
+	}
+
+	Summary summarize(std::vector<double> values)
+	{
+		Summary summary;
+		if (values.empty()) {
+			return summary;
+		}
+		std::sort(values.begin(), values.end());
+		for (double value : values) {
+			summary.mean += value;
+		}
+		summary.mean /= values.size();
+		summary.median = values[values.size() / 2];
+		summary.max = values.back();
+		return summary;
+	}
+
+	void print_summary(const char* label, const Summary& recorded, const Summary& replayed, bool bRecorded)
+	{
+		if (bRecorded) {
+			std::printf("  %-10s recorded mean %8.3f ms, median %8.3f, max %8.3f\n", label, recorded.mean, recorded.median, recorded.max);
+		}
+		std::printf("  %-10s replayed mean %8.3f ms, median %8.3f, max %8.3f\n", label, replayed.mean, replayed.median, replayed.max);
+	}
+
+	bool write_csv(const std::string& path, const std::vector<const RecordedFrameCost*>& recorded, const std::vector<RecordedFrameCost>& replayed)
+	{
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+		file << "frame,recordedCpuMs,recordedRecordMs,recordedGpuMs,recordedDrawnTriangles,replayedCpuMs,replayedRecordMs,replayedGpuMs,replayedDrawnTriangles\n";
+		for (size_t i = 0; i < replayed.size(); i++) {
+			file << replayed[i].frameIndex << ",";
+			if (recorded[i]) {
+				file << recorded[i]->cpuFrameTime << "," << recorded[i]->recordTime << "," << recorded[i]->get_gpu_time() << "," << recorded[i]->drawnTriangles;
+			}
+			else {
+				file << ",,,";
+			}
+			file << "," << replayed[i].cpuFrameTime << "," << replayed[i].recordTime << "," << replayed[i].get_gpu_time() << "," << replayed[i].drawnTriangles << "\n";
+		}
+		return file.good();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parse_options(argc, argv, options)) {
+		return 2;
+	}
+
+	FrameRecording recording;
+	if (!recording.load(options.recordingPath)) {
+		return 2;
+	}
+	if (recording.frames.empty()) {
+		std::cout << options.recordingPath << " holds no frames" << std::endl;
+		return 2;
+	}
+
+	EngineConfig config;
+	if (!build_config(recording, argc, argv, config)) {
+		return 2;
+	}
+	if (!options.icdPath.empty()) {
+		// VK_DRIVER_FILES is the current name, older loaders only know VK_ICD_FILENAMES
+		set_environment("VK_DRIVER_FILES", options.icdPath.c_str());
+		set_environment("VK_ICD_FILENAMES", options.icdPath.c_str());
+	}
+
+	std::cout << options.recordingPath << ": " << recording.frames.size() << " frames, " << recording.costs.size() << " with costs, "
+		<< recording.loads.size() << " loads, " << recording.lightSets.size() - 1 << " light changes" << std::endl;
+	std::cout << "recorded with: " << recording.config << std::endl;
+
+	VulkanEngine engine;
+	engine.init(true, config);
+	std::cout << "replaying with: " << engine.get_config().to_string() << std::endl;
+
+	// what was resident when recording started is resident before the first frame
+	for (const FrameRecording::Load& load : recording.loads) {
+		if (!load.bResident) {
+			continue;
+		}
+		if (load.bTexture) {
+			engine.load_texture(load.path);
+		}
+		else {
+			engine.load_scene(load.path);
+		}
+	}
+	engine.wait_for_assets();
+
+	// a frame keeps its fastest pass; loads are issued during the first, later passes find everything resident
+	std::vector<RecordedFrameCost> replayed;
+	for (uint32_t pass = 0; pass < options.passes; pass++) {
+		std::vector<RecordedFrameCost> passCosts = replay_pass(engine, recording, options, pass == 0);
+		std::vector<double> gpuTimes;
+		for (const RecordedFrameCost& cost : passCosts) {
+			gpuTimes.push_back(cost.get_gpu_time());
+		}
+		Summary passSummary = summarize(gpuTimes);
+		std::printf("pass %u: GPU mean %.3f ms, median %.3f, max %.3f\n", pass + 1, passSummary.mean, passSummary.median, passSummary.max);
+
+		if (replayed.empty()) {
+			replayed = std::move(passCosts);
+			continue;
+		}
+		for (size_t i = 0; i < replayed.size(); i++) {
+			if (passCosts[i].get_gpu_time() < replayed[i].get_gpu_time()) {
+				replayed[i] = std::move(passCosts[i]);
+			}
+		}
+	}
+
+	engine.cleanup();
+
+	// recorded costs by position in the recording; frames whose costs never came back have none
+	std::vector<const RecordedFrameCost*> recorded(recording.frames.size(), nullptr);
+	for (const RecordedFrameCost& cost : recording.costs) {
+		if (cost.frameIndex < recording.frames.size()) {
+			recorded[cost.frameIndex] = &cost;
+		}
+	}
+
+	std::vector<double> recordedCpu, recordedGpu, replayedCpu, replayedGpu;
+	for (size_t i = 0; i < replayed.size(); i++) {
+		replayedCpu.push_back(replayed[i].cpuFrameTime);
+		replayedGpu.push_back(replayed[i].get_gpu_time());
+		if (recorded[i]) {
+			recordedCpu.push_back(recorded[i]->cpuFrameTime);
+			recordedGpu.push_back(recorded[i]->get_gpu_time());
+		}
+	}
+	const bool bRecordedCosts = !recordedGpu.empty();
+	Summary recordedGpuSummary = summarize(recordedGpu);
+	Summary replayedGpuSummary = summarize(replayedGpu);
+	std::cout << "frame times" << std::endl;
+	print_summary("CPU", summarize(recordedCpu), summarize(replayedCpu), bRecordedCosts);
+	print_summary("GPU", recordedGpuSummary, replayedGpuSummary, bRecordedCosts);
+
+	std::vector<size_t> slowest(replayed.size());
+	for (size_t i = 0; i < slowest.size(); i++) {
+		slowest[i] = i;
+	}
+	std::sort(slowest.begin(), slowest.end(), [&](size_t a, size_t b) { return replayed[a].get_gpu_time() > replayed[b].get_gpu_time(); });
+	slowest.resize(std::min<size_t>(slowest.size(), options.slowestFrames));
+	if (!slowest.empty()) {
+		std::cout << "slowest frames (GPU)" << std::endl;
+	}
+	for (size_t i : slowest) {
+		std::printf("  frame %5u: replayed GPU %8.3f ms, CPU %8.3f ms, %llu triangles drawn", replayed[i].frameIndex, replayed[i].get_gpu_time(),
+			replayed[i].cpuFrameTime, (unsigned long long)replayed[i].drawnTriangles);
+		if (recorded[i]) {
+			std::printf("; recorded GPU %8.3f ms, CPU %8.3f ms, %llu triangles drawn", recorded[i]->get_gpu_time(), recorded[i]->cpuFrameTime,
+				(unsigned long long)recorded[i]->drawnTriangles);
+		}
+		std::printf("\n");
+	}
+
+	// mean time per GPU scope over the frames it ran in
+	struct ScopeTimes {
+		double recordedSum = 0.0;
+		uint32_t recordedCount = 0;
+		double replayedSum = 0.0;
+		uint32_t replayedCount = 0;
+	};
+	std::map<std::string, ScopeTimes> scopes;
+	for (size_t i = 0; i < replayed.size(); i++) {
+		for (const GpuProfiler::ScopeResult& scope : replayed[i].scopes) {
+			scopes[scope.name].replayedSum += scope.end - scope.begin;
+			scopes[scope.name].replayedCount++;
+		}
+		if (recorded[i]) {
+			for (const GpuProfiler::ScopeResult& scope : recorded[i]->scopes) {
+				scopes[scope.name].recordedSum += scope.end - scope.begin;
+				scopes[scope.name].recordedCount++;
+			}
+		}
+	}
+	if (!scopes.empty()) {
+		std::cout << "GPU scopes (mean ms)" << std::endl;
+	}
+	for (const auto& [name, times] : scopes) {
+		double recordedMean = times.recordedCount ? times.recordedSum / times.recordedCount : 0.0;
+		double replayedMean = times.replayedCount ? times.replayedSum / times.replayedCount : 0.0;
+		std::printf("  %-24s recorded %8.3f, replayed %8.3f", name.c_str(), recordedMean, replayedMean);
+		if (recordedMean > 0.0 && times.replayedCount) {
+			std::printf(" (%+.1f%%)", (replayedMean / recordedMean - 1.0) * 100.0);
+		}
+		std::printf("\n");
+	}
+
+	if (!options.csvPath.empty() && !write_csv(options.csvPath, recorded, replayed)) {
+		std::cout << "could not write " << options.csvPath << std::endl;
+		return 2;
+	}
+
+	if (options.maxSlowdown >= 0.0) {
+		if (!bRecordedCosts) {
+			std::cout << "the recording holds no costs to compare against" << std::endl;
+			return 2;
+		}
+		double limit = recordedGpuSummary.median * (1.0 + options.maxSlowdown);
+		bool bPassed = replayedGpuSummary.median <= limit;
+		std::printf("%s: replayed median GPU time %.3f ms, limit %.3f ms\n", bPassed ? "PASSED" : "FAILED", replayedGpuSummary.median, limit);
+		return bPassed ? 0 : 1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "vk_async_compute.h"
+#include "vk_utils.h"
+
+void AsyncComputeScheduler::init(VkDevice device, uint32_t graphicsQueueFamily, VkQueue computeQueue, uint32_t computeQueueFamily)
+{
+    mDevice = device;
+    mGraphicsQueueFamily = graphicsQueueFamily;
+    mComputeQueue = computeQueue;
+    mComputeQueueFamily = computeQueueFamily;
+}
+
+void AsyncComputeScheduler::schedule_pass(const char* name, std::function<void(VkCommandBuffer)>&& record)
+{
+    mPasses.push_back(ComputePass{ name, std::move(record) });
+}
+
+void AsyncComputeScheduler::share_image(const SharedImage& sharedImage)
+{
+    mSharedImages.push_back(sharedImage);
+}
+
+void AsyncComputeScheduler::record_release_to_compute(VkCommandBuffer graphicsCmd)
+{
+    for (const SharedImage& shared : mSharedImages) {
+        vkutil::transfer_image_ownership(graphicsCmd, shared.image, shared.graphicsLayout, shared.computeLayout,
+            mGraphicsQueueFamily, mComputeQueueFamily, true,
+            VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT);
+    }
+}
+
+void AsyncComputeScheduler::record_compute(VkCommandBuffer computeCmd, GpuProfiler& profiler, GpuPipelineStatistics& statistics)
+{
+    for (const SharedImage& shared : mSharedImages) {
+        vkutil::transfer_image_ownership(computeCmd, shared.image, shared.graphicsLayout, shared.computeLayout,
+            mGraphicsQueueFamily, mComputeQueueFamily, false,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    }
+
+    record_passes(computeCmd, profiler, statistics, GpuQueueTrack::Compute);
+
+    for (const SharedImage& shared : mSharedImages) {
+        vkutil::transfer_image_ownership(computeCmd, shared.image, shared.computeLayout, shared.returnLayout,
+            mComputeQueueFamily, mGraphicsQueueFamily, true,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    }
+}
+
+void AsyncComputeScheduler::record_acquire_from_compute(VkCommandBuffer graphicsCmd)
+{
+    for (const SharedImage& shared : mSharedImages) {
+        vkutil::transfer_image_ownership(graphicsCmd, shared.image, shared.computeLayout, shared.returnLayout,
+            mComputeQueueFamily, mGraphicsQueueFamily, false, shared.returnStage, shared.returnAccess);
+    }
+}
+
+void AsyncComputeScheduler::record_inline(VkCommandBuffer graphicsCmd, GpuProfiler& profiler, GpuPipelineStatistics& statistics)
+{
+    // same queue family: plain layout transitions stand in for the ownership transfers
+    for (const SharedImage& shared : mSharedImages) {
+        vkutil::transition_image(graphicsCmd, shared.image, 1, shared.graphicsLayout, shared.computeLayout);
+    }
+
+    record_passes(graphicsCmd, profiler, statistics, GpuQueueTrack::Graphics);
+
+    for (const SharedImage& shared : mSharedImages) {
+        vkutil::transition_image(graphicsCmd, shared.image, 1, shared.computeLayout, shared.returnLayout);
+    }
+}
+
+void AsyncComputeScheduler::end_frame()
+{
+    mPasses.clear();
+    mSharedImages.clear();
+}
+
+void AsyncComputeScheduler::record_passes(VkCommandBuffer cmd, GpuProfiler& profiler, GpuPipelineStatistics& statistics, GpuQueueTrack queue)
+{
+    for (ComputePass& pass : mPasses) {
+        uint32_t scope = profiler.begin_scope(cmd, pass.name.c_str(), queue);
+        uint32_t statisticsScope = statistics.begin_scope(cmd, pass.name.c_str(), queue);
+        pass.record(cmd);
+        statistics.end_scope(cmd, statisticsScope);
+        profiler.end_scope(cmd, scope);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <volk.h>
+
+#include "vk_pipeline_stats.h"
+#include "vk_profiler.h"
+
+// Schedules compute passes (post-processing, culling, depth pyramid, ...) that run after the scene has been drawn.
+// On hardware with a separate compute queue family, the passes are submitted to that queue so they can overlap with
+// graphics work, and images they touch are transferred between queue families. Without one, the same passes are
+// recorded inline into the graphics command buffer, so callers never need to care which path is taken
+class AsyncComputeScheduler {
+public:
+	// an image the graphics queue hands over to the compute passes for the current frame
+	struct SharedImage {
+		VkImage image;
+		// layout the graphics queue left the image in
+		VkImageLayout graphicsLayout;
+		// layout the compute passes expect
+		VkImageLayout computeLayout;
+		// layout the graphics queue expects once it gets the image back
+		VkImageLayout returnLayout;
+		// first graphics access after the compute passes; the compute semaphore must be waited on at this stage
+		// keeping it narrow (e.g. the transfer stage of a blit) lets unrelated graphics work of later frames overlap the passes
+		VkPipelineStageFlags2 returnStage;
+		VkAccessFlags2 returnAccess;
+	};
+
+	void init(VkDevice device, uint32_t graphicsQueueFamily, VkQueue computeQueue, uint32_t computeQueueFamily);
+
+	// true when passes run on their own queue; false when they fall back to the graphics queue
+	bool is_dedicated() const { return mComputeQueueFamily != mGraphicsQueueFamily; }
+	VkQueue get_queue() const { return mComputeQueue; }
+	uint32_t get_queue_family() const { return mComputeQueueFamily; }
+
+	// per-frame scheduling; everything scheduled is consumed by the next record_* calls
+	void schedule_pass(const char* name, std::function<void(VkCommandBuffer)>&& record);
+	void share_image(const SharedImage& sharedImage);
+	bool has_scheduled_passes() const { return !mPasses.empty(); }
+
+	// dedicated path: release the shared images from the graphics family (recorded at the end of the graphics command buffer)
+	void record_release_to_compute(VkCommandBuffer graphicsCmd);
+	// dedicated path: acquire shared images, run every pass and release the images back to the graphics family
+	void record_compute(VkCommandBuffer computeCmd, GpuProfiler& profiler, GpuPipelineStatistics& statistics);
+	// dedicated path: acquire the shared images back on the graphics queue, in their return layout
+	void record_acquire_from_compute(VkCommandBuffer graphicsCmd);
+
+	// fallback path: layout transitions and passes recorded straight into the graphics command buffer
+	void record_inline(VkCommandBuffer graphicsCmd, GpuProfiler& profiler, GpuPipelineStatistics& statistics);
+
+	// forget this frame's passes and shared images
+	void end_frame();
+
+private:
+	struct ComputePass {
+		std::string name;
+		std::function<void(VkCommandBuffer)> record;
+	};
+
+	void record_passes(VkCommandBuffer cmd, GpuProfiler& profiler, GpuPipelineStatistics& statistics, GpuQueueTrack queue);
+
+	VkDevice mDevice;
+	VkQueue mComputeQueue;
+	uint32_t mComputeQueueFamily;
+	uint32_t mGraphicsQueueFamily;
+
+	std::vector<ComputePass> mPasses;
+	std::vector<SharedImage> mSharedImages;
+};
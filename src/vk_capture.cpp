@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <glm/gtc/packing.hpp>
+#include "image_io.h"
+#include "vk_capture.h"
+#include "vk_utils.h"
+
+namespace {
+    // same curve as the post chain's tonemap pass
+    float linear_to_srgb(float value)
+    {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+    }
+}
+
+void FrameCapture::init(VmaAllocator allocator, JobSystem* jobSystem, uint32_t ringSize)
+{
+    mAllocator = allocator;
+    mJobSystem = jobSystem;
+
+    // readback buffers are only allocated once a capture actually starts
+    for (uint32_t i = 0; i < std::max(ringSize, 1u); i++) {
+        mSlots.push_back(std::make_unique<Slot>());
+    }
+}
+
+void FrameCapture::destroy()
+{
+    // whatever is still in flight is written out instead of losing the end of a sequence
+    flush();
+    // requests no frame was drawn for anymore
+    for (Request& request : mRequests) {
+        request.onWritten(false);
+    }
+    mRequests.clear();
+
+    for (std::unique_ptr<Slot>& slot : mSlots) {
+        if (slot->capacity > 0) {
+            vkutil::destroy_buffer(mAllocator, slot->buffer);
+        }
+    }
+    mSlots.clear();
+}
+
+void FrameCapture::flush()
+{
+    // the GPU is idle, so every recorded copy has landed
+    for (std::unique_ptr<Slot>& slot : mSlots) {
+        if (slot->state.load() == SlotState::InFlight) {
+            slot->state = SlotState::Encoding;
+            Slot* slotPointer = slot.get();
+            mJobSystem->schedule([this, slotPointer]() { encode(slotPointer); }, &mEncodeCounter);
+        }
+    }
+    mJobSystem->wait(mEncodeCounter);
+}
+
+void FrameCapture::start(const std::string& directory, CaptureFormat format, uint32_t frameCount)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cout << "failed to create capture directory " << directory << ": " << error.message() << std::endl;
+        return;
+    }
+
+    mDirectory = directory;
+    mFormat = format;
+    mContinuous = frameCount == 0;
+    mFramesRemaining = frameCount;
+    mSequenceNumber = 0;
+    mDroppedFrames = 0;
+}
+
+void FrameCapture::stop()
+{
+    // copies already recorded still finish and get written
+    mContinuous = false;
+    mFramesRemaining = 0;
+}
+
+void FrameCapture::capture_frame(const std::string& path, CaptureFormat format, std::function<void(bool)> onWritten)
+{
+    mRequests.push_back({ path, format, std::move(onWritten) });
+}
+
+void FrameCapture::begin_frame(uint32_t frameIndex)
+{
+    for (std::unique_ptr<Slot>& slot : mSlots) {
+        if (slot->state.load(std::memory_order_acquire) == SlotState::InFlight && slot->frameIndex == frameIndex) {
+            slot->state.store(SlotState::Encoding, std::memory_order_relaxed);
+            Slot* slotPointer = slot.get();
+            mJobSystem->schedule([this, slotPointer]() { encode(slotPointer); }, &mEncodeCounter);
+        }
+    }
+}
+
+void FrameCapture::record_copy(VkCommandBuffer cmd, const AllocatedImage& image, VkExtent2D extent, uint32_t frameIndex, bool bSceneLinear,
+    bool bSrgbEncoded)
+{
+    const bool bFloat32 = image.imageFormat == VK_FORMAT_R32G32B32A32_SFLOAT;
+    if (!is_capturing() || (image.imageFormat != VK_FORMAT_R16G16B16A16_SFLOAT && !bFloat32)) {
+        return;
+    }
+
+    const bool bRequested = !mRequests.empty();
+    CaptureFormat format = bRequested ? mRequests.front().format : mFormat;
+    if ((format == CaptureFormat::Exr) != bSceneLinear) {
+        return;
+    }
+    Slot* slot = find_free_slot();
+    if (!slot) {
+        // every buffer is still busy; waiting for one would stall the render loop. A requested frame is taken by a later
+        // one instead: encoders free their slots on their own, and frames in flight never hold the whole ring as long as it
+        // has more slots than there are frames in flight
+        if (bRequested) {
+            mDeferredFrames++;
+        }
+        else {
+            mDroppedFrames++;
+        }
+        return;
+    }
+
+    // buffers only ever grow, so a resize to a smaller window does not reallocate
+    VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4 * (bFloat32 ? sizeof(float) : sizeof(uint16_t));
+    if (slot->capacity < size) {
+        if (slot->capacity > 0) {
+            vkutil::destroy_buffer(mAllocator, slot->buffer);
+        }
+        slot->buffer = vkutil::create_buffer(mAllocator, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+        slot->capacity = size;
+    }
+
+    // the linear scene is read in the middle of the frame: after whatever wrote it, and before the post chain overwrites it
+    // in place (on the compute queue, the semaphore the scene submission signals orders that). The display-ready output is
+    // read alongside the blit into the swapchain, at whose stage it comes back from the compute queue: the copy is chained after that
+    VkMemoryBarrier2 sourceBarrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+    sourceBarrier.srcStageMask = bSceneLinear ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_2_BLIT_BIT;
+    sourceBarrier.srcAccessMask = bSceneLinear ? VK_ACCESS_2_MEMORY_WRITE_BIT : VK_ACCESS_2_NONE;
+    sourceBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    sourceBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    VkDependencyInfo sourceDepInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    sourceDepInfo.memoryBarrierCount = 1;
+    sourceDepInfo.pMemoryBarriers = &sourceBarrier;
+    vkCmdPipelineBarrier2(cmd, &sourceDepInfo);
+
+    VkBufferImageCopy copyRegion{};
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageExtent = { extent.width, extent.height, 1 };
+    VkImageLayout layout = bSceneLinear ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    vkCmdCopyImageToBuffer(cmd, image.image, layout, slot->buffer.buffer, 1, &copyRegion);
+
+    // makes the copy visible to host reads, which happen after the frame's fence signalled
+    VkBufferMemoryBarrier2 hostBarrier = { .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2 };
+    hostBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    hostBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    hostBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = slot->buffer.buffer;
+    hostBarrier.offset = 0;
+    hostBarrier.size = size;
+
+    // and keeps later passes on this queue from writing the image before the copy read it
+    VkMemoryBarrier2 readBarrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+    readBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    readBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+    VkDependencyInfo depInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    depInfo.memoryBarrierCount = bSceneLinear ? 1 : 0;
+    depInfo.pMemoryBarriers = &readBarrier;
+    depInfo.bufferMemoryBarrierCount = 1;
+    depInfo.pBufferMemoryBarriers = &hostBarrier;
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+
+    slot->frameIndex = frameIndex;
+    slot->extent = extent;
+    slot->bFloat32 = bFloat32;
+    slot->bSrgbEncoded = bSrgbEncoded;
+    if (bRequested) {
+        Request& request = mRequests.front();
+        slot->format = request.format;
+        slot->path = std::move(request.path);
+        slot->onWritten = std::move(request.onWritten);
+        mRequests.pop_front();
+    }
+    else {
+        static const char* extensions[] = { "png", "exr", "raw" };
+        char fileName[64];
+        std::snprintf(fileName, sizeof(fileName), "frame_%06u.%s", mSequenceNumber, extensions[(int)mFormat]);
+
+        slot->format = format;
+        slot->path = (std::filesystem::path(mDirectory) / fileName).string();
+        slot->onWritten = nullptr;
+        mSequenceNumber++;
+        if (!mContinuous) {
+            mFramesRemaining--;
+        }
+    }
+    slot->state.store(SlotState::InFlight, std::memory_order_release);
+    mPendingFrames++;
+}
+
+FrameCapture::Slot* FrameCapture::find_free_slot()
+{
+    for (std::unique_ptr<Slot>& slot : mSlots) {
+        if (slot->state.load(std::memory_order_acquire) == SlotState::Free) {
+            return slot.get();
+        }
+    }
+    return nullptr;
+}
+
+void FrameCapture::encode(Slot* slot)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // a no-op on coherent memory, which is what GPU_TO_CPU usually ends up in
+    vmaInvalidateAllocation(mAllocator, slot->buffer.allocation, 0, VK_WHOLE_SIZE);
+    const uint16_t* pixels = (const uint16_t*)slot->buffer.info.pMappedData;
+    const float* floatPixels = (const float*)slot->buffer.info.pMappedData;
+    const size_t valueCount = (size_t)slot->extent.width * slot->extent.height * 4;
+
+    bool bWritten;
+    if (slot->format == CaptureFormat::Exr) {
+        // the EXR writer takes half floats only
+        std::vector<uint16_t> halfPixels;
+        if (slot->bFloat32) {
+            halfPixels.resize(valueCount);
+            for (size_t i = 0; i < valueCount; i++) {
+                halfPixels[i] = glm::packHalf1x16(floatPixels[i]);
+            }
+        }
+        bWritten = imageio::write_exr(slot->path.c_str(), slot->extent.width, slot->extent.height, slot->bFloat32 ? halfPixels.data() : pixels);
+    }
+    else {
+        // the draw image already holds sRGB encoded values once post-processing ran, so this is just a quantization.
+        // Without the post chain it is still linear, and the color channels get the sRGB transfer function here
+        std::vector<uint8_t> rgba(valueCount);
+        for (size_t i = 0; i < valueCount; i++) {
+            float value = std::clamp(slot->bFloat32 ? floatPixels[i] : glm::unpackHalf1x16(pixels[i]), 0.f, 1.f);
+            if (!slot->bSrgbEncoded && i % 4 != 3) {
+                value = linear_to_srgb(value);
+            }
+            rgba[i] = (uint8_t)(value * 255.f + 0.5f);
+        }
+
+        if (slot->format == CaptureFormat::Png) {
+            bWritten = imageio::write_png(slot->path.c_str(), slot->extent.width, slot->extent.height, rgba.data());
+        }
+        else {
+            bWritten = imageio::write_raw(slot->path.c_str(), rgba.data(), rgba.size());
+        }
+    }
+
+    if (bWritten) {
+        mWrittenFrames++;
+    }
+    else {
+        std::cout << "failed to write capture " << slot->path << std::endl;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    mLastEncodeMicroseconds = (uint32_t)elapsed.count();
+    mPendingFrames--;
+    if (slot->onWritten) {
+        slot->onWritten(bWritten);
+        slot->onWritten = nullptr;
+    }
+
+    // the render thread may reuse the buffer from here on
+    slot->state.store(SlotState::Free, std::memory_order_release);
+}
+
+FrameCapture::Stats FrameCapture::get_stats() const
+{
+    Stats stats;
+    stats.writtenFrames = mWrittenFrames.load();
+    stats.droppedFrames = mDroppedFrames;
+    stats.deferredFrames = mDeferredFrames;
+    stats.pendingFrames = mPendingFrames.load();
+    stats.lastEncodeTime = mLastEncodeMicroseconds.load() / 1000.f;
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "job_system.h"
+#include "vk_types.h"
+
+enum class CaptureFormat : int {
+	Png = 0, // 8 bit sRGB RGBA, what ends up on screen (minus the UI)
+	Exr = 1, // the linear HDR scene as RGBA16F, before exposure, bloom and tonemapping; bit for bit unless it is RGBA32F
+	Raw = 2 // headerless 8 bit sRGB RGBA frames, for piping into a video encoder
+};
+
+// Copies frames of the draw image into a ring of host visible readback buffers and writes them to disk on worker threads.
+// A readback is only touched by the CPU once the fence of the frame that recorded it has been waited on by the render loop.
+// When every buffer of the ring is still in flight or being encoded, a sequence frame is dropped and a requested frame
+// deferred to a later one rather than waited for, so capturing never stalls rendering. Works the same with or without a swapchain
+class FrameCapture {
+public:
+	struct Stats {
+		uint32_t writtenFrames;
+		uint32_t droppedFrames;
+		// frames a requested capture could not take because the ring was busy, and left to a later frame
+		uint32_t deferredFrames;
+		// copied or being encoded, but not on disk yet
+		uint32_t pendingFrames;
+		float lastEncodeTime; // in ms, on the worker
+	};
+
+	void init(VmaAllocator allocator, JobSystem* jobSystem, uint32_t ringSize = 4);
+	// the device must be idle: frames that were copied but never collected are still written out before returning
+	void destroy();
+	// same requirement; writes out every frame copied so far and returns once they are on disk
+	void flush();
+
+	// captures frameCount consecutive frames as <directory>/frame_000000.<ext>, ...; a frameCount of 0 captures until stop()
+	void start(const std::string& directory, CaptureFormat format, uint32_t frameCount = 1);
+	void stop();
+	bool is_capturing() const { return mFramesRemaining > 0 || mContinuous || !mRequests.empty(); }
+	// writes the next frame into path (whose directory must exist), taking the place of a running sequence's frame.
+	// onWritten runs on the worker that wrote it, with whether writing succeeded. Requested frames are never dropped:
+	// when every readback is busy, the request stays queued for the first frame that finds one free
+	void capture_frame(const std::string& path, CaptureFormat format, std::function<void(bool)> onWritten);
+	uint32_t get_pending_requests() const { return (uint32_t)mRequests.size(); }
+
+	// call once the frame slot's fence has been waited on: hands the readbacks it recorded to the workers
+	void begin_frame(uint32_t frameIndex);
+
+	// records a copy of the image's drawn region into a free readback buffer if a capture of that stage of the frame is
+	// running: EXR captures take the linear scene (bSceneLinear, image in GENERAL), the others the display-ready output
+	// (image in TRANSFER_SRC_OPTIMAL). The image must be RGBA16F or RGBA32F, and frameIndex the slot whose fence covers cmd.
+	// bSrgbEncoded tells whether the output went through the post chain's sRGB encode; if not, 8 bit captures apply it
+	void record_copy(VkCommandBuffer cmd, const AllocatedImage& image, VkExtent2D extent, uint32_t frameIndex, bool bSceneLinear,
+		bool bSrgbEncoded);
+
+	Stats get_stats() const;
+
+private:
+	enum class SlotState : uint32_t {
+		Free,
+		InFlight, // copy recorded, the GPU may still be writing
+		Encoding // owned by a worker
+	};
+
+	struct Slot {
+		AllocatedBuffer buffer{};
+		VkDeviceSize capacity = 0;
+		std::atomic<SlotState> state{ SlotState::Free };
+		uint32_t frameIndex = 0;
+		VkExtent2D extent{};
+		// 32 bit float values in the buffer rather than 16 bit
+		bool bFloat32 = false;
+		// the values are sRGB already rather than linear
+		bool bSrgbEncoded = false;
+		CaptureFormat format = CaptureFormat::Png;
+		std::string path;
+		// of a requested frame
+		std::function<void(bool)> onWritten;
+	};
+
+	struct Request {
+		std::string path;
+		CaptureFormat format;
+		std::function<void(bool)> onWritten;
+	};
+
+	Slot* find_free_slot();
+	void encode(Slot* slot);
+
+	VmaAllocator mAllocator;
+	JobSystem* mJobSystem;
+	JobSystem::Counter mEncodeCounter;
+
+	// slots are handed to worker threads by pointer, so they must not move
+	std::vector<std::unique_ptr<Slot>> mSlots;
+
+	std::string mDirectory;
+	CaptureFormat mFormat = CaptureFormat::Png;
+	uint32_t mFramesRemaining = 0;
+	bool mContinuous = false;
+	uint32_t mSequenceNumber = 0;
+	// single frames, in the order they are drawn
+	std::deque<Request> mRequests;
+
+	std::atomic<uint32_t> mWrittenFrames{ 0 };
+	std::atomic<uint32_t> mPendingFrames{ 0 };
+	std::atomic<uint32_t> mLastEncodeMicroseconds{ 0 };
+	uint32_t mDroppedFrames = 0;
+	uint32_t mDeferredFrames = 0;
+};
\ No newline at end of file
@@ -0,0 +1,744 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include "bvh.h"
+#include "vk_check_macro.h"
+#include "vk_cluster_renderer.h"
+#include "vk_initializers.h"
+#include "vk_utils.h"
+
+namespace {
+    constexpr uint32_t CULL_FRUSTUM = 1;
+    constexpr uint32_t CULL_BACKFACE = 2;
+    constexpr uint32_t CULL_OCCLUSION = 4;
+    // shaders/cluster_culling.glsl INVALID_LOD, as a fill pattern
+    constexpr uint32_t INVALID_LOD = UINT32_MAX;
+    // fills of stale level state a frame records at most before it resets all of it instead
+    constexpr size_t MAX_LOD_RESET_RANGES = 64;
+    // workgroups per dispatch dimension every device supports
+    constexpr uint32_t MAX_GROUPS_PER_DIMENSION = 65535;
+
+    VkDeviceAddress get_buffer_address(VkDevice device, VkBuffer buffer)
+    {
+        VkBufferDeviceAddressInfo addressInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+        addressInfo.buffer = buffer;
+        return vkGetBufferDeviceAddress(device, &addressInfo);
+    }
+
+    void memory_barrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+    {
+        VkMemoryBarrier2 memoryBarrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+        memoryBarrier.srcStageMask = srcStage;
+        memoryBarrier.srcAccessMask = srcAccess;
+        memoryBarrier.dstStageMask = dstStage;
+        memoryBarrier.dstAccessMask = dstAccess;
+
+        VkDependencyInfo depInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+        depInfo.memoryBarrierCount = 1;
+        depInfo.pMemoryBarriers = &memoryBarrier;
+        vkCmdPipelineBarrier2(cmd, &depInfo);
+    }
+
+    void image_barrier(VkCommandBuffer cmd, VkImage image, VkImageAspectFlags aspect, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+    {
+        VkImageMemoryBarrier2 imageBarrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+        imageBarrier.srcStageMask = srcStage;
+        imageBarrier.srcAccessMask = srcAccess;
+        imageBarrier.dstStageMask = dstStage;
+        imageBarrier.dstAccessMask = dstAccess;
+        imageBarrier.oldLayout = oldLayout;
+        imageBarrier.newLayout = newLayout;
+        imageBarrier.image = image;
+        imageBarrier.subresourceRange = vkinit::image_subresource_range(aspect);
+
+        VkDependencyInfo depInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+        depInfo.imageMemoryBarrierCount = 1;
+        depInfo.pImageMemoryBarriers = &imageBarrier;
+        vkCmdPipelineBarrier2(cmd, &depInfo);
+    }
+
+    uint32_t round_down_to_power_of_two(uint32_t value)
+    {
+        uint32_t result = 1;
+        while (result * 2 <= value) {
+            result *= 2;
+        }
+        return result;
+    }
+}
+
+void ClusterRenderer::declare_targets(RenderTargetPool& renderTargets, VkExtent3D drawImageExtent)
+{
+    RenderTargetPool::TargetDesc depthDesc;
+    depthDesc.name = "Depth";
+    depthDesc.format = DEPTH_FORMAT;
+    depthDesc.extent = drawImageExtent;
+    depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // written by the scene draw, read by the HZB build right after
+    depthDesc.firstPass = FramePass::Scene;
+    depthDesc.lastPass = FramePass::Scene;
+    mDepthTarget = renderTargets.declare(depthDesc);
+
+    // a power of two pyramid keeps every level exactly half of the previous one; level 0 reduces the draw extent to it
+    VkExtent3D hzbExtent = { round_down_to_power_of_two(drawImageExtent.width), round_down_to_power_of_two(drawImageExtent.height), 1 };
+    RenderTargetPool::TargetDesc hzbDesc;
+    hzbDesc.name = "HZB";
+    hzbDesc.format = VK_FORMAT_R32_SFLOAT;
+    hzbDesc.extent = hzbExtent;
+    hzbDesc.mipLevels = (uint32_t)std::floor(std::log2((float)std::max(hzbExtent.width, hzbExtent.height))) + 1;
+    hzbDesc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    hzbDesc.firstPass = FramePass::Scene;
+    hzbDesc.lastPass = FramePass::Scene;
+    // culling tests the next frame against it
+    hzbDesc.bPersistent = true;
+    mHzbTarget = renderTargets.declare(hzbDesc);
+}
+
+void ClusterRenderer::init(VkDevice device, VmaAllocator allocator, PipelinePermutationCache& pipelineCache, const RenderTargetPool& renderTargets,
+    VkFormat drawImageFormat, VkDescriptorSetLayout textureSetLayout, uint32_t framesInFlight)
+{
+    mDevice = device;
+    mAllocator = allocator;
+    mPipelineCache = &pipelineCache;
+
+    init_resources(renderTargets);
+    init_pipelines(drawImageFormat, textureSetLayout);
+
+    mFrames.resize(framesInFlight);
+    for (FrameResources& frame : mFrames) {
+        frame.cullData = vkutil::create_buffer(mAllocator, (1 + MAX_DEPTH_VIEWS) * sizeof(GpuCullData),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        frame.cullDataAddress = get_buffer_address(mDevice, frame.cullData.buffer);
+        frame.stats = vkutil::create_buffer(mAllocator, (1 + MAX_DEPTH_VIEWS) * sizeof(GpuStats),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+        frame.statsAddress = get_buffer_address(mDevice, frame.stats.buffer);
+    }
+}
+
+void ClusterRenderer::init_resources(const RenderTargetPool& renderTargets)
+{
+    mDepthImage = renderTargets.get(mDepthTarget);
+    mHzbImage = renderTargets.get(mHzbTarget);
+
+    mHzbMipViews.resize(mHzbImage.mipLevels);
+    for (uint32_t mip = 0; mip < mHzbImage.mipLevels; mip++) {
+        VkImageViewCreateInfo mipViewInfo = vkinit::imageview_create_info(VK_FORMAT_R32_SFLOAT, mHzbImage.image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+        mipViewInfo.subresourceRange.baseMipLevel = mip;
+        VK_CHECK(vkCreateImageView(mDevice, &mipViewInfo, nullptr, &mHzbMipViews[mip]));
+    }
+
+    // the shaders only use texelFetch; the sampler just has to exist
+    VkSamplerCreateInfo samplerInfo = { .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mHzbSampler));
+}
+
+void ClusterRenderer::init_pipelines(VkFormat drawImageFormat, VkDescriptorSetLayout textureSetLayout)
+{
+    uint64_t shaderHash;
+
+    // culling reads the HZB through a sampler; everything else is addressed through push constants
+    DescriptorLayoutBuilder cullLayoutBuilder;
+    cullLayoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    mCullSetLayout = cullLayoutBuilder.build(mDevice, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    VkPushConstantRange cullPushConstants{};
+    cullPushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullPushConstants.offset = 0;
+    cullPushConstants.size = sizeof(CullConstants);
+
+    VkPipelineLayoutCreateInfo cullLayoutInfo = vkinit::pipeline_layout_create_info();
+    cullLayoutInfo.setLayoutCount = 1;
+    cullLayoutInfo.pSetLayouts = &mCullSetLayout;
+    cullLayoutInfo.pushConstantRangeCount = 1;
+    cullLayoutInfo.pPushConstantRanges = &cullPushConstants;
+    VK_CHECK(vkCreatePipelineLayout(mDevice, &cullLayoutInfo, nullptr, &mCullPipelineLayout));
+
+    ComputePipelineBuilder computeBuilder;
+    computeBuilder.set_shader(mPipelineCache->load_shader("cluster_cull.comp.spv", &shaderHash), shaderHash);
+    computeBuilder.set_layout(mCullPipelineLayout);
+    mCullFamily = mPipelineCache->register_compute_family("cluster cull", computeBuilder);
+
+    VkPushConstantRange lodPushConstants{};
+    lodPushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    lodPushConstants.offset = 0;
+    lodPushConstants.size = sizeof(LodConstants);
+
+    VkPipelineLayoutCreateInfo lodLayoutInfo = vkinit::pipeline_layout_create_info();
+    lodLayoutInfo.pushConstantRangeCount = 1;
+    lodLayoutInfo.pPushConstantRanges = &lodPushConstants;
+    VK_CHECK(vkCreatePipelineLayout(mDevice, &lodLayoutInfo, nullptr, &mLodPipelineLayout));
+
+    computeBuilder.set_shader(mPipelineCache->load_shader("lod_select.comp.spv", &shaderHash), shaderHash);
+    computeBuilder.set_layout(mLodPipelineLayout);
+    mLodFamily = mPipelineCache->register_compute_family("lod select", computeBuilder);
+
+    DescriptorLayoutBuilder hzbLayoutBuilder;
+    hzbLayoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    hzbLayoutBuilder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    mHzbSetLayout = hzbLayoutBuilder.build(mDevice, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    VkPushConstantRange hzbPushConstants{};
+    hzbPushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    hzbPushConstants.offset = 0;
+    hzbPushConstants.size = sizeof(HzbConstants);
+
+    VkPipelineLayoutCreateInfo hzbLayoutInfo = vkinit::pipeline_layout_create_info();
+    hzbLayoutInfo.setLayoutCount = 1;
+    hzbLayoutInfo.pSetLayouts = &mHzbSetLayout;
+    hzbLayoutInfo.pushConstantRangeCount = 1;
+    hzbLayoutInfo.pPushConstantRanges = &hzbPushConstants;
+    VK_CHECK(vkCreatePipelineLayout(mDevice, &hzbLayoutInfo, nullptr, &mHzbPipelineLayout));
+
+    computeBuilder.set_shader(mPipelineCache->load_shader("hzb_reduce.comp.spv", &shaderHash), shaderHash);
+    computeBuilder.set_layout(mHzbPipelineLayout);
+    mHzbFamily = mPipelineCache->register_compute_family("hzb reduce", computeBuilder);
+
+    VkPushConstantRange meshPushConstants{};
+    meshPushConstants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    meshPushConstants.offset = 0;
+    meshPushConstants.size = sizeof(MeshConstants);
+
+    // the shadow atlas and its cascades, then the texture streamer's heap; everything else is addressed through push constants
+    DescriptorLayoutBuilder meshLayoutBuilder;
+    meshLayoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    meshLayoutBuilder.add_binding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    mMeshSetLayout = meshLayoutBuilder.build(mDevice, VK_SHADER_STAGE_FRAGMENT_BIT);
+    VkDescriptorSetLayout meshSetLayouts[] = { mMeshSetLayout, textureSetLayout };
+
+    VkPipelineLayoutCreateInfo meshLayoutInfo = vkinit::pipeline_layout_create_info();
+    meshLayoutInfo.setLayoutCount = 2;
+    meshLayoutInfo.pSetLayouts = meshSetLayouts;
+    meshLayoutInfo.pushConstantRangeCount = 1;
+    meshLayoutInfo.pPushConstantRanges = &meshPushConstants;
+    VK_CHECK(vkCreatePipelineLayout(mDevice, &meshLayoutInfo, nullptr, &mMeshPipelineLayout));
+
+    // the projection flips Y, which keeps glTF's counter-clockwise front faces counter-clockwise on screen
+    uint64_t fragmentHash;
+    VkShaderModule vertexShader = mPipelineCache->load_shader("mesh.vert.spv", &shaderHash);
+    VkShaderModule fragmentShader = mPipelineCache->load_shader("mesh.frag.spv", &fragmentHash);
+    PipelineBuilder meshBuilder;
+    meshBuilder.set_shaders(vertexShader, fragmentShader, vkutil::hash_combine(shaderHash, fragmentHash));
+    meshBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    meshBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    meshBuilder.set_cull_mode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+    meshBuilder.set_multisampling_none();
+    meshBuilder.disable_blending();
+    meshBuilder.enable_depthtest(true, VK_COMPARE_OP_LESS);
+    meshBuilder.set_color_attachment_format(drawImageFormat);
+    meshBuilder.set_depth_format(DEPTH_FORMAT);
+    meshBuilder.set_layout(mMeshPipelineLayout);
+    mMeshFamily = mPipelineCache->register_graphics_family("cluster mesh", meshBuilder);
+
+    VkPushConstantRange depthPushConstants{};
+    depthPushConstants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    depthPushConstants.offset = 0;
+    depthPushConstants.size = sizeof(DepthConstants);
+
+    VkPipelineLayoutCreateInfo depthLayoutInfo = vkinit::pipeline_layout_create_info();
+    depthLayoutInfo.pushConstantRangeCount = 1;
+    depthLayoutInfo.pPushConstantRanges = &depthPushConstants;
+    VK_CHECK(vkCreatePipelineLayout(mDevice, &depthLayoutInfo, nullptr, &mDepthPipelineLayout));
+
+    // no culling: light space projections keep their own winding, and single sided surfaces (planes) still cast shadows
+    PipelineBuilder depthBuilder;
+    depthBuilder.set_vertex_shader_only(mPipelineCache->load_shader("shadow_depth.vert.spv", &shaderHash), shaderHash);
+    depthBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    depthBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    depthBuilder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+    depthBuilder.set_multisampling_none();
+    depthBuilder.disable_blending();
+    depthBuilder.enable_depthtest(true, VK_COMPARE_OP_LESS);
+    depthBuilder.enable_depth_bias();
+    depthBuilder.set_depth_format(DEPTH_FORMAT);
+    depthBuilder.set_layout(mDepthPipelineLayout);
+    mDepthFamily = mPipelineCache->register_graphics_family("cluster depth", depthBuilder);
+}
+
+void ClusterRenderer::destroy()
+{
+    for (FrameResources& frame : mFrames) {
+        destroy_frame_buffer(frame.instances);
+        destroy_frame_buffer(frame.lods);
+        destroy_frame_buffer(frame.clusters);
+        destroy_frame_buffer(frame.commandTemplates);
+        destroy_frame_buffer(frame.commands);
+        destroy_frame_buffer(frame.outputIndices);
+        vkutil::destroy_buffer(mAllocator, frame.cullData);
+        vkutil::destroy_buffer(mAllocator, frame.stats);
+    }
+    mFrames.clear();
+    for (RetiredBuffer& retired : mRetiredBuffers) {
+        destroy_frame_buffer(retired.buffer);
+    }
+    mRetiredBuffers.clear();
+    destroy_frame_buffer(mLodState);
+
+    vkDestroyPipelineLayout(mDevice, mDepthPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(mDevice, mMeshPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mMeshSetLayout, nullptr);
+    vkDestroyPipelineLayout(mDevice, mHzbPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mHzbSetLayout, nullptr);
+    vkDestroyPipelineLayout(mDevice, mLodPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(mDevice, mCullPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mCullSetLayout, nullptr);
+
+    vkDestroySampler(mDevice, mHzbSampler, nullptr);
+    for (VkImageView view : mHzbMipViews) {
+        vkDestroyImageView(mDevice, view, nullptr);
+    }
+    mHzbMipViews.clear();
+}
+
+void ClusterRenderer::ensure_capacity(FrameBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage)
+{
+    if (size <= buffer.capacity) {
+        return;
+    }
+    // the frame slot's fence has been waited on, so the old buffer is free; half again as much avoids regrowing every frame
+    // while a scene streams in
+    destroy_frame_buffer(buffer);
+    buffer.capacity = std::max(size + size / 2, VkDeviceSize(4096));
+    buffer.buffer = vkutil::create_buffer(mAllocator, buffer.capacity, usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, memoryUsage);
+    buffer.address = get_buffer_address(mDevice, buffer.buffer.buffer);
+}
+
+void ClusterRenderer::destroy_frame_buffer(FrameBuffer& buffer)
+{
+    if (buffer.capacity > 0) {
+        vkutil::destroy_buffer(mAllocator, buffer.buffer);
+    }
+    buffer = FrameBuffer();
+}
+
+void ClusterRenderer::begin_frame(uint32_t frameIndex)
+{
+    for (size_t i = 0; i < mRetiredBuffers.size();) {
+        if (mRetiredBuffers[i].frameIndex == frameIndex) {
+            destroy_frame_buffer(mRetiredBuffers[i].buffer);
+            mRetiredBuffers[i] = mRetiredBuffers.back();
+            mRetiredBuffers.pop_back();
+        }
+        else {
+            i++;
+        }
+    }
+
+    FrameResources& frame = mFrames[frameIndex];
+    if (!frame.bStatsPending) {
+        return;
+    }
+    frame.bStatsPending = false;
+
+    vmaInvalidateAllocation(mAllocator, frame.stats.allocation, 0, VK_WHOLE_SIZE);
+    GpuStats gpuStats[1 + MAX_DEPTH_VIEWS];
+    std::memcpy(gpuStats, frame.stats.info.pMappedData, (1 + frame.depthViewCount) * sizeof(GpuStats));
+
+    mStats.instanceCount = frame.instanceCount;
+    mStats.clusterCount = frame.clusterCount;
+    mStats.frustumCulledClusters = gpuStats[0].frustumCulledClusters;
+    mStats.backfaceCulledClusters = gpuStats[0].backfaceCulledClusters;
+    mStats.occlusionCulledClusters = gpuStats[0].occlusionCulledClusters;
+    mStats.totalTriangles = frame.totalTriangles;
+    mStats.frustumCulledTriangles = gpuStats[0].frustumCulledTriangles;
+    mStats.backfaceCulledTriangles = gpuStats[0].backfaceCulledTriangles;
+    mStats.occlusionCulledTriangles = gpuStats[0].occlusionCulledTriangles;
+    mStats.drawnTriangles = gpuStats[0].drawnTriangles;
+    for (uint32_t lod = 0; lod < MAX_MESH_LODS; lod++) {
+        mStats.lodInstances[lod] = gpuStats[0].lodInstances[lod];
+        mStats.lodSelectedTriangles[lod] = gpuStats[0].lodSelectedTriangles[lod];
+        mStats.lodDrawnTriangles[lod] = gpuStats[0].lodDrawnTriangles[lod];
+    }
+    mStats.depthViewCount = frame.depthViewCount;
+    mStats.depthViewDrawnTriangles = 0;
+    for (uint32_t depthView = 1; depthView <= frame.depthViewCount; depthView++) {
+        mStats.depthViewDrawnTriangles += gpuStats[depthView].drawnTriangles;
+    }
+}
+
+void ClusterRenderer::cull(VkCommandBuffer cmd, uint32_t frameIndex, DescriptorAllocatorGrowable& frameDescriptors, VkExtent2D drawExtent,
+    const SceneView& view, std::span<const glm::mat4> depthViews, const std::vector<std::unique_ptr<MeshAsset>>& meshes,
+    std::span<const Entity> instanceEntities, std::span<const uint32_t> instanceMeshes, std::span<const glm::mat4> instanceTransforms,
+    const GeometryBufferPool& vertexPool, const GeometryBufferPool& indexPool, const GeometryBufferPool& meshletPool)
+{
+    FrameResources& frame = mFrames[frameIndex];
+    const uint32_t depthViewCount = std::min((uint32_t)depthViews.size(), MAX_DEPTH_VIEWS);
+    const uint32_t viewCount = 1 + depthViewCount;
+
+    // sizes first, so every buffer is grown before anything is written. Every level's clusters are listed, but an instance
+    // never draws more than its full detail level
+    uint32_t drawCount = 0;
+    uint32_t clusterCount = 0;
+    uint32_t lodCount = 0;
+    uint64_t outputIndexCount = 0;
+    mMeshLodOffsets.assign(meshes.size(), UINT32_MAX);
+    for (uint32_t meshIndex : instanceMeshes) {
+        const MeshAsset* mesh = meshIndex < meshes.size() ? meshes[meshIndex].get() : nullptr;
+        if (mesh && mesh->bResident && mesh->meshletCount > 0) {
+            drawCount++;
+            clusterCount += mesh->meshletCount;
+            outputIndexCount += mesh->lods[0].indexCount;
+            if (mMeshLodOffsets[meshIndex] == UINT32_MAX) {
+                mMeshLodOffsets[meshIndex] = lodCount;
+                lodCount += (uint32_t)mesh->lods.size();
+            }
+        }
+    }
+    frame.instanceCount = drawCount;
+    frame.clusterCount = clusterCount;
+    frame.totalTriangles = outputIndexCount / 3;
+    frame.outputIndexCount = outputIndexCount;
+    frame.depthViewCount = depthViewCount;
+    if (drawCount == 0) {
+        // nothing will be drawn, so the depth the HZB would be built from is empty; culling starts over once there is a scene
+        mStats = Stats{};
+        mHistoryValid = false;
+        return;
+    }
+
+    ensure_capacity(frame.instances, drawCount * sizeof(GpuInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    ensure_capacity(frame.lods, lodCount * sizeof(GpuLod), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    ensure_capacity(frame.clusters, clusterCount * sizeof(glm::uvec2), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    ensure_capacity(frame.commandTemplates, drawCount * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    ensure_capacity(frame.commands, viewCount * drawCount * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    ensure_capacity(frame.outputIndices, viewCount * outputIndexCount * sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    // the level state outlives frames, so a replaced buffer is retired rather than destroyed; instances start over from
+    // no previous level, which costs at most one frame of hysteresis
+    uint32_t lodSlotCount = 0;
+    for (Entity entity : instanceEntities) {
+        lodSlotCount = std::max(lodSlotCount, entity.index() + 1);
+    }
+    bool bResetLodState = false;
+    if (lodSlotCount * sizeof(uint32_t) > mLodState.capacity) {
+        if (mLodState.capacity > 0) {
+            mRetiredBuffers.push_back({ mLodState, frameIndex });
+            mLodState = FrameBuffer();
+        }
+        ensure_capacity(mLodState, lodSlotCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY);
+        bResetLodState = true;
+        mLodStateOwners.assign(mLodState.capacity / sizeof(uint32_t), UINT32_MAX);
+    }
+    mStaleLodSlots.clear();
+
+    GpuLod* gpuLods = (GpuLod*)frame.lods.buffer.info.pMappedData;
+    for (size_t meshIndex = 0; meshIndex < meshes.size(); meshIndex++) {
+        if (mMeshLodOffsets[meshIndex] == UINT32_MAX) {
+            continue;
+        }
+        const std::vector<MeshLod>& lods = meshes[meshIndex]->lods;
+        for (size_t lod = 0; lod < lods.size(); lod++) {
+            gpuLods[mMeshLodOffsets[meshIndex] + lod] = { lods[lod].error, lods[lod].indexCount / 3 };
+        }
+    }
+
+    GpuInstance* gpuInstances = (GpuInstance*)frame.instances.buffer.info.pMappedData;
+    glm::uvec2* clusters = (glm::uvec2*)frame.clusters.buffer.info.pMappedData;
+    VkDrawIndexedIndirectCommand* commandTemplates = (VkDrawIndexedIndirectCommand*)frame.commandTemplates.buffer.info.pMappedData;
+    uint32_t drawIndex = 0;
+    uint32_t clusterIndex = 0;
+    uint32_t outputFirstIndex = 0;
+    for (uint32_t sceneIndex = 0; sceneIndex < instanceMeshes.size(); sceneIndex++) {
+        const uint32_t meshIndex = instanceMeshes[sceneIndex];
+        const glm::mat4& transform = instanceTransforms[sceneIndex];
+        const MeshAsset* mesh = meshIndex < meshes.size() ? meshes[meshIndex].get() : nullptr;
+        if (!mesh || !mesh->bResident || mesh->meshletCount == 0) {
+            continue;
+        }
+
+        GpuInstance& gpuInstance = gpuInstances[drawIndex];
+        gpuInstance.model = transform;
+        gpuInstance.vertices = vertexPool.get_address(mesh->vertices.page) + mesh->vertices.offset;
+        gpuInstance.indices = indexPool.get_address(mesh->indices.page) + mesh->indices.offset;
+        gpuInstance.meshlets = meshletPool.get_address(mesh->meshlets.page) + mesh->meshlets.offset;
+        gpuInstance.firstLod = mMeshLodOffsets[meshIndex];
+        gpuInstance.lodCount = (uint32_t)mesh->lods.size();
+        gpuInstance.outputFirstIndex = outputFirstIndex;
+        gpuInstance.maxScale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+            glm::length(glm::vec3(transform[2])) });
+        const Entity entity = instanceEntities[sceneIndex];
+        gpuInstance.lodSlot = entity.index();
+        gpuInstance.baseColorTexture = mesh->baseColorTexture;
+        gpuInstance.baseColorFactor = glm::packUnorm4x8(mesh->baseColorFactor);
+        if (mLodStateOwners[entity.index()] != entity.id) {
+            mLodStateOwners[entity.index()] = entity.id;
+            if (!bResetLodState) {
+                mStaleLodSlots.push_back(entity.index());
+            }
+        }
+        glm::vec3 center = glm::vec3(transform * glm::vec4((mesh->boundsMin + mesh->boundsMax) * 0.5f, 1.f));
+        gpuInstance.boundingSphere = glm::vec4(center, glm::length(mesh->boundsMax - mesh->boundsMin) * 0.5f * gpuInstance.maxScale);
+
+        // the index count is what culling adds up; the instance index reaches the vertex shader as gl_InstanceIndex.
+        // First indices are relative to the view's section of the output indices, which is bound at its offset
+        VkDrawIndexedIndirectCommand& command = commandTemplates[drawIndex];
+        command.indexCount = 0;
+        command.instanceCount = 1;
+        command.firstIndex = outputFirstIndex;
+        command.vertexOffset = 0;
+        command.firstInstance = drawIndex;
+
+        for (uint32_t meshlet = 0; meshlet < mesh->meshletCount; meshlet++) {
+            clusters[clusterIndex++] = glm::uvec2(drawIndex, meshlet);
+        }
+        outputFirstIndex += mesh->lods[0].indexCount;
+        drawIndex++;
+    }
+
+    GpuCullData* cullData = (GpuCullData*)frame.cullData.info.pMappedData;
+    glm::mat4 viewProjection = view.projection * view.view;
+    cullData[0].viewProjection = viewProjection;
+    cullData[0].previousViewProjection = mPreviousViewProjection;
+    extract_frustum_planes(viewProjection, cullData[0].frustumPlanes);
+    cullData[0].cameraPosition = glm::vec4(view.cameraPosition, 1.f);
+    cullData[0].hzbSize = glm::vec2(mHzbImage.imageExtent.width, mHzbImage.imageExtent.height);
+    cullData[0].hzbMipCount = mHzbImage.mipLevels;
+    cullData[0].flags = (mSettings.bFrustumCulling ? CULL_FRUSTUM : 0) | (mSettings.bBackfaceCulling ? CULL_BACKFACE : 0)
+        | (mSettings.bOcclusionCulling && mHistoryValid ? CULL_OCCLUSION : 0);
+    // the projection's vertical scale turns view space size over distance into half viewport heights
+    cullData[0].lodScale = std::abs(view.projection[1][1]) * drawExtent.height * 0.5f;
+    cullData[0].lodErrorPixels = mSettings.lodErrorPixels;
+    cullData[0].lodHysteresis = mSettings.lodHysteresis;
+    cullData[0].forcedLod = mSettings.forcedLod;
+    // depth views have no camera to face or history to be occluded by; levels were selected for the scene view
+    for (uint32_t depthView = 1; depthView < viewCount; depthView++) {
+        cullData[depthView] = cullData[0];
+        cullData[depthView].viewProjection = depthViews[depthView - 1];
+        extract_frustum_planes(depthViews[depthView - 1], cullData[depthView].frustumPlanes);
+        cullData[depthView].flags = CULL_FRUSTUM;
+    }
+
+    vmaFlushAllocation(mAllocator, frame.instances.buffer.allocation, 0, drawCount * sizeof(GpuInstance));
+    vmaFlushAllocation(mAllocator, frame.lods.buffer.allocation, 0, lodCount * sizeof(GpuLod));
+    vmaFlushAllocation(mAllocator, frame.clusters.buffer.allocation, 0, clusterCount * sizeof(glm::uvec2));
+    vmaFlushAllocation(mAllocator, frame.commandTemplates.buffer.allocation, 0, drawCount * sizeof(VkDrawIndexedIndirectCommand));
+    vmaFlushAllocation(mAllocator, frame.cullData.allocation, 0, VK_WHOLE_SIZE);
+
+    if (!mHzbInitialized) {
+        // an HZB of far depth culls nothing, so the first frame's culling is well defined even before one was built
+        mHzbInitialized = true;
+        image_barrier(cmd, mHzbImage.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+            VK_PIPELINE_STAGE_2_NONE, 0, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    }
+
+    // reset the draws and counters of every view; the previous frame's HZB writes (and this frame's background) come
+    // before culling
+    vkCmdFillBuffer(cmd, frame.stats.buffer, 0, viewCount * sizeof(GpuStats), 0);
+    // slots that changed owner are reset in runs of consecutive slots; past MAX_LOD_RESET_RANGES runs (a scene swap) the
+    // whole buffer is, which costs the instances that kept their slot one frame of hysteresis
+    std::sort(mStaleLodSlots.begin(), mStaleLodSlots.end());
+    mStaleLodRanges.clear();
+    for (uint32_t slot : mStaleLodSlots) {
+        if (!mStaleLodRanges.empty() && mStaleLodRanges.back().x + mStaleLodRanges.back().y == slot) {
+            mStaleLodRanges.back().y++;
+        }
+        else {
+            mStaleLodRanges.push_back(glm::uvec2(slot, 1));
+        }
+    }
+    if (bResetLodState || mStaleLodRanges.size() > MAX_LOD_RESET_RANGES) {
+        vkCmdFillBuffer(cmd, mLodState.buffer.buffer, 0, VK_WHOLE_SIZE, INVALID_LOD);
+    }
+    else {
+        for (glm::uvec2 range : mStaleLodRanges) {
+            vkCmdFillBuffer(cmd, mLodState.buffer.buffer, range.x * sizeof(uint32_t), range.y * sizeof(uint32_t), INVALID_LOD);
+        }
+    }
+    VkBufferCopy commandCopies[1 + MAX_DEPTH_VIEWS];
+    for (uint32_t viewIndex = 0; viewIndex < viewCount; viewIndex++) {
+        commandCopies[viewIndex] = { 0, viewIndex * drawCount * sizeof(VkDrawIndexedIndirectCommand), drawCount * sizeof(VkDrawIndexedIndirectCommand) };
+    }
+    vkCmdCopyBuffer(cmd, frame.commandTemplates.buffer.buffer, frame.commands.buffer.buffer, viewCount, commandCopies);
+    // the fills and copies by their own stages: the whole transfer stage would include the previous frame's blit, which waits
+    // for its post passes
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_CLEAR_BIT | VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+    LodConstants lodConstants{};
+    lodConstants.cullData = frame.cullDataAddress;
+    lodConstants.instances = frame.instances.address;
+    lodConstants.lods = frame.lods.address;
+    lodConstants.lodState = mLodState.address;
+    lodConstants.stats = frame.statsAddress;
+    lodConstants.instanceCount = drawCount;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineCache->get_pipeline(mLodFamily, SpecializationData()));
+    vkCmdPushConstants(cmd, mLodPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LodConstants), &lodConstants);
+    // one invocation per instance, in groups of 64
+    vkCmdDispatch(cmd, (drawCount + 63) / 64, 1, 1);
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    VkDescriptorSet cullSet = frameDescriptors.allocate(mDevice, mCullSetLayout);
+    DescriptorWriter writer;
+    writer.write_image(0, mHzbImage.imageView, mHzbSampler, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    writer.update_set(mDevice, cullSet);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineCache->get_pipeline(mCullFamily, SpecializationData()));
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mCullPipelineLayout, 0, 1, &cullSet, 0, nullptr);
+
+    // one dispatch per view, each counting into its own section of the draws, indices and statistics; the views only
+    // read the level state, so they need no barrier between them
+    for (uint32_t viewIndex = 0; viewIndex < viewCount; viewIndex++) {
+        CullConstants cullConstants;
+        cullConstants.cullData = frame.cullDataAddress + viewIndex * sizeof(GpuCullData);
+        cullConstants.instances = frame.instances.address;
+        cullConstants.clusters = frame.clusters.address;
+        cullConstants.commands = frame.commands.address + viewIndex * drawCount * sizeof(VkDrawIndexedIndirectCommand);
+        cullConstants.outputIndices = frame.outputIndices.address + viewIndex * outputIndexCount * sizeof(uint32_t);
+        cullConstants.lodState = mLodState.address;
+        cullConstants.stats = frame.statsAddress + viewIndex * sizeof(GpuStats);
+        cullConstants.clusterCount = clusterCount;
+        cullConstants.groupsPerRow = std::min(clusterCount, MAX_GROUPS_PER_DIMENSION);
+
+        vkCmdPushConstants(cmd, mCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &cullConstants);
+        // one workgroup per cluster
+        vkCmdDispatch(cmd, cullConstants.groupsPerRow, (clusterCount + cullConstants.groupsPerRow - 1) / cullConstants.groupsPerRow, 1);
+    }
+
+    // compacted draws -> indirect and index reads; the background's writes to the draw image -> color attachment
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+    frame.bStatsPending = true;
+}
+
+void ClusterRenderer::record_depth_view(VkCommandBuffer cmd, uint32_t frameIndex, uint32_t viewIndex, VkExtent2D extent, float depthBiasConstant,
+    float depthBiasSlope) const
+{
+    const FrameResources& frame = mFrames[frameIndex];
+    if (frame.instanceCount == 0 || viewIndex >= frame.depthViewCount) {
+        return;
+    }
+
+    VkViewport viewport = { 0.f, 0.f, (float)extent.width, (float)extent.height, 0.f, 1.f };
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    VkRect2D scissor = { { 0, 0 }, extent };
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    vkCmdSetDepthBias(cmd, depthBiasConstant, 0.f, depthBiasSlope);
+
+    const GpuCullData* cullData = (const GpuCullData*)frame.cullData.info.pMappedData;
+    DepthConstants constants{};
+    constants.viewProjection = cullData[1 + viewIndex].viewProjection;
+    constants.instances = frame.instances.address;
+
+    // the scene view's sections come first
+    const uint32_t section = 1 + viewIndex;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineCache->get_pipeline(mDepthFamily, SpecializationData()));
+    vkCmdPushConstants(cmd, mDepthPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DepthConstants), &constants);
+    vkCmdBindIndexBuffer(cmd, frame.outputIndices.buffer.buffer, section * frame.outputIndexCount * sizeof(uint32_t), VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexedIndirect(cmd, frame.commands.buffer.buffer, section * frame.instanceCount * sizeof(VkDrawIndexedIndirectCommand),
+        frame.instanceCount, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void ClusterRenderer::draw(VkCommandBuffer cmd, uint32_t frameIndex, DescriptorAllocatorGrowable& frameDescriptors, const AllocatedImage& drawImage,
+    VkExtent2D drawExtent, const SceneView& view)
+{
+    FrameResources& frame = mFrames[frameIndex];
+    const uint32_t drawCount = frame.instanceCount;
+    mDepthDrawn = drawCount > 0;
+    if (drawCount == 0) {
+        return;
+    }
+
+    // last frame's HZB build read the depth image, and the post passes may have written its memory through an aliased
+    // target since; its contents are cleared anyway
+    image_barrier(cmd, mDepthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+
+    VkDescriptorSet meshSet = frameDescriptors.allocate(mDevice, mMeshSetLayout);
+    DescriptorWriter writer;
+    writer.write_image(0, view.shadows.atlasView, view.shadows.sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    writer.write_buffer(1, view.shadows.data, view.shadows.dataSize, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    writer.update_set(mDevice, meshSet);
+
+    VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL);
+    VkRenderingAttachmentInfo depthAttachment = vkinit::depth_attachment_info(mDepthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+    VkRenderingInfo renderInfo = vkinit::rendering_info(drawExtent, &colorAttachment, &depthAttachment);
+    vkCmdBeginRendering(cmd, &renderInfo);
+
+    VkViewport viewport = { 0.f, 0.f, (float)drawExtent.width, (float)drawExtent.height, 0.f, 1.f };
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    VkRect2D scissor = { { 0, 0 }, drawExtent };
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    glm::mat4 viewProjection = view.projection * view.view;
+    MeshConstants meshConstants{};
+    meshConstants.viewProjection = viewProjection;
+    meshConstants.instances = frame.instances.address;
+    meshConstants.lighting = view.lighting;
+    meshConstants.sunDirection = view.sunDirection;
+    meshConstants.hemisphereColors = glm::uvec3(glm::packHalf2x16(glm::vec2(view.skyColor.r, view.skyColor.g)),
+        glm::packHalf2x16(glm::vec2(view.skyColor.b, view.groundColor.r)), glm::packHalf2x16(glm::vec2(view.groundColor.g, view.groundColor.b)));
+    meshConstants.frameNumber = view.textures.frameNumber;
+    meshConstants.textureTable = view.textures.table;
+    meshConstants.textureFeedback = view.textures.feedback;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineCache->get_pipeline(mMeshFamily, SpecializationData()));
+    VkDescriptorSet meshSets[] = { meshSet, view.textures.heap };
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mMeshPipelineLayout, 0, 2, meshSets, 0, nullptr);
+    vkCmdPushConstants(cmd, mMeshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MeshConstants), &meshConstants);
+    vkCmdBindIndexBuffer(cmd, frame.outputIndices.buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexedIndirect(cmd, frame.commands.buffer.buffer, 0, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+
+    vkCmdEndRendering(cmd);
+
+    // the texture streamer reads the feedback back once the frame's fence has been waited on
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+
+    build_hzb(cmd, frameDescriptors, drawExtent);
+
+    mPreviousViewProjection = viewProjection;
+    mHistoryValid = true;
+}
+
+void ClusterRenderer::build_hzb(VkCommandBuffer cmd, DescriptorAllocatorGrowable& frameDescriptors, VkExtent2D drawExtent)
+{
+    // the depth becomes a sampled source; culling of this frame read the HZB before it is overwritten
+    image_barrier(cmd, mDepthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineCache->get_pipeline(mHzbFamily, SpecializationData()));
+
+    VkExtent2D sourceSize = drawExtent;
+    for (uint32_t mip = 0; mip < mHzbImage.mipLevels; mip++) {
+        VkExtent2D destinationSize = { std::max(mHzbImage.imageExtent.width >> mip, 1u), std::max(mHzbImage.imageExtent.height >> mip, 1u) };
+
+        VkDescriptorSet set = frameDescriptors.allocate(mDevice, mHzbSetLayout);
+        DescriptorWriter writer;
+        if (mip == 0) {
+            writer.write_image(0, mDepthImage.imageView, mHzbSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        }
+        else {
+            writer.write_image(0, mHzbMipViews[mip - 1], mHzbSampler, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        }
+        writer.write_image(1, mHzbMipViews[mip], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+        writer.update_set(mDevice, set);
+
+        HzbConstants constants = { { (int32_t)sourceSize.width, (int32_t)sourceSize.height }, { (int32_t)destinationSize.width, (int32_t)destinationSize.height } };
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mHzbPipelineLayout, 0, 1, &set, 0, nullptr);
+        vkCmdPushConstants(cmd, mHzbPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HzbConstants), &constants);
+        // 8x8 workgroups
+        vkCmdDispatch(cmd, (destinationSize.width + 7) / 8, (destinationSize.height + 7) / 8, 1);
+
+        memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+        sourceSize = destinationSize;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "entity_store.h"
+#include "vk_descriptors.h"
+#include "vk_geometry.h"
+#include "vk_pipelines.h"
+#include "vk_render_targets.h"
+#include "vk_types.h"
+
+// sun shadows as the scene pass samples them (CascadedShadowMaps::get_scene_shadows)
+struct SceneShadows {
+	// depth array with a layer per cascade, in SHADER_READ_ONLY_OPTIMAL, and a comparison sampler for it
+	VkImageView atlasView = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	// shaders/shadows.glsl ShadowData, bound as a uniform buffer
+	VkBuffer data = VK_NULL_HANDLE;
+	VkDeviceSize dataSize = 0;
+};
+
+// streamed material textures as the scene pass samples them (shaders/texture_streaming.glsl)
+struct SceneTextures {
+	// TextureStreamer::get_set, bound as set 1
+	VkDescriptorSet heap = VK_NULL_HANDLE;
+	// TextureStreamer::get_table_address and get_feedback_address of the frame slot being recorded
+	VkDeviceAddress table = 0;
+	VkDeviceAddress feedback = 0;
+	// TextureStreamer::get_frame_number
+	uint32_t frameNumber = 0;
+};
+
+// what the scene is seen from and lit by in a frame
+struct SceneView {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 cameraPosition;
+	// xyz: direction towards the sun, w: intensity
+	glm::vec4 sunDirection{ 0.4f, 0.8f, 0.3f, 3.f };
+	glm::vec4 skyColor{ 0.3f, 0.35f, 0.45f, 1.f };
+	glm::vec4 groundColor{ 0.15f, 0.12f, 0.1f, 1.f };
+	// point lights binned for this view (ClusteredLighting::update); required, an empty light list still has one
+	VkDeviceAddress lighting = 0;
+	// required like the lighting; shadows that were turned off still have a cleared atlas
+	SceneShadows shadows;
+	// required as well; instances whose mesh has no base color texture do not sample it
+	SceneTextures textures;
+};
+
+// GPU driven scene rendering at meshlet granularity, without mesh shaders, so it runs on any Vulkan 1.3 device (lavapipe
+// included). Every frame a compute pass tests each meshlet of every resident instance against the view frustum, its normal
+// cone (a cluster facing away as a whole) and a hierarchical depth buffer (HZB), then copies the indices of the clusters that
+// survive into a per-frame index buffer, counting them into one indirect draw per instance. All instances are then drawn with a
+// single vkCmdDrawIndexedIndirect.
+// Meshes carry a chain of simplified levels of detail. A compute pass before culling picks one level per instance by the
+// screen-space size of its simplification error, with hysteresis against popping; the chosen levels persist across frames
+// in a buffer indexed by scene instance. The cluster list holds every level's meshlets, and culling drops those of the levels
+// not chosen first thing.
+// The HZB is built from the frame's own depth after the scene pass and tested by the next frame with the view projection it
+// was rendered with, so clusters that become visible through disocclusion appear one frame late.
+// Depth only views (shadow cascades) are culled by the same pass against their own frustum, into sections of the frame's
+// indirect draw and index buffers that follow the scene view's, and draw the levels of detail the scene view chose
+class ClusterRenderer {
+public:
+	static constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+	// depth only views a frame can cull besides the scene view
+	static constexpr uint32_t MAX_DEPTH_VIEWS = 4;
+
+	struct Settings {
+		bool bFrustumCulling = true;
+		bool bBackfaceCulling = true;
+		bool bOcclusionCulling = true;
+		// how many pixels a level's simplification error may cover on screen before a finer level is drawn
+		float lodErrorPixels = 1.f;
+		// fraction of lodErrorPixels a coarser level has to stay below before an instance switches to it
+		float lodHysteresis = 0.25f;
+		// draw this level everywhere (clamped to each mesh's chain), or select by screen-space error if negative
+		int forcedLod = -1;
+	};
+
+	// of the most recent frame whose results are back on the CPU
+	struct Stats {
+		uint32_t instanceCount;
+		uint32_t clusterCount;
+		uint32_t frustumCulledClusters;
+		uint32_t backfaceCulledClusters;
+		uint32_t occlusionCulledClusters;
+		uint64_t totalTriangles;
+		uint64_t frustumCulledTriangles;
+		uint64_t backfaceCulledTriangles;
+		uint64_t occlusionCulledTriangles;
+		uint64_t drawnTriangles;
+		// per level of detail: instances that selected it, their triangles before and after cluster culling
+		uint32_t lodInstances[MAX_MESH_LODS];
+		uint64_t lodSelectedTriangles[MAX_MESH_LODS];
+		uint64_t lodDrawnTriangles[MAX_MESH_LODS];
+		// depth only views culled, and the triangles they drew together
+		uint32_t depthViewCount;
+		uint64_t depthViewDrawnTriangles;
+	};
+
+	Settings mSettings;
+
+	// depth and HZB are sized for the largest extent the draw image can have; declared before the pool is built
+	void declare_targets(RenderTargetPool& renderTargets, VkExtent3D drawImageExtent);
+	// textureSetLayout is TextureStreamer::get_set_layout, the material textures the scene pass samples
+	void init(VkDevice device, VmaAllocator allocator, PipelinePermutationCache& pipelineCache, const RenderTargetPool& renderTargets,
+		VkFormat drawImageFormat, VkDescriptorSetLayout textureSetLayout, uint32_t framesInFlight);
+	void destroy();
+
+	// call once the frame slot's fence has been waited on: collects the culling statistics that slot's frame wrote
+	void begin_frame(uint32_t frameIndex);
+	// selects levels of detail for and culls every instance whose mesh is resident, for the scene view and for each of
+	// depthViews (at most MAX_DEPTH_VIEWS view projections of depth only passes, tested against their frustum only).
+	// Instances are given as parallel arrays (e.g. an EntityStore's components): the entity, which keys the level of detail
+	// it drew last however the arrays are reordered, the mesh it places, or an index past the meshes for none, and its world
+	// transform. Pools must have been created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	void cull(VkCommandBuffer cmd, uint32_t frameIndex, DescriptorAllocatorGrowable& frameDescriptors, VkExtent2D drawExtent,
+		const SceneView& view, std::span<const glm::mat4> depthViews, const std::vector<std::unique_ptr<MeshAsset>>& meshes,
+		std::span<const Entity> instanceEntities, std::span<const uint32_t> instanceMeshes, std::span<const glm::mat4> instanceTransforms,
+		const GeometryBufferPool& vertexPool,
+		const GeometryBufferPool& indexPool, const GeometryBufferPool& meshletPool);
+	// records the draws of depth view viewIndex of the frame's cull into cmd, inside rendering begun by the caller with a
+	// DEPTH_FORMAT attachment of the given extent. Only reads what cull left behind, so several views may be recorded at once
+	// on different threads (into command buffers from pools of their own)
+	void record_depth_view(VkCommandBuffer cmd, uint32_t frameIndex, uint32_t viewIndex, VkExtent2D extent, float depthBiasConstant,
+		float depthBiasSlope) const;
+	// draws what the frame's cull kept of the scene view over drawImage, which must be in GENERAL and stays there, then
+	// builds the HZB the next frame culls against. The texture feedback it writes is made visible to the host
+	void draw(VkCommandBuffer cmd, uint32_t frameIndex, DescriptorAllocatorGrowable& frameDescriptors, const AllocatedImage& drawImage,
+		VkExtent2D drawExtent, const SceneView& view);
+	// the depth the frame's draw rendered, in SHADER_READ_ONLY_OPTIMAL for the rest of the scene pass; null if it drew nothing
+	VkImageView get_scene_depth() const { return mDepthDrawn ? mDepthImage.imageView : VK_NULL_HANDLE; }
+	// the next frame skips occlusion culling (e.g. after a camera cut, when last frame's depth says nothing about this one)
+	void reset_history() { mHistoryValid = false; }
+
+	Stats get_stats() const { return mStats; }
+
+private:
+	// shaders/scene_geometry.glsl Instance
+	struct GpuInstance {
+		glm::mat4 model;
+		glm::vec4 boundingSphere;
+		VkDeviceAddress vertices;
+		VkDeviceAddress indices;
+		VkDeviceAddress meshlets;
+		uint32_t firstLod;
+		uint32_t lodCount;
+		uint32_t outputFirstIndex;
+		float maxScale;
+		uint32_t lodSlot;
+		uint32_t baseColorTexture;
+		uint32_t baseColorFactor;
+		uint32_t padding[3];
+	};
+	static_assert(sizeof(GpuInstance) == 144);
+
+	// shaders/cluster_culling.glsl Lod
+	struct GpuLod {
+		float error;
+		uint32_t triangleCount;
+	};
+
+	// shaders/cluster_culling.glsl CullData
+	struct GpuCullData {
+		glm::mat4 viewProjection;
+		glm::mat4 previousViewProjection;
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 cameraPosition;
+		glm::vec2 hzbSize;
+		uint32_t hzbMipCount;
+		uint32_t flags;
+		float lodScale;
+		float lodErrorPixels;
+		float lodHysteresis;
+		int32_t forcedLod;
+	};
+
+	// shaders/cluster_culling.glsl CullStats
+	struct GpuStats {
+		uint32_t frustumCulledClusters;
+		uint32_t backfaceCulledClusters;
+		uint32_t occlusionCulledClusters;
+		uint32_t frustumCulledTriangles;
+		uint32_t backfaceCulledTriangles;
+		uint32_t occlusionCulledTriangles;
+		uint32_t drawnTriangles;
+		uint32_t padding;
+		uint32_t lodInstances[MAX_MESH_LODS];
+		uint32_t lodSelectedTriangles[MAX_MESH_LODS];
+		uint32_t lodDrawnTriangles[MAX_MESH_LODS];
+	};
+
+	struct LodConstants {
+		VkDeviceAddress cullData;
+		VkDeviceAddress instances;
+		VkDeviceAddress lods;
+		VkDeviceAddress lodState;
+		VkDeviceAddress stats;
+		uint32_t instanceCount;
+		uint32_t padding;
+	};
+
+	struct CullConstants {
+		VkDeviceAddress cullData;
+		VkDeviceAddress instances;
+		VkDeviceAddress clusters;
+		VkDeviceAddress commands;
+		VkDeviceAddress outputIndices;
+		VkDeviceAddress lodState;
+		VkDeviceAddress stats;
+		uint32_t clusterCount;
+		uint32_t groupsPerRow;
+	};
+
+	struct MeshConstants {
+		glm::mat4 viewProjection;
+		VkDeviceAddress instances;
+		VkDeviceAddress lighting;
+		glm::vec4 sunDirection;
+		// sky then ground color as six halfs, which leaves room for the texture streamer's addresses
+		glm::uvec3 hemisphereColors;
+		uint32_t frameNumber;
+		VkDeviceAddress textureTable;
+		VkDeviceAddress textureFeedback;
+	};
+	static_assert(sizeof(MeshConstants) == 128, "push constants are guaranteed up to 128 bytes");
+
+	struct DepthConstants {
+		glm::mat4 viewProjection;
+		VkDeviceAddress instances;
+		VkDeviceAddress padding;
+	};
+
+	struct HzbConstants {
+		int32_t sourceSize[2];
+		int32_t destinationSize[2];
+	};
+
+	// a buffer that grows (never shrinks) to what a frame needs; only touched once the frame slot's fence was waited on
+	struct FrameBuffer {
+		AllocatedBuffer buffer{};
+		VkDeviceSize capacity = 0;
+		VkDeviceAddress address = 0;
+	};
+
+	struct FrameResources {
+		FrameBuffer instances; // GpuInstance per drawn instance, host written
+		FrameBuffer lods; // GpuLod per level of every drawn mesh, host written
+		FrameBuffer clusters; // (instance, meshlet) pairs, host written
+		FrameBuffer commandTemplates; // draw commands with an index count of 0, host written
+		// the scene view's section, then one per depth view
+		FrameBuffer commands; // indirect draws, counted up by culling
+		FrameBuffer outputIndices; // compacted indices of the visible clusters
+		// GpuCullData and GpuStats of the scene view, then of each depth view
+		AllocatedBuffer cullData;
+		VkDeviceAddress cullDataAddress;
+		AllocatedBuffer stats;
+		VkDeviceAddress statsAddress;
+		// of the frame last culled in this slot, to find its sections and complete its statistics; instances are its draws
+		uint32_t instanceCount = 0;
+		uint64_t outputIndexCount = 0;
+		uint32_t depthViewCount = 0;
+		uint32_t clusterCount = 0;
+		uint64_t totalTriangles = 0;
+		bool bStatsPending = false;
+	};
+
+	// a buffer shared by all frame slots that was replaced while frames in flight may still use it
+	struct RetiredBuffer {
+		FrameBuffer buffer;
+		// destroyed when this slot's fence has been waited on next
+		uint32_t frameIndex;
+	};
+
+	void init_resources(const RenderTargetPool& renderTargets);
+	void init_pipelines(VkFormat drawImageFormat, VkDescriptorSetLayout textureSetLayout);
+	void ensure_capacity(FrameBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+	void destroy_frame_buffer(FrameBuffer& buffer);
+	void build_hzb(VkCommandBuffer cmd, DescriptorAllocatorGrowable& frameDescriptors, VkExtent2D drawExtent);
+
+	VkDevice mDevice;
+	VmaAllocator mAllocator;
+	PipelinePermutationCache* mPipelineCache;
+
+	VkDescriptorSetLayout mCullSetLayout;
+	VkPipelineLayout mCullPipelineLayout;
+	uint32_t mCullFamily;
+	VkPipelineLayout mLodPipelineLayout;
+	uint32_t mLodFamily;
+	VkDescriptorSetLayout mHzbSetLayout;
+	VkPipelineLayout mHzbPipelineLayout;
+	uint32_t mHzbFamily;
+	// shadows of the scene pass
+	VkDescriptorSetLayout mMeshSetLayout;
+	VkPipelineLayout mMeshPipelineLayout;
+	uint32_t mMeshFamily;
+	VkPipelineLayout mDepthPipelineLayout;
+	uint32_t mDepthFamily;
+
+	// both owned by the render target pool; the depth only lives through the scene pass, so its memory is shared
+	RenderTargetPool::Handle mDepthTarget;
+	RenderTargetPool::Handle mHzbTarget;
+	AllocatedImage mDepthImage;
+	// whether the last draw rendered the depth at all
+	bool mDepthDrawn = false;
+	// power of two sized (rounded down from the draw image) farthest depth pyramid; one view per mip for writes and as
+	// the next level's source, one over all mips for culling
+	AllocatedImage mHzbImage;
+	std::vector<VkImageView> mHzbMipViews;
+	VkSampler mHzbSampler;
+	bool mHzbInitialized = false;
+	bool mHistoryValid = false;
+	glm::mat4 mPreviousViewProjection{ 1.f };
+
+	// level of detail each instance drew last (INVALID_LOD in shaders if none yet), written by one frame, read by the next.
+	// Indexed by entity slot; mLodStateOwners holds the entity whose level each slot holds, so a slot reused by a new
+	// entity starts over rather than inheriting the level of the one destroyed
+	FrameBuffer mLodState;
+	std::vector<uint32_t> mLodStateOwners;
+	// scratch: slots whose owner changed this frame, and their runs of consecutive slots (first, count)
+	std::vector<uint32_t> mStaleLodSlots;
+	std::vector<glm::uvec2> mStaleLodRanges;
+	std::vector<RetiredBuffer> mRetiredBuffers;
+	// scratch: where each mesh's levels start in the frame's level table
+	std::vector<uint32_t> mMeshLodOffsets;
+
+	std::vector<FrameResources> mFrames;
+	Stats mStats{};
+};
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include "vk_check_macro.h"
+#include "vk_clustered_lighting.h"
+#include "vk_initializers.h"
+#include "vk_utils.h"
+
+namespace {
+    // shaders/light_binning.comp local_size_x
+    constexpr uint32_t BINNING_GROUP_SIZE = 64;
+    static_assert(ClusteredLighting::CLUSTER_COUNT % BINNING_GROUP_SIZE == 0);
+
+    VkDeviceAddress get_buffer_address(VkDevice device, VkBuffer buffer)
+    {
+        VkBufferDeviceAddressInfo addressInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+        addressInfo.buffer = buffer;
+        return vkGetBufferDeviceAddress(device, &addressInfo);
+    }
+
+    // shaders/clustered_lighting.glsl get_cluster_bounds: depth runs along the view direction (-z in view space)
+    struct ClusterBounds {
+        glm::vec3 boxMin;
+        glm::vec3 boxMax;
+    };
+
+    float get_slice_depth(const ClusteredLighting::ViewParameters& view, uint32_t slice)
+    {
+        return view.nearPlane * std::pow(view.farPlane / view.nearPlane, (float)slice / (float)ClusteredLighting::GRID_Z);
+    }
+
+    ClusterBounds get_cluster_bounds(const ClusteredLighting::ViewParameters& view, uint32_t x, uint32_t y, float nearDepth, float farDepth)
+    {
+        // a point at NDC xy and depth d lies at view space xy = ndc * d / projectionScale
+        glm::vec2 ndcMin = glm::vec2(x, y) / glm::vec2(ClusteredLighting::GRID_X, ClusteredLighting::GRID_Y) * 2.f - 1.f;
+        glm::vec2 ndcMax = glm::vec2(x + 1, y + 1) / glm::vec2(ClusteredLighting::GRID_X, ClusteredLighting::GRID_Y) * 2.f - 1.f;
+        glm::vec2 corners[4] = { ndcMin * nearDepth / view.projectionScale, ndcMax * nearDepth / view.projectionScale,
+            ndcMin * farDepth / view.projectionScale, ndcMax * farDepth / view.projectionScale };
+
+        ClusterBounds bounds;
+        glm::vec2 cornerMin = glm::min(glm::min(corners[0], corners[1]), glm::min(corners[2], corners[3]));
+        glm::vec2 cornerMax = glm::max(glm::max(corners[0], corners[1]), glm::max(corners[2], corners[3]));
+        bounds.boxMin = glm::vec3(cornerMin, nearDepth);
+        bounds.boxMax = glm::vec3(cornerMax, farDepth);
+        return bounds;
+    }
+
+    bool sphere_intersects_box(const glm::vec4& sphere, const ClusterBounds& bounds)
+    {
+        glm::vec3 offset = glm::vec3(sphere) - glm::clamp(glm::vec3(sphere), bounds.boxMin, bounds.boxMax);
+        return glm::dot(offset, offset) <= sphere.w * sphere.w;
+    }
+}
+
+void ClusteredLighting::init(VkDevice device, VmaAllocator allocator, PipelinePermutationCache& pipelineCache, JobSystem* jobSystem,
+    uint32_t framesInFlight)
+{
+    mDevice = device;
+    mAllocator = allocator;
+    mPipelineCache = &pipelineCache;
+    mJobSystem = jobSystem;
+
+    VkPushConstantRange binningPushConstants{};
+    binningPushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    binningPushConstants.offset = 0;
+    binningPushConstants.size = sizeof(BinningConstants);
+
+    VkPipelineLayoutCreateInfo binningLayoutInfo = vkinit::pipeline_layout_create_info();
+    binningLayoutInfo.pushConstantRangeCount = 1;
+    binningLayoutInfo.pPushConstantRanges = &binningPushConstants;
+    VK_CHECK(vkCreatePipelineLayout(mDevice, &binningLayoutInfo, nullptr, &mBinningPipelineLayout));
+
+    uint64_t shaderHash;
+    ComputePipelineBuilder computeBuilder;
+    computeBuilder.set_shader(mPipelineCache->load_shader("light_binning.comp.spv", &shaderHash), shaderHash);
+    computeBuilder.set_layout(mBinningPipelineLayout);
+    mBinningFamily = mPipelineCache->register_compute_family("light binning", computeBuilder);
+
+    // the lists do not depend on the light count, so the GPU written ones are allocated once up front
+    VkBufferUsageFlags listUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    mFrames.resize(framesInFlight);
+    for (FrameResources& frame : mFrames) {
+        frame.lightingData = vkutil::create_buffer(mAllocator, sizeof(GpuLightingData),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        frame.lightingDataAddress = get_buffer_address(mDevice, frame.lightingData.buffer);
+        ensure_capacity(frame.counts, CLUSTER_COUNT * sizeof(uint32_t), listUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+        ensure_capacity(frame.indices, CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t), listUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+    }
+}
+
+void ClusteredLighting::destroy()
+{
+    for (FrameResources& frame : mFrames) {
+        vkutil::destroy_buffer(mAllocator, frame.lightingData);
+        destroy_frame_buffer(frame.lights);
+        destroy_frame_buffer(frame.counts);
+        destroy_frame_buffer(frame.indices);
+        destroy_frame_buffer(frame.hostCounts);
+        destroy_frame_buffer(frame.hostIndices);
+    }
+    mFrames.clear();
+
+    vkDestroyPipelineLayout(mDevice, mBinningPipelineLayout, nullptr);
+}
+
+void ClusteredLighting::ensure_capacity(FrameBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage)
+{
+    if (size <= buffer.capacity) {
+        return;
+    }
+    destroy_frame_buffer(buffer);
+    buffer.capacity = std::max(size + size / 2, VkDeviceSize(4096));
+    buffer.buffer = vkutil::create_buffer(mAllocator, buffer.capacity, usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, memoryUsage);
+    buffer.address = get_buffer_address(mDevice, buffer.buffer.buffer);
+}
+
+void ClusteredLighting::destroy_frame_buffer(FrameBuffer& buffer)
+{
+    if (buffer.capacity > 0) {
+        vkutil::destroy_buffer(mAllocator, buffer.buffer);
+    }
+    buffer = FrameBuffer();
+}
+
+VkDeviceAddress ClusteredLighting::update(VkCommandBuffer cmd, uint32_t frameIndex, const ViewParameters& view, VkExtent2D drawExtent,
+    std::span<const PointLight> lights)
+{
+    FrameResources& frame = mFrames[frameIndex];
+    uint32_t lightCount = (uint32_t)lights.size();
+
+    mStats = {};
+    mStats.lightCount = lightCount;
+    mStats.binning = mSettings.binning;
+
+    ensure_capacity(frame.lights, std::max(lightCount, 1u) * sizeof(PointLight), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    if (lightCount > 0) {
+        std::memcpy(frame.lights.buffer.info.pMappedData, lights.data(), lights.size_bytes());
+    }
+
+    // slice = log(depth / near) / log(far / near) * GRID_Z, split into a scale and bias of log(depth)
+    float logDepthRange = std::log(view.farPlane / view.nearPlane);
+
+    GpuLightingData* lightingData = (GpuLightingData*)frame.lightingData.info.pMappedData;
+    lightingData->view = view.view;
+    lightingData->lights = frame.lights.address;
+    lightingData->projectionScale = view.projectionScale;
+    lightingData->tileSize = glm::vec2(std::max(drawExtent.width, 1u), std::max(drawExtent.height, 1u)) / glm::vec2(GRID_X, GRID_Y);
+    lightingData->sliceScale = GRID_Z / logDepthRange;
+    lightingData->sliceBias = -(float)GRID_Z * std::log(view.nearPlane) / logDepthRange;
+    lightingData->nearPlane = view.nearPlane;
+    lightingData->farPlane = view.farPlane;
+    lightingData->lightCount = lightCount;
+
+    if (mSettings.binning == BinningMode::Cpu) {
+        ensure_capacity(frame.hostCounts, CLUSTER_COUNT * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        ensure_capacity(frame.hostIndices, CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+        auto binningStart = std::chrono::steady_clock::now();
+        mStats.binningStats = bin_lights(view, lights, mJobSystem, (uint32_t*)frame.hostCounts.buffer.info.pMappedData,
+            (uint32_t*)frame.hostIndices.buffer.info.pMappedData);
+        mStats.cpuBinningTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - binningStart).count();
+
+        // host writes are made visible by the submission
+        lightingData->counts = frame.hostCounts.address;
+        lightingData->indices = frame.hostIndices.address;
+        return frame.lightingDataAddress;
+    }
+
+    lightingData->counts = frame.counts.address;
+    lightingData->indices = frame.indices.address;
+
+    BinningConstants constants;
+    constants.lighting = frame.lightingDataAddress;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineCache->get_pipeline(mBinningFamily, SpecializationData()));
+    vkCmdPushConstants(cmd, mBinningPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BinningConstants), &constants);
+    // one invocation per froxel
+    vkCmdDispatch(cmd, CLUSTER_COUNT / BINNING_GROUP_SIZE, 1, 1);
+
+    // the lists are read by the scene's fragment shader; the slot's previous frame read its lists before the fence signaled
+    VkMemoryBarrier2 memoryBarrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+    VkDependencyInfo depInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &memoryBarrier;
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+
+    return frame.lightingDataAddress;
+}
+
+ClusteredLighting::BinningStats ClusteredLighting::bin_lights(const ViewParameters& view, std::span<const PointLight> lights,
+    JobSystem* jobSystem, uint32_t* outCounts, uint32_t* outIndices)
+{
+    // lights go to view space once, as (x, y, depth, radius)
+    std::vector<glm::vec4> viewLights(lights.size());
+    auto transformLights = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t light = begin; light < end; light++) {
+            glm::vec4 position = view.view * glm::vec4(glm::vec3(lights[light].positionRadius), 1.f);
+            viewLights[light] = glm::vec4(position.x, position.y, -position.z, lights[light].positionRadius.w);
+        }
+    };
+
+    // one depth slice per job: only the lights whose depth range reaches the slice are tested against its tiles, and each
+    // froxel's list is filled in light order, the same as the GPU's. Counts are kept on the stack until the slice is done,
+    // since the output may be write combined memory
+    std::atomic<uint64_t> lightReferences{ 0 };
+    std::atomic<uint64_t> droppedReferences{ 0 };
+    std::vector<uint32_t> sliceMaxLights(GRID_Z, 0);
+    auto binSlices = [&](uint32_t begin, uint32_t end) {
+        std::vector<uint32_t> candidates;
+        ClusterBounds tileBounds[GRID_X * GRID_Y];
+        uint32_t tileLights[GRID_X * GRID_Y];
+        for (uint32_t slice = begin; slice < end; slice++) {
+            float nearDepth = get_slice_depth(view, slice);
+            float farDepth = get_slice_depth(view, slice + 1);
+
+            candidates.clear();
+            for (uint32_t light = 0; light < viewLights.size(); light++) {
+                if (viewLights[light].z + viewLights[light].w >= nearDepth && viewLights[light].z - viewLights[light].w <= farDepth) {
+                    candidates.push_back(light);
+                }
+            }
+
+            for (uint32_t tile = 0; tile < GRID_X * GRID_Y; tile++) {
+                tileBounds[tile] = get_cluster_bounds(view, tile % GRID_X, tile / GRID_X, nearDepth, farDepth);
+                tileLights[tile] = 0;
+            }
+
+            uint32_t firstCluster = slice * GRID_X * GRID_Y;
+            for (uint32_t light : candidates) {
+                for (uint32_t tile = 0; tile < GRID_X * GRID_Y; tile++) {
+                    if (!sphere_intersects_box(viewLights[light], tileBounds[tile])) {
+                        continue;
+                    }
+                    if (tileLights[tile] < MAX_LIGHTS_PER_CLUSTER) {
+                        outIndices[(firstCluster + tile) * MAX_LIGHTS_PER_CLUSTER + tileLights[tile]] = light;
+                    }
+                    tileLights[tile]++;
+                }
+            }
+
+            uint64_t references = 0;
+            uint64_t dropped = 0;
+            for (uint32_t tile = 0; tile < GRID_X * GRID_Y; tile++) {
+                outCounts[firstCluster + tile] = std::min(tileLights[tile], MAX_LIGHTS_PER_CLUSTER);
+                references += tileLights[tile];
+                dropped += tileLights[tile] - std::min(tileLights[tile], MAX_LIGHTS_PER_CLUSTER);
+                sliceMaxLights[slice] = std::max(sliceMaxLights[slice], tileLights[tile]);
+            }
+            lightReferences += references;
+            droppedReferences += dropped;
+        }
+    };
+
+    if (jobSystem) {
+        jobSystem->parallel_for((uint32_t)lights.size(), 1024, transformLights);
+        jobSystem->parallel_for(GRID_Z, 1, binSlices);
+    }
+    else {
+        transformLights(0, (uint32_t)lights.size());
+        binSlices(0, GRID_Z);
+    }
+
+    BinningStats stats{};
+    stats.lightReferences = lightReferences;
+    stats.droppedReferences = droppedReferences;
+    stats.maxLightsPerCluster = *std::max_element(sliceMaxLights.begin(), sliceMaxLights.end());
+    return stats;
+}
+
+std::vector<PointLight> ClusteredLighting::generate_random_lights(uint32_t count, glm::vec3 boundsMin, glm::vec3 boundsMax, float radius,
+    float intensity, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    std::vector<PointLight> lights(count);
+    for (PointLight& light : lights) {
+        glm::vec3 position = glm::mix(boundsMin, boundsMax, glm::vec3(unit(random), unit(random), unit(random)));
+        // a fully saturated hue, lifted towards white a little
+        float hue = unit(random) * 6.f;
+        glm::vec3 color = glm::clamp(glm::vec3(std::abs(hue - 3.f) - 1.f, 2.f - std::abs(hue - 2.f), 2.f - std::abs(hue - 4.f)), 0.f, 1.f);
+        light.positionRadius = glm::vec4(position, radius);
+        light.colorIntensity = glm::vec4(glm::mix(color, glm::vec3(1.f), 0.25f), intensity);
+    }
+    return lights;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "job_system.h"
+#include "vk_pipelines.h"
+#include "vk_types.h"
+
+// shaders/clustered_lighting.glsl PointLight
+struct PointLight {
+	// xyz: world position, w: radius past which the light adds nothing
+	glm::vec4 positionRadius;
+	// rgb: linear color, a: intensity
+	glm::vec4 colorIntensity;
+};
+
+// Clustered forward lighting. The view frustum is cut into froxels (GRID_X by GRID_Y screen tiles, each split into GRID_Z
+// depth slices spaced exponentially between the near and far plane), and every frame each froxel gets the list of point
+// lights whose sphere of influence touches its view space box. The scene's fragment shader looks up the froxel it falls
+// in and shades with the lights listed there only, so what a pixel costs follows the lights around it rather than every
+// light in the scene.
+// Lists are built by a compute pass on the graphics queue just before the scene pass, or on the CPU over the job system,
+// written straight into host visible memory; the CPU path is there to compare against and for devices on which the pass
+// is the bottleneck. A froxel lists MAX_LIGHTS_PER_CLUSTER lights at most, the rest are dropped
+class ClusteredLighting {
+public:
+	// shaders/clustered_lighting.glsl GRID_X, GRID_Y, GRID_Z and MAX_LIGHTS_PER_CLUSTER
+	static constexpr uint32_t GRID_X = 16;
+	static constexpr uint32_t GRID_Y = 9;
+	static constexpr uint32_t GRID_Z = 24;
+	static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+
+	enum class BinningMode : uint32_t {
+		Gpu = 0,
+		Cpu
+	};
+
+	struct Settings {
+		BinningMode binning = BinningMode::Gpu;
+	};
+
+	// what the froxels are cut from
+	struct ViewParameters {
+		glm::mat4 view;
+		// the projection's [0][0] and [1][1], which take view space x and y over depth to NDC
+		glm::vec2 projectionScale;
+		float nearPlane;
+		float farPlane;
+	};
+
+	// of a CPU binning
+	struct BinningStats {
+		// lights in the fullest froxel, before dropping
+		uint32_t maxLightsPerCluster;
+		// light references over all froxels, and those that did not fit their froxel's list
+		uint64_t lightReferences;
+		uint64_t droppedReferences;
+	};
+
+	// of the most recent frame; the binning stats are only filled in by CPU binning
+	struct Stats {
+		uint32_t lightCount;
+		BinningMode binning;
+		float cpuBinningTime; // ms
+		BinningStats binningStats;
+	};
+
+	Settings mSettings;
+
+	void init(VkDevice device, VmaAllocator allocator, PipelinePermutationCache& pipelineCache, JobSystem* jobSystem, uint32_t framesInFlight);
+	void destroy();
+
+	// bins the frame's lights and returns the address of its lighting data (shaders/clustered_lighting.glsl LightingData)
+	// for the scene's fragment shader. GPU binning is recorded into cmd, followed by a barrier to fragment shader reads.
+	// Call once per frame, after the frame slot's fence has been waited on and before the scene pass
+	VkDeviceAddress update(VkCommandBuffer cmd, uint32_t frameIndex, const ViewParameters& view, VkExtent2D drawExtent,
+		std::span<const PointLight> lights);
+
+	Stats get_stats() const { return mStats; }
+
+	// the CPU binning on its own, which needs no device (benchmarks): outCounts takes CLUSTER_COUNT counts and outIndices
+	// MAX_LIGHTS_PER_CLUSTER indices per froxel. Runs on the calling thread if jobSystem is null
+	static BinningStats bin_lights(const ViewParameters& view, std::span<const PointLight> lights, JobSystem* jobSystem,
+		uint32_t* outCounts, uint32_t* outIndices);
+	// count lights scattered uniformly through a box, with random hues, for tests and benchmarks
+	static std::vector<PointLight> generate_random_lights(uint32_t count, glm::vec3 boundsMin, glm::vec3 boundsMax, float radius,
+		float intensity, uint32_t seed);
+
+private:
+	// shaders/clustered_lighting.glsl LightingData
+	struct GpuLightingData {
+		glm::mat4 view;
+		VkDeviceAddress lights;
+		VkDeviceAddress counts;
+		VkDeviceAddress indices;
+		glm::vec2 projectionScale;
+		glm::vec2 tileSize;
+		float sliceScale;
+		float sliceBias;
+		float nearPlane;
+		float farPlane;
+		uint32_t lightCount;
+		uint32_t padding;
+	};
+	static_assert(sizeof(GpuLightingData) == 128);
+
+	struct BinningConstants {
+		VkDeviceAddress lighting;
+	};
+
+	// a buffer that grows (never shrinks) to what a frame needs; only touched once the frame slot's fence was waited on
+	struct FrameBuffer {
+		AllocatedBuffer buffer{};
+		VkDeviceSize capacity = 0;
+		VkDeviceAddress address = 0;
+	};
+
+	struct FrameResources {
+		AllocatedBuffer lightingData; // host written
+		VkDeviceAddress lightingDataAddress;
+		FrameBuffer lights; // host written
+		// lists written by GPU binning
+		FrameBuffer counts;
+		FrameBuffer indices;
+		// lists written by CPU binning, created the first time it runs
+		FrameBuffer hostCounts;
+		FrameBuffer hostIndices;
+	};
+
+	void ensure_capacity(FrameBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+	void destroy_frame_buffer(FrameBuffer& buffer);
+
+	VkDevice mDevice;
+	VmaAllocator mAllocator;
+	PipelinePermutationCache* mPipelineCache;
+	JobSystem* mJobSystem;
+
+	VkPipelineLayout mBinningPipelineLayout;
+	uint32_t mBinningFamily;
+
+	std::vector<FrameResources> mFrames;
+	Stats mStats{};
+};
\ No newline at end of file
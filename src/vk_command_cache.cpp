@@ -0,0 +1,65 @@
+#include "vk_check_macro.h"
+#include "vk_command_cache.h"
+#include "vk_initializers.h"
+
+void StaticCommandCache::init(VkDevice device, uint32_t queueFamily, uint32_t framesInFlight)
+{
+    mDevice = device;
+    mFramesInFlight = framesInFlight;
+
+    // buffers are reset one at a time, whenever their key changes
+    VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(queueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mCommandPool));
+}
+
+void StaticCommandCache::destroy()
+{
+    // frees every pass's command buffers with it
+    vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+    mPasses.clear();
+}
+
+StaticCommandCache::PassId StaticCommandCache::register_pass(const std::string& name)
+{
+    Pass pass;
+    pass.name = name;
+    pass.buffers.resize(mFramesInFlight);
+    for (CachedBuffer& buffer : pass.buffers) {
+        VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(mCommandPool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(mDevice, &allocInfo, &buffer.commandBuffer));
+        buffer.key = 0;
+        buffer.bValid = false;
+    }
+    mPasses.push_back(std::move(pass));
+    return (PassId)(mPasses.size() - 1);
+}
+
+VkCommandBuffer StaticCommandCache::get(PassId pass, uint32_t frameIndex, uint64_t key, const RecordFunction& record)
+{
+    CachedBuffer& buffer = mPasses[pass].buffers[frameIndex];
+    if (buffer.bValid && buffer.key == key) {
+        mStats.reusedPasses++;
+        return buffer.commandBuffer;
+    }
+
+    // submitted many times, but never while a submission of it is pending (the frame slot's fence guards it)
+    VK_CHECK(vkResetCommandBuffer(buffer.commandBuffer, 0));
+    VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(0);
+    VK_CHECK(vkBeginCommandBuffer(buffer.commandBuffer, &beginInfo));
+    record(buffer.commandBuffer);
+    VK_CHECK(vkEndCommandBuffer(buffer.commandBuffer));
+
+    buffer.key = key;
+    buffer.bValid = true;
+    mStats.recordedPasses++;
+    return buffer.commandBuffer;
+}
+
+void StaticCommandCache::invalidate()
+{
+    for (Pass& pass : mPasses) {
+        for (CachedBuffer& buffer : pass.buffers) {
+            buffer.bValid = false;
+        }
+    }
+}
\ No newline at end of file
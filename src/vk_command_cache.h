@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <volk.h>
+
+// Primary command buffers of static passes, whose commands only change when something they were recorded from does.
+// A pass is recorded once and then submitted as is every frame, chained in front of (or behind) the frame's dynamically
+// recorded command buffers in the same submission, until its dependency key changes: a hash of everything the recording
+// reads, such as the extent, the pipeline handles (a permutation that finished compiling replaces its fallback) or a scene
+// version. Each pass keeps a command buffer per frame in flight, only ever touched by its own frame slot after the slot's
+// fence was waited on, so a buffer is never re-recorded while the GPU may still execute it.
+// Cached buffers must not depend on per-frame state: no sets from the frame descriptor allocators, no queries (the
+// profilers hand out and reset theirs every frame) and no buffers that are rewritten every frame
+class StaticCommandCache {
+public:
+	using PassId = uint32_t;
+	using RecordFunction = std::function<void(VkCommandBuffer)>;
+
+	struct Settings {
+		// off, the caller records static passes into its own command buffers every frame instead (to compare the cost)
+		bool bEnabled = true;
+	};
+
+	// of the frame since the last begin_frame
+	struct Stats {
+		uint32_t reusedPasses;
+		uint32_t recordedPasses;
+	};
+
+	Settings mSettings;
+
+	// command buffers are allocated for queueFamily
+	void init(VkDevice device, uint32_t queueFamily, uint32_t framesInFlight);
+	void destroy();
+
+	PassId register_pass(const std::string& name);
+	// resets the statistics; call once per frame
+	void begin_frame() { mStats = {}; }
+	// the pass's command buffer for the frame slot, whose fence must have been waited on; record fills it (between begin
+	// and end, which the cache calls) if the buffer was never recorded or recorded with another key
+	VkCommandBuffer get(PassId pass, uint32_t frameIndex, uint64_t key, const RecordFunction& record);
+	// every pass records again the next time it is requested
+	void invalidate();
+
+	Stats get_stats() const { return mStats; }
+
+private:
+	struct CachedBuffer {
+		VkCommandBuffer commandBuffer;
+		uint64_t key;
+		bool bValid;
+	};
+
+	struct Pass {
+		std::string name;
+		// one per frame in flight
+		std::vector<CachedBuffer> buffers;
+	};
+
+	VkDevice mDevice;
+	uint32_t mFramesInFlight;
+	VkCommandPool mCommandPool;
+	std::vector<Pass> mPasses;
+	Stats mStats{};
+};
\ No newline at end of file
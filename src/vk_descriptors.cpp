@@ -28,9 +28,9 @@ VkDescriptorPool DescriptorAllocatorGrowable::get_descriptor_allocation_pool(VkD
     }
     else {
         // we must allocate a new pool when all pools are full, with a larger number of max sets allocatable by the pool
-        mSetsPerPool = mSetsPerPool * GROWTH_FACTOR;
-        if (mSetsPerPool > CAP_SETS_IN_POOL) {
-            mSetsPerPool = CAP_SETS_IN_POOL;
+        mSetsPerPool = (uint32_t)(mSetsPerPool * mGrowthFactor);
+        if (mSetsPerPool > mCapSetsInPool) {
+            mSetsPerPool = mCapSetsInPool;
         }
 
         pool = create_pool(device, mSetsPerPool, mPoolRatios);
@@ -153,3 +153,55 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device, VkShaderSt
 
     return set;
 }
+
+void DescriptorWriter::write_image(uint32_t binding, VkImageView image, VkSampler sampler, VkImageLayout layout, VkDescriptorType type)
+{
+    VkDescriptorImageInfo& info = imageInfos.emplace_back(VkDescriptorImageInfo{
+        .sampler = sampler,
+        .imageView = image,
+        .imageLayout = layout
+    });
+
+    VkWriteDescriptorSet write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstBinding = binding;
+    write.dstSet = VK_NULL_HANDLE; // left empty until update_set
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pImageInfo = &info;
+
+    writes.push_back(write);
+}
+
+void DescriptorWriter::write_buffer(uint32_t binding, VkBuffer buffer, size_t size, size_t offset, VkDescriptorType type)
+{
+    VkDescriptorBufferInfo& info = bufferInfos.emplace_back(VkDescriptorBufferInfo{
+        .buffer = buffer,
+        .offset = offset,
+        .range = size
+    });
+
+    VkWriteDescriptorSet write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstBinding = binding;
+    write.dstSet = VK_NULL_HANDLE; // left empty until update_set
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pBufferInfo = &info;
+
+    writes.push_back(write);
+}
+
+void DescriptorWriter::clear()
+{
+    imageInfos.clear();
+    bufferInfos.clear();
+    writes.clear();
+}
+
+void DescriptorWriter::update_set(VkDevice device, VkDescriptorSet set)
+{
+    for (VkWriteDescriptorSet& write : writes) {
+        write.dstSet = set;
+    }
+
+    vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
\ No newline at end of file
@@ -1,14 +1,15 @@
 #pragma once
 
+#include <deque>
 #include <span>
 #include <vector>
 #include <volk.h>
 
 struct DescriptorAllocatorGrowable {
 public:
-	// how quickly we try to grow newly allocated pool max set sizes when all other pools are used up
+	// defaults of how quickly we try to grow newly allocated pool max set sizes when all other pools are used up, and of
+	// the cap of max set size of an allocated pool (see set_growth)
 	inline static const int GROWTH_FACTOR = 2;
-	// cap of max set size of an allocated pool
 	inline static const int CAP_SETS_IN_POOL = 4092;
 
 	struct PoolSizeRatio {
@@ -20,6 +21,12 @@ public:
 	void clear_pools(VkDevice device);
 	void destroy_pools(VkDevice device);
 	VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout, void* pNext = nullptr);
+	// applies to pools allocated from then on; existing pools keep their size
+	void set_growth(float growthFactor, uint32_t capSetsInPool) { mGrowthFactor = growthFactor; mCapSetsInPool = capSetsInPool; }
+
+	// pools owned right now; this only goes up when a frame needs more sets than the existing pools hold
+	uint32_t get_pool_count() const { return (uint32_t)(mFullPools.size() + mReadyPools.size()); }
+	uint32_t get_sets_per_pool() const { return mSetsPerPool; }
 
 private:
 	VkDescriptorPool get_descriptor_allocation_pool(VkDevice device);
@@ -32,8 +39,10 @@ private:
 	// We keep it in a vector as checking the vector size is more error-safe than checking if the ready pool is set/valid or not
 	std::vector<VkDescriptorPool> mReadyPools;
 	// tracks the largest max set size pool we have allocated so far
-	// the next allocated pool will have max set size of min(mSetsPerPool * GROWTH_FACTOR, CAP_SETS_IN_POOL)
+	// the next allocated pool will have max set size of min(mSetsPerPool * mGrowthFactor, mCapSetsInPool)
 	uint32_t mSetsPerPool;
+	float mGrowthFactor = (float)GROWTH_FACTOR;
+	uint32_t mCapSetsInPool = CAP_SETS_IN_POOL;
 
 };
 
@@ -44,4 +53,17 @@ struct DescriptorLayoutBuilder {
 	void add_binding(uint32_t binding, VkDescriptorType type);
 	void clear();
 	VkDescriptorSetLayout build(VkDevice device, VkShaderStageFlags shaderStages, void* pNext = nullptr, VkDescriptorSetLayoutCreateFlags flags = 0);
+};
+
+// batches descriptor writes so a whole set is updated with a single vkUpdateDescriptorSets call
+struct DescriptorWriter {
+	// deques keep the info structs at stable addresses while writes pointing at them are accumulated
+	std::deque<VkDescriptorImageInfo> imageInfos;
+	std::deque<VkDescriptorBufferInfo> bufferInfos;
+	std::vector<VkWriteDescriptorSet> writes;
+
+	void write_image(uint32_t binding, VkImageView image, VkSampler sampler, VkImageLayout layout, VkDescriptorType type);
+	void write_buffer(uint32_t binding, VkBuffer buffer, size_t size, size_t offset, VkDescriptorType type);
+	void clear();
+	void update_set(VkDevice device, VkDescriptorSet set);
 };
\ No newline at end of file
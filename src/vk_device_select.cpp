@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#include "vk_device_select.h"
+
+namespace {
+    // a device's score, and what the startup listing shows next to it
+    struct Candidate {
+        VkDeviceSize deviceLocalMemory; // largest device local heap
+        uint32_t group;
+        uint32_t groupSize;
+        int64_t score;
+    };
+
+    const char* device_type_name(VkPhysicalDeviceType type)
+    {
+        switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+        default: return "other";
+        }
+    }
+
+    int64_t device_type_score(VkPhysicalDeviceType type)
+    {
+        // far enough apart that no amount of memory or queues moves a device past one of a better type
+        switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 40000;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 30000;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 20000;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return 10000;
+        default: return 0;
+        }
+    }
+
+    Candidate score_device(const vkb::PhysicalDevice& device)
+    {
+        Candidate candidate{};
+        const VkPhysicalDeviceMemoryProperties& memory = device.memory_properties;
+        for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+            if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                candidate.deviceLocalMemory = std::max(candidate.deviceLocalMemory, memory.memoryHeaps[i].size);
+            }
+        }
+
+        candidate.score = device_type_score(device.properties.deviceType);
+        // otherwise the async compute scheduler runs its passes on the graphics queue
+        if (device.has_separate_compute_queue()) {
+            candidate.score += 2000;
+        }
+        // 100 per GiB, up to 32 GiB: beyond that the engine's budgets never get near the limit
+        VkDeviceSize memoryGiB = std::min<VkDeviceSize>(candidate.deviceLocalMemory >> 30, 32);
+        candidate.score += (int64_t)memoryGiB * 100;
+        return candidate;
+    }
+
+    std::string to_lower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return text;
+    }
+
+    // index of the device SUNABA_DEVICE names, or devices.size() if it is unset or names none of them
+    size_t find_override(const std::vector<vkb::PhysicalDevice>& devices)
+    {
+        const char* value = std::getenv("SUNABA_DEVICE");
+        if (!value || !*value) {
+            return devices.size();
+        }
+
+        char* end = nullptr;
+        unsigned long index = std::strtoul(value, &end, 10);
+        if (*end == '\0') {
+            if (index < devices.size()) {
+                return (size_t)index;
+            }
+        }
+        else {
+            std::string wanted = to_lower(value);
+            for (size_t i = 0; i < devices.size(); i++) {
+                if (to_lower(devices[i].name).find(wanted) != std::string::npos) {
+                    return i;
+                }
+            }
+        }
+        std::cout << "SUNABA_DEVICE=" << value << " matches no suitable device; choosing by score" << std::endl;
+        return devices.size();
+    }
+}
+
+const char* vkdevice::get_loader_override()
+{
+    const char* path = std::getenv("SUNABA_VULKAN_LIBRARY");
+    return path && *path ? path : nullptr;
+}
+
+bool vkdevice::load_loader()
+{
+    const char* path = get_loader_override();
+    if (!path) {
+        // volk knows the default loader of every platform
+        return volkInitialize() == VK_SUCCESS;
+    }
+
+#ifdef _WIN32
+    HMODULE library = LoadLibraryA(path);
+    void* getInstanceProcAddr = library ? (void*)GetProcAddress(library, "vkGetInstanceProcAddr") : nullptr;
+#else
+    void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    void* getInstanceProcAddr = library ? dlsym(library, "vkGetInstanceProcAddr") : nullptr;
+#endif
+    if (!getInstanceProcAddr) {
+        std::cout << "failed to load the Vulkan loader " << path << std::endl;
+        return false;
+    }
+    volkInitializeCustom((PFN_vkGetInstanceProcAddr)getInstanceProcAddr);
+    return true;
+}
+
+size_t vkdevice::select_device(VkInstance instance, const std::vector<vkb::PhysicalDevice>& devices)
+{
+    std::vector<Candidate> candidates;
+    candidates.reserve(devices.size());
+    for (const vkb::PhysicalDevice& device : devices) {
+        candidates.push_back(score_device(device));
+    }
+
+    // devices of a group are linked (e.g. by a bridge); the group of each candidate is only informative
+    uint32_t groupCount = 0;
+    vkEnumeratePhysicalDeviceGroups(instance, &groupCount, nullptr);
+    std::vector<VkPhysicalDeviceGroupProperties> groups(groupCount, { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GROUP_PROPERTIES });
+    vkEnumeratePhysicalDeviceGroups(instance, &groupCount, groups.data());
+    for (size_t i = 0; i < devices.size(); i++) {
+        for (uint32_t group = 0; group < groupCount; group++) {
+            const VkPhysicalDeviceGroupProperties& properties = groups[group];
+            const VkPhysicalDevice* first = properties.physicalDevices;
+            const VkPhysicalDevice* last = first + properties.physicalDeviceCount;
+            if (std::find(first, last, devices[i].physical_device) != last) {
+                candidates[i].group = group;
+                candidates[i].groupSize = properties.physicalDeviceCount;
+            }
+        }
+    }
+
+    // the first of equally scored devices wins, which keeps the choice stable across runs
+    size_t best = 0;
+    for (size_t i = 1; i < candidates.size(); i++) {
+        if (candidates[i].score > candidates[best].score) {
+            best = i;
+        }
+    }
+    size_t overridden = find_override(devices);
+    size_t selected = overridden < devices.size() ? overridden : best;
+
+    for (size_t i = 0; i < devices.size(); i++) {
+        const Candidate& candidate = candidates[i];
+        std::cout << (i == selected ? "* " : "  ") << i << ": " << devices[i].name << " ("
+            << device_type_name(devices[i].properties.deviceType) << ", " << (candidate.deviceLocalMemory >> 20) << " MiB";
+        if (devices[i].has_separate_compute_queue()) {
+            std::cout << ", async compute";
+        }
+        if (candidate.groupSize > 1) {
+            std::cout << ", device group " << candidate.group << " of " << candidate.groupSize << " linked devices";
+        }
+        std::cout << ", score " << candidate.score << ")" << std::endl;
+    }
+    if (overridden < devices.size()) {
+        std::cout << "device chosen by SUNABA_DEVICE" << std::endl;
+    }
+    return selected;
+}
\ No newline at end of file
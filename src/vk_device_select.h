@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <volk.h>
+#include <VkBootstrap.h>
+
+// Loading the Vulkan loader and choosing the physical device the engine runs on.
+// Devices that meet the engine's requirements (as checked by vk-bootstrap) are scored by type (discrete over integrated
+// over virtual over CPU), queues (a compute family without graphics lets async compute overlap the graphics work) and
+// device local memory. SUNABA_DEVICE overrides the choice with an index into the list printed at startup
+// or part of a device name, e.g. SUNABA_DEVICE=llvmpipe for lavapipe on machines that also have a GPU.
+// Linked device groups are shown in the listing, but the engine drives a single device, even when it belongs to a group
+namespace vkdevice {
+	// the loader library named by SUNABA_VULKAN_LIBRARY, or null for the platform's default (vulkan-1.dll, libvulkan.so.1,
+	// libvulkan.1.dylib). Windowed engines hand it to SDL, so SDL and volk share one loader
+	const char* get_loader_override();
+	// initializes volk from the loader get_loader_override names; false if it could not be loaded. The library stays
+	// loaded until the process exits
+	bool load_loader();
+
+	// index into devices (in vk-bootstrap's order, which must not be empty) of the one to create the engine's device on
+	size_t select_device(VkInstance instance, const std::vector<vkb::PhysicalDevice>& devices);
+}
\ No newline at end of file
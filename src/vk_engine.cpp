@@ -1,4 +1,8 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
 #include <thread>
 #include <volk.h>
 #include <VkBootstrap.h>
@@ -9,14 +13,25 @@
 #include <imgui_impl_vulkan.h>
 
 #include "vk_check_macro.h"
+#include "vk_device_select.h"
 #include "vk_engine.h"
 #include "vk_initializers.h"
 #include "vk_utils.h"
 
-void VulkanEngine::init()
+void VulkanEngine::init(bool bHeadless, const EngineConfig& config)
 {
+	mHeadless = bHeadless;
+	mConfig = config;
+	mTuningInput = config;
+	mWindowExtent = { mConfig.windowWidth, mConfig.windowHeight };
+	mResolution.renderScale = mConfig.renderScale;
+
+	// without a display (or Vulkan support in it), as on render nodes, the engine renders headless instead
+	if (!mHeadless && !init_sdl()) {
+		mHeadless = true;
+	}
 
-	init_sdl();
+	mJobSystem.init();
 
 	init_vulkan();
 
@@ -28,23 +43,34 @@ void VulkanEngine::init()
 
 	init_descriptors();
 
+	// the scene pass samples the texture streamer's heap, so its layout must exist before the pipelines
+	init_assets();
+
 	init_pipelines();
 
-	init_imgui();
+	if (!mHeadless) {
+		init_imgui();
+	}
 
 }
 
 void VulkanEngine::run() {
 	SDL_Event sdlEvent;
 	bool bQuitEngine = false;
+	mFrameGovernor.init();
+	auto lastFrameStart = std::chrono::steady_clock::now();
 
 	//main loop
 	while (!bQuitEngine)
 	{
+		// block until input arrives or the governor's next frame is due; any event wakes the loop at once
+		int32_t waitTimeout = mFrameGovernor.get_wait_timeout();
+		bool bHasEvent = waitTimeout != 0 ? SDL_WaitEventTimeout(&sdlEvent, waitTimeout) : SDL_PollEvent(&sdlEvent);
+
 		// clock at frame beginning
 		auto start = std::chrono::system_clock::now();
 		//Handle events on queue
-		while (SDL_PollEvent(&sdlEvent) != 0)
+		while (bHasEvent)
 		{
 			//close the window when user alt-f4s or clicks the X button			
 			if (sdlEvent.type == SDL_EVENT_QUIT)
@@ -55,15 +81,28 @@ void VulkanEngine::run() {
 			if (sdlEvent.type == SDL_EVENT_WINDOW_RESTORED) {
 				mStopRendering = false;
 			}
+			if (sdlEvent.type == SDL_EVENT_WINDOW_OCCLUDED) {
+				mWindowOccluded = true;
+			}
+			if (sdlEvent.type == SDL_EVENT_WINDOW_EXPOSED) {
+				mWindowOccluded = false;
+			}
+			mFrameGovernor.notify_activity();
 
 			//send SDL event to imgui for handling
 			ImGui_ImplSDL3_ProcessEvent(&sdlEvent);
+			// the camera only sees the mouse while it is not over a UI window
+			if (!ImGui::GetIO().WantCaptureMouse || sdlEvent.type == SDL_EVENT_MOUSE_BUTTON_UP) {
+				mCamera.process_sdl_event(sdlEvent);
+			}
+			bHasEvent = SDL_PollEvent(&sdlEvent);
 		}
 
-		// do not draw if the window is minimized
-		if (mStopRendering) {
-			// throttle the speed to avoid endless spinning
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		// focus on any of the engine's windows counts, UI windows dragged out of the main one included
+		mFrameGovernor.set_focused(SDL_GetKeyboardFocus() != nullptr);
+		mFrameGovernor.set_visible(!mStopRendering && !mWindowOccluded);
+		// nothing is drawn while minimized or occluded, nor once the scene has settled; the next wait then blocks until an event
+		if (!mFrameGovernor.begin_frame()) {
 			continue;
 		}
 
@@ -71,6 +110,15 @@ void VulkanEngine::run() {
 			resize_swapchain();
 		}
 
+		// frames can be far apart after an idle wait or while throttled, so the camera moves by wall time, up to a limit
+		auto frameStart = std::chrono::steady_clock::now();
+		float deltaTime = std::min(std::chrono::duration<float>(frameStart - lastFrameStart).count(), 0.1f);
+		lastFrameStart = frameStart;
+		bool bCameraMoved = false;
+		if (!ImGui::GetIO().WantCaptureKeyboard) {
+			bCameraMoved = mCamera.update(deltaTime);
+		}
+
 		// imgui new frame
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplSDL3_NewFrame();
@@ -78,16 +126,26 @@ void VulkanEngine::run() {
 		// Make this frame a dockspace (i.e. anchorable around the render window)
 		ImGui::DockSpaceOverViewport(0, 0, ImGuiDockNodeFlags_PassthruCentralNode);
 
-		if (ImGui::Begin("Statistics")) {
-			ImGui::Text("Frame Time: %f ms", engineStatistics.frametime);
-		}
-
-		ImGui::End();
+		draw_statistics_window();
+		draw_governor_window();
+		draw_render_targets_window();
+		draw_ui_window();
+		draw_background_settings_window();
+		draw_lights_window();
+		draw_shadows_window();
+		draw_anti_aliasing_window();
+		draw_post_process_window();
+		draw_assets_window();
+		draw_capture_window();
+		draw_pipeline_statistics_window();
+		draw_tuning_window();
 
 		//make imgui calculate internal draw structures
 		ImGui::Render();
 
 		draw();
+		mPipelineCache.reset_frame_stats();
+		update_frame_governor(bCameraMoved);
 
 		// clock at frame end
 		auto end = std::chrono::system_clock::now();
@@ -95,34 +153,155 @@ void VulkanEngine::run() {
 		// compute frame time in milliseconds
 		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 		engineStatistics.frametime = elapsed.count() / 1000.f;
+		mTuningTimeSum += engineStatistics.frametime;
+		mTuningFrames++;
+
+	}
+}
+
+void VulkanEngine::run_headless(uint32_t frameCount) {
+	for (uint32_t frame = 0; frame < frameCount; frame++) {
+		auto start = std::chrono::system_clock::now();
+
+		draw();
+		mPipelineCache.reset_frame_stats();
+
+		auto end = std::chrono::system_clock::now();
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+		engineStatistics.frametime = elapsed.count() / 1000.f;
+	}
+}
+
+void VulkanEngine::apply_config(const EngineConfig& config) {
+	// what changed, for the Tuning window's frame times before and after
+	std::string change;
+	for (const char* key : { "renderScale", "presentMode", "descriptorGrowthFactor", "descriptorPoolSetCap", "uploadBudgetMB" }) {
+		std::string value = config.get(key);
+		if (value != mConfig.get(key)) {
+			change += (change.empty() ? "" : ", ") + std::string(key) + "=" + value;
+		}
+	}
+	if (change.empty()) {
+		return;
+	}
 
+	if (config.renderScale != mConfig.renderScale) {
+		mResolution.renderScale = config.renderScale;
 	}
+	if (config.presentMode != mConfig.presentMode && !mHeadless) {
+		// the swapchain is recreated with it before the next frame
+		mSwapchainResizeRequested = true;
+	}
+	mConfig.renderScale = config.renderScale;
+	mConfig.presentMode = config.presentMode;
+	mConfig.descriptorGrowthFactor = config.descriptorGrowthFactor;
+	mConfig.descriptorPoolSetCap = config.descriptorPoolSetCap;
+	mConfig.uploadBudgetMB = config.uploadBudgetMB;
+
+	for (uint32_t i = 0; i < mConfig.framesInFlight; i++) {
+		mFrames[i].mFrameDescriptors.set_growth(mConfig.descriptorGrowthFactor, mConfig.descriptorPoolSetCap);
+	}
+	mGlobalDescriptors.set_growth(mConfig.descriptorGrowthFactor, mConfig.descriptorPoolSetCap);
+
+	mTuningChange = change;
+	mTuningTimeBefore = mTuningFrames > 0 ? mTuningTimeSum / mTuningFrames : 0.0;
+	mTuningTimeSum = 0.0;
+	mTuningFrames = 0;
+}
+
+void VulkanEngine::start_capture(const std::string& directory, CaptureFormat format, uint32_t frameCount) {
+	mCapture.start(directory, format, frameCount);
+}
+
+bool VulkanEngine::start_recording(const std::string& path, uint32_t frameCount) {
+	return mRecorder.start(path, mConfig.to_string(), frameCount, mLoadedScenePaths, mLoadedTexturePaths);
+}
+
+void VulkanEngine::load_scene(const std::string& path) {
+	mSceneLoader.load(path);
+	mLoadedScenePaths.push_back(path);
+	mRecorder.record_load(path, false);
+}
+
+TextureHandle VulkanEngine::load_texture(const std::string& path) {
+	mLoadedTexturePaths.push_back(path);
+	mRecorder.record_load(path, true);
+	return mTextureStreamer.load(path);
+}
+
+void VulkanEngine::wait_for_captures() {
+	// every recorded copy has landed once the device is idle
+	vkDeviceWaitIdle(mLogicalDevice);
+	mCapture.flush();
+}
+
+void VulkanEngine::wait_for_assets() {
+	// once the workers are done, every converted mesh is queued for upload by the loader's update
+	mSceneLoader.wait_for_workers();
+	mSceneLoader.update();
+	// textures only get their mip tail here; finer levels stream in from feedback once they are drawn
+	mTextureStreamer.wait_for_workers();
+	mTextureStreamer.update();
+	mUploader.flush();
+}
+
+VulkanEngine::ResourceStats VulkanEngine::get_resource_statistics() {
+	VmaTotalStatistics vmaStats;
+	vmaCalculateStatistics(mVmaAllocator, &vmaStats);
+
+	ResourceStats stats{};
+	stats.allocationCount = vmaStats.total.statistics.allocationCount;
+	stats.allocationBytes = vmaStats.total.statistics.allocationBytes;
+	stats.blockCount = vmaStats.total.statistics.blockCount;
+	stats.blockBytes = vmaStats.total.statistics.blockBytes;
+	for (uint32_t i = 0; i < mConfig.framesInFlight; i++) {
+		stats.descriptorPools += mFrames[i].mFrameDescriptors.get_pool_count();
+	}
+	return stats;
 }
 
 void VulkanEngine::cleanup()
 {
 	// wait for the GPU to finish all its pending tasks
 	vkDeviceWaitIdle(mLogicalDevice);
+	// frames whose costs were not collected yet are left out of the recording
+	mRecorder.destroy();
 
 	//destroy per frame resources
-	for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+	for (uint32_t i = 0; i < mConfig.framesInFlight; i++) {
 		mFrames[i].mDeletionQueue.flush();
 	}
 	// destroy global engine resources
 	mEngineDeletionQueue.flush();
 
+	mJobSystem.shutdown();
+
 	// destruction of these vulkan objects must come last, and order is important
-	destroy_swapchain();
-	vkDestroySurfaceKHR(mVkInstance, mSwapchainSurface, nullptr);
+	if (!mHeadless) {
+		destroy_swapchain();
+		vkDestroySurfaceKHR(mVkInstance, mSwapchainSurface, nullptr);
+	}
 	vkDestroyDevice(mLogicalDevice, nullptr);
 	vkb::destroy_debug_utils_messenger(mVkInstance, mDebugMessenger);
 	vkDestroyInstance(mVkInstance, nullptr);
-	SDL_DestroyWindow(mWindow);
+	if (!mHeadless) {
+		SDL_DestroyWindow(mWindow);
+	}
 }
 
-void VulkanEngine::init_sdl() {
+bool VulkanEngine::init_sdl() {
 	// We initialize SDL and create a window with it. 
-	SDL_Init(SDL_INIT_VIDEO);
+	if (!SDL_Init(SDL_INIT_VIDEO)) {
+		std::cout << "no display (" << SDL_GetError() << "); rendering headless" << std::endl;
+		return false;
+	}
+	// SDL loads the same loader volk is initialized from (the platform's default, or SUNABA_VULKAN_LIBRARY), before a
+	// Vulkan window would load the default one
+	if (!SDL_Vulkan_LoadLibrary(vkdevice::get_loader_override())) {
+		std::cout << "failed to load Vulkan for the window (" << SDL_GetError() << "); rendering headless" << std::endl;
+		SDL_Quit();
+		return false;
+	}
 
 	SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
 
@@ -132,16 +311,36 @@ void VulkanEngine::init_sdl() {
 		mWindowExtent.height,
 		window_flags
 	);
+	if (!mWindow) {
+		std::cout << "failed to create a window (" << SDL_GetError() << "); rendering headless" << std::endl;
+		SDL_Vulkan_UnloadLibrary();
+		SDL_Quit();
+		return false;
+	}
+	return true;
+}
+
+void VulkanEngine::destroy_window() {
+	if (mSwapchainSurface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(mVkInstance, mSwapchainSurface, nullptr);
+		mSwapchainSurface = VK_NULL_HANDLE;
+	}
+	SDL_DestroyWindow(mWindow);
+	mWindow = nullptr;
+	// SDL stays initialized: volk was initialized from the loader it holds
 }
 
 void VulkanEngine::init_vulkan() {
 
-	if (volkInitialize() != VK_SUCCESS) {
+	// windowed engines use the loader SDL already loaded; headless ones never initialize SDL, so volk loads it for them.
+	// Either way it is the platform's default loader unless SUNABA_VULKAN_LIBRARY names another
+	// if no loader can be found, your GPU may not have support for Vulkan :(
+	if (!mHeadless) {
+		volkInitializeCustom((PFN_vkGetInstanceProcAddr)SDL_Vulkan_GetVkGetInstanceProcAddr());
+	}
+	else if (!vkdevice::load_loader()) {
 		throw std::runtime_error("Failed to initialize Volk!");
 	}
-	// double check that vulkan-1.dll exists on your system in this directory; if not, point it to the right directory
-	// if vulkan-1.dll does not exist on your computer, your GPU may not have support for Vulkan :(
-	SDL_Vulkan_LoadLibrary("C:\\Windows\\System32\\vulkan-1.dll");
 #if _DEBUG
 	constexpr bool bUseValidationLayers = true;
 #endif
@@ -155,6 +354,7 @@ void VulkanEngine::init_vulkan() {
 		.request_validation_layers(bUseValidationLayers)
 		.use_default_debug_messenger()
 		.require_api_version(1, 3, 0)
+		.set_headless(mHeadless) // no surface extensions
 		.build();
 
 	vkb::Instance vkbInstance = builtVkbInstance.value();
@@ -165,7 +365,11 @@ void VulkanEngine::init_vulkan() {
 
 	volkLoadInstance(mVkInstance);
 
-	SDL_Vulkan_CreateSurface(mWindow, mVkInstance, nullptr, &mSwapchainSurface);
+	if (!mHeadless && !SDL_Vulkan_CreateSurface(mWindow, mVkInstance, nullptr, &mSwapchainSurface)) {
+		std::cout << "failed to create a window surface (" << SDL_GetError() << "); rendering headless" << std::endl;
+		destroy_window();
+		mHeadless = true;
+	}
 
 	//vulkan 1.3 features
 	VkPhysicalDeviceVulkan13Features features13{ };
@@ -178,19 +382,58 @@ void VulkanEngine::init_vulkan() {
 	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 	features12.bufferDeviceAddress = true;
 	features12.descriptorIndexing = true;
+	features12.hostQueryReset = true; // lets the profiler reset its queries without recording commands
+	// bindless texture heap of the texture streamer
+	features12.runtimeDescriptorArray = true;
+	features12.descriptorBindingPartiallyBound = true;
+	features12.descriptorBindingSampledImageUpdateAfterBind = true;
+	features12.descriptorBindingUpdateUnusedWhilePending = true;
+	features12.shaderSampledImageArrayNonUniformIndexing = true;
+
+
+	//use vkbootstrap to find the gpus that can write to the SDL surface and support the correct features of vulkan 1.2/1.3,
+	//then pick one of them by score (or SUNABA_DEVICE)
+	// the cluster renderer issues one indirect draw per instance, each carrying its instance index as the first instance
+	VkPhysicalDeviceFeatures features{ };
+	features.multiDrawIndirect = true;
+	features.drawIndirectFirstInstance = true;
 
-
-	//use vkbootstrap to select a gpu. 
-	//We want a gpu that can write to the SDL surface and supports the correct features of vulkan 1.2/1.3
 	vkb::PhysicalDeviceSelector selector{ vkbInstance };
-	vkb::PhysicalDevice vkbPhysicalDevice = selector
+	selector
 		.set_minimum_version(1, 3)
 		.add_required_extension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)
+		.set_required_features(features)
 		.set_required_features_13(features13)
 		.set_required_features_12(features12)
-		.set_surface(mSwapchainSurface)
-		.select()
-		.value();
+		.allow_any_gpu_device_type(true); // CPU implementations such as lavapipe included
+	// without a surface, presentation support is not required
+	if (!mHeadless) {
+		selector.set_surface(mSwapchainSurface);
+	}
+	else {
+		selector.require_present(false);
+	}
+	auto suitableDevices = selector.select_devices();
+	if (!mHeadless && (!suitableDevices.has_value() || suitableDevices.value().empty())) {
+		// e.g. a software device next to a display it cannot present to: render headless on whatever can render at all
+		std::cout << "no device can present to the window; rendering headless" << std::endl;
+		destroy_window();
+		mHeadless = true;
+		suitableDevices = selector.set_surface(VK_NULL_HANDLE).require_present(false).select_devices();
+	}
+	if (!suitableDevices.has_value() || suitableDevices.value().empty()) {
+		throw std::runtime_error("No Vulkan 1.3 device has the features the engine needs!");
+	}
+	std::vector<vkb::PhysicalDevice> devices = suitableDevices.value();
+	vkb::PhysicalDevice vkbPhysicalDevice = devices[vkdevice::select_device(mVkInstance, devices)];
+
+	// block compressed textures where the device has them; without, the texture streamer rejects BCn files
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(vkbPhysicalDevice.physical_device, &supportedFeatures);
+	vkbPhysicalDevice.features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	// likewise the per pass hardware counters, which are only instrumentation
+	vkbPhysicalDevice.features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	vkbPhysicalDevice.features.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise;
 
 	//create the final vulkan device
 	vkb::DeviceBuilder vkbDeviceBuilder{ vkbPhysicalDevice };
@@ -206,6 +449,27 @@ void VulkanEngine::init_vulkan() {
 	mGraphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 	mGraphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	// vkbootstrap's compute queue is one from a family without graphics support (preferring one without transfer too)
+	// hardware without such a family runs compute passes on the graphics queue instead
+	auto computeQueue = vkbDevice.get_queue(vkb::QueueType::compute);
+	if (computeQueue.has_value()) {
+		mComputeQueue = computeQueue.value();
+		mComputeQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::compute).value();
+	}
+	else {
+		mComputeQueue = mGraphicsQueue;
+		mComputeQueueFamily = mGraphicsQueueFamily;
+	}
+	mAsyncCompute.init(mLogicalDevice, mGraphicsQueueFamily, mComputeQueue, mComputeQueueFamily);
+
+	mGpuProfiler.init(mLogicalDevice, mPhysicalDevice, mConfig.framesInFlight);
+	mGpuProfiler.set_queue_family(GpuQueueTrack::Graphics, mGraphicsQueueFamily);
+	mGpuProfiler.set_queue_family(GpuQueueTrack::Compute, mComputeQueueFamily);
+	mPipelineStatistics.init(mLogicalDevice, mPhysicalDevice, mConfig.framesInFlight, supportedFeatures.pipelineStatisticsQuery,
+		supportedFeatures.occlusionQueryPrecise);
+	mPipelineStatistics.set_queue_family(GpuQueueTrack::Graphics, mGraphicsQueueFamily);
+	mPipelineStatistics.set_queue_family(GpuQueueTrack::Compute, mComputeQueueFamily);
+
 	// pass dynamic vk function pointers to VMA
 	VmaVulkanFunctions vma_vulkan_func{};
 	vma_vulkan_func.vkAllocateMemory = vkAllocateMemory;
@@ -235,12 +499,20 @@ void VulkanEngine::init_vulkan() {
 	allocatorInfo.pVulkanFunctions = &vma_vulkan_func;
 	vmaCreateAllocator(&allocatorInfo, &mVmaAllocator);
 
+	// encoding shares the job system with everything else; capture destroy waits for its last writes
+	mCapture.init(mVmaAllocator, &mJobSystem);
+
 	mEngineDeletionQueue.push_function([&]() {
+		mCapture.destroy();
+		mPipelineStatistics.destroy();
+		mGpuProfiler.destroy();
 		vmaDestroyAllocator(mVmaAllocator);
 	});
 }
 void VulkanEngine::init_swapchain() {
-	create_swapchain(mWindowExtent.width, mWindowExtent.height);
+	if (!mHeadless) {
+		create_swapchain(mWindowExtent.width, mWindowExtent.height);
+	}
 
 	// This section creates the drawn image buffer used every frame. The result is then just blitted to the appropriate swapchain image
 	// The draw image size will match the window
@@ -250,33 +522,62 @@ void VulkanEngine::init_swapchain() {
 		1
 	};
 
-	//hardcoding the draw format to RGBA 16 bits each, which is good for most purposes
-	mDrawImage.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-	mDrawImage.imageExtent = drawImageExtent;
+	// every render target comes out of one pool, which lets targets of passes that never run at the same time share memory
+	mRenderTargets.init(mLogicalDevice, mPhysicalDevice, mVmaAllocator, mGraphicsQueueFamily, mComputeQueueFamily);
+
+	// RGBA 16 bits float each by default, which is good for most purposes. The draw image is stored to by compute
+	// shaders, rendered to, sampled and blitted; a configured format the device cannot do all of that with (RGBA32F
+	// filtering is optional) falls back to the default, which every device supports
+	const VkFormatFeatureFlags drawImageFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+		| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT
+		| VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	VkFormatProperties drawFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, mConfig.drawFormat, &drawFormatProperties);
+	if ((drawFormatProperties.optimalTilingFeatures & drawImageFeatures) != drawImageFeatures) {
+		std::cout << "draw format " << EngineConfig::get_draw_format_name(mConfig.drawFormat) << " is not supported by the device; using rgba16f" << std::endl;
+		mConfig.drawFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		mTuningInput.drawFormat = mConfig.drawFormat;
+	}
+
+	RenderTargetPool::TargetDesc drawImageDesc;
+	drawImageDesc.name = "Draw image";
+	drawImageDesc.format = mConfig.drawFormat;
+	drawImageDesc.extent = drawImageExtent;
 
 	// usage flags are an internal Vulkan image optimization which we don't need to keep track of
 	VkImageUsageFlags drawImageUsages{};
 	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // allows blitting from the image
 	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; // allows blitting to the image
 	drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT; // allows writing to the image in a compute shader
+	drawImageUsages |= VK_IMAGE_USAGE_SAMPLED_BIT; // allows filtered reads in a shader (e.g. the bloom downsample)
 	drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // allows writing to the image in a fragment shader
 
-	VkImageCreateInfo drawImageCreateInfo = vkinit::image_create_info(mDrawImage.imageFormat, drawImageUsages, mDrawImage.imageExtent, 1);
+	drawImageDesc.usage = drawImageUsages;
+	// written from the background on and read until the blit into the swapchain (and the capture copy)
+	drawImageDesc.firstPass = FramePass::Background;
+	drawImageDesc.lastPass = FramePass::Composite;
+	// one per frame in flight: the post passes of a frame run on the compute queue while the next frame's scene is drawn
+	RenderTargetPool::Handle drawImageTargets[MAX_FRAMES_IN_FLIGHT];
+	for (uint32_t i = 0; i < mConfig.framesInFlight; i++) {
+		drawImageDesc.name = "Draw image " + std::to_string(i);
+		drawImageTargets[i] = mRenderTargets.declare(drawImageDesc);
+	}
 
-	// Allocate the draw image from gpu local memory
-	VmaAllocationCreateInfo drawImageAllocationInfo = {};
-	drawImageAllocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	drawImageAllocationInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	vmaCreateImage(mVmaAllocator, &drawImageCreateInfo, &drawImageAllocationInfo, &mDrawImage.image, &mDrawImage.allocation, nullptr);
+	// the other targets are declared by the modules that render to them, which pick them up from the pool when initialized
+	mClusterRenderer.declare_targets(mRenderTargets, drawImageExtent);
+	mPostProcess.declare_targets(mRenderTargets, drawImageExtent);
+	mShadows.declare_targets(mRenderTargets, SHADOW_MAP_RESOLUTION);
+	mTemporalAA.declare_targets(mRenderTargets, drawImageExtent, mConfig.drawFormat);
 
-	// allocate an image view for the draw image to use for rendering
-	VkImageViewCreateInfo drawImageViewCreateInfo = vkinit::imageview_create_info(mDrawImage.imageFormat, mDrawImage.image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-	VK_CHECK(vkCreateImageView(mLogicalDevice, &drawImageViewCreateInfo, nullptr, &mDrawImage.imageView));
+	// images, views and (shared) allocations of every target, in device local memory
+	mRenderTargets.build();
+	for (uint32_t i = 0; i < mConfig.framesInFlight; i++) {
+		mFrames[i].mDrawImage = mRenderTargets.get(drawImageTargets[i]);
+	}
+	mDrawImage = mFrames[0].mDrawImage;
 
-	//add draw image and its view to engine deletion queue
-	mEngineDeletionQueue.push_function([=]() {
-		vkDestroyImageView(mLogicalDevice, mDrawImage.imageView, nullptr);
-		vmaDestroyImage(mVmaAllocator, mDrawImage.image, mDrawImage.allocation);
+	mEngineDeletionQueue.push_function([&]() {
+		mRenderTargets.destroy();
 	});
 }
 
@@ -297,7 +598,7 @@ void VulkanEngine::init_commands() {
 	});
 
 
-	for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+	for (uint32_t i = 0; i < mConfig.framesInFlight; i++) {
 
 		VK_CHECK(vkCreateCommandPool(mLogicalDevice, &commandPoolInfo, nullptr, &mFrames[i].mCommandPool));
 
@@ -305,12 +606,33 @@ void VulkanEngine::init_commands() {
 		VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(mFrames[i].mCommandPool, 1);
 
 		VK_CHECK(vkAllocateCommandBuffers(mLogicalDevice, &cmdAllocInfo, &mFrames[i].mMainCommandBuffer));
+		VK_CHECK(vkAllocateCommandBuffers(mLogicalDevice, &cmdAllocInfo, &mFrames[i].mCompositeCommandBuffer));
 
 		// for efficiency, we clean up frame command pools when the engine terminates, not every frame
 		mEngineDeletionQueue.push_function([=]() {
 			vkDestroyCommandPool(mLogicalDevice, mFrames[i].mCommandPool, nullptr);
 		});
+
+		// command buffers can only be submitted to queues of the family their pool was created for
+		if (mAsyncCompute.is_dedicated()) {
+			VkCommandPoolCreateInfo computePoolInfo = vkinit::command_pool_create_info(mComputeQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+			VK_CHECK(vkCreateCommandPool(mLogicalDevice, &computePoolInfo, nullptr, &mFrames[i].mComputeCommandPool));
+
+			VkCommandBufferAllocateInfo computeAllocInfo = vkinit::command_buffer_allocate_info(mFrames[i].mComputeCommandPool, 1);
+			VK_CHECK(vkAllocateCommandBuffers(mLogicalDevice, &computeAllocInfo, &mFrames[i].mComputeCommandBuffer));
+
+			mEngineDeletionQueue.push_function([=]() {
+				vkDestroyCommandPool(mLogicalDevice, mFrames[i].mComputeCommandPool, nullptr);
+			});
+		}
 	}
+
+	// static passes are chained into the scene submission, so they are recorded for the graphics queue too
+	mStaticPasses.init(mLogicalDevice, mGraphicsQueueFamily, mConfig.framesInFlight);
+
+	mEngineDeletionQueue.push_function([&]() {
+		mStaticPasses.destroy();
+	});
 }
 void VulkanEngine::init_sync_structures() {
 	// create synchronization structures
@@ -320,7 +642,7 @@ void VulkanEngine::init_sync_structures() {
 	VkFenceCreateInfo fenceCreateInfo = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphore_create_info();
 
-	for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+	for (uint32_t i = 0; i < mConfig.framesInFlight; i++) {
 		// signals rendering has finished and the CPU can update this frame's command buffers
 		VK_CHECK(vkCreateFence(mLogicalDevice, &fenceCreateInfo, nullptr, &mFrames[i].mRenderFence));
 
@@ -329,8 +651,14 @@ void VulkanEngine::init_sync_structures() {
 		// signals rendering has finished and the frame can be presented
 		VK_CHECK(vkCreateSemaphore(mLogicalDevice, &semaphoreCreateInfo, nullptr, &mFrames[i].mRenderSemaphore));
 
+		// hand the frame between the graphics and the compute queue when compute passes run asynchronously
+		VK_CHECK(vkCreateSemaphore(mLogicalDevice, &semaphoreCreateInfo, nullptr, &mFrames[i].mSceneSemaphore));
+		VK_CHECK(vkCreateSemaphore(mLogicalDevice, &semaphoreCreateInfo, nullptr, &mFrames[i].mComputeSemaphore));
+
 		// for efficiency, we clean up frame sync structures when the engine terminates, not every frame
 		mEngineDeletionQueue.push_function([=]() {
+			vkDestroySemaphore(mLogicalDevice, mFrames[i].mSceneSemaphore, nullptr);
+			vkDestroySemaphore(mLogicalDevice, mFrames[i].mComputeSemaphore, nullptr);
 			vkDestroyFence(mLogicalDevice, mFrames[i].mRenderFence, nullptr);
 			vkDestroySemaphore(mLogicalDevice, mFrames[i].mRenderSemaphore, nullptr);
 			vkDestroySemaphore(mLogicalDevice, mFrames[i].mSwapchainSemaphore, nullptr);
@@ -346,9 +674,135 @@ void VulkanEngine::init_sync_structures() {
 }
 
 void VulkanEngine::init_descriptors() {
+	// per-frame descriptor sets are allocated while recording and thrown away when the frame slot comes around again
+	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> frameSizes = {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+	};
+
+	for (uint32_t i = 0; i < mConfig.framesInFlight; i++) {
+		mFrames[i].mFrameDescriptors.init(mLogicalDevice, 1000, frameSizes);
+		mFrames[i].mFrameDescriptors.set_growth(mConfig.descriptorGrowthFactor, mConfig.descriptorPoolSetCap);
+
+		mEngineDeletionQueue.push_function([&, i]() {
+			mFrames[i].mFrameDescriptors.destroy_pools(mLogicalDevice);
+		});
+	}
+
+	// a handful of sets written once at init, which cached command buffers can keep referring to
+	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> globalSizes = {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+	};
+	mGlobalDescriptors.init(mLogicalDevice, 10, globalSizes);
+	mGlobalDescriptors.set_growth(mConfig.descriptorGrowthFactor, mConfig.descriptorPoolSetCap);
+
+	mEngineDeletionQueue.push_function([&]() {
+		mGlobalDescriptors.destroy_pools(mLogicalDevice);
+	});
 }
 
 void VulkanEngine::init_pipelines() {
+	// every pipeline family is registered with this cache, which compiles specialization permutations on worker threads
+	mPipelineCache.init(mLogicalDevice, &mJobSystem);
+	mPipelineCache.set_archive(mAssetArchive.get());
+
+	mEngineDeletionQueue.push_function([&]() {
+		mPipelineCache.destroy();
+	});
+
+	// the background writes the frame slot's draw image as a storage image; the image of a slot never changes, so neither
+	// does its set, which lets the background's commands (cached per slot) be reused
+	DescriptorLayoutBuilder backgroundLayoutBuilder;
+	backgroundLayoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	mBackgroundSetLayout = backgroundLayoutBuilder.build(mLogicalDevice, VK_SHADER_STAGE_COMPUTE_BIT);
+
+	for (uint32_t i = 0; i < mConfig.framesInFlight; i++) {
+		mFrames[i].mBackgroundSet = mGlobalDescriptors.allocate(mLogicalDevice, mBackgroundSetLayout);
+		DescriptorWriter backgroundWriter;
+		backgroundWriter.write_image(0, mFrames[i].mDrawImage.imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		backgroundWriter.update_set(mLogicalDevice, mFrames[i].mBackgroundSet);
+	}
+
+	VkPushConstantRange backgroundPushConstants{};
+	backgroundPushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	backgroundPushConstants.offset = 0;
+	backgroundPushConstants.size = sizeof(BackgroundSettings);
+
+	VkPipelineLayoutCreateInfo backgroundLayoutInfo = vkinit::pipeline_layout_create_info();
+	backgroundLayoutInfo.setLayoutCount = 1;
+	backgroundLayoutInfo.pSetLayouts = &mBackgroundSetLayout;
+	backgroundLayoutInfo.pushConstantRangeCount = 1;
+	backgroundLayoutInfo.pPushConstantRanges = &backgroundPushConstants;
+	VK_CHECK(vkCreatePipelineLayout(mLogicalDevice, &backgroundLayoutInfo, nullptr, &mBackgroundPipelineLayout));
+
+	uint64_t backgroundShaderHash;
+	ComputePipelineBuilder backgroundBuilder;
+	backgroundBuilder.set_shader(mPipelineCache.load_draw_format_shader("background.comp.spv", mDrawImage.imageFormat, &backgroundShaderHash), backgroundShaderHash);
+	backgroundBuilder.set_layout(mBackgroundPipelineLayout);
+	mBackgroundFamily = mPipelineCache.register_compute_family("background", backgroundBuilder);
+	mBackgroundPass = mStaticPasses.register_pass("background");
+
+	mEngineDeletionQueue.push_function([=]() {
+		vkDestroyPipelineLayout(mLogicalDevice, mBackgroundPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(mLogicalDevice, mBackgroundSetLayout, nullptr);
+	});
+
+	mPostProcess.init(mLogicalDevice, mVmaAllocator, mPipelineCache, mRenderTargets, mDrawImage.imageFormat);
+	mClusterRenderer.init(mLogicalDevice, mVmaAllocator, mPipelineCache, mRenderTargets, mDrawImage.imageFormat, mTextureStreamer.get_set_layout(),
+		mConfig.framesInFlight);
+
+	mLighting.init(mLogicalDevice, mVmaAllocator, mPipelineCache, &mJobSystem, mConfig.framesInFlight);
+	mShadows.init(mLogicalDevice, mVmaAllocator, mRenderTargets, &mJobSystem, mGraphicsQueueFamily, mConfig.framesInFlight);
+	mTemporalAA.init(mLogicalDevice, mPipelineCache, mRenderTargets);
+
+	mEngineDeletionQueue.push_function([&]() {
+		mTemporalAA.destroy();
+		mShadows.destroy();
+		mLighting.destroy();
+		mClusterRenderer.destroy();
+		mPostProcess.destroy();
+	});
+}
+
+void VulkanEngine::init_assets() {
+	// assets (and shaders) come from the packed archive when there is one; SUNABA_ASSET_ARCHIVE overrides the one the build packs
+	const char* archivePath = std::getenv("SUNABA_ASSET_ARCHIVE");
+	std::shared_ptr<AssetArchive> archive = std::make_shared<AssetArchive>();
+	if (archive->open(archivePath ? archivePath : SUNABA_ASSET_ARCHIVE_PATH)) {
+		mAssetArchive = std::move(archive);
+	}
+	mEngineDeletionQueue.push_function([&]() {
+		mAssetArchive.reset();
+	});
+
+	// uploads share the graphics queue with rendering, so submission order alone orders them before the frames using them
+	mUploader.init(mLogicalDevice, mVmaAllocator, mGraphicsQueue, mGraphicsQueueFamily);
+
+	// vertices are pulled through buffer device addresses, indices are bound as index buffers (and read by compute culling)
+	mVertexBuffers.init(mVmaAllocator, mLogicalDevice, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+	mIndexBuffers.init(mVmaAllocator, mLogicalDevice, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+	// meshlet bounds are only read by the culling pass
+	mMeshletBuffers.init(mVmaAllocator, mLogicalDevice, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 16ull << 20);
+
+	mTextureStreamer.init(mLogicalDevice, mPhysicalDevice, mVmaAllocator, &mUploader, &mJobSystem, mConfig.framesInFlight, TEXTURE_MEMORY_BUDGET);
+	mTextureStreamer.set_archive(mAssetArchive);
+	// material textures of loaded scenes are streamed like any other
+	mSceneLoader.init(&mJobSystem, &mUploader, &mVertexBuffers, &mIndexBuffers, &mMeshletBuffers, &mTextureStreamer);
+	mSceneLoader.set_archive(mAssetArchive);
+
+	// the uploader goes first: its completion callbacks refer to the loader's meshes and the streamer's textures
+	mEngineDeletionQueue.push_function([&]() {
+		mTextureStreamer.destroy();
+		mSceneLoader.destroy();
+		mMeshletBuffers.destroy();
+		mIndexBuffers.destroy();
+		mVertexBuffers.destroy();
+	});
+	mEngineDeletionQueue.push_function([&]() {
+		mUploader.destroy();
+	});
 }
 
 void VulkanEngine::init_imgui() {
@@ -416,6 +870,12 @@ void VulkanEngine::init_imgui() {
 		ImGui::DestroyContext();
 		vkDestroyDescriptorPool(mLogicalDevice, imguiPool, nullptr);
 	});
+
+	// the backend above keeps the font atlas and secondary viewports; the main viewport goes through the UI renderer
+	mUiRenderer.init(mLogicalDevice, mVmaAllocator, mPipelineCache, mSwapchainImageFormat, mConfig.framesInFlight);
+	mEngineDeletionQueue.push_function([&]() {
+		mUiRenderer.destroy();
+	});
 }
 
 
@@ -428,14 +888,15 @@ void VulkanEngine::create_swapchain(uint32_t width, uint32_t height)
 	vkb::Swapchain vkbSwapchain = swapchainBuilder
 		//.use_default_format_selection()
 		.set_desired_format(VkSurfaceFormatKHR{ .format = mSwapchainImageFormat, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR })
-		//use vsync present mode
-		.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+		// FIFO (vsync) unless configured otherwise; vk-bootstrap falls back to it when the surface lacks the configured mode
+		.set_desired_present_mode(mConfig.presentMode)
 		.set_desired_extent(width, height)
 		.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
 		.build()
 		.value();
 
 	mSwapchainExtent = vkbSwapchain.extent;
+	mPresentMode = vkbSwapchain.present_mode;
 	//store swapchain and its related images
 	mSwapchain = vkbSwapchain.swapchain;
 	mSwapchainImages = vkbSwapchain.get_images().value();
@@ -478,22 +939,74 @@ void VulkanEngine::draw()
 	VK_CHECK(vkResetFences(mLogicalDevice, 1, &get_current_frame().mRenderFence));
 	// reset rendering resources 
 	get_current_frame().mDeletionQueue.flush();
+	// with the fence signalled, the previous frame that drew into this slot's image is done with it
+	mDrawImage = get_current_frame().mDrawImage;
 	get_current_frame().mFrameDescriptors.clear_pools(mLogicalDevice);
+	// the fence also covers every query written by this frame slot, so its timings can be read back without waiting
+	mGpuProfiler.begin_frame(mCurrentFrameNumber);
+	mPipelineStatistics.begin_frame(mCurrentFrameNumber);
+	// same for the frame readbacks, which go off to be encoded
+	mCapture.begin_frame(mCurrentFrameNumber);
+	// and for the texture usage feedback the slot's shaders wrote, and its culling statistics
+	mTextureStreamer.begin_frame(mCurrentFrameNumber);
+	mClusterRenderer.begin_frame(mCurrentFrameNumber);
+	// which completes the recorded frame the slot drew last
+	mRecorder.begin_frame(mCurrentFrameNumber, engineStatistics.frametime, engineStatistics.recordTime, mGpuProfiler, mClusterRenderer.get_stats());
+
+	// meshes converted and texture levels requested since the last frame are queued for upload, then a bounded slice of
+	// all queued uploads is submitted
+	mSceneLoader.update();
+	mTextureStreamer.update();
+	mUploader.update((VkDeviceSize)mConfig.uploadBudgetMB << 20);
+
+	// newly loaded nodes join the entities, then every changed world transform is brought up to date before drawing
+	sync_scene_entities();
+	mEntities.update(&mJobSystem);
+	update_scene_bvh();
 
 	// max resolution of the draw on screen is capped by the swap chain resolution and image buffer resolution
-	// however, we could render at an even higher resolution (render scale) then just downsample right before screen display
-	mDrawExtent.height = std::min(mSwapchainExtent.height, mDrawImage.imageExtent.height) * RENDER_SCALE;
-	mDrawExtent.width = std::min(mSwapchainExtent.width, mDrawImage.imageExtent.width) * RENDER_SCALE;
+	// the scene may render at a fraction of it (render scale), which TAA or the blit into the swapchain scales back up
+	// without a swapchain, the draw image is the final output
+	VkExtent2D outputExtent = mHeadless ? VkExtent2D{ mDrawImage.imageExtent.width, mDrawImage.imageExtent.height } : mSwapchainExtent;
+	outputExtent.width = std::min(outputExtent.width, mDrawImage.imageExtent.width);
+	outputExtent.height = std::min(outputExtent.height, mDrawImage.imageExtent.height);
+	update_render_scale();
+	mDrawExtent.width = std::max((uint32_t)(outputExtent.width * mResolution.renderScale), 1u);
+	mDrawExtent.height = std::max((uint32_t)(outputExtent.height * mResolution.renderScale), 1u);
+	mResolvedExtent = mTemporalAA.mSettings.bEnabled ? outputExtent : mDrawExtent;
 
 	// request an image from the swapchain
-	uint32_t swapchainImageIndex;
-	VkResult acquireImageResult = vkAcquireNextImageKHR(mLogicalDevice, mSwapchain, 1000000000, get_current_frame().mSwapchainSemaphore, nullptr, &swapchainImageIndex);
-	if (acquireImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
-		// our swapchain image resolution does not match the window resolution
-		// Don't waste time rendering until after the swapchain image resolution is fixed
-		mSwapchainResizeRequested = true;
-		return;
+	uint32_t swapchainImageIndex = 0;
+	if (!mHeadless) {
+		VkResult acquireImageResult = vkAcquireNextImageKHR(mLogicalDevice, mSwapchain, 1000000000, get_current_frame().mSwapchainSemaphore, nullptr, &swapchainImageIndex);
+		if (acquireImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
+			// our swapchain image resolution does not match the window resolution
+			// Don't waste time rendering until after the swapchain image resolution is fixed
+			mSwapchainResizeRequested = true;
+			return;
+		}
+	}
+
+	if (mRecorder.is_recording()) {
+		record_frame_state(outputExtent);
+	}
+
+	auto recordStart = std::chrono::steady_clock::now();
+
+	// the background only changes with the draw extent, its settings and its pipeline (a compiled permutation replaces
+	// the fallback), so with caching it is recorded once and submitted ahead of the frame's own command buffers after that
+	mStaticPasses.begin_frame();
+	VkPipeline backgroundPipeline = mPipelineCache.get_pipeline(mBackgroundFamily, SpecializationData());
+	VkCommandBuffer backgroundCommandBuffer = VK_NULL_HANDLE;
+	if (mStaticPasses.mSettings.bEnabled) {
+		uint64_t backgroundKey = vkutil::hash_bytes(&mBackground, sizeof(BackgroundSettings));
+		backgroundKey = vkutil::hash_combine(backgroundKey, ((uint64_t)mDrawExtent.width << 32) | mDrawExtent.height);
+		backgroundKey = vkutil::hash_combine(backgroundKey, (uint64_t)backgroundPipeline);
+		backgroundCommandBuffer = mStaticPasses.get(mBackgroundPass, mCurrentFrameNumber, backgroundKey, [&](VkCommandBuffer cmd) {
+			draw_background(cmd, backgroundPipeline);
+		});
 	}
+	float staticRecordTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
 
 	VkCommandBuffer frameDrawCommandBuffer = get_current_frame().mMainCommandBuffer;
 	// reset the command buffer to allow recording again.
@@ -503,41 +1016,133 @@ void VulkanEngine::draw()
 	VkCommandBufferBeginInfo frameDrawBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 	VK_CHECK(vkBeginCommandBuffer(frameDrawCommandBuffer, &frameDrawBeginInfo));
 
-	// set the draw image layout to optimal transfer destination for clearing
-	vkutil::transition_image(frameDrawCommandBuffer, mDrawImage.image, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	uint32_t sceneScope = mGpuProfiler.begin_scope(frameDrawCommandBuffer, "Scene");
 
-	clear_scene(frameDrawCommandBuffer, mDrawImage.image);
-
-	// transition the draw image layout into an optimal transfer source and the swapchain image into an optimal transfer destination 
-	// then blit from the draw image into the swapchain image
-	vkutil::transition_image(frameDrawCommandBuffer, mDrawImage.image, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-	vkutil::transition_image(frameDrawCommandBuffer, mSwapchainImages[swapchainImageIndex], 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	vkutil::copy_image_to_image(frameDrawCommandBuffer, mDrawImage.image, mSwapchainImages[swapchainImageIndex], mDrawExtent, mSwapchainExtent);
-
-	// set swapchain image layout to color attachment so IMGUI can write over it
-	vkutil::transition_image(frameDrawCommandBuffer, mSwapchainImages[swapchainImageIndex], 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-
-	// draw imgui into the swapchain image
-	draw_imgui(frameDrawCommandBuffer, mSwapchainImageViews[swapchainImageIndex]);
+	// the draw image stays in GENERAL for the scene, which starts with a compute background. A cached background ran
+	// before this command buffer; it carries no queries, so only the uncached one shows up in the statistics
+	if (backgroundCommandBuffer == VK_NULL_HANDLE) {
+		auto backgroundStart = std::chrono::steady_clock::now();
+		uint32_t backgroundStatistics = mPipelineStatistics.begin_scope(frameDrawCommandBuffer, "Background");
+		draw_background(frameDrawCommandBuffer, backgroundPipeline);
+		mPipelineStatistics.end_scope(frameDrawCommandBuffer, backgroundStatistics);
+		staticRecordTime += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - backgroundStart).count();
+	}
+	uint32_t sceneStatistics = mPipelineStatistics.begin_scope(frameDrawCommandBuffer, "Scene");
+	draw_scene(frameDrawCommandBuffer);
+	mPipelineStatistics.end_scope(frameDrawCommandBuffer, sceneStatistics);
+	// EXR captures keep the scene linear, so they copy it before the post chain tonemaps it in place
+	mCapture.record_copy(frameDrawCommandBuffer, mDrawImage, mResolvedExtent, mCurrentFrameNumber, true, false);
+
+	mGpuProfiler.end_scope(frameDrawCommandBuffer, sceneScope);
+
+	float deltaTime = mFixedDeltaTime > 0.f ? mFixedDeltaTime : engineStatistics.frametime / 1000.f;
+	mPostProcess.schedule(mAsyncCompute, get_current_frame().mFrameDescriptors, mDrawImage, mResolvedExtent, deltaTime);
+
+	// compute passes scheduled for this frame run between the scene and compositing
+	// with a dedicated compute queue, the frame is split into three submissions: scene (graphics) -> passes (compute) -> compositing (graphics)
+	// so the compute work of this frame can overlap graphics work of the next one. Nothing the next frame's scene starts with
+	// waits for compositing: it draws into its own image, and compositing only waits for the passes at the blit stage, which
+	// the scene never uses. Its color attachment writes do wait, behind the UI drawn over this frame's blit
+	bool bSubmitAsyncCompute = false;
+	if (mAsyncCompute.has_scheduled_passes()) {
+		// the draw image comes back ready for the blit into the swapchain (the capture copy chains its own barrier after it)
+		mAsyncCompute.share_image({ mDrawImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT });
+
+		if (mAsyncCompute.is_dedicated()) {
+			bSubmitAsyncCompute = true;
+			submit_async_compute(frameDrawCommandBuffer, backgroundCommandBuffer);
+
+			// the rest of the frame is recorded into the composite command buffer, which waits for the compute passes
+			frameDrawCommandBuffer = get_current_frame().mCompositeCommandBuffer;
+			VK_CHECK(vkResetCommandBuffer(frameDrawCommandBuffer, 0));
+			VK_CHECK(vkBeginCommandBuffer(frameDrawCommandBuffer, &frameDrawBeginInfo));
+			mAsyncCompute.record_acquire_from_compute(frameDrawCommandBuffer);
+		}
+		else {
+			mAsyncCompute.record_inline(frameDrawCommandBuffer, mGpuProfiler, mPipelineStatistics);
+		}
+	}
+	else {
+		vkutil::transition_image(frameDrawCommandBuffer, mDrawImage.image, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	}
+	mAsyncCompute.end_frame();
+
+	uint32_t compositeScope = mGpuProfiler.begin_scope(frameDrawCommandBuffer, "Composite + UI");
+	uint32_t compositeStatistics = mPipelineStatistics.begin_scope(frameDrawCommandBuffer, "Composite + UI");
+
+	// the draw image is an optimal transfer source by now; PNG and raw captures read it alongside the blit,
+	// sRGB encoding it themselves when the post chain is off and left it linear
+	mCapture.record_copy(frameDrawCommandBuffer, mDrawImage, mResolvedExtent, mCurrentFrameNumber, false, mPostProcess.mSettings.bEnabled);
+
+	if (!mHeadless) {
+		// transition the swapchain image into an optimal transfer destination
+		// then blit from the draw image into the swapchain image
+		// the swapchain transitions name their actual stages: as the composite waits for the compute passes, a barrier over
+		// all commands would hold back all of the next frame's work until the passes are done
+		VkImage swapchainImage = mSwapchainImages[swapchainImageIndex];
+		// chained after the acquire semaphore, which is waited on at the color attachment output stage
+		vkutil::transition_image(frameDrawCommandBuffer, swapchainImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+		vkutil::copy_image_to_image(frameDrawCommandBuffer, mDrawImage.image, swapchainImage, mResolvedExtent, mSwapchainExtent);
+
+		// set swapchain image layout to color attachment so IMGUI can write over it
+		vkutil::transition_image(frameDrawCommandBuffer, swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+
+		// draw imgui into the swapchain image
+		draw_imgui(frameDrawCommandBuffer, mSwapchainImageViews[swapchainImageIndex]);
+
+		// set swapchain image layout to present so the swapchain can present it; the render semaphore orders the present
+		vkutil::transition_image(frameDrawCommandBuffer, swapchainImage, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_2_NONE);
+	}
 
-	// set swapchain image layout to present so the swapchain can present it
-	vkutil::transition_image(frameDrawCommandBuffer, mSwapchainImages[swapchainImageIndex], 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	mPipelineStatistics.end_scope(frameDrawCommandBuffer, compositeStatistics);
+	mGpuProfiler.end_scope(frameDrawCommandBuffer, compositeScope);
 
 	//finalize the command buffer (we can no longer add commands, but it can now be executed)
 	VK_CHECK(vkEndCommandBuffer(frameDrawCommandBuffer));
+	engineStatistics.recordTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+	engineStatistics.staticRecordTime = staticRecordTime;
 
 	// prepare the rendering command buffer submission to the queue. 
 	// rendering waits on the mPresentSemaphore, which signals when the swapchain has finished presenting the previous frame using this resource (and thus we can render on it)
 	// rendering signals the mRenderSemaphore, to tell the swapchain that rendering has finished and we can present the new frame on this resource
-	VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(frameDrawCommandBuffer);
-	VkSemaphoreSubmitInfo waitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, get_current_frame().mSwapchainSemaphore);
+	// after async compute, it also waits for the compute passes before touching the images they wrote (from the blit stage onwards)
+	// headless frames have nothing to wait for or present, so they only wait on the compute passes
+	// the static passes go first, unless they went with the scene submission already
+	VkCommandBufferSubmitInfo cmdinfos[2];
+	uint32_t cmdCount = 0;
+	if (!bSubmitAsyncCompute && backgroundCommandBuffer != VK_NULL_HANDLE) {
+		cmdinfos[cmdCount++] = vkinit::command_buffer_submit_info(backgroundCommandBuffer);
+	}
+	cmdinfos[cmdCount++] = vkinit::command_buffer_submit_info(frameDrawCommandBuffer);
+	VkSemaphoreSubmitInfo waitInfos[2];
+	uint32_t waitCount = 0;
+	if (!mHeadless) {
+		waitInfos[waitCount++] = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, get_current_frame().mSwapchainSemaphore);
+	}
+	if (bSubmitAsyncCompute) {
+		waitInfos[waitCount++] = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_BLIT_BIT, get_current_frame().mComputeSemaphore);
+	}
 	VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, get_current_frame().mRenderSemaphore);
 
 	// submit the rendering command buffer to the queue and execute it.
 	// mRenderFence will now block until all the submitted rendering commands finish
-	VkSubmitInfo2 submit = vkinit::queue_submit_info(&cmdinfo, &signalInfo, &waitInfo);
+	// (and transitively the compute passes, since this submission waits on them)
+	VkSubmitInfo2 submit = vkinit::queue_submit_info(cmdinfos, mHeadless ? nullptr : &signalInfo, waitInfos);
+	submit.commandBufferInfoCount = cmdCount;
+	submit.waitSemaphoreInfoCount = waitCount;
 	VK_CHECK(vkQueueSubmit2(mGraphicsQueue, 1, &submit, get_current_frame().mRenderFence));
 
+	if (mHeadless) {
+		mCurrentFrameNumber = (mCurrentFrameNumber + 1) % mConfig.framesInFlight;
+		return;
+	}
+
 	// prepare image presentation to the window
 	// we wait on mRenderSemaphore as rendering commands must have finished before the image can be displayed to the user
 	VkPresentInfoKHR presentInfo = {};
@@ -557,31 +1162,756 @@ void VulkanEngine::draw()
 	}
 
 	// move on to next set of frame resources
-	mCurrentFrameNumber = (mCurrentFrameNumber + 1) % FRAMES_IN_FLIGHT;
+	mCurrentFrameNumber = (mCurrentFrameNumber + 1) % mConfig.framesInFlight;
 }
 
-void VulkanEngine::clear_scene(VkCommandBuffer cmd, VkImage targetImage) {
-	// clear screen to black; you probably don't need this if you're writing to all pixels of the screen every frame
-	VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-	VkImageSubresourceRange clearRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
-	vkCmdClearColorImage(cmd, targetImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &clearRange);
+void VulkanEngine::submit_async_compute(VkCommandBuffer sceneCommandBuffer, VkCommandBuffer staticCommandBuffer)
+{
+	FrameData& frame = get_current_frame();
+
+	// finish the scene: hand the shared images over to the compute family and let the compute queue start
+	mAsyncCompute.record_release_to_compute(sceneCommandBuffer);
+	VK_CHECK(vkEndCommandBuffer(sceneCommandBuffer));
+
+	VkCommandBufferSubmitInfo sceneCmdInfos[2];
+	uint32_t sceneCmdCount = 0;
+	if (staticCommandBuffer != VK_NULL_HANDLE) {
+		sceneCmdInfos[sceneCmdCount++] = vkinit::command_buffer_submit_info(staticCommandBuffer);
+	}
+	sceneCmdInfos[sceneCmdCount++] = vkinit::command_buffer_submit_info(sceneCommandBuffer);
+	VkSemaphoreSubmitInfo sceneSignalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.mSceneSemaphore);
+	VkSubmitInfo2 sceneSubmit = vkinit::queue_submit_info(sceneCmdInfos, &sceneSignalInfo, nullptr);
+	sceneSubmit.commandBufferInfoCount = sceneCmdCount;
+	VK_CHECK(vkQueueSubmit2(mGraphicsQueue, 1, &sceneSubmit, VK_NULL_HANDLE));
+
+	// the compute passes themselves, bracketed by the acquire and release halves of the ownership transfers
+	VkCommandBufferBeginInfo computeBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkResetCommandBuffer(frame.mComputeCommandBuffer, 0));
+	VK_CHECK(vkBeginCommandBuffer(frame.mComputeCommandBuffer, &computeBeginInfo));
+	mAsyncCompute.record_compute(frame.mComputeCommandBuffer, mGpuProfiler, mPipelineStatistics);
+	VK_CHECK(vkEndCommandBuffer(frame.mComputeCommandBuffer));
+
+	VkCommandBufferSubmitInfo computeCmdInfo = vkinit::command_buffer_submit_info(frame.mComputeCommandBuffer);
+	VkSemaphoreSubmitInfo computeWaitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, frame.mSceneSemaphore);
+	VkSemaphoreSubmitInfo computeSignalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.mComputeSemaphore);
+	VkSubmitInfo2 computeSubmit = vkinit::queue_submit_info(&computeCmdInfo, &computeSignalInfo, &computeWaitInfo);
+	VK_CHECK(vkQueueSubmit2(mAsyncCompute.get_queue(), 1, &computeSubmit, VK_NULL_HANDLE));
 }
 
-void VulkanEngine::draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView)
-{
-	VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(targetImageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-	VkRenderingInfo renderInfo = vkinit::rendering_info(mSwapchainExtent, &colorAttachment);
+void VulkanEngine::update_frame_governor(bool bCameraMoved) {
+	PipelinePermutationCache::Stats pipelineStats = mPipelineCache.get_stats();
+	// anything still changing on its own keeps frames coming without input
+	bool bStreaming = !mSceneLoader.is_idle() || mUploader.get_stats().pendingUploads > 0 || mTextureStreamer.get_stats().streamingTextures > 0;
+	mFrameGovernor.set_animating(bCameraMoved || bStreaming || mCapture.is_capturing() || pipelineStats.pendingPermutations > 0);
+	// auto-exposure closes all but 1/256 of the gap to its target in ln(256) / adaptationSpeed seconds of frame time (in
+	// frames with a fixed time step), TAA's history in the frames its current frame weight takes to decay as far
+	const PostProcessSettings& post = mPostProcess.mSettings;
+	float exposureSettleTime = post.bEnabled && post.bAutoExposure ? std::log(256.f) / std::max(post.adaptationSpeed, 0.01f) : 0.f;
+	uint32_t settleFrames = 0;
+	if (mTemporalAA.mSettings.bEnabled) {
+		float historyWeight = 1.f - std::clamp(mTemporalAA.mSettings.currentWeight, 0.01f, 0.99f);
+		settleFrames = (uint32_t)std::ceil(std::log(1.f / 256.f) / std::log(historyWeight));
+	}
+	if (mFixedDeltaTime > 0.f) {
+		settleFrames = std::max(settleFrames, (uint32_t)std::ceil(exposureSettleTime / mFixedDeltaTime));
+		exposureSettleTime = 0.f;
+	}
+	mFrameGovernor.set_settling(exposureSettleTime, settleFrames);
+	float gpuBusyTime = mGpuProfiler.get_queue_busy_time(GpuQueueTrack::Graphics) + mGpuProfiler.get_queue_busy_time(GpuQueueTrack::Compute)
+		- mGpuProfiler.get_overlap_time();
+	mFrameGovernor.end_frame(gpuBusyTime);
+}
+
+void VulkanEngine::draw_statistics_window() {
+	if (ImGui::Begin("Statistics")) {
+		ImGui::Text("Frame Time: %f ms", engineStatistics.frametime);
+
+		// CPU cost of command recording; toggling the cache shows what pre-recorded static passes save
+		StaticCommandCache::Stats staticStats = mStaticPasses.get_stats();
+		ImGui::SeparatorText("Command recording");
+		ImGui::Checkbox("Cache static passes", &mStaticPasses.mSettings.bEnabled);
+		ImGui::Text("Recording: %.3f ms, static passes %.3f ms (%u reused, %u recorded)", engineStatistics.recordTime,
+			engineStatistics.staticRecordTime, staticStats.reusedPasses, staticStats.recordedPasses);
+
+		PipelinePermutationCache::Stats pipelineStats = mPipelineCache.get_stats();
+		ImGui::Text("Pipelines: %u ready, %u compiling", pipelineStats.readyPermutations, pipelineStats.pendingPermutations);
+		ImGui::Text("Pipeline fallbacks: %u (compile time %.1f ms)", pipelineStats.fallbacksThisFrame, pipelineStats.totalCompileTime);
+
+		// per-queue GPU timings; with a dedicated compute queue, the overlap shows how much compute work was hidden behind graphics
+		ImGui::SeparatorText(mAsyncCompute.is_dedicated() ? "GPU (async compute queue)" : "GPU (compute on graphics queue)");
+		ImGui::Text("Graphics busy: %.3f ms", mGpuProfiler.get_queue_busy_time(GpuQueueTrack::Graphics));
+		ImGui::Text("Compute busy: %.3f ms", mGpuProfiler.get_queue_busy_time(GpuQueueTrack::Compute));
+		ImGui::Text("Overlap: %.3f ms", mGpuProfiler.get_overlap_time());
+		for (const GpuProfiler::ScopeResult& scope : mGpuProfiler.get_results()) {
+			ImGui::Text("  [%s] %s: %.3f ms (at %.3f ms)", scope.queue == GpuQueueTrack::Compute ? "compute" : "graphics",
+				scope.name.c_str(), scope.end - scope.begin, scope.begin);
+		}
+
+		// triangles removed per frame by each test, in the order the culling pass applies them
+		ClusterRenderer::Stats cullStats = mClusterRenderer.get_stats();
+		ImGui::SeparatorText("Cluster culling");
+		ImGui::Checkbox("Frustum", &mClusterRenderer.mSettings.bFrustumCulling);
+		ImGui::SameLine();
+		ImGui::Checkbox("Backface cones", &mClusterRenderer.mSettings.bBackfaceCulling);
+		ImGui::SameLine();
+		ImGui::Checkbox("Occlusion (HZB)", &mClusterRenderer.mSettings.bOcclusionCulling);
+		ImGui::Text("Instances: %u, clusters: %u", cullStats.instanceCount, cullStats.clusterCount);
+		ImGui::Text("Triangles drawn: %llu / %llu", (unsigned long long)cullStats.drawnTriangles, (unsigned long long)cullStats.totalTriangles);
+		ImGui::Text("Culled by frustum: %llu (%u clusters)", (unsigned long long)cullStats.frustumCulledTriangles, cullStats.frustumCulledClusters);
+		ImGui::Text("Culled by cone: %llu (%u clusters)", (unsigned long long)cullStats.backfaceCulledTriangles, cullStats.backfaceCulledClusters);
+		ImGui::Text("Culled by occlusion: %llu (%u clusters)", (unsigned long long)cullStats.occlusionCulledTriangles, cullStats.occlusionCulledClusters);
+
+		// triangles each level of detail contributes: selected is before cluster culling, drawn after
+		ImGui::SeparatorText("Level of detail");
+		ImGui::SliderFloat("Error (pixels)", &mClusterRenderer.mSettings.lodErrorPixels, 0.1f, 16.f, "%.2f", ImGuiSliderFlags_Logarithmic);
+		ImGui::SliderFloat("Hysteresis", &mClusterRenderer.mSettings.lodHysteresis, 0.f, 0.9f);
+		ImGui::SliderInt("Force level", &mClusterRenderer.mSettings.forcedLod, -1, (int)MAX_MESH_LODS - 1, mClusterRenderer.mSettings.forcedLod < 0 ? "off" : "%d");
+		if (ImGui::BeginTable("lods", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+			ImGui::TableSetupColumn("Level");
+			ImGui::TableSetupColumn("Instances");
+			ImGui::TableSetupColumn("Selected triangles");
+			ImGui::TableSetupColumn("Drawn triangles");
+			ImGui::TableHeadersRow();
+			for (uint32_t lod = 0; lod < MAX_MESH_LODS; lod++) {
+				if (cullStats.lodInstances[lod] == 0) {
+					continue;
+				}
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", lod);
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", cullStats.lodInstances[lod]);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", (unsigned long long)cullStats.lodSelectedTriangles[lod]);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", (unsigned long long)cullStats.lodDrawnTriangles[lod]);
+			}
+			ImGui::EndTable();
+		}
+	}
+	ImGui::End();
+}
 
-	vkCmdBeginRendering(cmd, &renderInfo);
+void VulkanEngine::draw_governor_window() {
+	if (ImGui::Begin("Frame Rate Governor")) {
+		// utilization with the governor on and off is kept apart, so toggling it shows what it saves
+		FrameGovernor::Stats governorStats = mFrameGovernor.get_stats();
+		static const char* governorModes[] = { "active", "throttled (unfocused)", "idle (on demand)", "hidden" };
+		ImGui::Checkbox("Enabled", &mFrameGovernor.mSettings.bEnabled);
+		ImGui::SameLine();
+		ImGui::Text("mode: %s", governorModes[(uint32_t)governorStats.mode]);
+		ImGui::SliderFloat("Unfocused rate (fps)", &mFrameGovernor.mSettings.unfocusedFrameRate, 1.f, 60.f, "%.0f");
+		ImGui::SliderFloat("Settle time (s)", &mFrameGovernor.mSettings.settleTime, 0.f, 10.f, "%.1f");
+		ImGui::Text("Now: %.1f fps, CPU %.0f%% of a core, GPU %.0f%%", governorStats.current.frameRate, governorStats.current.cpu * 100.f,
+			governorStats.current.gpu * 100.f);
+		ImGui::Text("Governed: %.1f fps, CPU %.0f%%, GPU %.0f%%", governorStats.governed.frameRate, governorStats.governed.cpu * 100.f,
+			governorStats.governed.gpu * 100.f);
+		ImGui::Text("Ungoverned: %.1f fps, CPU %.0f%%, GPU %.0f%%", governorStats.ungoverned.frameRate, governorStats.ungoverned.cpu * 100.f,
+			governorStats.ungoverned.gpu * 100.f);
+	}
+	ImGui::End();
+}
 
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+void VulkanEngine::draw_render_targets_window() {
+	if (ImGui::Begin("Render Targets")) {
+		// device memory of the render targets: targets sharing an allocation never live at the same time within a frame
+		RenderTargetPool::Stats targetStats = mRenderTargets.get_stats();
+		ImGui::Text("%.1f MB in %u allocations (%.1f MB without aliasing), %.1f MB lazily allocated",
+			targetStats.allocatedBytes / (1024.0 * 1024.0), targetStats.allocationCount, targetStats.requestedBytes / (1024.0 * 1024.0),
+			targetStats.lazyBytes / (1024.0 * 1024.0));
+		for (const RenderTargetPool::TargetInfo& target : mRenderTargets.get_targets()) {
+			ImGui::Text("  %s: %.1f MB, allocation %u%s", target.name.c_str(), target.size / (1024.0 * 1024.0), target.allocationIndex,
+				target.bLazy ? " (lazy)" : "");
+		}
+	}
+	ImGui::End();
+}
 
-	vkCmdEndRendering(cmd);
+void VulkanEngine::draw_ui_window() {
+	if (ImGui::Begin("UI")) {
+		// CPU cost of the UI itself; geometry is only copied when it changed since the frame slot last drew it
+		UiRenderer::Stats uiStats = mUiRenderer.get_stats();
+		ImGui::Text("Vertices: %u, indices: %u, draws: %u", uiStats.vertexCount, uiStats.indexCount, uiStats.drawCalls);
+		ImGui::Text("Hash %.3f ms, upload %.3f ms (%.1f KB), record %.3f ms", uiStats.hashTime, uiStats.uploadTime,
+			uiStats.uploadedBytes / 1024.f, uiStats.recordTime);
+		ImGui::Text("Uploads skipped: %llu", (unsigned long long)uiStats.skippedUploads);
+		// ImGui destroys the platform windows of secondary viewports once this is cleared, and recreates them when set again
+		bool bViewports = (ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable) != 0;
+		if (ImGui::Checkbox("Windows outside the main window (viewports)", &bViewports)) {
+			ImGui::GetIO().ConfigFlags ^= ImGuiConfigFlags_ViewportsEnable;
+		}
+		for (const UiRenderer::ViewportCost& cost : mUiRenderer.get_viewport_costs()) {
+			ImGui::Text("  Viewport %08x: render %.3f ms, present %.3f ms", cost.id, cost.renderTime, cost.presentTime);
+		}
+	}
+	ImGui::End();
+}
 
-	// Allow the IMGUI UI to be dragged out of the render window
-	ImGuiIO& io = ImGui::GetIO();
-	if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
-		ImGui::UpdatePlatformWindows();
-		ImGui::RenderPlatformWindowsDefault();
+void VulkanEngine::draw_background_settings_window() {
+	if (ImGui::Begin("Background")) {
+		ImGui::ColorEdit3("Top", &mBackground.topColor.x, ImGuiColorEditFlags_Float | ImGuiColorEditFlags_HDR);
+		ImGui::ColorEdit3("Bottom", &mBackground.bottomColor.x, ImGuiColorEditFlags_Float | ImGuiColorEditFlags_HDR);
+		ImGui::SliderFloat2("Sun position", &mBackground.sun.x, 0.f, 1.f);
+		ImGui::SliderFloat("Sun radius", &mBackground.sun.z, 0.f, 0.5f);
+		ImGui::SliderFloat("Sun intensity", &mBackground.sun.w, 0.f, 1000.f, "%.1f", ImGuiSliderFlags_Logarithmic);
 	}
+	ImGui::End();
+}
+
+void VulkanEngine::draw_lights_window() {
+	if (ImGui::Begin("Lights")) {
+		// froxel lists built by the GPU pass show up as the "Light binning" GPU scope, CPU binning is timed here
+		ClusteredLighting::Stats lightingStats = mLighting.get_stats();
+		int binning = (int)mLighting.mSettings.binning;
+		if (ImGui::Combo("Binning", &binning, "GPU (compute)\0CPU (job system)\0")) {
+			mLighting.mSettings.binning = (ClusteredLighting::BinningMode)binning;
+		}
+		ImGui::Text("Point lights: %u", lightingStats.lightCount);
+		if (lightingStats.binning == ClusteredLighting::BinningMode::Cpu) {
+			ImGui::Text("CPU binning: %.3f ms", lightingStats.cpuBinningTime);
+			ImGui::Text("Fullest froxel: %u lights, %llu references (%llu dropped)", lightingStats.binningStats.maxLightsPerCluster,
+				(unsigned long long)lightingStats.binningStats.lightReferences, (unsigned long long)lightingStats.binningStats.droppedReferences);
+		}
+		ImGui::SeparatorText("Scatter around the camera");
+		ImGui::InputInt("Count", &mLightCountInput);
+		ImGui::SliderFloat("Spread", &mLightSpreadInput, 1.f, 200.f, "%.1f", ImGuiSliderFlags_Logarithmic);
+		ImGui::SliderFloat("Radius", &mLightRadiusInput, 0.1f, 50.f, "%.2f", ImGuiSliderFlags_Logarithmic);
+		if (ImGui::Button("Scatter")) {
+			glm::vec3 extent(mLightSpreadInput);
+			mLights = ClusteredLighting::generate_random_lights((uint32_t)std::max(mLightCountInput, 0), mCamera.mPosition - extent,
+				mCamera.mPosition + extent, mLightRadiusInput, 4.f, (uint32_t)mLights.size() + 1);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Clear")) {
+			mLights.clear();
+		}
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::draw_shadows_window() {
+	if (ImGui::Begin("Shadows")) {
+		// rendered cascades show up as the "Shadows" GPU scope; cached ones cost nothing but their lookups
+		CascadedShadowMaps::Settings& shadows = mShadows.mSettings;
+		CascadedShadowMaps::Stats shadowStats = mShadows.get_stats();
+		ImGui::Checkbox("Enabled", &shadows.bEnabled);
+		ImGui::SliderFloat3("Sun direction", &mSunDirection.x, -1.f, 1.f);
+		ImGui::SliderFloat("Distance", &shadows.maxDistance, 10.f, 1000.f, "%.0f", ImGuiSliderFlags_Logarithmic);
+		ImGui::SliderFloat("Split lambda", &shadows.splitLambda, 0.f, 1.f);
+		ImGui::SliderFloat("Caster distance", &shadows.casterDistance, 0.f, 1000.f, "%.0f", ImGuiSliderFlags_Logarithmic);
+		ImGui::SliderFloat("Depth bias", &shadows.depthBiasConstant, 0.f, 8.f);
+		ImGui::SliderFloat("Slope bias", &shadows.depthBiasSlope, 0.f, 8.f);
+		ImGui::Checkbox("Stabilize", &shadows.bStabilize);
+		ImGui::SameLine();
+		ImGui::Checkbox("Cache", &shadows.bCacheStatic);
+		ImGui::SameLine();
+		ImGui::Checkbox("Record in parallel", &shadows.bParallelRecording);
+		ImGui::Text("Cascades: %u rendered, %u cached", shadowStats.renderedCascades, shadowStats.cachedCascades);
+		ImGui::Text("Recording: %.3f ms (%.3f ms over all threads)", shadowStats.recordTime, shadowStats.recordThreadTime);
+		ImGui::Text("Splits: %.1f, %.1f, %.1f, %.1f", shadowStats.splits[0], shadowStats.splits[1], shadowStats.splits[2], shadowStats.splits[3]);
+		ImGui::Text("Triangles drawn: %llu", (unsigned long long)mClusterRenderer.get_stats().depthViewDrawnTriangles);
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::draw_anti_aliasing_window() {
+	if (ImGui::Begin("Anti-aliasing")) {
+		TemporalAntiAliasing::Settings& taa = mTemporalAA.mSettings;
+		ImGui::Checkbox("TAA", &taa.bEnabled);
+		ImGui::SliderFloat("Current frame weight", &taa.currentWeight, 0.02f, 1.f, "%.2f", ImGuiSliderFlags_Logarithmic);
+		ImGui::SliderFloat("Clip gamma", &taa.clipGamma, 0.5f, 4.f);
+		ImGui::Checkbox("Sharp history", &taa.bSharpHistory);
+
+		// below 1, TAA upscales to the output; without TAA, the blit into the swapchain does
+		ImGui::SeparatorText("Resolution");
+		ImGui::Checkbox("Dynamic", &mResolution.bDynamic);
+		if (mResolution.bDynamic) {
+			ImGui::SliderFloat("Target scene time (ms)", &mResolution.targetSceneTime, 1.f, 33.f);
+			ImGui::SliderFloat("Min scale", &mResolution.minScale, 0.25f, 1.f);
+		}
+		else {
+			ImGui::SliderFloat("Render scale", &mResolution.renderScale, 0.25f, 1.f);
+		}
+		ImGui::Text("Render %ux%u, output %ux%u", mDrawExtent.width, mDrawExtent.height, mResolvedExtent.width, mResolvedExtent.height);
+		for (const GpuProfiler::ScopeResult& scope : mGpuProfiler.get_results()) {
+			if (scope.name == "Scene" || scope.name == "TAA") {
+				ImGui::Text("%s: %.3f ms", scope.name.c_str(), scope.end - scope.begin);
+			}
+		}
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::draw_post_process_window() {
+	if (ImGui::Begin("Post Processing")) {
+		PostProcessSettings& post = mPostProcess.mSettings;
+		ImGui::Checkbox("Enabled", &post.bEnabled);
+		ImGui::Combo("Tonemapper", &post.tonemapper, "ACES\0Filmic\0Reinhard\0None\0");
+		ImGui::Checkbox("Auto exposure", &post.bAutoExposure);
+		if (post.bAutoExposure) {
+			ImGui::SliderFloat("Adaptation speed", &post.adaptationSpeed, 0.1f, 10.f);
+			ImGui::DragFloatRange2("Log luminance range", &post.minLogLuminance, &post.maxLogLuminance, 0.1f, -16.f, 16.f);
+		}
+		else {
+			ImGui::SliderFloat("Exposure", &post.manualExposure, 0.01f, 16.f, "%.2f", ImGuiSliderFlags_Logarithmic);
+		}
+		ImGui::SliderFloat("Exposure compensation (EV)", &post.exposureCompensation, -5.f, 5.f);
+		ImGui::Checkbox("Bloom", &post.bBloom);
+		if (post.bBloom) {
+			ImGui::SliderFloat("Bloom intensity", &post.bloomIntensity, 0.f, 1.f);
+			ImGui::SliderFloat("Bloom threshold", &post.bloomThreshold, 0.f, 10.f);
+			ImGui::SliderFloat("Bloom knee", &post.bloomKnee, 0.f, 5.f);
+			ImGui::SliderFloat("Bloom radius", &post.bloomFilterRadius, 0.5f, 4.f);
+			ImGui::SliderInt("Bloom mips", &post.bloomMipCount, 1, PostProcessChain::MAX_BLOOM_MIPS);
+		}
+
+		// GPU cost of each post pass, as measured on whichever queue it ran on
+		ImGui::SeparatorText("GPU cost");
+		double postTotal = 0.0;
+		for (const GpuProfiler::ScopeResult& scope : mGpuProfiler.get_results()) {
+			if (scope.name.rfind("Post:", 0) == 0) {
+				ImGui::Text("%s: %.3f ms", scope.name.c_str(), scope.end - scope.begin);
+				postTotal += scope.end - scope.begin;
+			}
+		}
+		ImGui::Text("Total: %.3f ms", postTotal);
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::draw_assets_window() {
+	if (ImGui::Begin("Assets")) {
+		ImGui::InputText("glTF file", mScenePathInput, sizeof(mScenePathInput));
+		if (ImGui::Button("Load") && mScenePathInput[0] != '\0') {
+			load_scene(mScenePathInput);
+		}
+
+		if (mAssetArchive) {
+			ImGui::Text("Archive: %zu entries", mAssetArchive->get_entries().size());
+		}
+		else {
+			ImGui::TextUnformatted("Archive: none, loading loose files");
+		}
+		ImGui::InputText("KTX2 texture", mTexturePathInput, sizeof(mTexturePathInput));
+		if (ImGui::Button("Load texture") && mTexturePathInput[0] != '\0') {
+			load_texture(mTexturePathInput);
+		}
+
+		GltfLoader::Stats loadStats = mSceneLoader.get_stats();
+		ImGui::Text("Loading: %u, meshes resident: %u / %u, nodes: %zu", loadStats.activeLoads, loadStats.residentMeshes,
+			loadStats.totalMeshes, mSceneLoader.get_nodes().size());
+		// world transforms recomputed this frame: only entities whose transform (or an ancestor's) changed
+		EntityStore::Stats entityStats = mEntities.get_stats();
+		ImGui::Text("Entities: %u in %u depths, %u transforms updated in %.3f ms%s", entityStats.entityCount, entityStats.depthCount,
+			entityStats.updatedTransforms, entityStats.updateTime, entityStats.bSorted ? " (sorted)" : "");
+		DynamicBvh::Stats bvhStats = mSceneBvh.get_stats();
+		ImGui::Text("Scene BVH: %u objects in %u nodes (%u pending), %zu in view in %.3f ms, %u rebuilds, area %.2fx", bvhStats.objectCount,
+			bvhStats.nodeCount, bvhStats.pendingCount, mVisibleEntities.size(), mVisibilityQueryTime, bvhStats.rebuildCount, bvhStats.areaRatio);
+		ImGui::SeparatorText("Last load");
+		ImGui::Text("Source: %.1f MB in %.2f s (%.1f MB/s)", loadStats.sourceBytes / (1024.0 * 1024.0), loadStats.loadTime, loadStats.sourceThroughput);
+		ImGui::Text("Packed geometry: %.1f MB, worker time %.2f s", loadStats.geometryBytes / (1024.0 * 1024.0), loadStats.workerTime);
+		ImGui::Text("Vertex cache miss ratio: %.3f -> %.3f", loadStats.acmrBefore, loadStats.acmrAfter);
+
+		StagingUploader::Stats uploadStats = mUploader.get_stats();
+		GeometryBufferPool::Stats vertexStats = mVertexBuffers.get_stats();
+		GeometryBufferPool::Stats indexStats = mIndexBuffers.get_stats();
+		ImGui::SeparatorText("Streaming");
+		ImGui::Text("Uploads pending: %u (%.1f MB), chunks in flight: %u", uploadStats.pendingUploads,
+			uploadStats.pendingBytes / (1024.0 * 1024.0), uploadStats.chunksInFlight);
+		ImGui::Text("Vertex pool: %.1f / %.1f MB in %u pages", vertexStats.usedBytes / (1024.0 * 1024.0), vertexStats.reservedBytes / (1024.0 * 1024.0), vertexStats.pageCount);
+		ImGui::Text("Index pool: %.1f / %.1f MB in %u pages", indexStats.usedBytes / (1024.0 * 1024.0), indexStats.reservedBytes / (1024.0 * 1024.0), indexStats.pageCount);
+
+		TextureStreamer::Stats textureStats = mTextureStreamer.get_stats();
+		ImGui::SeparatorText("Textures");
+		ImGui::Text("Resident: %u / %u, streaming: %u, on screen: %u", textureStats.residentTextures, textureStats.textureCount,
+			textureStats.streamingTextures, textureStats.requestedTextures);
+		ImGui::Text("Memory: %.1f / %.1f MB, streamed %.1f MB, levels evicted: %u", textureStats.residentBytes / (1024.0 * 1024.0),
+			textureStats.memoryBudget / (1024.0 * 1024.0), textureStats.streamedBytes / (1024.0 * 1024.0), textureStats.evictedLevels);
+		int budgetMegabytes = (int)(textureStats.memoryBudget >> 20);
+		if (ImGui::SliderInt("Budget (MB)", &budgetMegabytes, 16, 4096)) {
+			mTextureStreamer.set_memory_budget((VkDeviceSize)budgetMegabytes << 20);
+		}
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::draw_capture_window() {
+	if (ImGui::Begin("Capture")) {
+		ImGui::InputText("Directory", mCaptureDirectoryInput, sizeof(mCaptureDirectoryInput));
+		ImGui::Combo("Format", &mCaptureFormatInput, "PNG\0EXR (linear RGBA16F)\0Raw RGBA8\0");
+		ImGui::InputInt("Frames (0: until stopped)", &mCaptureFrameCountInput);
+		mCaptureFrameCountInput = std::max(mCaptureFrameCountInput, 0);
+		if (mCapture.is_capturing()) {
+			if (ImGui::Button("Stop")) {
+				mCapture.stop();
+			}
+		}
+		else if (ImGui::Button("Start")) {
+			start_capture(mCaptureDirectoryInput, (CaptureFormat)mCaptureFormatInput, (uint32_t)mCaptureFrameCountInput);
+		}
+
+		FrameCapture::Stats captureStats = mCapture.get_stats();
+		ImGui::Text("Written: %u, pending: %u, dropped: %u, deferred: %u", captureStats.writtenFrames, captureStats.pendingFrames,
+			captureStats.droppedFrames, captureStats.deferredFrames);
+		ImGui::Text("Last encode: %.2f ms (on a worker)", captureStats.lastEncodeTime);
+
+		// what frames are made of and what they cost, for SunabaReplay
+		ImGui::SeparatorText("Recording");
+		ImGui::InputText("File", mRecordingPathInput, sizeof(mRecordingPathInput));
+		ImGui::InputInt("Recorded frames (0: until stopped)", &mRecordingFrameCountInput);
+		mRecordingFrameCountInput = std::max(mRecordingFrameCountInput, 0);
+		if (mRecorder.is_recording()) {
+			if (ImGui::Button("Stop recording")) {
+				stop_recording();
+			}
+		}
+		else if (mRecorder.is_active()) {
+			ImGui::TextUnformatted("Waiting for GPU results");
+		}
+		else if (ImGui::Button("Start recording")) {
+			start_recording(mRecordingPathInput, (uint32_t)mRecordingFrameCountInput);
+		}
+		ImGui::Text("Recorded: %u frames", mRecorder.get_recorded_frames());
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::draw_pipeline_statistics_window() {
+	if (ImGui::Begin("Pipeline Statistics")) {
+		if (!mPipelineStatistics.is_enabled()) {
+			ImGui::TextUnformatted("Not supported by this device");
+		}
+		// counters of the last frame whose queries are back; compute-only queues record nothing but compute invocations
+		else if (ImGui::BeginTable("passes", 2 + GpuPipelineStatistics::COUNTER_COUNT,
+			ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollX)) {
+			ImGui::TableSetupColumn("Pass");
+			ImGui::TableSetupColumn("Queue");
+			for (uint32_t counter = 0; counter < GpuPipelineStatistics::COUNTER_COUNT; counter++) {
+				ImGui::TableSetupColumn(GpuPipelineStatistics::get_counter_name((GpuPipelineStatistics::Counter)counter));
+			}
+			ImGui::TableHeadersRow();
+			for (const GpuPipelineStatistics::ScopeResult& scope : mPipelineStatistics.get_results()) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(scope.name.c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(scope.queue == GpuQueueTrack::Compute ? "compute" : "graphics");
+				for (uint32_t counter = 0; counter < GpuPipelineStatistics::COUNTER_COUNT; counter++) {
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", (unsigned long long)scope.counters[counter]);
+				}
+			}
+			ImGui::EndTable();
+		}
+
+		// the exports average every pass over the frames since the last reset, for comparing builds offline
+		const std::vector<GpuPipelineStatistics::ScopeTotals>& totals = mPipelineStatistics.get_totals();
+		ImGui::Text("Frames averaged: %llu", totals.empty() ? 0ull : (unsigned long long)totals.front().frameCount);
+		ImGui::SameLine();
+		if (ImGui::Button("Reset")) {
+			mPipelineStatistics.reset_totals();
+		}
+		ImGui::InputText("Export path", mPipelineStatisticsPathInput, sizeof(mPipelineStatisticsPathInput));
+		if (ImGui::Button("Export CSV")) {
+			std::string path = std::string(mPipelineStatisticsPathInput) + ".csv";
+			mPipelineStatisticsExportStatus = (mPipelineStatistics.export_csv(path) ? "wrote " : "could not write ") + path;
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Export JSON")) {
+			std::string path = std::string(mPipelineStatisticsPathInput) + ".json";
+			mPipelineStatisticsExportStatus = (mPipelineStatistics.export_json(path) ? "wrote " : "could not write ") + path;
+		}
+		if (!mPipelineStatisticsExportStatus.empty()) {
+			ImGui::TextUnformatted(mPipelineStatisticsExportStatus.c_str());
+		}
+	}
+	ImGui::End();
+}
+void VulkanEngine::draw_tuning_window() {
+	if (ImGui::Begin("Tuning")) {
+		// runtime settings apply once an edit is done, so dragging a slider does not restart the measurement every frame
+		ImGui::SeparatorText("Runtime");
+		bool bChanged = false;
+		ImGui::SliderFloat("Render scale", &mTuningInput.renderScale, 0.1f, 1.f);
+		bChanged |= ImGui::IsItemDeactivatedAfterEdit();
+		static const VkPresentModeKHR presentModes[] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+			VK_PRESENT_MODE_IMMEDIATE_KHR };
+		int presentModeIndex = 0;
+		for (int i = 0; i < 4; i++) {
+			if (presentModes[i] == mTuningInput.presentMode) {
+				presentModeIndex = i;
+			}
+		}
+		if (ImGui::Combo("Present mode", &presentModeIndex, "fifo\0fifo_relaxed\0mailbox\0immediate\0")) {
+			mTuningInput.presentMode = presentModes[presentModeIndex];
+			bChanged = true;
+		}
+		if (!mHeadless && mPresentMode != mConfig.presentMode) {
+			ImGui::Text("Not supported by the surface, presenting with %s", EngineConfig::get_present_mode_name(mPresentMode));
+		}
+		ImGui::SliderFloat("Descriptor pool growth", &mTuningInput.descriptorGrowthFactor, 1.f, 8.f);
+		bChanged |= ImGui::IsItemDeactivatedAfterEdit();
+		int poolSetCap = (int)mTuningInput.descriptorPoolSetCap;
+		ImGui::InputInt("Descriptor pool set cap", &poolSetCap);
+		mTuningInput.descriptorPoolSetCap = (uint32_t)std::clamp(poolSetCap, 1, 1 << 20);
+		bChanged |= ImGui::IsItemDeactivatedAfterEdit();
+		int uploadBudget = (int)mTuningInput.uploadBudgetMB;
+		ImGui::SliderInt("Upload budget (MB per frame)", &uploadBudget, 1, 4096, "%d", ImGuiSliderFlags_Logarithmic);
+		mTuningInput.uploadBudgetMB = (uint32_t)uploadBudget;
+		bChanged |= ImGui::IsItemDeactivatedAfterEdit();
+		if (bChanged) {
+			apply_config(mTuningInput);
+		}
+
+		// means since the last change (or reset); vsync and the frame rate governor cap what any change can show
+		ImGui::SeparatorText("Frame time");
+		double meanTime = mTuningFrames > 0 ? mTuningTimeSum / mTuningFrames : 0.0;
+		if (mTuningChange.empty()) {
+			ImGui::Text("Mean: %.3f ms over %u frames", meanTime, mTuningFrames);
+		}
+		else {
+			ImGui::TextWrapped("Last change: %s", mTuningChange.c_str());
+			ImGui::Text("Before: %.3f ms, after: %.3f ms over %u frames (%+.1f%%)", mTuningTimeBefore, meanTime, mTuningFrames,
+				mTuningTimeBefore > 0.0 ? (meanTime / mTuningTimeBefore - 1.0) * 100.0 : 0.0);
+		}
+		if (ImGui::Button("Restart measurement")) {
+			mTuningTimeSum = 0.0;
+			mTuningFrames = 0;
+		}
+
+		// startup settings only take effect through a config file the next run loads (--config or SUNABA_CONFIG)
+		ImGui::SeparatorText("Startup (saved for the next run)");
+		int framesInFlight = (int)mTuningInput.framesInFlight;
+		ImGui::SliderInt("Frames in flight", &framesInFlight, 1, (int)EngineConfig::MAX_FRAMES_IN_FLIGHT);
+		mTuningInput.framesInFlight = (uint32_t)framesInFlight;
+		int windowSize[2] = { (int)mTuningInput.windowWidth, (int)mTuningInput.windowHeight };
+		ImGui::InputInt2("Window size", windowSize);
+		mTuningInput.windowWidth = (uint32_t)std::clamp(windowSize[0], 1, 16384);
+		mTuningInput.windowHeight = (uint32_t)std::clamp(windowSize[1], 1, 16384);
+		int drawFormat = mTuningInput.drawFormat == VK_FORMAT_R32G32B32A32_SFLOAT ? 1 : 0;
+		if (ImGui::Combo("Draw format", &drawFormat, "rgba16f\0rgba32f\0")) {
+			mTuningInput.drawFormat = drawFormat == 1 ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R16G16B16A16_SFLOAT;
+		}
+		ImGui::InputText("Config file", mConfigPathInput, sizeof(mConfigPathInput));
+		if (ImGui::Button("Save")) {
+			// runtime settings are saved as last applied, startup ones as edited
+			EngineConfig saved = mTuningInput;
+			saved.renderScale = mConfig.renderScale;
+			saved.presentMode = mConfig.presentMode;
+			saved.descriptorGrowthFactor = mConfig.descriptorGrowthFactor;
+			saved.descriptorPoolSetCap = mConfig.descriptorPoolSetCap;
+			saved.uploadBudgetMB = mConfig.uploadBudgetMB;
+			mConfigSaveStatus = (saved.save_file(mConfigPathInput) ? "wrote " : "could not write ") + std::string(mConfigPathInput);
+		}
+		if (!mConfigSaveStatus.empty()) {
+			ImGui::TextUnformatted(mConfigSaveStatus.c_str());
+		}
+		ImGui::TextWrapped("Running with: %s", mConfig.to_string().c_str());
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::record_frame_state(VkExtent2D outputExtent) {
+	RecordedFrame frame;
+	frame.deltaTime = mFixedDeltaTime > 0.f ? mFixedDeltaTime : engineStatistics.frametime / 1000.f;
+	frame.outputWidth = outputExtent.width;
+	frame.outputHeight = outputExtent.height;
+	frame.renderScale = mResolution.renderScale;
+	frame.cameraPosition = mCamera.mPosition;
+	frame.cameraYaw = mCamera.mYaw;
+	frame.cameraPitch = mCamera.mPitch;
+	frame.cameraVerticalFov = mCamera.mVerticalFov;
+	frame.cameraNearPlane = mCamera.mNearPlane;
+	frame.cameraFarPlane = mCamera.mFarPlane;
+	frame.sunDirection = mSunDirection;
+	frame.background[0] = mBackground.topColor;
+	frame.background[1] = mBackground.bottomColor;
+	frame.background[2] = mBackground.sun;
+	frame.background[3] = mBackground.data;
+	frame.postProcess = mPostProcess.mSettings;
+	frame.temporalAA = mTemporalAA.mSettings;
+	frame.shadows = mShadows.mSettings;
+	frame.lighting = mLighting.mSettings;
+	frame.clusters = mClusterRenderer.mSettings;
+	frame.staticPasses = mStaticPasses.mSettings;
+	frame.visibleNodesFirst = mVisibleNodesFirst;
+	frame.visibleNodesCount = mVisibleNodesCount;
+	mRecorder.record_frame(mCurrentFrameNumber, frame, mLights);
+}
+
+void VulkanEngine::update_render_scale() {
+	// the draw image caps the resolution, so the scale never goes above 1
+	if (!mResolution.bDynamic) {
+		mResolution.renderScale = std::clamp(mResolution.renderScale, 0.1f, 1.f);
+		return;
+	}
+
+	double sceneTime = 0.0;
+	for (const GpuProfiler::ScopeResult& scope : mGpuProfiler.get_results()) {
+		if (scope.name == "Scene") {
+			sceneTime = scope.end - scope.begin;
+		}
+	}
+	if (sceneTime > 0.0) {
+		// scene cost goes with the pixel count, i.e. the square of the scale; small steps keep it from oscillating on noise
+		float correction = (float)std::sqrt(mResolution.targetSceneTime / sceneTime);
+		mResolution.renderScale *= std::clamp(correction, 0.95f, 1.05f);
+	}
+	mResolution.renderScale = std::clamp(mResolution.renderScale, std::clamp(mResolution.minScale, 0.1f, 1.f), 1.f);
+}
+
+void VulkanEngine::draw_background(VkCommandBuffer cmd, VkPipeline pipeline) {
+	// the background writes every pixel of the draw extent, so no clear is needed. The slot's image was last read by the
+	// composite of the frame that used the slot before, which its fence covers: nothing earlier on the queue has to finish
+	vkutil::transition_image(cmd, mDrawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+	BackgroundSettings constants = mBackground;
+	constants.data.x = (float)mDrawExtent.width;
+	constants.data.y = (float)mDrawExtent.height;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mBackgroundPipelineLayout, 0, 1, &get_current_frame().mBackgroundSet, 0, nullptr);
+	vkCmdPushConstants(cmd, mBackgroundPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BackgroundSettings), &constants);
+	// 16x16 workgroups
+	vkCmdDispatch(cmd, (mDrawExtent.width + 15) / 16, (mDrawExtent.height + 15) / 16, 1);
+}
+
+void VulkanEngine::sync_scene_entities() {
+	const std::vector<SceneNode>& nodes = mSceneLoader.get_nodes();
+	// parents come before their children, so a parent's entity always exists by the time its children are created
+	for (size_t i = mSceneNodeEntities.size(); i < nodes.size(); i++) {
+		const SceneNode& node = nodes[i];
+		Entity entity = mEntities.create(node.parent != SceneNode::NO_PARENT ? mSceneNodeEntities[node.parent] : Entity());
+		mEntities.set_local_transform(entity, node.localTransform);
+		mEntities.set_mesh(entity, get_visible_node_mesh((uint32_t)i));
+		mSceneNodeEntities.push_back(entity);
+	}
+}
+
+uint32_t VulkanEngine::get_visible_node_mesh(uint32_t node) const {
+	const SceneNode& sceneNode = mSceneLoader.get_nodes()[node];
+	// the count may be UINT32_MAX, so the range is tested without adding it to first
+	bool bVisible = node >= mVisibleNodesFirst && node - mVisibleNodesFirst < mVisibleNodesCount;
+	return bVisible && sceneNode.meshIndex != SceneNode::NO_MESH ? sceneNode.meshIndex : EntityStore::NO_MESH;
+}
+
+void VulkanEngine::set_visible_scene_nodes(uint32_t first, uint32_t count) {
+	mVisibleNodesFirst = first;
+	mVisibleNodesCount = count;
+	// entities that lose or regain their mesh leave or rejoin the scene BVH with the next frame
+	for (uint32_t i = 0; i < (uint32_t)mSceneNodeEntities.size(); i++) {
+		mEntities.set_mesh(mSceneNodeEntities[i], get_visible_node_mesh(i));
+	}
+}
+
+void VulkanEngine::update_scene_bvh() {
+	const std::vector<std::unique_ptr<MeshAsset>>& meshes = mSceneLoader.get_meshes();
+	std::span<const Entity> entities = mEntities.get_entities();
+	std::span<const glm::mat4> transforms = mEntities.get_world_transforms();
+	std::span<const uint32_t> meshIndices = mEntities.get_mesh_indices();
+
+	// destroyed entities leave the tree first, so a slot reused by a new entity starts over
+	for (SceneBvhEntry& entry : mSceneBvhEntries) {
+		if (entry.object != DynamicBvh::INVALID_OBJECT && !mEntities.is_alive(entry.entity)) {
+			mSceneBvh.remove(entry.object);
+			entry.object = DynamicBvh::INVALID_OBJECT;
+			mSceneVersion++;
+		}
+	}
+
+	for (uint32_t i = 0; i < (uint32_t)entities.size(); i++) {
+		uint32_t slot = entities[i].index();
+		if (slot >= mSceneBvhEntries.size()) {
+			mSceneBvhEntries.resize(slot + 1, { Entity(), EntityStore::NO_MESH, DynamicBvh::INVALID_OBJECT });
+		}
+		SceneBvhEntry& entry = mSceneBvhEntries[slot];
+		const MeshAsset* mesh = meshIndices[i] < meshes.size() ? meshes[meshIndices[i]].get() : nullptr;
+		if (!mesh || !mesh->bResident) {
+			if (entry.object != DynamicBvh::INVALID_OBJECT) {
+				mSceneBvh.remove(entry.object);
+				entry.object = DynamicBvh::INVALID_OBJECT;
+				mSceneVersion++;
+			}
+			continue;
+		}
+
+		if (entry.object == DynamicBvh::INVALID_OBJECT) {
+			entry = { entities[i], meshIndices[i], mSceneBvh.insert(Aabb::transformed(mesh->boundsMin, mesh->boundsMax, transforms[i]), entities[i].id) };
+			mSceneVersion++;
+		}
+		else if (mEntities.is_world_updated(i) || entry.meshIndex != meshIndices[i]) {
+			entry.meshIndex = meshIndices[i];
+			mSceneBvh.update(entry.object, Aabb::transformed(mesh->boundsMin, mesh->boundsMax, transforms[i]));
+			mSceneVersion++;
+		}
+	}
+	mSceneBvh.maintain();
+}
+
+void VulkanEngine::draw_scene(VkCommandBuffer cmd) {
+	float aspectRatio = (float)mDrawExtent.width / (float)std::max(mDrawExtent.height, 1u);
+	SceneView view;
+	view.view = mCamera.get_view_matrix();
+	// everything of the scene is drawn jittered; the resolve reprojects with the plain projection
+	glm::mat4 projection = mCamera.get_projection_matrix(aspectRatio);
+	view.projection = mTemporalAA.jitter_projection(projection, mDrawExtent, mResolvedExtent);
+	view.cameraPosition = mCamera.mPosition;
+	view.sunDirection = glm::vec4(mSunDirection, view.sunDirection.w);
+	// the sky light matches the background the scene is drawn over
+	view.skyColor = mBackground.topColor;
+	view.groundColor = mBackground.bottomColor;
+
+	// whole entities in view, for CPU-side work that does not need the GPU's cluster precision
+	auto queryStart = std::chrono::steady_clock::now();
+	glm::vec4 frustumPlanes[6];
+	extract_frustum_planes(view.projection * view.view, frustumPlanes);
+	mVisibleEntities.clear();
+	mSceneBvh.query_frustum(frustumPlanes, mVisibleEntities);
+	mVisibilityQueryTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - queryStart).count();
+
+	// froxels follow the camera's own planes, which the projection was built from
+	ClusteredLighting::ViewParameters lightingView;
+	lightingView.view = view.view;
+	lightingView.projectionScale = glm::vec2(view.projection[0][0], view.projection[1][1]);
+	lightingView.nearPlane = mCamera.mNearPlane;
+	lightingView.farPlane = mCamera.mFarPlane;
+	uint32_t binningScope = mGpuProfiler.begin_scope(cmd, "Light binning");
+	view.lighting = mLighting.update(cmd, mCurrentFrameNumber, lightingView, mDrawExtent, mLights);
+	mGpuProfiler.end_scope(cmd, binningScope);
+
+	// cascades that changed are culled along with the camera's view, then rendered before the scene pass samples them
+	CascadedShadowMaps::CameraParameters shadowCamera = { view.view, mCamera.mVerticalFov, aspectRatio, mCamera.mNearPlane };
+	std::span<const glm::mat4> shadowViews = mShadows.update(mCurrentFrameNumber, shadowCamera, mSunDirection, mSceneVersion);
+
+	mClusterRenderer.cull(cmd, mCurrentFrameNumber, get_current_frame().mFrameDescriptors, mDrawExtent, view, shadowViews,
+		mSceneLoader.get_meshes(), mEntities.get_entities(), mEntities.get_mesh_indices(), mEntities.get_world_transforms(), mVertexBuffers,
+		mIndexBuffers, mMeshletBuffers);
+
+	uint32_t shadowScope = mGpuProfiler.begin_scope(cmd, "Shadows");
+	mShadows.render(cmd, mCurrentFrameNumber, mClusterRenderer);
+	mGpuProfiler.end_scope(cmd, shadowScope);
+	view.shadows = mShadows.get_scene_shadows(mCurrentFrameNumber);
+	view.textures.heap = mTextureStreamer.get_set();
+	view.textures.table = mTextureStreamer.get_table_address(mCurrentFrameNumber);
+	view.textures.feedback = mTextureStreamer.get_feedback_address(mCurrentFrameNumber);
+	view.textures.frameNumber = mTextureStreamer.get_frame_number();
+
+	mClusterRenderer.draw(cmd, mCurrentFrameNumber, get_current_frame().mFrameDescriptors, mDrawImage, mDrawExtent, view);
+
+	// the draw image holds the frame at mResolvedExtent from here on
+	if (mTemporalAA.mSettings.bEnabled) {
+		uint32_t taaScope = mGpuProfiler.begin_scope(cmd, "TAA");
+		mTemporalAA.resolve(cmd, get_current_frame().mFrameDescriptors, mDrawImage, mClusterRenderer.get_scene_depth(), mDrawExtent,
+			mResolvedExtent, projection * view.view);
+		mGpuProfiler.end_scope(cmd, taaScope);
+	}
+}
+
+void VulkanEngine::draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView)
+{
+	mUiRenderer.draw(cmd, mCurrentFrameNumber, ImGui::GetDrawData(), targetImageView, mSwapchainExtent);
+
+	// Allow the IMGUI UI to be dragged out of the render window
+	mUiRenderer.render_platform_windows();
 }
\ No newline at end of file
@@ -1,31 +1,163 @@
 #pragma once
 
 #include <volk.h>
+#include <functional>
+#include <string>
 #include <vector>
 #include <glm/glm.hpp>
 #include <vk_mem_alloc.h>
 
+#include "asset_archive.h"
+#include "bvh.h"
+#include "camera.h"
 #include "deletion_queue.h"
+#include "engine_config.h"
+#include "entity_store.h"
 #include "frame_data.h"
+#include "frame_recording.h"
+#include "frame_governor.h"
+#include "gltf_loader.h"
+#include "job_system.h"
+#include "vk_async_compute.h"
+#include "vk_capture.h"
+#include "vk_cluster_renderer.h"
+#include "vk_clustered_lighting.h"
+#include "vk_command_cache.h"
+#include "vk_geometry.h"
+#include "vk_pipeline_stats.h"
+#include "vk_pipelines.h"
+#include "vk_post_process.h"
+#include "vk_profiler.h"
+#include "vk_render_targets.h"
+#include "vk_shadows.h"
+#include "vk_temporal_aa.h"
+#include "vk_texture_streamer.h"
 #include "vk_types.h"
+#include "vk_ui_renderer.h"
+#include "vk_upload.h"
+
+// push constants of the procedural background the scene is drawn over (see background.comp)
+struct BackgroundSettings {
+	glm::vec4 topColor{ 0.05f, 0.1f, 0.3f, 1.f };
+	glm::vec4 bottomColor{ 0.5f, 0.35f, 0.2f, 1.f };
+	// xy: center in [0, 1], z: radius relative to the draw height, w: HDR intensity
+	glm::vec4 sun{ 0.7f, 0.3f, 0.04f, 40.f };
+	// xy: draw extent, filled in when the background is drawn
+	glm::vec4 data{ 0.f };
+};
 
 class VulkanEngine {
 
 public:
-	inline static const int FRAMES_IN_FLIGHT = 2;
+	// frame slots allocated; EngineConfig::framesInFlight of them are used
+	inline static const uint32_t MAX_FRAMES_IN_FLIGHT = EngineConfig::MAX_FRAMES_IN_FLIGHT;
 	inline static const char* ENGINE_NAME = "Sunaba";
-	inline static const double RENDER_SCALE = 1.0f;
+	// device memory streamed textures may take before the least recently used ones lose their finest levels
+	inline static const VkDeviceSize TEXTURE_MEMORY_BUDGET = 512ull << 20;
+	// width and height of each sun shadow cascade
+	inline static const uint32_t SHADOW_MAP_RESOLUTION = 2048;
 
 	struct EngineStats {
 		float frametime;
+		// CPU time of recording the frame's command buffers (ms), and the part of it spent on static passes, which is
+		// next to nothing while they are cached
+		float recordTime;
+		float staticRecordTime;
+	};
+
+	// scene resolution relative to the output (the swapchain, or the draw image when headless); the result is scaled back
+	// up by TAA, or by the blit into the swapchain without it
+	struct ResolutionSettings {
+		float renderScale = 1.f;
+		// steer renderScale every frame to keep the scene's GPU time near targetSceneTime
+		bool bDynamic = false;
+		float targetSceneTime = 8.f; // ms
+		float minScale = 0.5f;
 	};
 	EngineStats engineStatistics;
 
-	void init();
+	// GPU memory and descriptor usage, for tests and benchmarks
+	struct ResourceStats {
+		uint32_t allocationCount; // VMA allocations
+		uint64_t allocationBytes;
+		uint32_t blockCount; // device memory blocks backing them
+		uint64_t blockBytes;
+		uint32_t descriptorPools; // over all frames in flight
+	};
+
+	// headless engines render into the draw image only: no window, swapchain, presentation or UI. Windowed engines fall back
+	// to headless rendering when there is no display or no device can present to it
+	void init(bool bHeadless = false, const EngineConfig& config = EngineConfig());
+	bool is_headless() const { return mHeadless; }
+	// the settings the engine runs with: startup ones as init could apply them (e.g. a draw format the device lacks falls
+	// back to the default), runtime ones as last applied
+	const EngineConfig& get_config() const { return mConfig; }
+	// applies the runtime settings of config (see engine_config.h) from the next frame on; startup settings are ignored
+	void apply_config(const EngineConfig& config);
 	void run();
+	// renders frameCount frames as fast as possible; the only way to drive a headless engine
+	void run_headless(uint32_t frameCount);
 	void cleanup();
 
+	// writes the next frameCount frames (0: until stopped) of the draw image into directory
+	void start_capture(const std::string& directory, CaptureFormat format, uint32_t frameCount);
+	// writes the next frame drawn into path; onWritten runs on a worker thread once it is on disk, or failed to be written
+	void capture_frame(const std::string& path, CaptureFormat format, std::function<void(bool)> onWritten) { mCapture.capture_frame(path, format, std::move(onWritten)); }
+	// requested frames no frame has been copied for yet (the ring was busy when they were due)
+	uint32_t get_pending_capture_requests() const { return mCapture.get_pending_requests(); }
+	// waits for the GPU, then for every captured frame to be written to disk
+	void wait_for_captures();
+	// records what the next frameCount frames (0: until stopped) are made of, and what they cost, into path for the
+	// replay tool; false if the file cannot be created
+	bool start_recording(const std::string& path, uint32_t frameCount);
+	// records no more frames; the file is complete once the GPU results of those recorded came back
+	void stop_recording() { mRecorder.stop(); }
+	const FrameRecorder& get_recorder() const { return mRecorder; }
+	// blocks until every pipeline permutation requested so far is compiled, so following frames use no fallbacks
+	void wait_for_pipelines() { mPipelineCache.wait_for_pending(); }
+
+	// a fixed simulation time step in seconds, for reproducible frames; 0 uses the measured frame time
+	void set_fixed_delta_time(float seconds) { mFixedDeltaTime = seconds; }
+	BackgroundSettings& get_background_settings() { return mBackground; }
+	Camera& get_camera() { return mCamera; }
+	// every placed object: loaded scene nodes become entities here, and whatever has a mesh is drawn with its world transform
+	EntityStore& get_entities() { return mEntities; }
+	PostProcessSettings& get_post_process_settings() { return mPostProcess.mSettings; }
+	// drops state carried over from previous frames (adapted exposure, last frame's depth for occlusion culling), so what
+	// follows renders the same regardless of history
+	void reset_temporal_history() { mPostProcess.reset_history(); mClusterRenderer.reset_history(); mTemporalAA.reset_history(); }
+	ResourceStats get_resource_statistics();
+	// GPU timings of the most recently completed frame, per scope
+	const GpuProfiler& get_gpu_profiler() const { return mGpuProfiler; }
+	// point lights shading the scene, uploaded and binned every frame, so they can change freely
+	std::vector<PointLight>& get_lights() { return mLights; }
+	// culling and level of detail of the scene's meshlets, and what they left of the last frame whose results are back
+	ClusterRenderer::Settings& get_cluster_settings() { return mClusterRenderer.mSettings; }
+	ClusterRenderer::Stats get_cluster_statistics() const { return mClusterRenderer.get_stats(); }
+	ClusteredLighting::Settings& get_lighting_settings() { return mLighting.mSettings; }
+	ClusteredLighting::Stats get_lighting_statistics() const { return mLighting.get_stats(); }
+	// towards the sun; shadow cascades are rendered again whenever it changes
+	glm::vec3& get_sun_direction() { return mSunDirection; }
+	CascadedShadowMaps::Settings& get_shadow_settings() { return mShadows.mSettings; }
+	CascadedShadowMaps::Stats get_shadow_statistics() const { return mShadows.get_stats(); }
+	TemporalAntiAliasing::Settings& get_taa_settings() { return mTemporalAA.mSettings; }
+	ResolutionSettings& get_resolution_settings() { return mResolution; }
+	StaticCommandCache::Settings& get_static_pass_settings() { return mStaticPasses.mSettings; }
+
+	// starts loading a glTF scene in the background; its meshes become resident over the following frames
+	void load_scene(const std::string& path);
+	// starts loading a KTX2 texture; sampled through the bindless heap with the returned handle
+	TextureHandle load_texture(const std::string& path);
+	// blocks until every scene load started so far is parsed, converted and uploaded
+	void wait_for_assets();
+	// nodes of every scene loaded so far, in load order (each load's nodes are contiguous once wait_for_assets returned)
+	uint32_t get_scene_node_count() const { return (uint32_t)mSceneLoader.get_nodes().size(); }
+	// draws only the meshes of nodes [first, first + count), nodes loaded later included, until called again; e.g. to
+	// render one of several loaded scenes. Everything is visible by default
+	void set_visible_scene_nodes(uint32_t first, uint32_t count);
+
 private:
+	EngineConfig mConfig;
 	VkExtent2D mWindowExtent{ 1700 , 900 }; // window size
 	struct SDL_Window* mWindow{ nullptr };
 
@@ -34,40 +166,160 @@ private:
 	VkPhysicalDevice mPhysicalDevice;// GPU chosen as the default device
 	VkDevice mLogicalDevice; // Vulkan device for commands
 
-	VkSurfaceKHR mSwapchainSurface;// Vulkan window surface
+	VkSurfaceKHR mSwapchainSurface{ VK_NULL_HANDLE };// Vulkan window surface
 	VkSwapchainKHR mSwapchain;
 	VkFormat mSwapchainImageFormat;
 	VkExtent2D mSwapchainExtent; // size of swapchain image
+	// what the swapchain was created with, which is FIFO when the configured mode is not supported
+	VkPresentModeKHR mPresentMode = VK_PRESENT_MODE_FIFO_KHR;
 	std::vector<VkImage> mSwapchainImages;
 	std::vector<VkImageView> mSwapchainImageViews;
 
 	VkQueue mGraphicsQueue;
 	uint32_t mGraphicsQueueFamily;
+	// a separate compute family if the hardware has one, otherwise the graphics queue again
+	VkQueue mComputeQueue;
+	uint32_t mComputeQueueFamily;
 
 	// resources for immediate rendering
 	VkCommandPool mImmediateCommandPool;
 	VkCommandBuffer mImmediateCommandBuffer;
 	VkFence mImmediateFence;
 
+	// command buffers of passes that rarely change, submitted ahead of the frame's own until what they depend on changes
+	StaticCommandCache mStaticPasses;
+	StaticCommandCache::PassId mBackgroundPass;
+	// descriptor sets that live as long as the engine (i.e. those static passes use)
+	DescriptorAllocatorGrowable mGlobalDescriptors;
+
 	int mCurrentFrameNumber {0};
-	FrameData mFrames[FRAMES_IN_FLIGHT];
+	FrameData mFrames[MAX_FRAMES_IN_FLIGHT];
 
+	bool mHeadless = false;
 	bool mStopRendering = false;
+	bool mWindowOccluded = false;
+	// when the main loop renders: on demand once the scene settles, slower without focus
+	FrameGovernor mFrameGovernor;
+	float mFixedDeltaTime = 0.f;
 	bool mSwapchainResizeRequested = false;
 	VmaAllocator mVmaAllocator;
 	DeletionQueue mEngineDeletionQueue;
 
-	// resources for initial drawing of frame (i.e. before up/downscaling)
+	// every render target, with memory shared between targets whose passes do not overlap
+	RenderTargetPool mRenderTargets;
+	// resources for initial drawing of frame (i.e. before up/downscaling): the current frame slot's draw image
 	AllocatedImage mDrawImage;
 	VkExtent2D mDrawExtent; // actual resolution with which we render frames
+	// what the draw image holds after the scene pass: the output resolution when TAA resolved it, otherwise mDrawExtent
+	VkExtent2D mResolvedExtent;
+	ResolutionSettings mResolution;
+
+	// memory mapped shaders and assets; null when no archive was found, in which case loose files are used
+	std::shared_ptr<AssetArchive> mAssetArchive;
+	// worker threads for CPU work that must not block the render loop
+	JobSystem mJobSystem;
+	// lazily compiled specialization constant permutations of every pipeline the engine uses
+	PipelinePermutationCache mPipelineCache;
+	// compute passes scheduled after the scene, run on the compute queue when there is one
+	AsyncComputeScheduler mAsyncCompute;
+	// per-queue GPU timestamps of every frame
+	GpuProfiler mGpuProfiler;
+	// hardware counters (shader invocations, primitives, samples passed) of the same passes
+	GpuPipelineStatistics mPipelineStatistics;
+	// HDR post chain turning the draw image into display-ready output
+	PostProcessChain mPostProcess;
+	// readback of finished frames to image files
+	FrameCapture mCapture;
+	// frame state and costs for offline replay, and what was loaded so far, which a recording starts from
+	FrameRecorder mRecorder;
+	std::vector<std::string> mLoadedScenePaths;
+	std::vector<std::string> mLoadedTexturePaths;
+	// streams asset data into device local memory on the graphics queue
+	StagingUploader mUploader;
+	// every mesh's vertices, indices and meshlets, sub-allocated from a few shared buffers
+	GeometryBufferPool mVertexBuffers;
+	GeometryBufferPool mIndexBuffers;
+	GeometryBufferPool mMeshletBuffers;
+	GltfLoader mSceneLoader;
+	// KTX2 textures, mip levels resident according to on-screen use
+	TextureStreamer mTextureStreamer;
+
+	// scene nodes as entities; mSceneNodeEntities holds the entity of each of the loader's nodes picked up so far
+	EntityStore mEntities;
+	std::vector<Entity> mSceneNodeEntities;
+	// nodes outside this range get no mesh
+	uint32_t mVisibleNodesFirst = 0;
+	uint32_t mVisibleNodesCount = UINT32_MAX;
+
+	struct SceneBvhEntry {
+		Entity entity;
+		uint32_t meshIndex;
+		uint32_t object;
+	};
+	// world bounds of every entity with a resident mesh, for visibility queries on the CPU; objects report entity ids.
+	// mSceneBvhEntries is indexed by entity slot
+	DynamicBvh mSceneBvh;
+	std::vector<SceneBvhEntry> mSceneBvhEntries;
+	// entities in the camera frustum this frame, and how long the query took (ms)
+	std::vector<uint32_t> mVisibleEntities;
+	float mVisibilityQueryTime = 0.f;
+
+	// meshlet culling and drawing of the loaded scene, seen from the camera
+	ClusterRenderer mClusterRenderer;
+	// point lights binned into froxels for the scene pass
+	ClusteredLighting mLighting;
+	std::vector<PointLight> mLights;
+	// sun shadows, kept across frames for as long as the sun and the scene stay put
+	CascadedShadowMaps mShadows;
+	glm::vec3 mSunDirection{ 0.4f, 0.8f, 0.3f };
+	// bumped whenever a drawn entity moves, appears or goes away, which invalidates cached shadows
+	uint64_t mSceneVersion = 0;
+	// jittered scene samples accumulated over frames, at output resolution
+	TemporalAntiAliasing mTemporalAA;
+	// ImGui's main viewport, drawn without re-uploading geometry that did not change
+	UiRenderer mUiRenderer;
+	Camera mCamera;
+
+	BackgroundSettings mBackground;
+	VkDescriptorSetLayout mBackgroundSetLayout;
+	VkPipelineLayout mBackgroundPipelineLayout;
+	uint32_t mBackgroundFamily;
+	// capture settings edited in the UI before a capture is started
+	char mCaptureDirectoryInput[256] = "captures";
+	int mCaptureFormatInput = (int)CaptureFormat::Png;
+	int mCaptureFrameCountInput = 1;
+	char mRecordingPathInput[256] = "frames.snbr";
+	int mRecordingFrameCountInput = 300;
+	// scene file typed into the Assets window
+	char mScenePathInput[256] = "";
+	char mTexturePathInput[256] = "";
+	// pipeline statistics export, written as <path>.csv or <path>.json
+	char mPipelineStatisticsPathInput[256] = "pipeline_statistics";
+	std::string mPipelineStatisticsExportStatus;
+	// Tuning window: settings edited there, and the mean frame time (ms) before and after the last change applied
+	EngineConfig mTuningInput;
+	char mConfigPathInput[256] = "sunaba.json";
+	std::string mConfigSaveStatus;
+	std::string mTuningChange;
+	double mTuningTimeBefore = 0.0;
+	double mTuningTimeSum = 0.0;
+	uint32_t mTuningFrames = 0;
+	// random lights scattered from the Lights window
+	int mLightCountInput = 1024;
+	float mLightSpreadInput = 20.f;
+	float mLightRadiusInput = 3.f;
 
-	void init_sdl();
+	// false if there is no display to open a window on
+	bool init_sdl();
+	// drops the window (and its surface) of an engine that falls back to headless rendering during init
+	void destroy_window();
 	void init_vulkan();
 	void init_swapchain();
 	void init_commands();
 	void init_sync_structures();
 	void init_descriptors();
 	void init_pipelines();
+	void init_assets();
 	void init_imgui();
 
 	FrameData& get_current_frame() { return mFrames[mCurrentFrameNumber]; };
@@ -77,6 +329,39 @@ private:
 	void destroy_swapchain();
 
 	void draw();
-	void clear_scene(VkCommandBuffer cmd, VkImage targetImage);
+	// hands the governor what keeps frames coming and what the last frame cost
+	void update_frame_governor(bool bCameraMoved);
+	// one per UI window, drawn between ImGui::NewFrame and ImGui::Render
+	void draw_statistics_window();
+	void draw_governor_window();
+	void draw_render_targets_window();
+	void draw_ui_window();
+	void draw_background_settings_window();
+	void draw_lights_window();
+	void draw_shadows_window();
+	void draw_anti_aliasing_window();
+	void draw_post_process_window();
+	void draw_assets_window();
+	void draw_capture_window();
+	void draw_pipeline_statistics_window();
+	void draw_tuning_window();
+	// with dynamic resolution, moves the render scale towards the target scene time by the last measured frame
+	void update_render_scale();
+	// hands the recorder what the frame being drawn is made of
+	void record_frame_state(VkExtent2D outputExtent);
+	// ends and submits the scene command buffer (after staticCommandBuffer, if any), then records and submits this frame's
+	// compute passes on the compute queue
+	void submit_async_compute(VkCommandBuffer sceneCommandBuffer, VkCommandBuffer staticCommandBuffer);
+	// transitions the draw image to GENERAL and fills it with the procedural background; records nothing that changes from
+	// frame to frame other than the extent, settings and pipeline, so the commands can be cached
+	void draw_background(VkCommandBuffer cmd, VkPipeline pipeline);
+	// creates entities for the scene nodes loaded since the last call
+	void sync_scene_entities();
+	// the mesh node's entity draws, NO_MESH if the node is hidden or has none
+	uint32_t get_visible_node_mesh(uint32_t node) const;
+	// brings the scene BVH in line with the entities' meshes and world transforms after their update
+	void update_scene_bvh();
+	// culls and draws the resident scene over the background
+	void draw_scene(VkCommandBuffer cmd);
 	void draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView);
 };
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+#include "vk_check_macro.h"
+#include "vk_geometry.h"
+#include "vk_utils.h"
+
+uint32_t vkutil::pack_normal(glm::vec3 normal)
+{
+    // project onto the octahedron, then fold the lower hemisphere over the diagonals
+    glm::vec3 octahedral = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z) + 1e-20f);
+    glm::vec2 encoded(octahedral.x, octahedral.y);
+    if (octahedral.z < 0.f) {
+        encoded = (1.f - glm::abs(glm::vec2(encoded.y, encoded.x))) * glm::vec2(encoded.x >= 0.f ? 1.f : -1.f, encoded.y >= 0.f ? 1.f : -1.f);
+    }
+    return glm::packSnorm2x16(encoded);
+}
+
+glm::vec3 vkutil::unpack_normal(uint32_t packedNormal)
+{
+    glm::vec2 encoded = glm::unpackSnorm2x16(packedNormal);
+    glm::vec3 normal(encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y));
+    float fold = std::max(-normal.z, 0.f);
+    normal.x += normal.x >= 0.f ? -fold : fold;
+    normal.y += normal.y >= 0.f ? -fold : fold;
+    return glm::normalize(normal);
+}
+
+uint32_t vkutil::pack_uv(glm::vec2 uv)
+{
+    return glm::packHalf2x16(uv);
+}
+
+void GeometryBufferPool::init(VmaAllocator allocator, VkDevice device, VkBufferUsageFlags usage, VkDeviceSize pageSize)
+{
+    mAllocator = allocator;
+    mDevice = device;
+    // every page is filled through the staging uploader
+    mUsage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    mPageSize = pageSize;
+}
+
+void GeometryBufferPool::destroy()
+{
+    for (Page& page : mPages) {
+        // meshes still holding ranges are being torn down with the pool
+        vmaClearVirtualBlock(page.block);
+        vmaDestroyVirtualBlock(page.block);
+        vkutil::destroy_buffer(mAllocator, page.buffer);
+    }
+    mPages.clear();
+}
+
+GeometryAllocation GeometryBufferPool::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VmaVirtualAllocationCreateInfo allocInfo = {};
+    allocInfo.size = std::max(size, VkDeviceSize(1));
+    allocInfo.alignment = alignment;
+
+    GeometryAllocation result;
+    result.size = size;
+    for (uint32_t page = 0; page < (uint32_t)mPages.size(); page++) {
+        if (vmaVirtualAllocate(mPages[page].block, &allocInfo, &result.allocation, &result.offset) == VK_SUCCESS) {
+            result.page = page;
+            return result;
+        }
+    }
+
+    result.page = add_page(std::max(mPageSize, allocInfo.size));
+    VK_CHECK(vmaVirtualAllocate(mPages[result.page].block, &allocInfo, &result.allocation, &result.offset));
+    return result;
+}
+
+void GeometryBufferPool::free(GeometryAllocation& allocation)
+{
+    if (allocation.is_valid()) {
+        vmaVirtualFree(mPages[allocation.page].block, allocation.allocation);
+    }
+    allocation = GeometryAllocation();
+}
+
+GeometryBufferPool::Stats GeometryBufferPool::get_stats() const
+{
+    Stats stats{};
+    stats.pageCount = (uint32_t)mPages.size();
+    for (const Page& page : mPages) {
+        VmaStatistics blockStats;
+        vmaGetVirtualBlockStatistics(page.block, &blockStats);
+        stats.reservedBytes += page.size;
+        stats.usedBytes += blockStats.allocationBytes;
+        stats.allocationCount += blockStats.allocationCount;
+    }
+    return stats;
+}
+
+uint32_t GeometryBufferPool::add_page(VkDeviceSize size)
+{
+    Page page;
+    page.size = size;
+    page.buffer = vkutil::create_buffer(mAllocator, size, mUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    page.address = 0;
+    if (mUsage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+        VkBufferDeviceAddressInfo addressInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+        addressInfo.buffer = page.buffer.buffer;
+        page.address = vkGetBufferDeviceAddress(mDevice, &addressInfo);
+    }
+
+    VmaVirtualBlockCreateInfo blockInfo = {};
+    blockInfo.size = size;
+    VK_CHECK(vmaCreateVirtualBlock(&blockInfo, &page.block));
+
+    mPages.push_back(page);
+    return (uint32_t)mPages.size() - 1;
+}
\ No newline at end of file
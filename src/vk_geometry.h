@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "vk_types.h"
+
+// The vertex layout every mesh is converted to on load. Shaders pull vertices through buffer device addresses
+// (there is no vertex input state), so the layout is free to be packed: 20 bytes instead of 32 for float normals and UVs
+struct Vertex {
+	glm::vec3 position;
+	uint32_t normal; // octahedral encoding, two snorm16 (see pack_normal)
+	uint32_t uv; // two halfs
+};
+static_assert(sizeof(Vertex) == 20, "shaders read vertices as 5 consecutive 32 bit words");
+
+namespace vkutil {
+	// octahedral normal encoding; expects a normalized vector, worst case error is about 0.005 degrees
+	uint32_t pack_normal(glm::vec3 normal);
+	glm::vec3 unpack_normal(uint32_t packedNormal);
+	uint32_t pack_uv(glm::vec2 uv);
+}
+
+// a range of a geometry pool page; offset and size are in bytes
+struct GeometryAllocation {
+	uint32_t page = UINT32_MAX;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	VmaVirtualAllocation allocation = VK_NULL_HANDLE;
+
+	bool is_valid() const { return allocation != VK_NULL_HANDLE; }
+};
+
+// a draw range of a mesh (a glTF primitive), in indices relative to the mesh's first index
+struct MeshSurface {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+// most detail levels a mesh is simplified into, the full detail one included
+inline constexpr uint32_t MAX_MESH_LODS = 8;
+
+// a level of detail of a mesh: a range of its index buffer (every level shares the mesh's vertices) and its meshlets
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	// in mesh space units: how far the level's surface may be from the full detail one
+	float error;
+};
+
+// a mesh as the renderer sees it: its ranges in the shared vertex and index pools plus what culling needs.
+// Indices are relative to the mesh's first vertex, and shaders address vertices from the mesh's base address
+struct MeshAsset {
+	std::string name;
+	std::vector<MeshSurface> surfaces;
+	glm::vec3 boundsMin{ 0.f };
+	glm::vec3 boundsMax{ 0.f };
+	uint32_t vertexCount = 0;
+	// of every level of detail together
+	uint32_t indexCount = 0;
+	GeometryAllocation vertices;
+	GeometryAllocation indices;
+	// clusters of the index buffer, in index order; culling works on these rather than on whole meshes
+	GeometryAllocation meshlets;
+	uint32_t meshletCount = 0;
+	// lods[0] is the full detail mesh (what surfaces cover), each further level has about half the triangles of the previous one
+	std::vector<MeshLod> lods;
+	// material of the first surface, which every surface is drawn with: linear base color factor and the TextureStreamer
+	// handle of its base color texture (UINT32_MAX for none)
+	glm::vec4 baseColorFactor{ 1.f };
+	uint32_t baseColorTexture = UINT32_MAX;
+	// false until every upload has finished; meshes must not be drawn before that
+	bool bResident = false;
+};
+
+// A cluster of up to meshutil::MESHLET_MAX_TRIANGLES consecutive triangles of a mesh, with the bounds GPU culling tests
+// it against. The layout is the one shaders read (see shaders/scene_geometry.glsl)
+struct Meshlet {
+	// bounding sphere in mesh space: xyz center, w radius
+	glm::vec4 sphere;
+	// normal cone: xyz average normal, w sine of the half angle every triangle normal is within (1: never back facing as a whole)
+	glm::vec4 cone;
+	// first index relative to the mesh's first index; indices stay relative to the mesh's first vertex
+	uint32_t firstIndex;
+	uint32_t triangleCount;
+	// the level of detail of the mesh the meshlet belongs to
+	uint32_t lod;
+	uint32_t padding;
+};
+static_assert(sizeof(Meshlet) == 48, "shaders read meshlets as three 16 byte rows");
+
+// a node of a loaded scene: a transform relative to its parent, optionally placing a mesh
+struct SceneNode {
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+	static constexpr uint32_t NO_MESH = UINT32_MAX;
+
+	// index of the parent in the same node list, where it always comes before its children
+	uint32_t parent;
+	uint32_t meshIndex;
+	glm::mat4 localTransform;
+};
+
+// Sub-allocates many meshes out of a few large device local buffers (pages), so the whole scene's geometry can be bound
+// or addressed with one buffer per page rather than one per mesh. Ranges are managed with VMA virtual blocks;
+// a new page is added when an allocation fits in none of the existing ones
+class GeometryBufferPool {
+public:
+	struct Stats {
+		uint32_t pageCount;
+		uint64_t reservedBytes; // size of all pages
+		uint64_t usedBytes;
+		uint32_t allocationCount;
+	};
+
+	void init(VmaAllocator allocator, VkDevice device, VkBufferUsageFlags usage, VkDeviceSize pageSize = 64ull << 20);
+	// the pool must not be in use by the GPU anymore
+	void destroy();
+
+	// alignment must be a power of two; allocations larger than the page size get a page of their own
+	GeometryAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+	// the range must not be in use by the GPU anymore; resets allocation
+	void free(GeometryAllocation& allocation);
+
+	VkBuffer get_buffer(uint32_t page) const { return mPages[page].buffer.buffer; }
+	// only valid for pools created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	VkDeviceAddress get_address(uint32_t page) const { return mPages[page].address; }
+	uint32_t get_page_count() const { return (uint32_t)mPages.size(); }
+	Stats get_stats() const;
+
+private:
+	struct Page {
+		AllocatedBuffer buffer;
+		VkDeviceAddress address;
+		VkDeviceSize size;
+		VmaVirtualBlock block;
+	};
+
+	uint32_t add_page(VkDeviceSize size);
+
+	VmaAllocator mAllocator;
+	VkDevice mDevice;
+	VkBufferUsageFlags mUsage;
+	VkDeviceSize mPageSize;
+	std::vector<Page> mPages;
+};
\ No newline at end of file
@@ -113,6 +113,20 @@ VkRenderingAttachmentInfo vkinit::attachment_info(
     return colorAttachment;
 }
 
+VkRenderingAttachmentInfo vkinit::depth_attachment_info(VkImageView view, VkImageLayout layout)
+{
+    VkRenderingAttachmentInfo depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.pNext = nullptr;
+
+    depthAttachment.imageView = view;
+    depthAttachment.imageLayout = layout;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.clearValue.depthStencil.depth = 1.f;
+    return depthAttachment;
+}
+
 VkRenderingInfo vkinit::rendering_info(
     VkExtent2D viewExtent, VkRenderingAttachmentInfo* colorAttachments, VkRenderingAttachmentInfo* depthAttachment)
 {
@@ -121,7 +135,7 @@ VkRenderingInfo vkinit::rendering_info(
     renderInfo.pNext = nullptr;
     renderInfo.renderArea.extent = viewExtent;
     renderInfo.layerCount = 1;
-    renderInfo.colorAttachmentCount = 1;
+    renderInfo.colorAttachmentCount = colorAttachments ? 1 : 0;
     renderInfo.pColorAttachments = colorAttachments;
     renderInfo.pDepthAttachment = depthAttachment;
     return renderInfo;
@@ -165,4 +179,30 @@ VkSubmitInfo2 vkinit::queue_submit_info(VkCommandBufferSubmitInfo* cmd, VkSemaph
     info.commandBufferInfoCount = 1;
     info.pCommandBufferInfos = cmd;
     return info;
+}
+
+VkPipelineShaderStageCreateInfo vkinit::pipeline_shader_stage_create_info(VkShaderStageFlagBits stage, VkShaderModule shaderModule, const char* entry)
+{
+    VkPipelineShaderStageCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.pNext = nullptr;
+    info.stage = stage;
+    info.module = shaderModule;
+    // the entry point of the shader
+    info.pName = entry;
+    return info;
+}
+
+VkPipelineLayoutCreateInfo vkinit::pipeline_layout_create_info()
+{
+    VkPipelineLayoutCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    info.pNext = nullptr;
+    // empty defaults
+    info.flags = 0;
+    info.setLayoutCount = 0;
+    info.pSetLayouts = nullptr;
+    info.pushConstantRangeCount = 0;
+    info.pPushConstantRanges = nullptr;
+    return info;
 }
\ No newline at end of file
@@ -12,8 +12,12 @@ namespace vkinit {
     VkCommandBufferBeginInfo command_buffer_begin_info(VkCommandBufferUsageFlags flags);
     VkImageSubresourceRange image_subresource_range(VkImageAspectFlags aspectMask);
     VkRenderingAttachmentInfo attachment_info(VkImageView view, VkClearValue* clear, VkImageLayout layout);
+    // cleared to the far plane (1.0) and stored, e.g. so the depth can be read back or reduced afterwards
+    VkRenderingAttachmentInfo depth_attachment_info(VkImageView view, VkImageLayout layout);
     VkRenderingInfo rendering_info(VkExtent2D viewExtent, VkRenderingAttachmentInfo* colorAttachments, VkRenderingAttachmentInfo* depthAttachment = nullptr);
     VkCommandBufferSubmitInfo command_buffer_submit_info(VkCommandBuffer cmd);
     VkSemaphoreSubmitInfo semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore);
     VkSubmitInfo2 queue_submit_info(VkCommandBufferSubmitInfo* cmd, VkSemaphoreSubmitInfo* signalSemaphoreInfo, VkSemaphoreSubmitInfo* waitSemaphoreInfo);
+    VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info(VkShaderStageFlagBits stage, VkShaderModule shaderModule, const char* entry = "main");
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info();
 }
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <fstream>
+#include "vk_check_macro.h"
+#include "vk_pipeline_stats.h"
+
+namespace {
+    // the counters graphics capable queues record, in the order of their flag bits, which is the order results come back in
+    constexpr VkQueryPipelineStatisticFlags GRAPHICS_STATISTICS =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+    constexpr uint32_t GRAPHICS_STATISTIC_COUNT = 7;
+
+    std::string escape(const std::string& text)
+    {
+        std::string escaped;
+        for (char character : text) {
+            if (character == '"' || character == '\\') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(character);
+        }
+        return escaped;
+    }
+
+    const char* queue_name(GpuQueueTrack queue)
+    {
+        return queue == GpuQueueTrack::Compute ? "compute" : "graphics";
+    }
+}
+
+const char* GpuPipelineStatistics::get_counter_name(Counter counter)
+{
+    static const char* names[COUNTER_COUNT] = {
+        "ia_vertices",
+        "ia_primitives",
+        "vs_invocations",
+        "clipping_invocations",
+        "clipping_primitives",
+        "fs_invocations",
+        "cs_invocations",
+        "samples_passed",
+    };
+    return names[counter];
+}
+
+void GpuPipelineStatistics::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, bool bEnabled,
+    bool bPreciseOcclusion, uint32_t maxScopesPerFrame)
+{
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    mEnabled = bEnabled;
+    mPreciseOcclusion = bPreciseOcclusion;
+    mMaxScopesPerFrame = maxScopesPerFrame;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+    mDeviceName = properties.deviceName;
+
+    if (!mEnabled) {
+        return;
+    }
+
+    VkQueryPoolCreateInfo graphicsPoolInfo = { .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    graphicsPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    graphicsPoolInfo.queryCount = mMaxScopesPerFrame;
+    graphicsPoolInfo.pipelineStatistics = GRAPHICS_STATISTICS;
+
+    VkQueryPoolCreateInfo computePoolInfo = graphicsPoolInfo;
+    computePoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    VkQueryPoolCreateInfo occlusionPoolInfo = { .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    occlusionPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+    occlusionPoolInfo.queryCount = mMaxScopesPerFrame;
+
+    mFrames.resize(framesInFlight);
+    for (FrameQueries& frame : mFrames) {
+        VK_CHECK(vkCreateQueryPool(mDevice, &graphicsPoolInfo, nullptr, &frame.graphicsPool));
+        VK_CHECK(vkCreateQueryPool(mDevice, &computePoolInfo, nullptr, &frame.computePool));
+        VK_CHECK(vkCreateQueryPool(mDevice, &occlusionPoolInfo, nullptr, &frame.occlusionPool));
+        // queries must be reset before their first use, here from the host like the profiler's
+        vkResetQueryPool(mDevice, frame.graphicsPool, 0, mMaxScopesPerFrame);
+        vkResetQueryPool(mDevice, frame.computePool, 0, mMaxScopesPerFrame);
+        vkResetQueryPool(mDevice, frame.occlusionPool, 0, mMaxScopesPerFrame);
+        frame.usedGraphicsQueries = 0;
+        frame.usedComputeQueries = 0;
+        frame.usedOcclusionQueries = 0;
+        frame.frame = 0;
+    }
+}
+
+void GpuPipelineStatistics::destroy()
+{
+    for (FrameQueries& frame : mFrames) {
+        vkDestroyQueryPool(mDevice, frame.graphicsPool, nullptr);
+        vkDestroyQueryPool(mDevice, frame.computePool, nullptr);
+        vkDestroyQueryPool(mDevice, frame.occlusionPool, nullptr);
+    }
+    mFrames.clear();
+}
+
+void GpuPipelineStatistics::set_queue_family(GpuQueueTrack queue, uint32_t queueFamilyIndex)
+{
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &familyCount, families.data());
+
+    // graphics counters and occlusion queries may only be recorded on families that can draw
+    mQueueSupportsGraphics[(uint32_t)queue] = (families[queueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+}
+
+void GpuPipelineStatistics::read_pool(VkQueryPool pool, uint32_t count, uint32_t valuesPerQuery, std::vector<uint64_t>& outValues,
+    std::vector<bool>& outAvailable)
+{
+    // every query's values are followed by its availability
+    uint32_t stride = valuesPerQuery + 1;
+    outValues.assign((size_t)count * stride, 0);
+    outAvailable.assign(count, false);
+    if (count == 0) {
+        return;
+    }
+
+    // no WAIT flag: VK_NOT_READY still writes the availability of every query, so whatever is there is taken
+    VkResult result = vkGetQueryPoolResults(mDevice, pool, 0, count, outValues.size() * sizeof(uint64_t), outValues.data(),
+        stride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        return;
+    }
+    for (uint32_t query = 0; query < count; query++) {
+        outAvailable[query] = outValues[(size_t)query * stride + valuesPerQuery] != 0;
+    }
+}
+
+void GpuPipelineStatistics::accumulate(const ScopeResult& result)
+{
+    ScopeTotals* totals = nullptr;
+    for (ScopeTotals& candidate : mTotals) {
+        if (candidate.name == result.name && candidate.queue == result.queue) {
+            totals = &candidate;
+            break;
+        }
+    }
+    if (!totals) {
+        totals = &mTotals.emplace_back();
+        totals->name = result.name;
+        totals->queue = result.queue;
+        totals->frameCount = 0;
+        std::fill(std::begin(totals->counters), std::end(totals->counters), 0);
+    }
+
+    totals->frameCount++;
+    for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++) {
+        totals->counters[counter] += result.counters[counter];
+    }
+}
+
+void GpuPipelineStatistics::begin_frame(uint32_t frameIndex)
+{
+    mCurrentFrame = frameIndex;
+    mOpenScope = INVALID_SCOPE;
+    if (!mEnabled) {
+        return;
+    }
+    FrameQueries& frame = mFrames[mCurrentFrame];
+
+    if (!frame.scopes.empty()) {
+        std::vector<uint64_t> graphicsValues, computeValues, occlusionValues;
+        std::vector<bool> graphicsAvailable, computeAvailable, occlusionAvailable;
+        read_pool(frame.graphicsPool, frame.usedGraphicsQueries, GRAPHICS_STATISTIC_COUNT, graphicsValues, graphicsAvailable);
+        read_pool(frame.computePool, frame.usedComputeQueries, 1, computeValues, computeAvailable);
+        read_pool(frame.occlusionPool, frame.usedOcclusionQueries, 1, occlusionValues, occlusionAvailable);
+
+        std::vector<ScopeResult> results;
+        for (const Scope& scope : frame.scopes) {
+            if (!scope.bEnded) {
+                continue;
+            }
+            ScopeResult result;
+            result.name = scope.name;
+            result.queue = scope.queue;
+            result.frame = frame.frame;
+            std::fill(std::begin(result.counters), std::end(result.counters), 0);
+
+            // a scope is only reported once all of its queries are back
+            if (mQueueSupportsGraphics[(uint32_t)scope.queue]) {
+                if (!graphicsAvailable[scope.statisticsQuery] || !occlusionAvailable[scope.occlusionQuery]) {
+                    continue;
+                }
+                const uint64_t* values = &graphicsValues[(size_t)scope.statisticsQuery * (GRAPHICS_STATISTIC_COUNT + 1)];
+                for (uint32_t counter = 0; counter < GRAPHICS_STATISTIC_COUNT; counter++) {
+                    result.counters[counter] = values[counter];
+                }
+                result.counters[SamplesPassed] = occlusionValues[(size_t)scope.occlusionQuery * 2];
+            }
+            else {
+                if (!computeAvailable[scope.statisticsQuery]) {
+                    continue;
+                }
+                result.counters[ComputeShaderInvocations] = computeValues[(size_t)scope.statisticsQuery * 2];
+            }
+            results.push_back(result);
+        }
+
+        if (!results.empty()) {
+            for (const ScopeResult& result : results) {
+                accumulate(result);
+            }
+            mLastResults = std::move(results);
+        }
+
+        if (frame.usedGraphicsQueries > 0) {
+            vkResetQueryPool(mDevice, frame.graphicsPool, 0, frame.usedGraphicsQueries);
+            vkResetQueryPool(mDevice, frame.occlusionPool, 0, frame.usedOcclusionQueries);
+        }
+        if (frame.usedComputeQueries > 0) {
+            vkResetQueryPool(mDevice, frame.computePool, 0, frame.usedComputeQueries);
+        }
+    }
+
+    frame.scopes.clear();
+    frame.usedGraphicsQueries = 0;
+    frame.usedComputeQueries = 0;
+    frame.usedOcclusionQueries = 0;
+    frame.frame = mFrameNumber++;
+}
+
+uint32_t GpuPipelineStatistics::begin_scope(VkCommandBuffer cmd, const char* name, GpuQueueTrack queue)
+{
+    if (!mEnabled || mOpenScope != INVALID_SCOPE) {
+        return INVALID_SCOPE;
+    }
+
+    FrameQueries& frame = mFrames[mCurrentFrame];
+    bool bGraphics = mQueueSupportsGraphics[(uint32_t)queue];
+    uint32_t& usedQueries = bGraphics ? frame.usedGraphicsQueries : frame.usedComputeQueries;
+    if (usedQueries >= mMaxScopesPerFrame) {
+        return INVALID_SCOPE;
+    }
+
+    Scope scope;
+    scope.name = name;
+    scope.queue = queue;
+    scope.statisticsQuery = usedQueries++;
+    scope.occlusionQuery = INVALID_SCOPE;
+    scope.bEnded = false;
+
+    vkCmdBeginQuery(cmd, bGraphics ? frame.graphicsPool : frame.computePool, scope.statisticsQuery, 0);
+    if (bGraphics) {
+        scope.occlusionQuery = frame.usedOcclusionQueries++;
+        vkCmdBeginQuery(cmd, frame.occlusionPool, scope.occlusionQuery, mPreciseOcclusion ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+    }
+
+    frame.scopes.push_back(scope);
+    mOpenScope = (uint32_t)frame.scopes.size() - 1;
+    return mOpenScope;
+}
+
+void GpuPipelineStatistics::end_scope(VkCommandBuffer cmd, uint32_t scopeId)
+{
+    if (scopeId == INVALID_SCOPE) {
+        return;
+    }
+
+    FrameQueries& frame = mFrames[mCurrentFrame];
+    Scope& scope = frame.scopes[scopeId];
+    if (scope.occlusionQuery != INVALID_SCOPE) {
+        vkCmdEndQuery(cmd, frame.occlusionPool, scope.occlusionQuery);
+        vkCmdEndQuery(cmd, frame.graphicsPool, scope.statisticsQuery);
+    }
+    else {
+        vkCmdEndQuery(cmd, frame.computePool, scope.statisticsQuery);
+    }
+    scope.bEnded = true;
+    mOpenScope = INVALID_SCOPE;
+}
+
+bool GpuPipelineStatistics::export_csv(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // one row per scope, counters averaged over the frames it was recorded in
+    file << "scope,queue,frames";
+    for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++) {
+        file << "," << get_counter_name((Counter)counter);
+    }
+    file << "\n";
+    for (const ScopeTotals& totals : mTotals) {
+        file << "\"" << escape(totals.name) << "\"," << queue_name(totals.queue) << "," << totals.frameCount;
+        for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++) {
+            file << "," << (double)totals.counters[counter] / (double)totals.frameCount;
+        }
+        file << "\n";
+    }
+    return file.good();
+}
+
+bool GpuPipelineStatistics::export_json(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file << "{\n  \"device\": \"" << escape(mDeviceName) << "\",\n";
+    file << "  \"preciseOcclusion\": " << (mPreciseOcclusion ? "true" : "false") << ",\n  \"scopes\": [\n";
+    for (size_t i = 0; i < mTotals.size(); i++) {
+        const ScopeTotals& totals = mTotals[i];
+        file << "    {\n";
+        file << "      \"name\": \"" << escape(totals.name) << "\",\n";
+        file << "      \"queue\": \"" << queue_name(totals.queue) << "\",\n";
+        file << "      \"frames\": " << totals.frameCount << ",\n";
+        file << "      \"mean\": {";
+        for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++) {
+            file << (counter > 0 ? ", " : " ") << "\"" << get_counter_name((Counter)counter) << "\": "
+                << (double)totals.counters[counter] / (double)totals.frameCount;
+        }
+        file << " },\n";
+
+        // the scope's counters in the last completed frame, if it was recorded there
+        file << "      \"last\": ";
+        const ScopeResult* last = nullptr;
+        for (const ScopeResult& result : mLastResults) {
+            if (result.name == totals.name && result.queue == totals.queue) {
+                last = &result;
+                break;
+            }
+        }
+        if (last) {
+            file << "{ \"frame\": " << last->frame;
+            for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++) {
+                file << ", \"" << get_counter_name((Counter)counter) << "\": " << last->counters[counter];
+            }
+            file << " }\n";
+        }
+        else {
+            file << "null\n";
+        }
+        file << "    }" << (i + 1 < mTotals.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return file.good();
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <volk.h>
+
+#include "vk_profiler.h"
+
+// Hardware counters per pass: pipeline statistics queries (vertices and primitives assembled, shader invocations, clipping)
+// and, on queues that can draw, an occlusion query counting the samples that passed depth testing. Like GpuProfiler, every
+// frame in flight has its own queries, read back without waiting once the CPU comes back to the slot, so results lag
+// as many frames behind as there are frames in flight and are tagged with the frame they were recorded in.
+// Queries of one type cannot be active twice in a command buffer, so scopes do not nest: a scope begun while another is open
+// is dropped
+class GpuPipelineStatistics {
+public:
+	enum Counter : uint32_t {
+		InputAssemblyVertices = 0,
+		InputAssemblyPrimitives,
+		VertexShaderInvocations,
+		ClippingInvocations,
+		ClippingPrimitives,
+		FragmentShaderInvocations,
+		ComputeShaderInvocations,
+		SamplesPassed,
+		COUNTER_COUNT
+	};
+
+	struct ScopeResult {
+		std::string name;
+		GpuQueueTrack queue;
+		// frame number (counted by begin_frame) the scope was recorded in
+		uint64_t frame;
+		// counters the queue cannot record (graphics counters on a compute-only family) stay 0
+		uint64_t counters[COUNTER_COUNT];
+	};
+
+	// running sums of a scope over every frame since the last reset, for exports that compare builds
+	struct ScopeTotals {
+		std::string name;
+		GpuQueueTrack queue;
+		uint64_t frameCount;
+		uint64_t counters[COUNTER_COUNT];
+	};
+
+	// short column names of the counters, as used by the exports
+	static const char* get_counter_name(Counter counter);
+
+	// bEnabled: whether the device was created with pipelineStatisticsQuery; without it every scope is dropped.
+	// bPreciseOcclusion: whether occlusionQueryPrecise was enabled, otherwise samples passed only tells zero from non-zero
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, bool bEnabled, bool bPreciseOcclusion,
+		uint32_t maxScopesPerFrame = 32);
+	void destroy();
+
+	bool is_enabled() const { return mEnabled; }
+
+	// tells which queue family a track records on, which decides the counters its scopes can carry
+	void set_queue_family(GpuQueueTrack queue, uint32_t queueFamilyIndex);
+
+	// call once the frame slot's fence has been waited on: collects the slot's previous results and resets its queries
+	void begin_frame(uint32_t frameIndex);
+
+	// returns a scope id for end_scope. Scopes must begin and end outside of a rendering instance, or both inside the same one
+	uint32_t begin_scope(VkCommandBuffer cmd, const char* name, GpuQueueTrack queue = GpuQueueTrack::Graphics);
+	void end_scope(VkCommandBuffer cmd, uint32_t scopeId);
+
+	// results of the most recently completed frame
+	const std::vector<ScopeResult>& get_results() const { return mLastResults; }
+	const std::vector<ScopeTotals>& get_totals() const { return mTotals; }
+	void reset_totals() { mTotals.clear(); }
+
+	// per scope averages over the totals, plus the results of the last frame; false if the file could not be written
+	bool export_csv(const std::string& path) const;
+	bool export_json(const std::string& path) const;
+
+private:
+	static constexpr uint32_t INVALID_SCOPE = ~0u;
+
+	struct Scope {
+		std::string name;
+		GpuQueueTrack queue;
+		uint32_t statisticsQuery;
+		// INVALID_SCOPE on queues that cannot draw
+		uint32_t occlusionQuery;
+		bool bEnded;
+	};
+
+	struct FrameQueries {
+		// all counters, for queue families with graphics support
+		VkQueryPool graphicsPool;
+		// only compute invocations, the one counter compute-only families may record
+		VkQueryPool computePool;
+		VkQueryPool occlusionPool;
+		uint32_t usedGraphicsQueries;
+		uint32_t usedComputeQueries;
+		uint32_t usedOcclusionQueries;
+		std::vector<Scope> scopes;
+		uint64_t frame;
+	};
+
+	// reads count queries of a pool with their availability; values of queries whose results are not there yet stay empty
+	void read_pool(VkQueryPool pool, uint32_t count, uint32_t valuesPerQuery, std::vector<uint64_t>& outValues,
+		std::vector<bool>& outAvailable);
+	void accumulate(const ScopeResult& result);
+
+	VkDevice mDevice;
+	VkPhysicalDevice mPhysicalDevice;
+	bool mEnabled = false;
+	bool mPreciseOcclusion = false;
+	uint32_t mMaxScopesPerFrame;
+	bool mQueueSupportsGraphics[(uint32_t)GpuQueueTrack::Count]{};
+	std::string mDeviceName;
+
+	std::vector<FrameQueries> mFrames;
+	uint32_t mCurrentFrame{ 0 };
+	uint64_t mFrameNumber{ 0 };
+	// scope currently open, if any
+	uint32_t mOpenScope{ INVALID_SCOPE };
+	std::vector<ScopeResult> mLastResults;
+	std::vector<ScopeTotals> mTotals;
+};
\ No newline at end of file
@@ -0,0 +1,501 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include "asset_archive.h"
+#include "vk_check_macro.h"
+#include "vk_initializers.h"
+#include "vk_pipelines.h"
+#include "vk_utils.h"
+
+VkSpecializationInfo SpecializationData::get_info() const
+{
+    VkSpecializationInfo info{};
+    info.mapEntryCount = (uint32_t)mEntries.size();
+    info.pMapEntries = mEntries.data();
+    info.dataSize = mData.size();
+    info.pData = mData.data();
+    return info;
+}
+
+uint64_t SpecializationData::hash() const
+{
+    uint64_t hash = vkutil::hash_bytes(mEntries.data(), mEntries.size() * sizeof(VkSpecializationMapEntry));
+    return vkutil::hash_bytes(mData.data(), mData.size(), hash);
+}
+
+void PipelineBuilder::clear()
+{
+    // clear all of the structs we need back to 0 with their correct sType
+    mInputAssembly = { .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+    mRasterizer = { .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    mRasterizer.lineWidth = 1.f;
+    mColorBlendAttachment = {};
+    mMultisampling = { .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    mDepthStencil = { .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+    mPipelineLayout = VK_NULL_HANDLE;
+    mColorAttachmentFormats.clear();
+    mDepthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    mSpecializedStages = 0;
+    mShaderHash = 0;
+    mShaderStages.clear();
+}
+
+VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkPipelineCache pipelineCache, const SpecializationData* specialization) const
+{
+    // viewport and scissor are dynamic state, so only their count is baked into the pipeline
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.pNext = nullptr;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    // every color attachment shares the same blending setup
+    std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(mColorAttachmentFormats.size(), mColorBlendAttachment);
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.pNext = nullptr;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = (uint32_t)blendAttachments.size();
+    colorBlending.pAttachments = blendAttachments.data();
+
+    // we pull vertices from buffers through device addresses, so there is no vertex input state
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+
+    // dynamic rendering: attachment formats are chained in instead of a render pass
+    VkPipelineRenderingCreateInfo renderInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
+    renderInfo.colorAttachmentCount = (uint32_t)mColorAttachmentFormats.size();
+    renderInfo.pColorAttachmentFormats = mColorAttachmentFormats.data();
+    renderInfo.depthAttachmentFormat = mDepthAttachmentFormat;
+
+    // patch the specialization info into a local copy of the stages so the builder itself stays untouched (and thread safe)
+    VkSpecializationInfo specializationInfo{};
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStages = mShaderStages;
+    if (specialization && !specialization->empty()) {
+        specializationInfo = specialization->get_info();
+        for (VkPipelineShaderStageCreateInfo& stage : shaderStages) {
+            if (stage.stage & mSpecializedStages) {
+                stage.pSpecializationInfo = &specializationInfo;
+            }
+        }
+    }
+
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_DEPTH_BIAS };
+    VkPipelineDynamicStateCreateInfo dynamicInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+    dynamicInfo.pDynamicStates = dynamicStates;
+    // depth bias is only dynamic when the pipeline enables it
+    dynamicInfo.dynamicStateCount = mRasterizer.depthBiasEnable ? 3 : 2;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = { .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    pipelineInfo.pNext = &renderInfo;
+    pipelineInfo.stageCount = (uint32_t)shaderStages.size();
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &mInputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &mRasterizer;
+    pipelineInfo.pMultisampleState = &mMultisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDepthStencilState = &mDepthStencil;
+    pipelineInfo.pDynamicState = &dynamicInfo;
+    pipelineInfo.layout = mPipelineLayout;
+
+    VkPipeline newPipeline;
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+        std::cout << "failed to create graphics pipeline" << std::endl;
+        return VK_NULL_HANDLE;
+    }
+    return newPipeline;
+}
+
+uint64_t PipelineBuilder::hash() const
+{
+    // hash field by field; the create info structs contain pointers which must not leak into the key
+    uint64_t hash = vkutil::hash_combine(0, mShaderHash);
+    hash = vkutil::hash_combine(hash, mInputAssembly.topology);
+    hash = vkutil::hash_combine(hash, mRasterizer.polygonMode);
+    hash = vkutil::hash_combine(hash, mRasterizer.cullMode);
+    hash = vkutil::hash_combine(hash, mRasterizer.frontFace);
+    hash = vkutil::hash_combine(hash, mRasterizer.depthBiasEnable);
+    hash = vkutil::hash_bytes(&mColorBlendAttachment, sizeof(mColorBlendAttachment), hash);
+    hash = vkutil::hash_combine(hash, mMultisampling.rasterizationSamples);
+    hash = vkutil::hash_combine(hash, mDepthStencil.depthTestEnable);
+    hash = vkutil::hash_combine(hash, mDepthStencil.depthWriteEnable);
+    hash = vkutil::hash_combine(hash, mDepthStencil.depthCompareOp);
+    hash = vkutil::hash_bytes(mColorAttachmentFormats.data(), mColorAttachmentFormats.size() * sizeof(VkFormat), hash);
+    hash = vkutil::hash_combine(hash, mDepthAttachmentFormat);
+    hash = vkutil::hash_combine(hash, mSpecializedStages);
+    return vkutil::hash_combine(hash, (uint64_t)mPipelineLayout);
+}
+
+void PipelineBuilder::set_shaders(VkShaderModule vertexShader, VkShaderModule fragmentShader, uint64_t shaderHash)
+{
+    mShaderStages.clear();
+    mShaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, vertexShader));
+    mShaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader));
+    mShaderHash = shaderHash;
+}
+
+void PipelineBuilder::set_vertex_shader_only(VkShaderModule vertexShader, uint64_t shaderHash)
+{
+    mShaderStages.clear();
+    mShaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, vertexShader));
+    mShaderHash = shaderHash;
+}
+
+void PipelineBuilder::set_specialized_stages(VkShaderStageFlags stages)
+{
+    mSpecializedStages = stages;
+}
+
+void PipelineBuilder::set_input_topology(VkPrimitiveTopology topology)
+{
+    mInputAssembly.topology = topology;
+    // primitive restart is only used for triangle and line strips
+    mInputAssembly.primitiveRestartEnable = VK_FALSE;
+}
+
+void PipelineBuilder::set_polygon_mode(VkPolygonMode mode)
+{
+    mRasterizer.polygonMode = mode;
+    mRasterizer.lineWidth = 1.f;
+}
+
+void PipelineBuilder::set_cull_mode(VkCullModeFlags cullMode, VkFrontFace frontFace)
+{
+    mRasterizer.cullMode = cullMode;
+    mRasterizer.frontFace = frontFace;
+}
+
+void PipelineBuilder::set_multisampling_none()
+{
+    mMultisampling.sampleShadingEnable = VK_FALSE;
+    // multisampling defaulted to no multisampling (1 sample per pixel)
+    mMultisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    mMultisampling.minSampleShading = 1.0f;
+    mMultisampling.pSampleMask = nullptr;
+    // no alpha to coverage either
+    mMultisampling.alphaToCoverageEnable = VK_FALSE;
+    mMultisampling.alphaToOneEnable = VK_FALSE;
+}
+
+void PipelineBuilder::disable_blending()
+{
+    // default write mask
+    mColorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    mColorBlendAttachment.blendEnable = VK_FALSE;
+}
+
+void PipelineBuilder::enable_blending_additive()
+{
+    mColorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    mColorBlendAttachment.blendEnable = VK_TRUE;
+    mColorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    mColorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    mColorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    mColorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    mColorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    mColorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+}
+
+void PipelineBuilder::enable_blending_alphablend()
+{
+    mColorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    mColorBlendAttachment.blendEnable = VK_TRUE;
+    mColorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    mColorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    mColorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    mColorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    mColorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    mColorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+}
+
+void PipelineBuilder::set_color_attachment_format(VkFormat format)
+{
+    mColorAttachmentFormats.assign(1, format);
+}
+
+void PipelineBuilder::set_color_attachment_formats(std::span<const VkFormat> formats)
+{
+    mColorAttachmentFormats.assign(formats.begin(), formats.end());
+}
+
+void PipelineBuilder::set_depth_format(VkFormat format)
+{
+    mDepthAttachmentFormat = format;
+}
+
+void PipelineBuilder::disable_depthtest()
+{
+    mDepthStencil.depthTestEnable = VK_FALSE;
+    mDepthStencil.depthWriteEnable = VK_FALSE;
+    mDepthStencil.depthCompareOp = VK_COMPARE_OP_NEVER;
+    mDepthStencil.depthBoundsTestEnable = VK_FALSE;
+    mDepthStencil.stencilTestEnable = VK_FALSE;
+    mDepthStencil.front = {};
+    mDepthStencil.back = {};
+    mDepthStencil.minDepthBounds = 0.f;
+    mDepthStencil.maxDepthBounds = 1.f;
+}
+
+void PipelineBuilder::enable_depthtest(bool bDepthWriteEnable, VkCompareOp compareOp)
+{
+    mDepthStencil.depthTestEnable = VK_TRUE;
+    mDepthStencil.depthWriteEnable = bDepthWriteEnable;
+    mDepthStencil.depthCompareOp = compareOp;
+    mDepthStencil.depthBoundsTestEnable = VK_FALSE;
+    mDepthStencil.stencilTestEnable = VK_FALSE;
+    mDepthStencil.front = {};
+    mDepthStencil.back = {};
+    mDepthStencil.minDepthBounds = 0.f;
+    mDepthStencil.maxDepthBounds = 1.f;
+}
+
+void PipelineBuilder::enable_depth_bias()
+{
+    // the actual bias values are set per draw through vkCmdSetDepthBias
+    mRasterizer.depthBiasEnable = VK_TRUE;
+}
+
+void PipelineBuilder::set_layout(VkPipelineLayout layout)
+{
+    mPipelineLayout = layout;
+}
+
+void ComputePipelineBuilder::clear()
+{
+    mShaderStage = { .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+    mPipelineLayout = VK_NULL_HANDLE;
+    mShaderHash = 0;
+}
+
+VkPipeline ComputePipelineBuilder::build_pipeline(VkDevice device, VkPipelineCache pipelineCache, const SpecializationData* specialization) const
+{
+    VkSpecializationInfo specializationInfo{};
+    VkComputePipelineCreateInfo pipelineInfo = { .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    pipelineInfo.layout = mPipelineLayout;
+    pipelineInfo.stage = mShaderStage;
+    if (specialization && !specialization->empty()) {
+        specializationInfo = specialization->get_info();
+        pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+    }
+
+    VkPipeline newPipeline;
+    if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+        std::cout << "failed to create compute pipeline" << std::endl;
+        return VK_NULL_HANDLE;
+    }
+    return newPipeline;
+}
+
+uint64_t ComputePipelineBuilder::hash() const
+{
+    return vkutil::hash_combine(mShaderHash, (uint64_t)mPipelineLayout);
+}
+
+void ComputePipelineBuilder::set_shader(VkShaderModule computeShader, uint64_t shaderHash)
+{
+    mShaderStage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, computeShader);
+    mShaderHash = shaderHash;
+}
+
+void ComputePipelineBuilder::set_layout(VkPipelineLayout layout)
+{
+    mPipelineLayout = layout;
+}
+
+void PipelinePermutationCache::init(VkDevice device, JobSystem* jobSystem)
+{
+    mDevice = device;
+    mJobSystem = jobSystem;
+
+    VkPipelineCacheCreateInfo cacheInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    VK_CHECK(vkCreatePipelineCache(mDevice, &cacheInfo, nullptr, &mVkPipelineCache));
+}
+
+void PipelinePermutationCache::destroy()
+{
+    // compilations still running on workers write into entries we are about to destroy
+    mJobSystem->wait(mPendingCompilations);
+
+    for (auto& [key, permutation] : mPermutations) {
+        if (permutation->pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(mDevice, permutation->pipeline, nullptr);
+        }
+    }
+    mPermutations.clear();
+    mFamilies.clear();
+
+    for (VkShaderModule shaderModule : mShaderModules) {
+        vkDestroyShaderModule(mDevice, shaderModule, nullptr);
+    }
+    mShaderModules.clear();
+
+    vkDestroyPipelineCache(mDevice, mVkPipelineCache, nullptr);
+}
+
+void PipelinePermutationCache::wait_for_pending()
+{
+    mJobSystem->wait(mPendingCompilations);
+}
+
+VkShaderModule PipelinePermutationCache::load_shader(const char* fileName, uint64_t* outCodeHash)
+{
+    VkShaderModule shaderModule;
+    if (mArchive) {
+        // archived SPIR-V is stored uncompressed and aligned, so the module is created straight from the mapping
+        // and the stored content hash replaces hashing the code again
+        const AssetArchive::Entry* entry = mArchive->find(std::string("shaders/") + fileName);
+        if (entry && entry->compression == AssetArchive::Compression::None) {
+            if (vkutil::create_shader_module(entry->storedData, entry->size, mDevice, &shaderModule)) {
+                if (outCodeHash) {
+                    *outCodeHash = entry->contentHash;
+                }
+                mShaderModules.push_back(shaderModule);
+                return shaderModule;
+            }
+        }
+    }
+
+    // SUNABA_SHADER_DIR is set by the build to wherever the Shaders target writes its SPIR-V
+    std::string path = std::string(SUNABA_SHADER_DIR) + fileName;
+
+    if (!vkutil::load_shader_module(path.c_str(), mDevice, &shaderModule, outCodeHash)) {
+        throw std::runtime_error("Failed to load shader " + path);
+    }
+    mShaderModules.push_back(shaderModule);
+    return shaderModule;
+}
+
+VkShaderModule PipelinePermutationCache::load_draw_format_shader(const char* fileName, VkFormat drawFormat, uint64_t* outCodeHash)
+{
+    if (drawFormat != VK_FORMAT_R32G32B32A32_SFLOAT) {
+        return load_shader(fileName, outCodeHash);
+    }
+    // background.comp.spv -> background.comp.rgba32f.spv
+    std::string variant = fileName;
+    variant.insert(variant.rfind(".spv"), ".rgba32f");
+    return load_shader(variant.c_str(), outCodeHash);
+}
+
+uint32_t PipelinePermutationCache::register_family(const char* name, uint64_t baseHash, PermutationBuilder&& builder, const SpecializationData& fallbackSpecialization)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    VkPipeline fallback = builder(mDevice, mVkPipelineCache, fallbackSpecialization);
+    auto end = std::chrono::high_resolution_clock::now();
+    if (fallback == VK_NULL_HANDLE) {
+        throw std::runtime_error(std::string("Failed to compile fallback pipeline for ") + name);
+    }
+
+    uint32_t familyIndex = (uint32_t)mFamilies.size();
+    mFamilies.push_back(std::make_unique<Family>(Family{ name, baseHash, std::move(builder), fallback }));
+
+    // the fallback is also a regular permutation, so requesting its specialization never compiles it twice
+    auto permutation = std::make_unique<Permutation>();
+    permutation->pipeline = fallback;
+    permutation->compileTime = std::chrono::duration<float, std::milli>(end - start).count();
+    permutation->state.store(PermutationState::Ready);
+
+    uint64_t key = vkutil::hash_combine(vkutil::hash_combine(baseHash, familyIndex), fallbackSpecialization.hash());
+    std::lock_guard<std::mutex> lock(mPermutationsMutex);
+    mPermutations[key] = std::move(permutation);
+
+    return familyIndex;
+}
+
+uint32_t PipelinePermutationCache::register_graphics_family(const char* name, const PipelineBuilder& builder, const SpecializationData& fallbackSpecialization)
+{
+    // the builder is captured by value so workers compile against an immutable copy
+    return register_family(name, builder.hash(),
+        [builder](VkDevice device, VkPipelineCache pipelineCache, const SpecializationData& specialization) {
+            return builder.build_pipeline(device, pipelineCache, &specialization);
+        },
+        fallbackSpecialization);
+}
+
+uint32_t PipelinePermutationCache::register_compute_family(const char* name, const ComputePipelineBuilder& builder, const SpecializationData& fallbackSpecialization)
+{
+    return register_family(name, builder.hash(),
+        [builder](VkDevice device, VkPipelineCache pipelineCache, const SpecializationData& specialization) {
+            return builder.build_pipeline(device, pipelineCache, &specialization);
+        },
+        fallbackSpecialization);
+}
+
+PipelinePermutationCache::Permutation* PipelinePermutationCache::request_permutation(uint32_t family, const SpecializationData& specialization)
+{
+    const Family* familyInfo = mFamilies[family].get();
+    uint64_t key = vkutil::hash_combine(vkutil::hash_combine(familyInfo->baseHash, family), specialization.hash());
+
+    Permutation* permutation;
+    {
+        std::lock_guard<std::mutex> lock(mPermutationsMutex);
+        auto found = mPermutations.find(key);
+        if (found != mPermutations.end()) {
+            return found->second.get();
+        }
+        auto newPermutation = std::make_unique<Permutation>();
+        permutation = newPermutation.get();
+        mPermutations[key] = std::move(newPermutation);
+    }
+
+    // first request of this permutation: compile it in the background
+    // the job owns a copy of the specialization data, as the caller's copy is usually a temporary
+    mJobSystem->schedule([this, permutation, familyInfo, specialization]() {
+        auto start = std::chrono::high_resolution_clock::now();
+        VkPipeline pipeline = familyInfo->builder(mDevice, mVkPipelineCache, specialization);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        permutation->pipeline = pipeline;
+        permutation->compileTime = std::chrono::duration<float, std::milli>(end - start).count();
+        mTotalCompileMicroseconds.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+        // publishing the state last makes the pipeline handle visible to the render thread
+        permutation->state.store(pipeline != VK_NULL_HANDLE ? PermutationState::Ready : PermutationState::Failed);
+        if (pipeline == VK_NULL_HANDLE) {
+            std::cout << "pipeline permutation of " << familyInfo->name << " failed to compile; keeping the fallback" << std::endl;
+        }
+    }, &mPendingCompilations);
+
+    return permutation;
+}
+
+VkPipeline PipelinePermutationCache::get_pipeline(uint32_t family, const SpecializationData& specialization)
+{
+    Permutation* permutation = request_permutation(family, specialization);
+    if (permutation->state.load() == PermutationState::Ready) {
+        return permutation->pipeline;
+    }
+
+    mFallbacksThisFrame.fetch_add(1);
+    return mFamilies[family]->fallback;
+}
+
+bool PipelinePermutationCache::is_ready(uint32_t family, const SpecializationData& specialization)
+{
+    return request_permutation(family, specialization)->state.load() == PermutationState::Ready;
+}
+
+void PipelinePermutationCache::prewarm(uint32_t family, const SpecializationData& specialization)
+{
+    request_permutation(family, specialization);
+}
+
+PipelinePermutationCache::Stats PipelinePermutationCache::get_stats()
+{
+    Stats stats{};
+    {
+        std::lock_guard<std::mutex> lock(mPermutationsMutex);
+        for (auto& [key, permutation] : mPermutations) {
+            if (permutation->state.load() == PermutationState::Ready) {
+                stats.readyPermutations++;
+            }
+            else if (permutation->state.load() == PermutationState::Pending) {
+                stats.pendingPermutations++;
+            }
+        }
+    }
+    stats.fallbacksThisFrame = mFallbacksThisFrame.load();
+    stats.totalCompileTime = mTotalCompileMicroseconds.load() / 1000.f;
+    return stats;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <volk.h>
+
+#include "job_system.h"
+
+class AssetArchive;
+
+// specialization constants baked into a pipeline at creation time; each permutation of these values is a separate pipeline
+struct SpecializationData {
+	std::vector<VkSpecializationMapEntry> mEntries;
+	std::vector<uint8_t> mData;
+
+	// constants must be scalars (bool32, int, uint, float) to match the shader's layout(constant_id = ...) declarations
+	template<typename T>
+	SpecializationData& add_constant(uint32_t constantId, T value) {
+		static_assert(sizeof(T) == 4, "specialization constants are 32 bit scalars");
+		VkSpecializationMapEntry entry{};
+		entry.constantID = constantId;
+		entry.offset = (uint32_t)mData.size();
+		entry.size = sizeof(T);
+		mEntries.push_back(entry);
+
+		mData.resize(mData.size() + sizeof(T));
+		std::memcpy(mData.data() + entry.offset, &value, sizeof(T));
+		return *this;
+	}
+
+	bool empty() const { return mEntries.empty(); }
+	// the returned info points into this struct, so it must outlive pipeline creation
+	VkSpecializationInfo get_info() const;
+	uint64_t hash() const;
+};
+
+// builds graphics pipelines for dynamic rendering (no render pass objects)
+// the builder is a plain value, so it can be copied into a worker job that compiles a permutation later
+class PipelineBuilder {
+public:
+	std::vector<VkPipelineShaderStageCreateInfo> mShaderStages;
+	VkPipelineInputAssemblyStateCreateInfo mInputAssembly;
+	VkPipelineRasterizationStateCreateInfo mRasterizer;
+	VkPipelineColorBlendAttachmentState mColorBlendAttachment;
+	VkPipelineMultisampleStateCreateInfo mMultisampling;
+	VkPipelineDepthStencilStateCreateInfo mDepthStencil;
+	VkPipelineLayout mPipelineLayout;
+	std::vector<VkFormat> mColorAttachmentFormats;
+	VkFormat mDepthAttachmentFormat;
+	// stages which receive the specialization constants passed to build_pipeline
+	VkShaderStageFlags mSpecializedStages;
+	// identifies the shader code (see vkutil::load_shader_module) independently of the module handles
+	uint64_t mShaderHash;
+
+	PipelineBuilder() { clear(); }
+
+	void clear();
+	VkPipeline build_pipeline(VkDevice device, VkPipelineCache pipelineCache = VK_NULL_HANDLE, const SpecializationData* specialization = nullptr) const;
+	// hash of the shader code and every piece of fixed function state that affects the compiled pipeline
+	uint64_t hash() const;
+
+	void set_shaders(VkShaderModule vertexShader, VkShaderModule fragmentShader, uint64_t shaderHash = 0);
+	// depth only pipelines (e.g. shadow maps) have no fragment shader
+	void set_vertex_shader_only(VkShaderModule vertexShader, uint64_t shaderHash = 0);
+	void set_specialized_stages(VkShaderStageFlags stages);
+	void set_input_topology(VkPrimitiveTopology topology);
+	void set_polygon_mode(VkPolygonMode mode);
+	void set_cull_mode(VkCullModeFlags cullMode, VkFrontFace frontFace);
+	void set_multisampling_none();
+	void disable_blending();
+	void enable_blending_additive();
+	void enable_blending_alphablend();
+	void set_color_attachment_format(VkFormat format);
+	void set_color_attachment_formats(std::span<const VkFormat> formats);
+	void set_depth_format(VkFormat format);
+	void disable_depthtest();
+	void enable_depthtest(bool bDepthWriteEnable, VkCompareOp compareOp);
+	void enable_depth_bias();
+	void set_layout(VkPipelineLayout layout);
+};
+
+class ComputePipelineBuilder {
+public:
+	VkPipelineShaderStageCreateInfo mShaderStage;
+	VkPipelineLayout mPipelineLayout;
+	uint64_t mShaderHash;
+
+	ComputePipelineBuilder() { clear(); }
+
+	void clear();
+	VkPipeline build_pipeline(VkDevice device, VkPipelineCache pipelineCache = VK_NULL_HANDLE, const SpecializationData* specialization = nullptr) const;
+	uint64_t hash() const;
+
+	void set_shader(VkShaderModule computeShader, uint64_t shaderHash = 0);
+	void set_layout(VkPipelineLayout layout);
+};
+
+// Caches specialization constant permutations of pipeline "families" (one shader set + fixed function state).
+// Permutations are keyed on hash(shader, state, specialization data) and compiled lazily on worker threads;
+// until a permutation is ready, get_pipeline returns the family's fallback so a frame never stalls on compilation
+class PipelinePermutationCache {
+public:
+	using PermutationBuilder = std::function<VkPipeline(VkDevice, VkPipelineCache, const SpecializationData&)>;
+
+	struct Stats {
+		uint32_t readyPermutations;
+		uint32_t pendingPermutations;
+		// number of get_pipeline calls that fell back since the last reset_frame_stats
+		uint32_t fallbacksThisFrame;
+		float totalCompileTime; // in milliseconds, summed over all worker threads
+	};
+
+	void init(VkDevice device, JobSystem* jobSystem);
+	// waits for in-flight compilations, then destroys every pipeline the cache created
+	void destroy();
+
+	// compiles the fallback permutation immediately and returns the family id used for lookups
+	uint32_t register_family(const char* name, uint64_t baseHash, PermutationBuilder&& builder, const SpecializationData& fallbackSpecialization);
+	uint32_t register_graphics_family(const char* name, const PipelineBuilder& builder, const SpecializationData& fallbackSpecialization = {});
+	uint32_t register_compute_family(const char* name, const ComputePipelineBuilder& builder, const SpecializationData& fallbackSpecialization = {});
+
+	// never blocks: returns the requested permutation if compiled, otherwise schedules it and returns the fallback
+	VkPipeline get_pipeline(uint32_t family, const SpecializationData& specialization);
+	// true when get_pipeline would return the exact permutation requested
+	bool is_ready(uint32_t family, const SpecializationData& specialization);
+	// schedules compilation ahead of time (e.g. during loading) without using the result
+	void prewarm(uint32_t family, const SpecializationData& specialization);
+	// blocks until every scheduled compilation is done; for loading screens and tests, never mid-frame
+	void wait_for_pending();
+
+	// loads a compiled shader from the asset archive if one is set and has it, otherwise from the shader output directory;
+	// the cache owns the module because permutations referencing it may be compiled at any point until destroy().
+	// Throws if the shader is missing
+	VkShaderModule load_shader(const char* fileName, uint64_t* outCodeHash = nullptr);
+	// load_shader for shaders storing into the draw image, which are built once per draw format (see src/CMakeLists.txt):
+	// the variant of fileName for drawFormat, fileName itself for RGBA16F
+	VkShaderModule load_draw_format_shader(const char* fileName, VkFormat drawFormat, uint64_t* outCodeHash = nullptr);
+
+	// the archive must stay open while shaders are loaded
+	void set_archive(const AssetArchive* archive) { mArchive = archive; }
+
+	VkPipelineCache get_vk_pipeline_cache() const { return mVkPipelineCache; }
+	Stats get_stats();
+	void reset_frame_stats() { mFallbacksThisFrame = 0; }
+
+private:
+	enum class PermutationState : uint32_t { Pending, Ready, Failed };
+
+	struct Permutation {
+		std::atomic<PermutationState> state{ PermutationState::Pending };
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		float compileTime{ 0.f };
+	};
+
+	struct Family {
+		std::string name;
+		uint64_t baseHash;
+		PermutationBuilder builder;
+		VkPipeline fallback;
+	};
+
+	// finds or creates the permutation entry; schedules its compilation if it was just created
+	Permutation* request_permutation(uint32_t family, const SpecializationData& specialization);
+
+	VkDevice mDevice;
+	JobSystem* mJobSystem;
+	const AssetArchive* mArchive = nullptr;
+	// driver-level cache shared by all compilations (internally synchronized)
+	VkPipelineCache mVkPipelineCache;
+
+	// families are heap allocated so worker jobs can hold on to them while new families are registered
+	std::vector<std::unique_ptr<Family>> mFamilies;
+	std::vector<VkShaderModule> mShaderModules;
+	std::unordered_map<uint64_t, std::unique_ptr<Permutation>> mPermutations;
+	std::mutex mPermutationsMutex;
+	JobSystem::Counter mPendingCompilations;
+	std::atomic<uint32_t> mFallbacksThisFrame{ 0 };
+	std::atomic<uint64_t> mTotalCompileMicroseconds{ 0 };
+};
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cmath>
+#include "vk_check_macro.h"
+#include "vk_initializers.h"
+#include "vk_post_process.h"
+#include "vk_utils.h"
+
+namespace {
+    // orders every compute write before the next pass reads or writes anything; the passes are strictly sequential anyway
+    void compute_barrier(VkCommandBuffer cmd)
+    {
+        VkMemoryBarrier2 memoryBarrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+        memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+        memoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+
+        VkDependencyInfo depInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+        depInfo.memoryBarrierCount = 1;
+        depInfo.pMemoryBarriers = &memoryBarrier;
+        vkCmdPipelineBarrier2(cmd, &depInfo);
+    }
+
+    uint32_t group_count(uint32_t size)
+    {
+        // every post shader uses 8x8 groups
+        return (size + 7) / 8;
+    }
+}
+
+void PostProcessChain::declare_targets(RenderTargetPool& renderTargets, VkExtent3D drawImageExtent)
+{
+    // bloom starts at half resolution; the chain stops before mips get smaller than a few texels
+    mBloomExtent = { std::max(drawImageExtent.width / 2, 1u), std::max(drawImageExtent.height / 2, 1u) };
+    uint32_t smallestSide = std::min(mBloomExtent.width, mBloomExtent.height);
+    mBloomMipLevels = std::clamp((int)std::floor(std::log2((float)smallestSide)) - 1, 1, MAX_BLOOM_MIPS);
+
+    RenderTargetPool::TargetDesc bloomDesc;
+    bloomDesc.name = "Bloom";
+    bloomDesc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    bloomDesc.extent = VkExtent3D{ mBloomExtent.width, mBloomExtent.height, 1 };
+    bloomDesc.mipLevels = mBloomMipLevels;
+    bloomDesc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    bloomDesc.firstPass = FramePass::Post;
+    bloomDesc.lastPass = FramePass::Post;
+    mBloomTarget = renderTargets.declare(bloomDesc);
+}
+
+void PostProcessChain::init(VkDevice device, VmaAllocator allocator, PipelinePermutationCache& pipelineCache, const RenderTargetPool& renderTargets,
+    VkFormat drawFormat)
+{
+    mDevice = device;
+    mAllocator = allocator;
+    mPipelineCache = &pipelineCache;
+    mDrawFormat = drawFormat;
+
+    init_resources(renderTargets);
+    init_pipelines();
+}
+
+void PostProcessChain::init_resources(const RenderTargetPool& renderTargets)
+{
+    mBloomImage = renderTargets.get(mBloomTarget).image;
+    mBloomSampledView = renderTargets.get(mBloomTarget).imageView;
+
+    for (int mip = 0; mip < mBloomMipLevels; mip++) {
+        VkImageViewCreateInfo mipViewInfo = vkinit::imageview_create_info(VK_FORMAT_R16G16B16A16_SFLOAT, mBloomImage, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+        mipViewInfo.subresourceRange.baseMipLevel = mip;
+        VK_CHECK(vkCreateImageView(mDevice, &mipViewInfo, nullptr, &mBloomMipViews[mip]));
+    }
+
+    // clamp to edge: the shaders clamp to the used region themselves, this only covers the border texels
+    VkSamplerCreateInfo samplerInfo = { .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mLinearSampler));
+
+    mHistogramBuffer = vkutil::create_buffer(mAllocator, HISTOGRAM_BINS * sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    mExposureBuffer = vkutil::create_buffer(mAllocator, 2 * sizeof(float),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+}
+
+void PostProcessChain::init_pipelines()
+{
+    DescriptorLayoutBuilder layoutBuilder;
+    layoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    layoutBuilder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    layoutBuilder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    layoutBuilder.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    mSetLayout = layoutBuilder.build(mDevice, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    // one push constant range large enough for the biggest pass
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = (uint32_t)std::max({ sizeof(DownsampleConstants), sizeof(ExposureConstants), sizeof(UpsampleConstants), sizeof(TonemapConstants) });
+
+    VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &mSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &mPipelineLayout));
+
+    ComputePipelineBuilder builder;
+    builder.set_layout(mPipelineLayout);
+    uint64_t shaderHash;
+
+    // the fallback of the downsample is the plain variant; the first mip variant is prewarmed right away
+    VkShaderModule downsampleShader = mPipelineCache->load_shader("post_downsample.comp.spv", &shaderHash);
+    builder.set_shader(downsampleShader, shaderHash);
+    mDownsampleFamily = mPipelineCache->register_compute_family("post downsample", builder,
+        SpecializationData().add_constant(0, VkBool32(VK_FALSE)));
+    mPipelineCache->prewarm(mDownsampleFamily, SpecializationData().add_constant(0, VkBool32(VK_TRUE)));
+
+    VkShaderModule exposureShader = mPipelineCache->load_shader("post_exposure.comp.spv", &shaderHash);
+    builder.set_shader(exposureShader, shaderHash);
+    mExposureFamily = mPipelineCache->register_compute_family("post exposure", builder);
+
+    VkShaderModule upsampleShader = mPipelineCache->load_shader("post_upsample.comp.spv", &shaderHash);
+    builder.set_shader(upsampleShader, shaderHash);
+    mUpsampleFamily = mPipelineCache->register_compute_family("post upsample", builder);
+
+    // tonemapper, bloom and auto-exposure toggles are specialization constants, so each combination compiles without dead branches
+    // the fallback is the default settings' combination; others compile in the background the first time they are selected
+    // the only pass storing into the HDR image itself; bloom mips stay RGBA16F whatever its format
+    VkShaderModule tonemapShader = mPipelineCache->load_draw_format_shader("post_tonemap.comp.spv", mDrawFormat, &shaderHash);
+    builder.set_shader(tonemapShader, shaderHash);
+    PostProcessSettings defaults;
+    mTonemapFamily = mPipelineCache->register_compute_family("post tonemap", builder, SpecializationData()
+        .add_constant(0, int32_t(defaults.tonemapper))
+        .add_constant(1, VkBool32(defaults.bBloom))
+        .add_constant(2, VkBool32(defaults.bAutoExposure)));
+}
+
+void PostProcessChain::destroy()
+{
+    vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+    vkDestroySampler(mDevice, mLinearSampler, nullptr);
+
+    for (int mip = 0; mip < mBloomMipLevels; mip++) {
+        vkDestroyImageView(mDevice, mBloomMipViews[mip], nullptr);
+    }
+
+    vkutil::destroy_buffer(mAllocator, mHistogramBuffer);
+    vkutil::destroy_buffer(mAllocator, mExposureBuffer);
+}
+
+VkDescriptorSet PostProcessChain::allocate_set(DescriptorAllocatorGrowable& frameDescriptors, VkImageView sampledView, VkImageView storageView)
+{
+    VkDescriptorSet set = frameDescriptors.allocate(mDevice, mSetLayout);
+
+    // every image the post chain touches stays in GENERAL while the passes run
+    DescriptorWriter writer;
+    writer.write_image(0, sampledView, mLinearSampler, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    writer.write_image(1, storageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    writer.write_buffer(2, mHistogramBuffer.buffer, HISTOGRAM_BINS * sizeof(uint32_t), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.write_buffer(3, mExposureBuffer.buffer, 2 * sizeof(float), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.update_set(mDevice, set);
+    return set;
+}
+
+VkExtent2D PostProcessChain::get_bloom_mip_extent(VkExtent2D drawExtent, int mip) const
+{
+    // the used region of each mip follows the draw extent, which can be smaller than the draw image
+    return { std::max((drawExtent.width / 2) >> mip, 1u), std::max((drawExtent.height / 2) >> mip, 1u) };
+}
+
+void PostProcessChain::schedule(AsyncComputeScheduler& scheduler, DescriptorAllocatorGrowable& frameDescriptors,
+    const AllocatedImage& hdrImage, VkExtent2D drawExtent, float deltaTime)
+{
+    if (!mSettings.bEnabled) {
+        return;
+    }
+
+    const PostProcessSettings settings = mSettings;
+    const int mipCount = std::clamp(settings.bBloom ? settings.bloomMipCount : 1, 1, mBloomMipLevels);
+    const float logLuminanceRange = std::max(settings.maxLogLuminance - settings.minLogLuminance, 0.001f);
+    const bool bNeedsFirstDownsample = settings.bBloom || settings.bAutoExposure;
+
+    // pipelines and descriptor sets are resolved now, on the render thread; the passes only record commands
+    VkPipeline firstDownsamplePipeline = mPipelineCache->get_pipeline(mDownsampleFamily, SpecializationData().add_constant(0, VkBool32(VK_TRUE)));
+    VkPipeline downsamplePipeline = mPipelineCache->get_pipeline(mDownsampleFamily, SpecializationData().add_constant(0, VkBool32(VK_FALSE)));
+    VkPipeline exposurePipeline = mPipelineCache->get_pipeline(mExposureFamily, SpecializationData());
+    VkPipeline upsamplePipeline = mPipelineCache->get_pipeline(mUpsampleFamily, SpecializationData());
+    VkPipeline tonemapPipeline = mPipelineCache->get_pipeline(mTonemapFamily, SpecializationData()
+        .add_constant(0, int32_t(settings.tonemapper))
+        .add_constant(1, VkBool32(settings.bBloom))
+        .add_constant(2, VkBool32(settings.bAutoExposure)));
+
+    VkPipelineLayout layout = mPipelineLayout;
+    VkBuffer histogramBuffer = mHistogramBuffer.buffer;
+    VkBuffer exposureBuffer = mExposureBuffer.buffer;
+
+    // the bloom chain stays in GENERAL while the passes run; other passes' targets share its memory in between, so every
+    // frame starts it over from UNDEFINED
+    const bool bInitBuffers = !mBuffersInitialized;
+    mBuffersInitialized = true;
+    VkImage bloomImage = mBloomImage;
+    scheduler.schedule_pass("Post: init", [=](VkCommandBuffer cmd) {
+        vkutil::transition_image(cmd, bloomImage, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        if (bInitBuffers) {
+            vkCmdFillBuffer(cmd, histogramBuffer, 0, VK_WHOLE_SIZE, 0);
+            // 1.0f, so exposure adapts from a neutral value
+            vkCmdFillBuffer(cmd, exposureBuffer, 0, VK_WHOLE_SIZE, 0x3F800000);
+        }
+        compute_barrier(cmd);
+    });
+
+    // downsample chain: mip 0 reads the HDR image (and builds the histogram), every further mip reads the previous one
+    if (bNeedsFirstDownsample) {
+        VkExtent2D mip0 = get_bloom_mip_extent(drawExtent, 0);
+        VkDescriptorSet firstSet = allocate_set(frameDescriptors, hdrImage.imageView, mBloomMipViews[0]);
+
+        DownsampleConstants constants{};
+        constants.sourceSize[0] = (int32_t)drawExtent.width;
+        constants.sourceSize[1] = (int32_t)drawExtent.height;
+        constants.destinationSize[0] = (int32_t)mip0.width;
+        constants.destinationSize[1] = (int32_t)mip0.height;
+        constants.sourceLod = 0;
+        constants.threshold = settings.bloomThreshold;
+        constants.knee = std::max(settings.bloomKnee, 0.0001f);
+        constants.minLogLuminance = settings.minLogLuminance;
+        constants.inverseLogLuminanceRange = 1.f / logLuminanceRange;
+
+        scheduler.schedule_pass("Post: downsample + histogram", [=](VkCommandBuffer cmd) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, firstDownsamplePipeline);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &firstSet, 0, nullptr);
+            vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsampleConstants), &constants);
+            vkCmdDispatch(cmd, group_count(mip0.width), group_count(mip0.height), 1);
+            compute_barrier(cmd);
+        });
+    }
+
+    if (settings.bBloom && mipCount > 1) {
+        std::vector<VkDescriptorSet> sets;
+        std::vector<DownsampleConstants> mipConstants;
+        std::vector<VkExtent2D> extents;
+        for (int mip = 1; mip < mipCount; mip++) {
+            VkExtent2D source = get_bloom_mip_extent(drawExtent, mip - 1);
+            VkExtent2D destination = get_bloom_mip_extent(drawExtent, mip);
+            sets.push_back(allocate_set(frameDescriptors, mBloomSampledView, mBloomMipViews[mip]));
+
+            DownsampleConstants constants{};
+            constants.sourceSize[0] = (int32_t)source.width;
+            constants.sourceSize[1] = (int32_t)source.height;
+            constants.destinationSize[0] = (int32_t)destination.width;
+            constants.destinationSize[1] = (int32_t)destination.height;
+            constants.sourceLod = mip - 1;
+            mipConstants.push_back(constants);
+            extents.push_back(destination);
+        }
+
+        scheduler.schedule_pass("Post: bloom downsample", [=](VkCommandBuffer cmd) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline);
+            for (size_t i = 0; i < sets.size(); i++) {
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &sets[i], 0, nullptr);
+                vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsampleConstants), &mipConstants[i]);
+                vkCmdDispatch(cmd, group_count(extents[i].width), group_count(extents[i].height), 1);
+                compute_barrier(cmd);
+            }
+        });
+    }
+
+    if (settings.bAutoExposure) {
+        // the exposure pass only touches the buffers, but the set layout wants valid images in every binding
+        VkDescriptorSet exposureSet = allocate_set(frameDescriptors, mBloomSampledView, mBloomMipViews[0]);
+
+        ExposureConstants constants{};
+        constants.minLogLuminance = settings.minLogLuminance;
+        constants.logLuminanceRange = logLuminanceRange;
+        constants.deltaTime = deltaTime;
+        constants.adaptationSpeed = settings.adaptationSpeed;
+        constants.exposureCompensation = settings.exposureCompensation;
+        constants.pixelCount = drawExtent.width * drawExtent.height;
+
+        scheduler.schedule_pass("Post: exposure", [=](VkCommandBuffer cmd) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, exposurePipeline);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &exposureSet, 0, nullptr);
+            vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ExposureConstants), &constants);
+            vkCmdDispatch(cmd, 1, 1, 1);
+            compute_barrier(cmd);
+        });
+    }
+
+    // upsample chain: from the smallest mip up, each mip is blurred and added onto the next larger one
+    if (settings.bBloom && mipCount > 1) {
+        std::vector<VkDescriptorSet> sets;
+        std::vector<UpsampleConstants> mipConstants;
+        std::vector<VkExtent2D> extents;
+        for (int mip = mipCount - 1; mip > 0; mip--) {
+            VkExtent2D source = get_bloom_mip_extent(drawExtent, mip);
+            VkExtent2D destination = get_bloom_mip_extent(drawExtent, mip - 1);
+            sets.push_back(allocate_set(frameDescriptors, mBloomSampledView, mBloomMipViews[mip - 1]));
+
+            UpsampleConstants constants{};
+            constants.destinationSize[0] = (int32_t)destination.width;
+            constants.destinationSize[1] = (int32_t)destination.height;
+            constants.sourceSize[0] = (int32_t)source.width;
+            constants.sourceSize[1] = (int32_t)source.height;
+            constants.sourceLod = mip;
+            constants.filterRadius = settings.bloomFilterRadius;
+            mipConstants.push_back(constants);
+            extents.push_back(destination);
+        }
+
+        scheduler.schedule_pass("Post: bloom upsample", [=](VkCommandBuffer cmd) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, upsamplePipeline);
+            for (size_t i = 0; i < sets.size(); i++) {
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &sets[i], 0, nullptr);
+                vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(UpsampleConstants), &mipConstants[i]);
+                vkCmdDispatch(cmd, group_count(extents[i].width), group_count(extents[i].height), 1);
+                compute_barrier(cmd);
+            }
+        });
+    }
+
+    // composite + exposure + tonemap + sRGB encode, in place on the HDR image
+    {
+        VkExtent2D bloomExtent = get_bloom_mip_extent(drawExtent, 0);
+        VkDescriptorSet tonemapSet = allocate_set(frameDescriptors, mBloomSampledView, hdrImage.imageView);
+
+        TonemapConstants constants{};
+        constants.size[0] = (int32_t)drawExtent.width;
+        constants.size[1] = (int32_t)drawExtent.height;
+        constants.bloomSize[0] = (int32_t)bloomExtent.width;
+        constants.bloomSize[1] = (int32_t)bloomExtent.height;
+        constants.manualExposure = settings.manualExposure * std::exp2(settings.exposureCompensation);
+        constants.bloomIntensity = settings.bloomIntensity;
+        constants.bloomNormalization = 1.f / (float)mipCount;
+
+        scheduler.schedule_pass("Post: tonemap", [=](VkCommandBuffer cmd) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, tonemapPipeline);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &tonemapSet, 0, nullptr);
+            vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(TonemapConstants), &constants);
+            vkCmdDispatch(cmd, group_count(drawExtent.width), group_count(drawExtent.height), 1);
+        });
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "vk_async_compute.h"
+#include "vk_descriptors.h"
+#include "vk_pipelines.h"
+#include "vk_render_targets.h"
+#include "vk_types.h"
+
+// everything about the post chain that can be changed at runtime
+struct PostProcessSettings {
+	bool bEnabled = true;
+	bool bAutoExposure = true;
+	bool bBloom = true;
+	int tonemapper = 0; // PostProcessChain::Tonemapper
+	float exposureCompensation = 0.f; // in EV, applied on top of auto-exposure
+	float manualExposure = 1.f; // used when auto-exposure is off
+	float adaptationSpeed = 1.5f;
+	// luminance range covered by the histogram, in log2 units
+	float minLogLuminance = -10.f;
+	float maxLogLuminance = 6.f;
+	float bloomIntensity = 0.04f;
+	float bloomThreshold = 1.f;
+	float bloomKnee = 0.5f;
+	float bloomFilterRadius = 1.f; // in texels of the smaller mip
+	int bloomMipCount = 6;
+};
+
+// Compute post-processing of the HDR draw image: luminance histogram auto-exposure, a downsample/upsample bloom
+// chain and filmic tonemapping. Passes are handed to the AsyncComputeScheduler so they run on the compute queue
+// where there is one. Adjacent passes are fused where they read the same data: the histogram is built by the first
+// bloom downsample, and bloom composite, exposure, tonemapping and sRGB encoding are a single pass
+class PostProcessChain {
+public:
+	enum Tonemapper : int {
+		Aces = 0,
+		Filmic = 1,
+		Reinhard = 2,
+		None = 3
+	};
+
+	static constexpr int MAX_BLOOM_MIPS = 8;
+	static constexpr uint32_t HISTOGRAM_BINS = 256;
+
+	PostProcessSettings mSettings;
+
+	// the bloom chain is sized for the largest extent the draw image can have; declared before the pool is built
+	void declare_targets(RenderTargetPool& renderTargets, VkExtent3D drawImageExtent);
+	// drawFormat is that of the HDR images schedule is given
+	void init(VkDevice device, VmaAllocator allocator, PipelinePermutationCache& pipelineCache, const RenderTargetPool& renderTargets,
+		VkFormat drawFormat);
+	void destroy();
+
+	// forgets the adapted exposure; the next scheduled frame starts over from an exposure of 1
+	void reset_history() { mBuffersInitialized = false; }
+
+	// queues this frame's passes; the HDR image is tonemapped in place and left sRGB encoded
+	void schedule(AsyncComputeScheduler& scheduler, DescriptorAllocatorGrowable& frameDescriptors,
+		const AllocatedImage& hdrImage, VkExtent2D drawExtent, float deltaTime);
+
+private:
+	struct DownsampleConstants {
+		int32_t sourceSize[2];
+		int32_t destinationSize[2];
+		int32_t sourceLod;
+		float threshold;
+		float knee;
+		float minLogLuminance;
+		float inverseLogLuminanceRange;
+	};
+
+	struct ExposureConstants {
+		float minLogLuminance;
+		float logLuminanceRange;
+		float deltaTime;
+		float adaptationSpeed;
+		float exposureCompensation;
+		uint32_t pixelCount;
+	};
+
+	struct UpsampleConstants {
+		int32_t destinationSize[2];
+		int32_t sourceSize[2];
+		int32_t sourceLod;
+		float filterRadius;
+	};
+
+	struct TonemapConstants {
+		int32_t size[2];
+		int32_t bloomSize[2];
+		float manualExposure;
+		float bloomIntensity;
+		float bloomNormalization;
+	};
+
+	void init_resources(const RenderTargetPool& renderTargets);
+	void init_pipelines();
+
+	// the set layout is shared by every pass: 0 sampled source, 1 storage destination, 2 histogram, 3 exposure
+	VkDescriptorSet allocate_set(DescriptorAllocatorGrowable& frameDescriptors, VkImageView sampledView, VkImageView storageView);
+	VkExtent2D get_bloom_mip_extent(VkExtent2D drawExtent, int mip) const;
+
+	VkDevice mDevice;
+	VmaAllocator mAllocator;
+	PipelinePermutationCache* mPipelineCache;
+	VkFormat mDrawFormat;
+
+	VkDescriptorSetLayout mSetLayout;
+	VkPipelineLayout mPipelineLayout;
+	uint32_t mDownsampleFamily;
+	uint32_t mExposureFamily;
+	uint32_t mUpsampleFamily;
+	uint32_t mTonemapFamily;
+
+	VkSampler mLinearSampler;
+
+	// half resolution bloom chain; one view per mip for storage writes, one view over all mips for sampling (the pool's).
+	// Only used by the post passes, so it shares memory with render targets of other passes
+	RenderTargetPool::Handle mBloomTarget;
+	VkImage mBloomImage;
+	VkExtent2D mBloomExtent;
+	int mBloomMipLevels;
+	VkImageView mBloomSampledView;
+	VkImageView mBloomMipViews[MAX_BLOOM_MIPS];
+
+	AllocatedBuffer mHistogramBuffer;
+	// adapted exposure, carried over from frame to frame
+	AllocatedBuffer mExposureBuffer;
+	// the buffers are cleared by the first frame's command buffer
+	bool mBuffersInitialized = false;
+};
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include "vk_check_macro.h"
+#include "vk_profiler.h"
+
+void GpuProfiler::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, uint32_t maxScopesPerFrame)
+{
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    // every scope writes a begin and an end timestamp
+    mMaxQueriesPerFrame = maxScopesPerFrame * 2;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+    mTimestampPeriod = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolInfo = { .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = mMaxQueriesPerFrame;
+
+    mFrames.resize(framesInFlight);
+    for (FrameQueries& frame : mFrames) {
+        VK_CHECK(vkCreateQueryPool(mDevice, &queryPoolInfo, nullptr, &frame.queryPool));
+        // queries must be reset before their first use; host reset avoids recording a reset command on some queue
+        vkResetQueryPool(mDevice, frame.queryPool, 0, mMaxQueriesPerFrame);
+        frame.usedQueries = 0;
+    }
+}
+
+void GpuProfiler::destroy()
+{
+    for (FrameQueries& frame : mFrames) {
+        vkDestroyQueryPool(mDevice, frame.queryPool, nullptr);
+    }
+    mFrames.clear();
+}
+
+void GpuProfiler::set_queue_family(GpuQueueTrack queue, uint32_t queueFamilyIndex)
+{
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &familyCount, families.data());
+
+    // a family reporting 0 valid bits cannot write timestamps at all; the bits above the valid ones are undefined
+    uint32_t validBits = families[queueFamilyIndex].timestampValidBits;
+    mTimestampMasks[(uint32_t)queue] = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+}
+
+void GpuProfiler::begin_frame(uint32_t frameIndex)
+{
+    mCurrentFrame = frameIndex;
+    FrameQueries& frame = mFrames[mCurrentFrame];
+
+    if (frame.usedQueries > 0) {
+        std::vector<uint64_t> timestamps(frame.usedQueries);
+        // no WAIT flag: the frame's fence has signalled so results should be there, but we never block if they are not
+        VkResult result = vkGetQueryPoolResults(mDevice, frame.queryPool, 0, frame.usedQueries,
+            timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS) {
+            // timestamps are only strictly comparable within a queue, but desktop drivers share one time domain across queues,
+            // which is what makes the overlap visible
+            uint64_t frameStart = UINT64_MAX;
+            for (const Scope& scope : frame.scopes) {
+                if (scope.bEnded) {
+                    frameStart = std::min(frameStart, timestamps[scope.beginQuery] & mTimestampMasks[(uint32_t)scope.queue]);
+                }
+            }
+
+            // keep the last results as the previous frame's, shifted so both frames share this frame's timebase
+            mPreviousResults.clear();
+            if (mLastResultsFrame + 1 == mCollectedFrames) {
+                uint64_t mask = mTimestampMasks[(uint32_t)GpuQueueTrack::Graphics] | mTimestampMasks[(uint32_t)GpuQueueTrack::Compute];
+                double shift = ((frameStart - mLastFrameStart) & mask) * mTimestampPeriod / 1000000.0;
+                mPreviousResults.swap(mLastResults);
+                for (ScopeResult& scopeResult : mPreviousResults) {
+                    scopeResult.begin -= shift;
+                    scopeResult.end -= shift;
+                }
+            }
+            mLastFrameStart = frameStart;
+            mLastResultsFrame = mCollectedFrames;
+
+            mLastResults.clear();
+            for (const Scope& scope : frame.scopes) {
+                if (!scope.bEnded) {
+                    continue;
+                }
+                ScopeResult scopeResult;
+                scopeResult.name = scope.name;
+                scopeResult.queue = scope.queue;
+                // differences are taken modulo the valid bits too, so a counter wrapping within the frame still measures right
+                uint64_t mask = mTimestampMasks[(uint32_t)scope.queue];
+                uint64_t begin = timestamps[scope.beginQuery] & mask;
+                uint64_t end = timestamps[scope.endQuery] & mask;
+                uint64_t beginTicks = (begin - frameStart) & mask;
+                uint64_t durationTicks = (end - begin) & mask;
+                scopeResult.begin = beginTicks * mTimestampPeriod / 1000000.0;
+                scopeResult.end = (beginTicks + durationTicks) * mTimestampPeriod / 1000000.0;
+                mLastResults.push_back(scopeResult);
+            }
+        }
+
+        vkResetQueryPool(mDevice, frame.queryPool, 0, frame.usedQueries);
+    }
+
+    frame.scopes.clear();
+    frame.usedQueries = 0;
+    mCollectedFrames++;
+}
+
+uint32_t GpuProfiler::begin_scope(VkCommandBuffer cmd, const char* name, GpuQueueTrack queue)
+{
+    FrameQueries& frame = mFrames[mCurrentFrame];
+    if (mTimestampMasks[(uint32_t)queue] == 0 || frame.usedQueries + 2 > mMaxQueriesPerFrame) {
+        return INVALID_SCOPE;
+    }
+
+    Scope scope;
+    scope.name = name;
+    scope.queue = queue;
+    scope.beginQuery = frame.usedQueries++;
+    scope.endQuery = frame.usedQueries++;
+    scope.bEnded = false;
+
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, frame.queryPool, scope.beginQuery);
+
+    frame.scopes.push_back(scope);
+    return (uint32_t)frame.scopes.size() - 1;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer cmd, uint32_t scopeId)
+{
+    if (scopeId == INVALID_SCOPE) {
+        return;
+    }
+
+    FrameQueries& frame = mFrames[mCurrentFrame];
+    Scope& scope = frame.scopes[scopeId];
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, frame.queryPool, scope.endQuery);
+    scope.bEnded = true;
+}
+
+std::vector<std::pair<double, double>> GpuProfiler::get_busy_intervals(GpuQueueTrack queue, bool bIncludePrevious) const
+{
+    std::vector<std::pair<double, double>> intervals;
+    for (const ScopeResult& scope : mLastResults) {
+        if (scope.queue == queue) {
+            intervals.push_back({ scope.begin, scope.end });
+        }
+    }
+    if (bIncludePrevious) {
+        for (const ScopeResult& scope : mPreviousResults) {
+            if (scope.queue == queue) {
+                intervals.push_back({ scope.begin, scope.end });
+            }
+        }
+    }
+    std::sort(intervals.begin(), intervals.end());
+
+    // nested scopes would otherwise be counted twice
+    std::vector<std::pair<double, double>> merged;
+    for (const auto& interval : intervals) {
+        if (!merged.empty() && interval.first <= merged.back().second) {
+            merged.back().second = std::max(merged.back().second, interval.second);
+        }
+        else {
+            merged.push_back(interval);
+        }
+    }
+    return merged;
+}
+
+double GpuProfiler::get_queue_busy_time(GpuQueueTrack queue) const
+{
+    double busyTime = 0.0;
+    for (const auto& interval : get_busy_intervals(queue)) {
+        busyTime += interval.second - interval.first;
+    }
+    return busyTime;
+}
+
+double GpuProfiler::get_overlap_time() const
+{
+    std::vector<std::pair<double, double>> graphics = get_busy_intervals(GpuQueueTrack::Graphics);
+    // the previous frame's post passes overlap this frame's scene, so its compute scopes count as well
+    std::vector<std::pair<double, double>> compute = get_busy_intervals(GpuQueueTrack::Compute, true);
+
+    // both lists are sorted and disjoint, so a merge-style sweep finds every intersection
+    double overlap = 0.0;
+    size_t g = 0, c = 0;
+    while (g < graphics.size() && c < compute.size()) {
+        double begin = std::max(graphics[g].first, compute[c].first);
+        double end = std::min(graphics[g].second, compute[c].second);
+        if (end > begin) {
+            overlap += end - begin;
+        }
+        if (graphics[g].second < compute[c].second) {
+            g++;
+        }
+        else {
+            c++;
+        }
+    }
+    return overlap;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <volk.h>
+
+// which queue a GPU scope was recorded on; timings are grouped per queue so overlap between them is visible
+enum class GpuQueueTrack : uint32_t {
+	Graphics = 0,
+	Compute = 1,
+	Count
+};
+
+// GPU timestamp scopes, recorded per frame in flight and read back without ever waiting on the GPU.
+// Results of a frame slot are fetched when the CPU comes back to that slot (after its render fence signalled),
+// so the displayed timings lag as many frames behind as there are frames in flight
+class GpuProfiler {
+public:
+	struct ScopeResult {
+		std::string name;
+		GpuQueueTrack queue;
+		// milliseconds relative to the earliest timestamp written in the frame (over all queues)
+		double begin;
+		double end;
+	};
+
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, uint32_t maxScopesPerFrame = 64);
+	void destroy();
+
+	// tells the profiler which queue families can write timestamps at all
+	void set_queue_family(GpuQueueTrack queue, uint32_t queueFamilyIndex);
+
+	// call once the frame slot's fence has been waited on: collects the slot's previous results and resets its queries
+	void begin_frame(uint32_t frameIndex);
+
+	// returns a scope id for end_scope; scopes on queues without timestamp support are silently dropped
+	uint32_t begin_scope(VkCommandBuffer cmd, const char* name, GpuQueueTrack queue = GpuQueueTrack::Graphics);
+	void end_scope(VkCommandBuffer cmd, uint32_t scopeId);
+
+	// results of the most recently completed frame
+	const std::vector<ScopeResult>& get_results() const { return mLastResults; }
+	// total busy time of a queue in the last completed frame (union of its scopes)
+	double get_queue_busy_time(GpuQueueTrack queue) const;
+	// time in which the graphics queue ran the last completed frame while the compute queue was busy, either with the
+	// same frame or with the frame before it (whose post passes may still run when the next scene starts)
+	double get_overlap_time() const;
+
+private:
+	static constexpr uint32_t INVALID_SCOPE = ~0u;
+
+	struct Scope {
+		std::string name;
+		GpuQueueTrack queue;
+		uint32_t beginQuery;
+		uint32_t endQuery;
+		bool bEnded;
+	};
+
+	struct FrameQueries {
+		VkQueryPool queryPool;
+		std::vector<Scope> scopes;
+		uint32_t usedQueries;
+	};
+
+	// merges overlapping [begin, end) intervals of the given queue, sorted by begin; with bIncludePrevious the previous
+	// frame's scopes are merged in as well
+	std::vector<std::pair<double, double>> get_busy_intervals(GpuQueueTrack queue, bool bIncludePrevious = false) const;
+
+	VkDevice mDevice;
+	VkPhysicalDevice mPhysicalDevice;
+	uint32_t mMaxQueriesPerFrame;
+	// nanoseconds per timestamp tick
+	double mTimestampPeriod;
+	// timestampValidBits of each queue's family as a mask, 0 if it cannot write timestamps
+	uint64_t mTimestampMasks[(uint32_t)GpuQueueTrack::Count]{};
+
+	std::vector<FrameQueries> mFrames;
+	uint32_t mCurrentFrame{ 0 };
+	std::vector<ScopeResult> mLastResults;
+	// results of the frame collected right before mLastResults, moved into its timebase; empty if that frame's results
+	// could not be read back, since then the two are not consecutive frames
+	std::vector<ScopeResult> mPreviousResults;
+	// raw timestamp the last results are relative to
+	uint64_t mLastFrameStart{ 0 };
+	// counts begin_frame calls, so consecutive results can be told apart from ones with a dropped frame in between
+	uint64_t mCollectedFrames{ 0 };
+	uint64_t mLastResultsFrame{ UINT64_MAX };
+};
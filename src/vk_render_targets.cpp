@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include "vk_check_macro.h"
+#include "vk_initializers.h"
+#include "vk_render_targets.h"
+
+namespace {
+    // usages that keep a target inside the passes rendering to it; anything else (sampling, storage, copies) needs real memory
+    constexpr VkImageUsageFlags ATTACHMENT_USAGES = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+        | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+    VkImageAspectFlags get_view_aspect(VkFormat format)
+    {
+        switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+}
+
+void RenderTargetPool::init(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator allocator, uint32_t graphicsQueueFamily,
+    uint32_t computeQueueFamily)
+{
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    mAllocator = allocator;
+    mGraphicsQueueFamily = graphicsQueueFamily;
+    mComputeQueueFamily = computeQueueFamily;
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memoryProperties);
+    mLazyMemoryTypeBits = 0;
+    for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++) {
+        if (memoryProperties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+            mLazyMemoryTypeBits |= 1u << type;
+        }
+    }
+}
+
+void RenderTargetPool::destroy()
+{
+    for (Target& target : mTargets) {
+        if (target.image.image != VK_NULL_HANDLE) {
+            vkDestroyImageView(mDevice, target.image.imageView, nullptr);
+            vkDestroyImage(mDevice, target.image.image, nullptr);
+        }
+    }
+    for (SharedAllocation& shared : mAllocations) {
+        vmaFreeMemory(mAllocator, shared.allocation);
+    }
+    mTargets.clear();
+    mAllocations.clear();
+    mInfos.clear();
+    mStats = {};
+}
+
+RenderTargetPool::Handle RenderTargetPool::declare(const TargetDesc& desc)
+{
+    Target target;
+    target.desc = desc;
+    mTargets.push_back(target);
+    return (Handle)mTargets.size() - 1;
+}
+
+bool RenderTargetPool::overlaps(const Target& target, const SharedAllocation& shared) const
+{
+    for (Handle other : shared.targets) {
+        const TargetDesc& otherDesc = mTargets[other].desc;
+        if (target.desc.firstPass <= otherDesc.lastPass && otherDesc.firstPass <= target.desc.lastPass) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t RenderTargetPool::get_queue_family(const TargetDesc& desc) const
+{
+    uint32_t queueFamily = UINT32_MAX;
+    for (uint32_t pass = (uint32_t)desc.firstPass; pass <= (uint32_t)desc.lastPass; pass++) {
+        uint32_t passQueueFamily = pass == (uint32_t)FramePass::Post ? mComputeQueueFamily : mGraphicsQueueFamily;
+        if (queueFamily != UINT32_MAX && queueFamily != passQueueFamily) {
+            return UINT32_MAX;
+        }
+        queueFamily = passQueueFamily;
+    }
+    return queueFamily;
+}
+
+void RenderTargetPool::build()
+{
+    // images first: their memory requirements decide what can share an allocation
+    for (Target& target : mTargets) {
+        const TargetDesc& desc = target.desc;
+        bool bAttachmentOnly = (desc.usage & ~ATTACHMENT_USAGES) == 0;
+        VkImageUsageFlags usage = desc.usage;
+        if (bAttachmentOnly && mLazyMemoryTypeBits != 0) {
+            usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+
+        VkImageCreateInfo imageInfo = vkinit::image_create_info(desc.format, usage, desc.extent, desc.mipLevels);
+        imageInfo.arrayLayers = desc.arrayLayers;
+        VK_CHECK(vkCreateImage(mDevice, &imageInfo, nullptr, &target.image.image));
+        vkGetImageMemoryRequirements(mDevice, target.image.image, &target.requirements);
+        target.image.imageFormat = desc.format;
+        target.image.imageExtent = desc.extent;
+        target.image.mipLevels = desc.mipLevels;
+        // a transient image may still be bound to ordinary memory when no lazy type suits it
+        target.bLazy = bAttachmentOnly && (target.requirements.memoryTypeBits & mLazyMemoryTypeBits) != 0;
+    }
+
+    // largest first, so smaller targets fill in behind the big ones; a target joins the first allocation whose targets
+    // are all dead while it lives
+    std::vector<Handle> order(mTargets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](Handle a, Handle b) {
+        return mTargets[a].requirements.size > mTargets[b].requirements.size;
+    });
+
+    for (Handle handle : order) {
+        const Target& target = mTargets[handle];
+        // a target used on both queues would need the next frame's graphics work to wait for this frame's compute work
+        uint32_t queueFamily = get_queue_family(target.desc);
+        SharedAllocation* shared = nullptr;
+        if (!target.desc.bPersistent && !target.bLazy && queueFamily != UINT32_MAX) {
+            for (SharedAllocation& candidate : mAllocations) {
+                if (!candidate.bPersistent && !candidate.bLazy && candidate.queueFamily == queueFamily
+                    && (candidate.requirements.memoryTypeBits & target.requirements.memoryTypeBits) != 0 && !overlaps(target, candidate)) {
+                    shared = &candidate;
+                    break;
+                }
+            }
+        }
+
+        if (shared) {
+            shared->requirements.size = std::max(shared->requirements.size, target.requirements.size);
+            shared->requirements.alignment = std::max(shared->requirements.alignment, target.requirements.alignment);
+            shared->requirements.memoryTypeBits &= target.requirements.memoryTypeBits;
+        }
+        else {
+            shared = &mAllocations.emplace_back();
+            shared->requirements = target.requirements;
+            shared->bPersistent = target.desc.bPersistent;
+            shared->queueFamily = queueFamily;
+            shared->bLazy = target.bLazy;
+            shared->allocation = VK_NULL_HANDLE;
+        }
+        shared->targets.push_back(handle);
+    }
+
+    mStats = {};
+    mStats.targetCount = (uint32_t)mTargets.size();
+    mStats.allocationCount = (uint32_t)mAllocations.size();
+    for (uint32_t allocationIndex = 0; allocationIndex < mAllocations.size(); allocationIndex++) {
+        SharedAllocation& shared = mAllocations[allocationIndex];
+
+        VmaAllocationCreateInfo allocationInfo = {};
+        if (shared.bLazy) {
+            allocationInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+        }
+        else {
+            allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+            allocationInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+        // a target of its own is allocated for its image, which lets VMA give large render targets dedicated memory
+        if (shared.targets.size() == 1) {
+            VK_CHECK(vmaAllocateMemoryForImage(mAllocator, mTargets[shared.targets[0]].image.image, &allocationInfo, &shared.allocation, nullptr));
+        }
+        else {
+            VK_CHECK(vmaAllocateMemory(mAllocator, &shared.requirements, &allocationInfo, &shared.allocation, nullptr));
+        }
+
+        for (Handle handle : shared.targets) {
+            Target& target = mTargets[handle];
+            VK_CHECK(vmaBindImageMemory(mAllocator, shared.allocation, target.image.image));
+            target.image.allocation = shared.allocation;
+
+            VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(target.desc.format, target.image.image,
+                get_view_aspect(target.desc.format), target.desc.mipLevels);
+            if (target.desc.arrayLayers > 1) {
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+                viewInfo.subresourceRange.layerCount = target.desc.arrayLayers;
+            }
+            VK_CHECK(vkCreateImageView(mDevice, &viewInfo, nullptr, &target.image.imageView));
+
+            mStats.requestedBytes += target.requirements.size;
+            mStats.aliasedTargets += shared.targets.size() > 1 ? 1 : 0;
+            mStats.lazyTargets += target.bLazy ? 1 : 0;
+        }
+        mStats.allocatedBytes += shared.requirements.size;
+        mStats.lazyBytes += shared.bLazy ? shared.requirements.size : 0;
+    }
+
+    mInfos.resize(mTargets.size());
+    for (uint32_t allocationIndex = 0; allocationIndex < mAllocations.size(); allocationIndex++) {
+        for (Handle handle : mAllocations[allocationIndex].targets) {
+            mInfos[handle] = { mTargets[handle].desc.name, mTargets[handle].requirements.size, allocationIndex, mTargets[handle].bLazy };
+        }
+    }
+
+    std::cout << "render targets: " << mStats.targetCount << " in " << mStats.allocationCount << " allocations, "
+        << mStats.allocatedBytes / (1024.0 * 1024.0) << " MB (" << mStats.requestedBytes / (1024.0 * 1024.0) << " MB without aliasing, "
+        << mStats.lazyBytes / (1024.0 * 1024.0) << " MB lazily allocated)" << std::endl;
+}
\ No newline at end of file
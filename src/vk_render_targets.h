@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "vk_types.h"
+
+// the passes of a frame, in the order they run; render target lifetimes are given in these
+enum class FramePass : uint32_t {
+	Background = 0,
+	Scene, // culling, the scene draw and the HZB build of the cluster renderer
+	Post, // the post chain, on the compute queue when there is one
+	Composite, // capture copy, blit to the swapchain and UI
+	Count
+};
+
+// Owns the engine's render targets. Every module declares its targets up front with the passes that use them, then a
+// single build creates all of them: targets whose lifetimes do not overlap share one VMA allocation (bound at offset 0),
+// and targets only ever used as attachments within a pass go to lazily allocated memory where the device has it (tile based
+// GPUs then never back them with memory at all).
+// A target that is not persistent holds nothing between its last pass and its first pass of the next frame, since other
+// targets may have written the memory in between: its first use in a frame must transition it from UNDEFINED. Targets
+// exist once (not per frame in flight) unless declared once per frame, like the draw image; that is safe because work on
+// one queue is ordered frame to frame, and the post passes finish before the frame's composite. Nothing orders the compute
+// queue's post passes against the next frame's graphics work though, so only targets used on the same single queue family
+// share memory
+class RenderTargetPool {
+public:
+	using Handle = uint32_t;
+
+	struct TargetDesc {
+		std::string name;
+		VkFormat format;
+		VkExtent3D extent;
+		uint32_t mipLevels = 1;
+		// more than one makes a 2D array image, viewed as one
+		uint32_t arrayLayers = 1;
+		VkImageUsageFlags usage;
+		// first and last pass that touch the target within a frame
+		FramePass firstPass;
+		FramePass lastPass;
+		// contents are read by a later frame (history), so the memory is never shared
+		bool bPersistent = false;
+	};
+
+	struct TargetInfo {
+		std::string name;
+		VkDeviceSize size;
+		// the allocation the target is bound to; targets with the same index alias each other
+		uint32_t allocationIndex;
+		bool bLazy;
+	};
+
+	// device memory of the targets; requested is what one allocation per target would take
+	struct Stats {
+		uint32_t targetCount;
+		uint32_t allocationCount;
+		uint32_t aliasedTargets;
+		uint32_t lazyTargets;
+		VkDeviceSize requestedBytes;
+		VkDeviceSize allocatedBytes;
+		// part of allocatedBytes in lazily allocated memory, which the driver may never commit
+		VkDeviceSize lazyBytes;
+	};
+
+	// the post passes run on the compute queue family, all other passes on the graphics one (the same without async compute)
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator allocator, uint32_t graphicsQueueFamily, uint32_t computeQueueFamily);
+	// destroys every target's image, view and memory
+	void destroy();
+
+	// only before build
+	Handle declare(const TargetDesc& desc);
+	// creates the images, assigns them memory and creates a view over all of each image's mips and layers
+	void build();
+
+	// after build
+	const AllocatedImage& get(Handle handle) const { return mTargets[handle].image; }
+	const std::vector<TargetInfo>& get_targets() const { return mInfos; }
+	Stats get_stats() const { return mStats; }
+
+private:
+	struct Target {
+		TargetDesc desc;
+		AllocatedImage image{};
+		VkMemoryRequirements requirements;
+		bool bLazy = false;
+	};
+
+	// targets sharing one allocation, which satisfies the requirements of each of them
+	struct SharedAllocation {
+		std::vector<Handle> targets;
+		VkMemoryRequirements requirements;
+		bool bPersistent;
+		// the queue family all its targets are used on
+		uint32_t queueFamily;
+		// a lazily allocated target, never shared
+		bool bLazy;
+		VmaAllocation allocation;
+	};
+
+	bool overlaps(const Target& target, const SharedAllocation& shared) const;
+	// the family of the queue all of the target's passes run on, UINT32_MAX when they span queues
+	uint32_t get_queue_family(const TargetDesc& desc) const;
+
+	VkDevice mDevice;
+	VkPhysicalDevice mPhysicalDevice;
+	VmaAllocator mAllocator;
+	uint32_t mGraphicsQueueFamily;
+	uint32_t mComputeQueueFamily;
+	// memory types with VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+	uint32_t mLazyMemoryTypeBits = 0;
+
+	std::vector<Target> mTargets;
+	std::vector<SharedAllocation> mAllocations;
+	std::vector<TargetInfo> mInfos;
+	Stats mStats{};
+};
\ No newline at end of file
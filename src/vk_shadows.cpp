@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include "vk_check_macro.h"
+#include "vk_initializers.h"
+#include "vk_shadows.h"
+#include "vk_utils.h"
+
+namespace {
+    // radii are rounded up to this, so rounding errors in the fit never change a cascade's size
+    constexpr float RADIUS_STEP = 1.f / 16.f;
+    // light space depth is snapped to this fraction of a cascade's radius; depth does not move texels, so this only
+    // keeps a slowly moving camera from invalidating cached cascades
+    constexpr float DEPTH_STEP = 0.25f;
+
+    using Clock = std::chrono::steady_clock;
+
+    VkImageMemoryBarrier2 layer_barrier(VkImage image, uint32_t layer, uint32_t layerCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+    {
+        VkImageMemoryBarrier2 imageBarrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+        imageBarrier.srcStageMask = srcStage;
+        imageBarrier.srcAccessMask = srcAccess;
+        imageBarrier.dstStageMask = dstStage;
+        imageBarrier.dstAccessMask = dstAccess;
+        imageBarrier.oldLayout = oldLayout;
+        imageBarrier.newLayout = newLayout;
+        imageBarrier.image = image;
+        imageBarrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_DEPTH_BIT);
+        imageBarrier.subresourceRange.baseArrayLayer = layer;
+        imageBarrier.subresourceRange.layerCount = layerCount;
+        return imageBarrier;
+    }
+
+    void image_barriers(VkCommandBuffer cmd, std::span<const VkImageMemoryBarrier2> barriers)
+    {
+        VkDependencyInfo depInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+        depInfo.imageMemoryBarrierCount = (uint32_t)barriers.size();
+        depInfo.pImageMemoryBarriers = barriers.data();
+        vkCmdPipelineBarrier2(cmd, &depInfo);
+    }
+}
+
+void CascadedShadowMaps::declare_targets(RenderTargetPool& renderTargets, uint32_t resolution)
+{
+    mResolution = resolution;
+
+    RenderTargetPool::TargetDesc atlasDesc;
+    atlasDesc.name = "Shadow atlas";
+    atlasDesc.format = DEPTH_FORMAT;
+    atlasDesc.extent = { resolution, resolution, 1 };
+    atlasDesc.arrayLayers = CASCADE_COUNT;
+    atlasDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    atlasDesc.firstPass = FramePass::Scene;
+    atlasDesc.lastPass = FramePass::Scene;
+    // cached cascades are sampled by later frames
+    atlasDesc.bPersistent = true;
+    mAtlasTarget = renderTargets.declare(atlasDesc);
+}
+
+void CascadedShadowMaps::init(VkDevice device, VmaAllocator allocator, const RenderTargetPool& renderTargets, JobSystem* jobSystem,
+    uint32_t queueFamily, uint32_t framesInFlight)
+{
+    mDevice = device;
+    mAllocator = allocator;
+    mJobSystem = jobSystem;
+
+    mAtlas = renderTargets.get(mAtlasTarget);
+    for (uint32_t layer = 0; layer < CASCADE_COUNT; layer++) {
+        VkImageViewCreateInfo layerViewInfo = vkinit::imageview_create_info(DEPTH_FORMAT, mAtlas.image, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+        layerViewInfo.subresourceRange.baseArrayLayer = layer;
+        VK_CHECK(vkCreateImageView(mDevice, &layerViewInfo, nullptr, &mLayerViews[layer]));
+    }
+
+    // hardware comparison with bilinear filtering; beyond the edge of a cascade nothing is in shadow
+    VkSamplerCreateInfo samplerInfo = { .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = 0.f;
+    VK_CHECK(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mSampler));
+
+    // pools are reset as a whole once the frame slot's fence has been waited on
+    VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(queueFamily, 0);
+    mFrames.resize(framesInFlight);
+    for (FrameResources& frame : mFrames) {
+        frame.shadowData = vkutil::create_buffer(mAllocator, sizeof(GpuShadowData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++) {
+            VK_CHECK(vkCreateCommandPool(mDevice, &poolInfo, nullptr, &frame.commandPools[cascade]));
+            VkCommandBufferAllocateInfo allocateInfo = vkinit::command_buffer_allocate_info(frame.commandPools[cascade], 1);
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            VK_CHECK(vkAllocateCommandBuffers(mDevice, &allocateInfo, &frame.commandBuffers[cascade]));
+        }
+    }
+}
+
+void CascadedShadowMaps::destroy()
+{
+    for (FrameResources& frame : mFrames) {
+        vkutil::destroy_buffer(mAllocator, frame.shadowData);
+        for (VkCommandPool pool : frame.commandPools) {
+            vkDestroyCommandPool(mDevice, pool, nullptr);
+        }
+    }
+    mFrames.clear();
+
+    vkDestroySampler(mDevice, mSampler, nullptr);
+    for (VkImageView view : mLayerViews) {
+        vkDestroyImageView(mDevice, view, nullptr);
+    }
+}
+
+void CascadedShadowMaps::invalidate()
+{
+    for (Cascade& cascade : mCascades) {
+        cascade.bValid = false;
+    }
+}
+
+glm::mat4 CascadedShadowMaps::fit_cascade(const CameraParameters& camera, const glm::mat4& lightView, float nearDepth, float farDepth,
+    float* outTexelSize) const
+{
+    // the slice's corners at depth d lie sqrt(k) * d off the view axis; the smallest sphere around all eight is centered
+    // on the axis, where the near and far corners are equally far, or at the far plane if that point lies beyond it
+    float tanHalfFov = std::tan(camera.verticalFov * 0.5f);
+    float k = tanHalfFov * tanHalfFov * (1.f + camera.aspectRatio * camera.aspectRatio);
+    float centerDepth = std::min((1.f + k) * (nearDepth + farDepth) * 0.5f, farDepth);
+    float radius = std::sqrt(std::max((centerDepth - nearDepth) * (centerDepth - nearDepth) + k * nearDepth * nearDepth,
+        (farDepth - centerDepth) * (farDepth - centerDepth) + k * farDepth * farDepth));
+
+    glm::mat4 cameraWorld = glm::inverse(camera.view);
+    glm::vec3 center = glm::vec3(cameraWorld * glm::vec4(0.f, 0.f, -centerDepth, 1.f));
+    glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.f));
+
+    if (mSettings.bStabilize) {
+        radius = std::ceil(radius / RADIUS_STEP) * RADIUS_STEP;
+    }
+    float texelSize = 2.f * radius / (float)mResolution;
+    // light space depth runs along -z; behind the sphere (towards the sun) the range reaches out to casters outside it
+    float depth = -lightCenter.z;
+    float depthSlack = 0.f;
+    if (mSettings.bStabilize) {
+        // whole texels keep every texel's footprint in the world where it was; the radius is a whole number of texels
+        // (the resolution is even), so the bounds land on texel edges too
+        lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+        lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+        float depthStep = radius * DEPTH_STEP;
+        depthSlack = depthStep;
+        depth = std::floor(depth / depthStep) * depthStep;
+    }
+
+    glm::mat4 projection = glm::orthoRH_ZO(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+        depth - radius - mSettings.casterDistance, depth + radius + depthSlack);
+    *outTexelSize = texelSize;
+    return projection * lightView;
+}
+
+std::span<const glm::mat4> CascadedShadowMaps::update(uint32_t frameIndex, const CameraParameters& camera, glm::vec3 sunDirection,
+    uint64_t sceneVersion)
+{
+    FrameResources& frame = mFrames[frameIndex];
+    mRenderCascades.clear();
+    mRenderViews.clear();
+    mStats.renderedCascades = 0;
+    mStats.cachedCascades = 0;
+    mStats.recordTime = 0.f;
+    mStats.recordThreadTime = 0.f;
+
+    GpuShadowData* shadowData = (GpuShadowData*)frame.shadowData.info.pMappedData;
+    if (!mSettings.bEnabled) {
+        // the layers are left as they are, but nothing says what they hold any more
+        invalidate();
+        *shadowData = GpuShadowData{};
+        vmaFlushAllocation(mAllocator, frame.shadowData.allocation, 0, VK_WHOLE_SIZE);
+        return {};
+    }
+
+    // the light looks down the sun's rays, with any up axis that is not parallel to them
+    sunDirection = glm::normalize(sunDirection);
+    glm::vec3 up = std::abs(sunDirection.y) > 0.99f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+    glm::mat4 lightView = glm::lookAtRH(glm::vec3(0.f), -sunDirection, up);
+
+    // practical split scheme: logarithmic spacing keeps texel density even along the view, uniform spacing keeps the
+    // near cascades from getting too thin
+    float nearPlane = camera.nearPlane;
+    float farPlane = std::max(mSettings.maxDistance, nearPlane * 2.f);
+    float sliceNear = nearPlane;
+    for (uint32_t cascadeIndex = 0; cascadeIndex < CASCADE_COUNT; cascadeIndex++) {
+        float fraction = (float)(cascadeIndex + 1) / (float)CASCADE_COUNT;
+        float logarithmic = nearPlane * std::pow(farPlane / nearPlane, fraction);
+        float uniform = nearPlane + (farPlane - nearPlane) * fraction;
+        float sliceFar = mSettings.splitLambda * logarithmic + (1.f - mSettings.splitLambda) * uniform;
+        mStats.splits[cascadeIndex] = sliceFar;
+
+        float texelSize;
+        glm::mat4 viewProjection = fit_cascade(camera, lightView, sliceNear, sliceFar, &texelSize);
+        sliceNear = sliceFar;
+
+        Cascade& cascade = mCascades[cascadeIndex];
+        bool bCached = mSettings.bCacheStatic && cascade.bValid && cascade.viewProjection == viewProjection
+            && cascade.sunDirection == sunDirection && cascade.sceneVersion == sceneVersion;
+        if (bCached) {
+            mStats.cachedCascades++;
+            continue;
+        }
+        cascade.viewProjection = viewProjection;
+        cascade.sunDirection = sunDirection;
+        cascade.sceneVersion = sceneVersion;
+        cascade.texelSize = texelSize;
+        cascade.bValid = true;
+        mRenderCascades.push_back(cascadeIndex);
+        mRenderViews.push_back(viewProjection);
+        mStats.renderedCascades++;
+    }
+
+    // cached cascades sample with the view projection their layer was rendered with, which is the one fitted now
+    glm::mat4 cameraWorld = glm::inverse(camera.view);
+    for (uint32_t cascadeIndex = 0; cascadeIndex < CASCADE_COUNT; cascadeIndex++) {
+        shadowData->cascadeViewProjections[cascadeIndex] = mCascades[cascadeIndex].viewProjection;
+        shadowData->cascadeSplits[cascadeIndex] = mStats.splits[cascadeIndex];
+        shadowData->cascadeTexelSizes[cascadeIndex] = mCascades[cascadeIndex].texelSize;
+    }
+    shadowData->cameraPosition = glm::vec4(glm::vec3(cameraWorld[3]), 1.f);
+    shadowData->cameraForward = glm::vec4(-glm::normalize(glm::vec3(cameraWorld[2])), 1.f / (float)mResolution);
+    vmaFlushAllocation(mAllocator, frame.shadowData.allocation, 0, VK_WHOLE_SIZE);
+
+    return mRenderViews;
+}
+
+void CascadedShadowMaps::record_cascade(uint32_t frameIndex, uint32_t viewIndex, const ClusterRenderer& renderer)
+{
+    FrameResources& frame = mFrames[frameIndex];
+    uint32_t cascade = mRenderCascades[viewIndex];
+    VK_CHECK(vkResetCommandPool(mDevice, frame.commandPools[cascade], 0));
+
+    // the draws continue the rendering the primary command buffer begins on the cascade's layer
+    VkCommandBufferInheritanceRenderingInfo renderingInheritance = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO };
+    renderingInheritance.depthAttachmentFormat = DEPTH_FORMAT;
+    renderingInheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkCommandBufferInheritanceInfo inheritance = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    inheritance.pNext = &renderingInheritance;
+
+    VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+        | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+    beginInfo.pInheritanceInfo = &inheritance;
+    VK_CHECK(vkBeginCommandBuffer(frame.commandBuffers[cascade], &beginInfo));
+    renderer.record_depth_view(frame.commandBuffers[cascade], frameIndex, viewIndex, { mResolution, mResolution }, mSettings.depthBiasConstant,
+        mSettings.depthBiasSlope);
+    VK_CHECK(vkEndCommandBuffer(frame.commandBuffers[cascade]));
+}
+
+void CascadedShadowMaps::render(VkCommandBuffer cmd, uint32_t frameIndex, const ClusterRenderer& renderer)
+{
+    FrameResources& frame = mFrames[frameIndex];
+    if (!mAtlasInitialized) {
+        // layers are only ever rendered when a cascade needs them, but every one is bound for sampling from the start
+        mAtlasInitialized = true;
+        VkImageMemoryBarrier2 barrier = layer_barrier(mAtlas.image, 0, CASCADE_COUNT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_2_NONE, 0, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+        image_barriers(cmd, std::span<const VkImageMemoryBarrier2>(&barrier, 1));
+    }
+    if (mRenderCascades.empty()) {
+        return;
+    }
+
+    // every cascade on its own thread; the pipeline cache and the cluster renderer's recording are safe to share
+    auto recordStart = Clock::now();
+    std::atomic<uint64_t> threadMicroseconds{ 0 };
+    auto record = [&](uint32_t viewIndex) {
+        auto start = Clock::now();
+        record_cascade(frameIndex, viewIndex, renderer);
+        threadMicroseconds.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    };
+    if (mSettings.bParallelRecording && mJobSystem && mRenderCascades.size() > 1) {
+        JobSystem::Counter counter;
+        for (uint32_t viewIndex = 0; viewIndex < mRenderCascades.size(); viewIndex++) {
+            mJobSystem->schedule([&record, viewIndex]() { record(viewIndex); }, &counter);
+        }
+        mJobSystem->wait(counter);
+    }
+    else {
+        for (uint32_t viewIndex = 0; viewIndex < mRenderCascades.size(); viewIndex++) {
+            record(viewIndex);
+        }
+    }
+    mStats.recordTime = std::chrono::duration<float, std::milli>(Clock::now() - recordStart).count();
+    mStats.recordThreadTime = threadMicroseconds.load() / 1000.f;
+
+    // the layers' previous contents are replaced, but the scene pass of an earlier frame may still be sampling them
+    VkImageMemoryBarrier2 barriers[CASCADE_COUNT];
+    for (uint32_t viewIndex = 0; viewIndex < mRenderCascades.size(); viewIndex++) {
+        barriers[viewIndex] = layer_barrier(mAtlas.image, mRenderCascades[viewIndex], 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+    }
+    image_barriers(cmd, std::span<const VkImageMemoryBarrier2>(barriers, mRenderCascades.size()));
+
+    for (uint32_t viewIndex = 0; viewIndex < mRenderCascades.size(); viewIndex++) {
+        uint32_t cascade = mRenderCascades[viewIndex];
+        VkRenderingAttachmentInfo depthAttachment = vkinit::depth_attachment_info(mLayerViews[cascade], VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+        VkRenderingInfo renderInfo = vkinit::rendering_info({ mResolution, mResolution }, nullptr, &depthAttachment);
+        renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+        vkCmdBeginRendering(cmd, &renderInfo);
+        vkCmdExecuteCommands(cmd, 1, &frame.commandBuffers[cascade]);
+        vkCmdEndRendering(cmd);
+    }
+
+    for (uint32_t viewIndex = 0; viewIndex < mRenderCascades.size(); viewIndex++) {
+        barriers[viewIndex] = layer_barrier(mAtlas.image, mRenderCascades[viewIndex], 1, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    }
+    image_barriers(cmd, std::span<const VkImageMemoryBarrier2>(barriers, mRenderCascades.size()));
+}
+
+SceneShadows CascadedShadowMaps::get_scene_shadows(uint32_t frameIndex) const
+{
+    SceneShadows shadows;
+    shadows.atlasView = mAtlas.imageView;
+    shadows.sampler = mSampler;
+    shadows.data = mFrames[frameIndex].shadowData.buffer;
+    shadows.dataSize = sizeof(GpuShadowData);
+    return shadows;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "job_system.h"
+#include "vk_cluster_renderer.h"
+#include "vk_render_targets.h"
+#include "vk_types.h"
+
+// Cascaded shadow maps for the sun. The camera's view depth up to maxDistance is cut into CASCADE_COUNT slices, spaced
+// between uniformly and logarithmically, and each slice gets an orthographic view along the sun that renders into its own
+// layer of a depth array; the scene pass picks the layer by the fragment's view depth.
+// Cascades are stabilized: each covers the bounding sphere of its slice, whose size only depends on the camera's
+// projection, and is snapped to whole texels in light space, so a moving or turning camera slides the shadow map by whole
+// texels rather than resampling it (which shimmers along shadow edges).
+// Snapping is also what lets cascades be cached: one is only rendered again when its view projection, the sun or the
+// scene changed, otherwise its layer keeps what an earlier frame rendered, so the far cascades (which move rarely) mostly
+// cost nothing. Cascades to render are culled by the cluster renderer along with the scene view, into sections of the same
+// indirect draw buffers, then each is recorded into a secondary command buffer on its own worker thread
+class CascadedShadowMaps {
+public:
+	// shaders/shadows.glsl CASCADE_COUNT
+	static constexpr uint32_t CASCADE_COUNT = 4;
+	static_assert(CASCADE_COUNT <= ClusterRenderer::MAX_DEPTH_VIEWS);
+	static constexpr VkFormat DEPTH_FORMAT = ClusterRenderer::DEPTH_FORMAT;
+
+	struct Settings {
+		bool bEnabled = true;
+		// view depth at which the last cascade ends
+		float maxDistance = 150.f;
+		// 0 spaces the cascades uniformly, 1 logarithmically
+		float splitLambda = 0.8f;
+		// snap cascades to whole texels; without it they follow the camera exactly, and can never be cached
+		bool bStabilize = true;
+		// keep the layers of cascades whose view, sun and scene did not change instead of rendering them again
+		bool bCacheStatic = true;
+		// record every cascade on a worker thread, otherwise on the calling thread one after another
+		bool bParallelRecording = true;
+		// how far beyond a cascade's slice, towards the sun, casters still throw shadows into it
+		float casterDistance = 200.f;
+		float depthBiasConstant = 1.f;
+		float depthBiasSlope = 1.5f;
+	};
+
+	// the camera the cascades cover
+	struct CameraParameters {
+		glm::mat4 view;
+		float verticalFov; // radians
+		float aspectRatio;
+		float nearPlane;
+	};
+
+	// of the most recent frame
+	struct Stats {
+		uint32_t renderedCascades;
+		uint32_t cachedCascades;
+		// CPU time of recording the rendered cascades: from the first job scheduled to the last finished, and summed
+		// over the threads that recorded them
+		float recordTime; // ms
+		float recordThreadTime; // ms
+		// view depth at which each cascade ends
+		float splits[CASCADE_COUNT];
+	};
+
+	Settings mSettings;
+
+	// the atlas: a persistent depth array with a resolution by resolution layer per cascade
+	void declare_targets(RenderTargetPool& renderTargets, uint32_t resolution);
+	// command buffers are recorded for queueFamily
+	void init(VkDevice device, VmaAllocator allocator, const RenderTargetPool& renderTargets, JobSystem* jobSystem, uint32_t queueFamily,
+		uint32_t framesInFlight);
+	void destroy();
+
+	// fits the cascades to the camera and decides which have to be rendered; returns their view projections, which
+	// ClusterRenderer::cull must cull as its depth views before render. sunDirection points towards the sun, and
+	// sceneVersion changes whenever something that casts shadows moved, appeared or went away.
+	// Call once per frame, after the frame slot's fence has been waited on
+	std::span<const glm::mat4> update(uint32_t frameIndex, const CameraParameters& camera, glm::vec3 sunDirection, uint64_t sceneVersion);
+	// renders the cascades update returned into their layers and leaves the whole atlas ready for sampling
+	void render(VkCommandBuffer cmd, uint32_t frameIndex, const ClusterRenderer& renderer);
+	// what the scene pass samples the frame's shadows from
+	SceneShadows get_scene_shadows(uint32_t frameIndex) const;
+	// the next update renders every cascade (e.g. after the scene was replaced wholesale)
+	void invalidate();
+
+	Stats get_stats() const { return mStats; }
+
+private:
+	// shaders/shadows.glsl ShadowData
+	struct GpuShadowData {
+		glm::mat4 cascadeViewProjections[CASCADE_COUNT];
+		glm::vec4 cascadeSplits;
+		glm::vec4 cascadeTexelSizes;
+		glm::vec4 cameraPosition;
+		glm::vec4 cameraForward;
+	};
+	static_assert(CASCADE_COUNT == 4, "GpuShadowData packs one float per cascade into a vec4");
+
+	// what a layer of the atlas holds
+	struct Cascade {
+		glm::mat4 viewProjection{ 1.f };
+		glm::vec3 sunDirection{ 0.f };
+		uint64_t sceneVersion = 0;
+		float texelSize = 0.f;
+		bool bValid = false;
+	};
+
+	struct FrameResources {
+		AllocatedBuffer shadowData; // host written
+		// a pool per cascade, so each can be recorded on its own thread
+		VkCommandPool commandPools[CASCADE_COUNT];
+		VkCommandBuffer commandBuffers[CASCADE_COUNT];
+	};
+
+	// the view projection covering the camera slice [nearDepth, farDepth] from the sun
+	glm::mat4 fit_cascade(const CameraParameters& camera, const glm::mat4& lightView, float nearDepth, float farDepth, float* outTexelSize) const;
+	void record_cascade(uint32_t frameIndex, uint32_t viewIndex, const ClusterRenderer& renderer);
+
+	VkDevice mDevice;
+	VmaAllocator mAllocator;
+	JobSystem* mJobSystem;
+
+	RenderTargetPool::Handle mAtlasTarget;
+	uint32_t mResolution = 0;
+	// the pool's view covers every layer, for sampling; these each cover one, for rendering
+	AllocatedImage mAtlas;
+	VkImageView mLayerViews[CASCADE_COUNT];
+	VkSampler mSampler;
+	bool mAtlasInitialized = false;
+
+	Cascade mCascades[CASCADE_COUNT];
+	// this frame's cascades to render, and their view projections in the same order
+	std::vector<uint32_t> mRenderCascades;
+	std::vector<glm::mat4> mRenderViews;
+
+	std::vector<FrameResources> mFrames;
+	Stats mStats{};
+};
\ No newline at end of file
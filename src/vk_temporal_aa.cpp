@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+#include "vk_check_macro.h"
+#include "vk_initializers.h"
+#include "vk_temporal_aa.h"
+#include "vk_utils.h"
+
+namespace {
+    // shaders/taa_resolve.comp flags
+    constexpr uint32_t FLAG_HISTORY_VALID = 1;
+    constexpr uint32_t FLAG_HAS_DEPTH = 2;
+    constexpr uint32_t FLAG_SHARP_HISTORY = 4;
+
+    // jitter positions per output pixel area; at native resolution that is 8 samples per pixel before the sequence repeats
+    constexpr float JITTER_PHASES_PER_PIXEL = 8.f;
+    constexpr uint32_t MAX_JITTER_PHASES = 128;
+
+    void memory_barrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+    {
+        VkMemoryBarrier2 memoryBarrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+        memoryBarrier.srcStageMask = srcStage;
+        memoryBarrier.srcAccessMask = srcAccess;
+        memoryBarrier.dstStageMask = dstStage;
+        memoryBarrier.dstAccessMask = dstAccess;
+
+        VkDependencyInfo depInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+        depInfo.memoryBarrierCount = 1;
+        depInfo.pMemoryBarriers = &memoryBarrier;
+        vkCmdPipelineBarrier2(cmd, &depInfo);
+    }
+
+    // radical inverse of index in base; successive indices fill [0, 1) evenly
+    float halton(uint32_t index, uint32_t base)
+    {
+        float fraction = 1.f;
+        float result = 0.f;
+        while (index > 0) {
+            fraction /= (float)base;
+            result += fraction * (float)(index % base);
+            index /= base;
+        }
+        return result;
+    }
+}
+
+void TemporalAntiAliasing::declare_targets(RenderTargetPool& renderTargets, VkExtent3D drawImageExtent, VkFormat drawFormat)
+{
+    mHistoryFormat = drawFormat;
+    for (uint32_t history = 0; history < HISTORY_COUNT; history++) {
+        RenderTargetPool::TargetDesc historyDesc;
+        historyDesc.name = history == 0 ? "TAA history 0" : "TAA history 1";
+        historyDesc.format = mHistoryFormat;
+        historyDesc.extent = drawImageExtent;
+        historyDesc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        historyDesc.firstPass = FramePass::Scene;
+        historyDesc.lastPass = FramePass::Scene;
+        // read by the next frame's resolve
+        historyDesc.bPersistent = true;
+        mHistoryTargets[history] = renderTargets.declare(historyDesc);
+    }
+}
+
+void TemporalAntiAliasing::init(VkDevice device, PipelinePermutationCache& pipelineCache, const RenderTargetPool& renderTargets)
+{
+    mDevice = device;
+    mPipelineCache = &pipelineCache;
+
+    for (uint32_t history = 0; history < HISTORY_COUNT; history++) {
+        mHistory[history] = renderTargets.get(mHistoryTargets[history]);
+    }
+
+    // clamp to edge: the shader clamps to the used region itself, this only covers the border texels
+    VkSamplerCreateInfo samplerInfo = { .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = 0.f;
+    VK_CHECK(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mLinearSampler));
+
+    DescriptorLayoutBuilder layoutBuilder;
+    layoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    layoutBuilder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    layoutBuilder.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    layoutBuilder.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    mSetLayout = layoutBuilder.build(mDevice, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ResolveConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &mSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &mPipelineLayout));
+
+    ComputePipelineBuilder builder;
+    builder.set_layout(mPipelineLayout);
+    uint64_t shaderHash;
+    builder.set_shader(mPipelineCache->load_draw_format_shader("taa_resolve.comp.spv", mHistoryFormat, &shaderHash), shaderHash);
+    mResolveFamily = mPipelineCache->register_compute_family("taa resolve", builder);
+}
+
+void TemporalAntiAliasing::destroy()
+{
+    vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+    vkDestroySampler(mDevice, mLinearSampler, nullptr);
+}
+
+glm::mat4 TemporalAntiAliasing::jitter_projection(const glm::mat4& projection, VkExtent2D renderExtent, VkExtent2D outputExtent)
+{
+    if (!mSettings.bEnabled) {
+        // whatever accumulated before was jittered and is stale by the time the resolve runs again
+        reset_history();
+        mJitter = glm::vec2(0.f);
+        return projection;
+    }
+
+    // every output pixel should see about the same number of distinct sample positions, whatever the render scale
+    float scale = (float)outputExtent.width / (float)std::max(renderExtent.width, 1u);
+    uint32_t phaseCount = std::clamp((uint32_t)std::ceil(JITTER_PHASES_PER_PIXEL * scale * scale), 1u, MAX_JITTER_PHASES);
+    // Halton starts at index 1, index 0 would be the corner of the pixel in both bases
+    uint32_t phase = mFrameIndex % phaseCount + 1;
+    mFrameIndex++;
+    mJitter = glm::vec2(halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f);
+
+    // a translation in clip space scaled by w, i.e. by a constant amount in NDC. w is -z, so adding c * z to x moves
+    // geometry by -c in NDC: the image shifts by -mJitter pixels, and every render sample lands mJitter from its pixel center
+    glm::mat4 jittered = projection;
+    jittered[2][0] += mJitter.x * 2.f / (float)std::max(renderExtent.width, 1u);
+    jittered[2][1] += mJitter.y * 2.f / (float)std::max(renderExtent.height, 1u);
+    return jittered;
+}
+
+void TemporalAntiAliasing::resolve(VkCommandBuffer cmd, DescriptorAllocatorGrowable& frameDescriptors, const AllocatedImage& drawImage,
+    VkImageView depthView, VkExtent2D renderExtent, VkExtent2D outputExtent, const glm::mat4& viewProjection)
+{
+    // the history never shares memory, so it only needs a layout once
+    if (!mHistoryInitialized) {
+        for (uint32_t history = 0; history < HISTORY_COUNT; history++) {
+            vkutil::transition_image(cmd, mHistory[history].image, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        }
+        mHistoryInitialized = true;
+    }
+
+    // a resized output invalidates the history; a changed render scale does not, the history is at output resolution
+    const bool bHistoryValid = mHistoryValid && outputExtent.width == mHistoryExtent.width && outputExtent.height == mHistoryExtent.height;
+    const uint32_t previous = mCurrentHistory;
+    const uint32_t current = (mCurrentHistory + 1) % HISTORY_COUNT;
+
+    // the scene (drawn, or only the compute background) becomes a sampled source; the history being written was last sampled
+    // by the previous frame's resolve
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT,
+        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    // without depth the draw image stands in, which the shader then never reads from that binding
+    VkDescriptorSet set = frameDescriptors.allocate(mDevice, mSetLayout);
+    DescriptorWriter writer;
+    writer.write_image(0, drawImage.imageView, mLinearSampler, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    if (depthView != VK_NULL_HANDLE) {
+        writer.write_image(1, depthView, mLinearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    }
+    else {
+        writer.write_image(1, drawImage.imageView, mLinearSampler, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    }
+    writer.write_image(2, mHistory[previous].imageView, mLinearSampler, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    writer.write_image(3, mHistory[current].imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    writer.update_set(mDevice, set);
+
+    ResolveConstants constants{};
+    constants.reprojection = mPreviousViewProjection * glm::inverse(viewProjection);
+    constants.jitter = mJitter;
+    constants.renderSize[0] = (int32_t)renderExtent.width;
+    constants.renderSize[1] = (int32_t)renderExtent.height;
+    constants.outputSize[0] = (int32_t)outputExtent.width;
+    constants.outputSize[1] = (int32_t)outputExtent.height;
+    constants.currentWeight = std::clamp(mSettings.currentWeight, 0.01f, 1.f);
+    constants.clipGamma = std::max(mSettings.clipGamma, 0.f);
+    constants.flags = (bHistoryValid ? FLAG_HISTORY_VALID : 0) | (depthView != VK_NULL_HANDLE ? FLAG_HAS_DEPTH : 0)
+        | (mSettings.bSharpHistory ? FLAG_SHARP_HISTORY : 0);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineCache->get_pipeline(mResolveFamily, SpecializationData()));
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(cmd, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ResolveConstants), &constants);
+    // 8x8 workgroups
+    vkCmdDispatch(cmd, (outputExtent.width + 7) / 8, (outputExtent.height + 7) / 8, 1);
+
+    // the resolve goes back into the draw image, where the post chain picks it up; the history itself must survive until
+    // the next frame, and post-processing works in place
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    VkImageCopy2 copyRegion = { .sType = VK_STRUCTURE_TYPE_IMAGE_COPY_2 };
+    copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.srcSubresource.layerCount = 1;
+    copyRegion.dstSubresource = copyRegion.srcSubresource;
+    copyRegion.extent = { outputExtent.width, outputExtent.height, 1 };
+
+    VkCopyImageInfo2 copyInfo = { .sType = VK_STRUCTURE_TYPE_COPY_IMAGE_INFO_2 };
+    copyInfo.srcImage = mHistory[current].image;
+    copyInfo.srcImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    copyInfo.dstImage = drawImage.image;
+    copyInfo.dstImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    copyInfo.regionCount = 1;
+    copyInfo.pRegions = &copyRegion;
+    vkCmdCopyImage2(cmd, &copyInfo);
+
+    // whatever reads the draw image next (post passes, the capture copy or the blit) sees the resolve
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+
+    mCurrentHistory = current;
+    mHistoryValid = true;
+    mHistoryExtent = outputExtent;
+    mPreviousViewProjection = viewProjection;
+}
\ No newline at end of file
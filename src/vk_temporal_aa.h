@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "vk_descriptors.h"
+#include "vk_pipelines.h"
+#include "vk_render_targets.h"
+#include "vk_types.h"
+
+// Temporal anti-aliasing. Every frame the projection is offset by a different sub-pixel jitter (a Halton sequence), so
+// successive frames sample different points of each pixel; the resolve accumulates them into a history that is reprojected
+// from frame to frame, which converges on a supersampled image at the cost of one sample per pixel and frame.
+// Motion vectors are derived per pixel in the resolve itself, from the scene depth and the camera's movement between the
+// two frames (the nearest depth of the 3x3 neighborhood, so edges follow the foreground). Objects that move by themselves
+// are not reprojected; like disocclusions, their stale history is caught by clipping it to the variance of the current
+// neighborhood, in YCoCg.
+// The resolve also upscales: the scene may be rendered at a lower resolution than the output (render scale, which can
+// change every frame), since each output pixel gathers the jittered render samples around it and the history is kept at
+// output resolution. The jitter sequence gets longer as the scale drops, so every output pixel still receives samples
+class TemporalAntiAliasing {
+public:
+	struct Settings {
+		bool bEnabled = true;
+		// weight of the current frame in the blend with the history; lower converges further but ghosts longer
+		float currentWeight = 0.1f;
+		// width of the clipping box in standard deviations of the neighborhood; wider keeps more history (and ghosts)
+		float clipGamma = 1.25f;
+		// sample the history with a Catmull-Rom filter instead of bilinearly, which keeps it from blurring over time
+		bool bSharpHistory = true;
+	};
+
+	Settings mSettings;
+
+	// the history is sized for the largest extent the draw image can have, and in its format, so it can be copied into it;
+	// declared before the pool is built
+	void declare_targets(RenderTargetPool& renderTargets, VkExtent3D drawImageExtent, VkFormat drawFormat);
+	void init(VkDevice device, PipelinePermutationCache& pipelineCache, const RenderTargetPool& renderTargets);
+	void destroy();
+
+	// the next resolve starts over from the current frame alone, and the jitter sequence from its beginning
+	void reset_history() { mHistoryValid = false; mFrameIndex = 0; }
+
+	// offsets projection by this frame's jitter; render samples at renderExtent, resolved to outputExtent. Call once per
+	// frame and draw everything the resolve reads with the result (unjittered when disabled)
+	glm::mat4 jitter_projection(const glm::mat4& projection, VkExtent2D renderExtent, VkExtent2D outputExtent);
+	// accumulates the scene in drawImage (GENERAL, renderExtent) into the history, then copies the result back into
+	// drawImage at outputExtent, where it stays in GENERAL. depthView is the scene's depth in SHADER_READ_ONLY_OPTIMAL, or
+	// null if nothing was drawn; viewProjection is the frame's unjittered one
+	void resolve(VkCommandBuffer cmd, DescriptorAllocatorGrowable& frameDescriptors, const AllocatedImage& drawImage, VkImageView depthView,
+		VkExtent2D renderExtent, VkExtent2D outputExtent, const glm::mat4& viewProjection);
+
+private:
+	// shaders/taa_resolve.comp constants
+	struct ResolveConstants {
+		// current clip space to last frame's, both unjittered
+		glm::mat4 reprojection;
+		// offset of every render sample from its pixel center, in render pixels
+		glm::vec2 jitter;
+		int32_t renderSize[2];
+		int32_t outputSize[2];
+		float currentWeight;
+		float clipGamma;
+		uint32_t flags;
+		uint32_t padding;
+	};
+
+	static constexpr uint32_t HISTORY_COUNT = 2;
+
+	VkDevice mDevice;
+	PipelinePermutationCache* mPipelineCache;
+
+	VkDescriptorSetLayout mSetLayout;
+	VkPipelineLayout mPipelineLayout;
+	uint32_t mResolveFamily;
+	VkSampler mLinearSampler;
+
+	// ping-ponged: the resolve reads last frame's and writes the other. Persistent, and in GENERAL once initialized
+	RenderTargetPool::Handle mHistoryTargets[HISTORY_COUNT];
+	AllocatedImage mHistory[HISTORY_COUNT];
+	VkFormat mHistoryFormat;
+	bool mHistoryInitialized = false;
+	// the history that holds the last resolve, and what it was resolved from
+	uint32_t mCurrentHistory = 0;
+	bool mHistoryValid = false;
+	VkExtent2D mHistoryExtent{ 0, 0 };
+	glm::mat4 mPreviousViewProjection{ 1.f };
+
+	// frames since the history was reset, which picks the jitter; and the jitter of this frame
+	uint32_t mFrameIndex = 0;
+	glm::vec2 mJitter{ 0.f };
+};
\ No newline at end of file
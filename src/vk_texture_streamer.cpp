@@ -0,0 +1,508 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include "asset_archive.h"
+#include "vk_check_macro.h"
+#include "vk_descriptors.h"
+#include "vk_initializers.h"
+#include "vk_texture_streamer.h"
+#include "vk_utils.h"
+
+namespace {
+    // layout of StreamedTexture in texture_streaming.glsl
+    struct GpuStreamedTexture {
+        uint32_t descriptor;
+        uint32_t residentLevel; // UINT32_MAX while only the fallback is bound
+        uint32_t levelCount;
+        uint32_t padding;
+    };
+    static_assert(sizeof(GpuStreamedTexture) == 16);
+
+    constexpr uint32_t FALLBACK_DESCRIPTOR = 0;
+    constexpr uint32_t FALLBACK_TEXEL = 0xFFFFFFFF;
+    constexpr uint32_t NO_REQUEST = UINT32_MAX;
+
+    VkDeviceAddress get_buffer_address(VkDevice device, VkBuffer buffer)
+    {
+        VkBufferDeviceAddressInfo addressInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+        addressInfo.buffer = buffer;
+        return vkGetBufferDeviceAddress(device, &addressInfo);
+    }
+}
+
+void TextureStreamer::init(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator allocator, StagingUploader* uploader,
+    JobSystem* jobSystem, uint32_t framesInFlight, VkDeviceSize memoryBudget)
+{
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    mAllocator = allocator;
+    mUploader = uploader;
+    mJobSystem = jobSystem;
+    mMemoryBudget = memoryBudget;
+
+    // one large array of combined image samplers. Slots are rewritten while the set is bound by frames in flight, which is
+    // fine as long as those frames never use the slot (UPDATE_UNUSED_WHILE_PENDING); slots are only reused once retired
+    DescriptorLayoutBuilder layoutBuilder;
+    layoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    layoutBuilder.bindings[0].descriptorCount = MAX_DESCRIPTORS;
+
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+        | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+    bindingFlagsInfo.bindingCount = 1;
+    bindingFlagsInfo.pBindingFlags = &bindingFlags;
+    mSetLayout = layoutBuilder.build(mDevice, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT, &bindingFlagsInfo,
+        VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_DESCRIPTORS };
+    VkDescriptorPoolCreateInfo poolInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    VK_CHECK(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mPool));
+
+    VkDescriptorSetAllocateInfo allocInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocInfo.descriptorPool = mPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &mSetLayout;
+    VK_CHECK(vkAllocateDescriptorSets(mDevice, &allocInfo, &mSet));
+
+    // trilinear and repeating, like most material textures want; views only cover resident levels, so no LOD clamp is needed
+    VkSamplerCreateInfo samplerInfo = { .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mSampler));
+
+    // every unloaded texture samples opaque white from slot 0
+    mFallbackImage.imageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    mFallbackImage.imageExtent = { 1, 1, 1 };
+    VkImageCreateInfo fallbackInfo = vkinit::image_create_info(mFallbackImage.imageFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, mFallbackImage.imageExtent, 1);
+    VmaAllocationCreateInfo imageAllocationInfo = {};
+    imageAllocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    VK_CHECK(vmaCreateImage(mAllocator, &fallbackInfo, &imageAllocationInfo, &mFallbackImage.image, &mFallbackImage.allocation, nullptr));
+    VkImageViewCreateInfo fallbackViewInfo = vkinit::imageview_create_info(mFallbackImage.imageFormat, mFallbackImage.image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    VK_CHECK(vkCreateImageView(mDevice, &fallbackViewInfo, nullptr, &mFallbackImage.imageView));
+    mUploader->enqueue_image(mFallbackImage.image, 0, mFallbackImage.imageExtent, &FALLBACK_TEXEL, sizeof(FALLBACK_TEXEL));
+    write_descriptor(FALLBACK_DESCRIPTOR, mFallbackImage.imageView);
+
+    // lowest slots are handed out first
+    for (uint32_t slot = MAX_DESCRIPTORS - 1; slot > FALLBACK_DESCRIPTOR; slot--) {
+        mFreeDescriptors.push_back(slot);
+    }
+
+    mFrames.resize(framesInFlight);
+    for (FrameResources& frame : mFrames) {
+        frame.table = vkutil::create_buffer(mAllocator, MAX_TEXTURES * sizeof(GpuStreamedTexture),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        frame.tableAddress = get_buffer_address(mDevice, frame.table.buffer);
+        frame.feedback = vkutil::create_buffer(mAllocator, MAX_TEXTURES * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+        frame.feedbackAddress = get_buffer_address(mDevice, frame.feedback.buffer);
+        std::memset(frame.feedback.info.pMappedData, 0xFF, MAX_TEXTURES * sizeof(uint32_t));
+        vmaFlushAllocation(mAllocator, frame.feedback.allocation, 0, VK_WHOLE_SIZE);
+    }
+}
+
+void TextureStreamer::destroy()
+{
+    mJobSystem->wait(mJobCounter);
+
+    auto destroy_image = [&](AllocatedImage& image) {
+        if (image.image != VK_NULL_HANDLE) {
+            vkDestroyImageView(mDevice, image.imageView, nullptr);
+            vmaDestroyImage(mAllocator, image.image, image.allocation);
+            image = {};
+        }
+    };
+    for (std::unique_ptr<Texture>& texture : mTextures) {
+        destroy_image(texture->image);
+        destroy_image(texture->pendingImage);
+    }
+    for (RetiredImage& retired : mRetiredImages) {
+        destroy_image(retired.image);
+    }
+    destroy_image(mFallbackImage);
+    mTextures.clear();
+    mRetiredImages.clear();
+    mParsedTextures.clear();
+    mFreeDescriptors.clear();
+
+    for (FrameResources& frame : mFrames) {
+        vkutil::destroy_buffer(mAllocator, frame.table);
+        vkutil::destroy_buffer(mAllocator, frame.feedback);
+    }
+    mFrames.clear();
+
+    vkDestroySampler(mDevice, mSampler, nullptr);
+    vkDestroyDescriptorPool(mDevice, mPool, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+    mResidentBytes = 0;
+}
+
+TextureHandle TextureStreamer::load(const std::string& path)
+{
+    if (mTextures.size() >= MAX_TEXTURES) {
+        std::cout << "texture limit reached, not loading " << path << std::endl;
+        return INVALID_TEXTURE_HANDLE;
+    }
+
+    TextureHandle handle = (TextureHandle)mTextures.size();
+    mTextures.push_back(std::make_unique<Texture>());
+    Texture* texture = mTextures.back().get();
+    texture->path = path;
+
+    std::shared_ptr<const AssetArchive> archive = mArchive;
+    mJobSystem->schedule([this, texture, handle, archive]() {
+        // uncompressed archive entries are uploaded straight out of the mapping
+        const AssetArchive::Entry* entry = archive ? archive->find(std::filesystem::path(texture->path).lexically_normal().generic_string()) : nullptr;
+        if (entry && archive->get_mapped_data(*entry)) {
+            texture->source = std::span<const uint8_t>(entry->storedData, entry->size);
+            texture->sourceOwner = archive;
+        }
+        else {
+            std::shared_ptr<std::vector<uint8_t>> bytes = std::make_shared<std::vector<uint8_t>>();
+            bool bRead = false;
+            if (entry) {
+                bRead = archive->read(*entry, *bytes);
+            }
+            else {
+                std::ifstream file(texture->path, std::ios::binary | std::ios::ate);
+                if (file.is_open()) {
+                    bytes->resize((size_t)file.tellg());
+                    file.seekg(0);
+                    file.read((char*)bytes->data(), bytes->size());
+                    bRead = (bool)file;
+                }
+            }
+            if (bRead) {
+                texture->source = *bytes;
+                texture->sourceOwner = bytes;
+            }
+        }
+        parse(texture);
+
+        std::lock_guard<std::mutex> lock(mParsedMutex);
+        mParsedTextures.push_back(handle);
+    }, &mJobCounter);
+    return handle;
+}
+
+void TextureStreamer::parse(Texture* texture)
+{
+    auto fail = [&](const char* reason) {
+        std::cout << "texture " << texture->path << ": " << reason << std::endl;
+        texture->source = {};
+        texture->sourceOwner.reset();
+        texture->state = TextureState::Failed;
+    };
+
+    if (texture->sourceOwner == nullptr) {
+        return fail("could not read file");
+    }
+    if (!ktx2::parse(texture->source, texture->info)) {
+        return fail("invalid KTX2 file");
+    }
+
+    // BCn formats need the textureCompressionBC feature, which software rasterizers and most mobile GPUs lack
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, texture->info.format, &formatProperties);
+    VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures) {
+        return fail("format not supported by the device");
+    }
+
+    const ktx2::TextureInfo& info = texture->info;
+    uint32_t levelCount = (uint32_t)info.levels.size();
+    texture->tailLevel = levelCount - 1;
+    while (texture->tailLevel > 0 && std::max(ktx2::get_level_dimension(info.width, texture->tailLevel - 1),
+        ktx2::get_level_dimension(info.height, texture->tailLevel - 1)) <= TAIL_SIZE) {
+        texture->tailLevel--;
+    }
+    // image uploads are not split, so levels larger than an upload chunk never become resident
+    texture->finestLevel = 0;
+    while (texture->finestLevel < texture->tailLevel && info.levels[texture->finestLevel].size > mUploader->get_chunk_size()) {
+        texture->finestLevel++;
+    }
+    if (info.levels[texture->finestLevel].size > mUploader->get_chunk_size()) {
+        return fail("mip tail larger than an upload chunk");
+    }
+    texture->state = TextureState::Ready;
+}
+
+void TextureStreamer::request_level(TextureHandle texture, uint32_t level)
+{
+    if (texture < mTextures.size()) {
+        mTextures[texture]->requestedLevel = std::min(mTextures[texture]->requestedLevel, level);
+    }
+}
+
+void TextureStreamer::begin_frame(uint32_t frameIndex)
+{
+    mFrameNumber++;
+
+    // slot frameIndex's previous frame was the last one that could sample images retired before it was recorded
+    const uint64_t framesInFlight = mFrames.size();
+    std::erase_if(mRetiredImages, [&](RetiredImage& retired) {
+        if (retired.frame + framesInFlight > mFrameNumber) {
+            return false;
+        }
+        vkDestroyImageView(mDevice, retired.image.imageView, nullptr);
+        vmaDestroyImage(mAllocator, retired.image.image, retired.image.allocation);
+        mFreeDescriptors.push_back(retired.descriptor);
+        mResidentBytes -= retired.bytes;
+        return true;
+    });
+
+    FrameResources& frame = mFrames[frameIndex];
+    uint32_t textureCount = (uint32_t)mTextures.size();
+
+    // shaders wrote the finest level they wanted of every texture they sampled (atomicMin, so UINT32_MAX means unused)
+    vmaInvalidateAllocation(mAllocator, frame.feedback.allocation, 0, VK_WHOLE_SIZE);
+    uint32_t* feedback = (uint32_t*)frame.feedback.info.pMappedData;
+    mRequestedTextures = 0;
+    for (uint32_t i = 0; i < textureCount; i++) {
+        if (feedback[i] != NO_REQUEST) {
+            mTextures[i]->requestedLevel = std::min(mTextures[i]->requestedLevel, feedback[i]);
+            mRequestedTextures++;
+        }
+    }
+    std::memset(feedback, 0xFF, textureCount * sizeof(uint32_t));
+    vmaFlushAllocation(mAllocator, frame.feedback.allocation, 0, VK_WHOLE_SIZE);
+
+    GpuStreamedTexture* table = (GpuStreamedTexture*)frame.table.info.pMappedData;
+    for (uint32_t i = 0; i < textureCount; i++) {
+        const Texture& texture = *mTextures[i];
+        bool bResident = texture.image.image != VK_NULL_HANDLE;
+        table[i].descriptor = bResident ? texture.descriptor : FALLBACK_DESCRIPTOR;
+        table[i].residentLevel = bResident ? texture.residentLevel : UINT32_MAX;
+        // info is still being written by the load job until the texture has been placed
+        table[i].levelCount = bResident ? (uint32_t)texture.info.levels.size() : 0;
+        table[i].padding = 0;
+    }
+    vmaFlushAllocation(mAllocator, frame.table.allocation, 0, textureCount * sizeof(GpuStreamedTexture));
+}
+
+void TextureStreamer::update()
+{
+    std::vector<TextureHandle> parsedTextures;
+    {
+        std::lock_guard<std::mutex> lock(mParsedMutex);
+        parsedTextures.swap(mParsedTextures);
+    }
+
+    uint32_t streamingCount = 0;
+    for (const std::unique_ptr<Texture>& texture : mTextures) {
+        streamingCount += texture->pendingImage.image != VK_NULL_HANDLE;
+    }
+
+    // the mip tail of new textures goes first, regardless of the budget: it is what keeps them from sampling the fallback
+    for (size_t i = 0; i < parsedTextures.size(); i++) {
+        Texture& texture = *mTextures[parsedTextures[i]];
+        if (texture.state != TextureState::Ready) {
+            continue;
+        }
+        if (!stream_to_level(parsedTextures[i], texture.tailLevel)) {
+            // out of descriptor slots until something retires; try again next frame
+            std::lock_guard<std::mutex> lock(mParsedMutex);
+            mParsedTextures.insert(mParsedTextures.end(), parsedTextures.begin() + i, parsedTextures.end());
+            break;
+        }
+        streamingCount++;
+    }
+
+    // memory the resident set will take once every replacement in flight has landed
+    VkDeviceSize projectedBytes = 0;
+    struct Candidate {
+        TextureHandle handle;
+        uint32_t level;
+        uint32_t priority;
+    };
+    std::vector<Candidate> streamIn;
+    std::vector<TextureHandle> evictable;
+    for (TextureHandle handle = 0; handle < mTextures.size(); handle++) {
+        Texture& texture = *mTextures[handle];
+        bool bStreaming = texture.pendingImage.image != VK_NULL_HANDLE;
+        if (bStreaming || texture.image.image != VK_NULL_HANDLE) {
+            projectedBytes += get_image_bytes(texture, bStreaming ? texture.pendingLevel : texture.residentLevel);
+        }
+        if (bStreaming || texture.image.image == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        if (texture.requestedLevel <= texture.residentLevel) {
+            texture.lastRequestFrame = mFrameNumber;
+        }
+        uint32_t wantedLevel = std::clamp(texture.requestedLevel, texture.finestLevel, texture.tailLevel);
+        if (wantedLevel < texture.residentLevel) {
+            // the further a texture is from what is on screen, the more it gains from streaming
+            streamIn.push_back({ handle, wantedLevel, texture.residentLevel - wantedLevel });
+        }
+        else if (texture.residentLevel < texture.tailLevel && mFrameNumber - texture.lastRequestFrame > EVICTION_DELAY_FRAMES) {
+            evictable.push_back(handle);
+        }
+    }
+    for (std::unique_ptr<Texture>& texture : mTextures) {
+        texture->requestedLevel = NO_REQUEST;
+    }
+
+    // least recently requested first
+    std::sort(evictable.begin(), evictable.end(), [&](TextureHandle a, TextureHandle b) {
+        return mTextures[a]->lastRequestFrame < mTextures[b]->lastRequestFrame;
+    });
+    std::sort(streamIn.begin(), streamIn.end(), [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+
+    size_t nextEviction = 0;
+    auto evict_one = [&]() {
+        while (nextEviction < evictable.size() && streamingCount < MAX_CONCURRENT_STREAMS) {
+            TextureHandle handle = evictable[nextEviction++];
+            Texture& texture = *mTextures[handle];
+            // straight down to the tail: nothing has asked for any of these levels in a while
+            uint32_t level = texture.tailLevel;
+            VkDeviceSize savedBytes = get_image_bytes(texture, texture.residentLevel) - get_image_bytes(texture, level);
+            uint32_t residentLevel = texture.residentLevel;
+            if (stream_to_level(handle, level)) {
+                projectedBytes -= savedBytes;
+                mEvictedLevels += level - residentLevel;
+                streamingCount++;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (const Candidate& candidate : streamIn) {
+        if (streamingCount >= MAX_CONCURRENT_STREAMS) {
+            break;
+        }
+        Texture& texture = *mTextures[candidate.handle];
+        VkDeviceSize extraBytes = get_image_bytes(texture, candidate.level) - get_image_bytes(texture, texture.residentLevel);
+        while (projectedBytes + extraBytes > mMemoryBudget && evict_one()) {
+        }
+        if (projectedBytes + extraBytes > mMemoryBudget || streamingCount >= MAX_CONCURRENT_STREAMS) {
+            continue;
+        }
+        if (stream_to_level(candidate.handle, candidate.level)) {
+            projectedBytes += extraBytes;
+            streamingCount++;
+        }
+    }
+
+    // over budget without anything wanting more (e.g. the budget was lowered): unused levels go anyway
+    while (projectedBytes > mMemoryBudget && evict_one()) {
+    }
+}
+
+bool TextureStreamer::stream_to_level(TextureHandle handle, uint32_t level)
+{
+    if (mFreeDescriptors.empty()) {
+        return false;
+    }
+    Texture& texture = *mTextures[handle];
+    const ktx2::TextureInfo& info = texture.info;
+    uint32_t levelCount = (uint32_t)info.levels.size() - level;
+
+    AllocatedImage& image = texture.pendingImage;
+    image.imageFormat = info.format;
+    image.imageExtent = { ktx2::get_level_dimension(info.width, level), ktx2::get_level_dimension(info.height, level), 1 };
+    image.mipLevels = levelCount;
+    VkImageCreateInfo imageInfo = vkinit::image_create_info(image.imageFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        image.imageExtent, levelCount);
+    VmaAllocationCreateInfo allocationInfo = {};
+    allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    VmaAllocationInfo allocatedInfo;
+    VK_CHECK(vmaCreateImage(mAllocator, &imageInfo, &allocationInfo, &image.image, &image.allocation, &allocatedInfo));
+    VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(image.imageFormat, image.image, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+    VK_CHECK(vkCreateImageView(mDevice, &viewInfo, nullptr, &image.imageView));
+
+    texture.pendingLevel = level;
+    texture.pendingBytes = allocatedInfo.size;
+    texture.pendingDescriptor = mFreeDescriptors.back();
+    mFreeDescriptors.pop_back();
+    // no frame can reference the slot before the swap below, so it is written right away
+    write_descriptor(texture.pendingDescriptor, image.imageView);
+    mResidentBytes += texture.pendingBytes;
+
+    // coarsest first; the image takes over only once its finest level has landed
+    texture.pendingUploads = levelCount;
+    for (uint32_t sourceLevel = (uint32_t)info.levels.size() - 1; ; sourceLevel--) {
+        const ktx2::Level& sourceData = info.levels[sourceLevel];
+        VkExtent3D extent = { ktx2::get_level_dimension(info.width, sourceLevel), ktx2::get_level_dimension(info.height, sourceLevel), 1 };
+        mUploader->enqueue_image(image.image, sourceLevel - level, extent, texture.source.data() + sourceData.offset, sourceData.size,
+            texture.sourceOwner, [this, handle]() {
+                Texture& texture = *mTextures[handle];
+                if (--texture.pendingUploads > 0) {
+                    return;
+                }
+                if (texture.image.image != VK_NULL_HANDLE) {
+                    retire(texture.image, texture.descriptor, texture.residentBytes);
+                }
+                texture.image = texture.pendingImage;
+                texture.descriptor = texture.pendingDescriptor;
+                texture.residentLevel = texture.pendingLevel;
+                texture.residentBytes = texture.pendingBytes;
+                texture.pendingImage = {};
+            });
+        mStreamedBytes += sourceData.size;
+        if (sourceLevel == level) {
+            break;
+        }
+    }
+    return true;
+}
+
+void TextureStreamer::write_descriptor(uint32_t slot, VkImageView view)
+{
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = mSampler;
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstSet = mSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(mDevice, 1, &write, 0, nullptr);
+}
+
+void TextureStreamer::retire(AllocatedImage& image, uint32_t descriptor, VkDeviceSize bytes)
+{
+    mRetiredImages.push_back({ image, descriptor, bytes, mFrameNumber });
+    image = {};
+}
+
+VkDeviceSize TextureStreamer::get_image_bytes(const Texture& texture, uint32_t level) const
+{
+    VkDeviceSize bytes = 0;
+    for (uint32_t i = level; i < texture.info.levels.size(); i++) {
+        bytes += texture.info.levels[i].size;
+    }
+    return bytes;
+}
+
+TextureStreamer::Stats TextureStreamer::get_stats() const
+{
+    Stats stats{};
+    stats.textureCount = (uint32_t)mTextures.size();
+    for (const std::unique_ptr<Texture>& texture : mTextures) {
+        stats.residentTextures += texture->image.image != VK_NULL_HANDLE;
+        stats.streamingTextures += texture->pendingImage.image != VK_NULL_HANDLE;
+    }
+    stats.residentBytes = mResidentBytes;
+    stats.memoryBudget = mMemoryBudget;
+    stats.streamedBytes = mStreamedBytes;
+    stats.evictedLevels = mEvictedLevels;
+    stats.requestedTextures = mRequestedTextures;
+    return stats;
+}
\ No newline at end of file
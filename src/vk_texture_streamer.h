@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "job_system.h"
+#include "ktx2.h"
+#include "vk_types.h"
+#include "vk_upload.h"
+
+class AssetArchive;
+
+// index of a streamed texture in the shader-side texture table (see shaders/texture_streaming.glsl)
+using TextureHandle = uint32_t;
+inline constexpr TextureHandle INVALID_TEXTURE_HANDLE = UINT32_MAX;
+
+// Streams KTX2 textures mip by mip into a bindless descriptor heap, under a device memory budget.
+// A texture first becomes resident with only its mip tail (every level of at most TAIL_SIZE texels a side), so it can be
+// sampled a few frames after load. Finer levels follow on demand: shaders sampling through texture_streaming.glsl lower a
+// per-texture requested level in a feedback buffer, which is read back once the fence of the frame that wrote it was waited on.
+// Without sparse residency the resident levels of a texture live in a single image, so changing them means creating a new
+// image and uploading its levels again, coarsest first (the coarser levels add at most a third to the finest). The new image
+// takes over in a fresh descriptor slot once all of its levels have landed; the old one is freed when no frame in flight can
+// use it. When streaming in would exceed the budget, the least recently requested textures give up their finest level first
+class TextureStreamer {
+public:
+	inline static const uint32_t MAX_TEXTURES = 4096;
+	// each texture may hold two slots while its replacement streams in; slot 0 is the fallback texture
+	inline static const uint32_t MAX_DESCRIPTORS = MAX_TEXTURES * 2 + 1;
+	// levels with at most this many texels on their longer side are always resident
+	inline static const uint32_t TAIL_SIZE = 64;
+	// replacement images in flight at once, which bounds the temporary memory a change of residency costs
+	inline static const uint32_t MAX_CONCURRENT_STREAMS = 4;
+	// a texture asked for a coarser level keeps its finer ones until it has gone this many frames without needing them,
+	// so a texture near a level boundary does not stream the same level in and out
+	inline static const uint32_t EVICTION_DELAY_FRAMES = 60;
+
+	struct Stats {
+		uint32_t textureCount;
+		uint32_t residentTextures; // with at least their mip tail resident
+		uint32_t streamingTextures; // with a replacement image in flight
+		uint64_t residentBytes; // device memory of all texture images, including replacements in flight
+		uint64_t memoryBudget;
+		uint64_t streamedBytes; // uploaded since init
+		uint32_t evictedLevels; // since init
+		uint32_t requestedTextures; // reported by shader feedback in the last collected frame
+	};
+
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator allocator, StagingUploader* uploader,
+		JobSystem* jobSystem, uint32_t framesInFlight, VkDeviceSize memoryBudget);
+	// waits for load jobs; the device must be idle and the uploader destroyed, since its callbacks refer to textures
+	void destroy();
+
+	// the archive is searched before the file system for loads started afterwards
+	void set_archive(std::shared_ptr<const AssetArchive> archive) { mArchive = std::move(archive); }
+	// starts loading a .ktx2 file on a worker; the handle samples the fallback texture until the mip tail is resident.
+	// Returns INVALID_TEXTURE_HANDLE once MAX_TEXTURES textures exist
+	TextureHandle load(const std::string& path);
+	void wait_for_workers() { mJobSystem->wait(mJobCounter); }
+
+	// CPU side usage feedback (e.g. from distance to the camera), merged with what shaders report
+	void request_level(TextureHandle texture, uint32_t level);
+	void set_memory_budget(VkDeviceSize memoryBudget) { mMemoryBudget = memoryBudget; }
+
+	// call once the frame slot's fence has been waited on: collects that slot's feedback, frees what no frame uses anymore
+	// and writes the slot's texture table
+	void begin_frame(uint32_t frameIndex);
+	// render thread, once per frame before the uploader's update: places finished loads and decides what streams in or out
+	void update();
+
+	// set 0 of pipelines sampling streamed textures; bound once, it never changes
+	VkDescriptorSetLayout get_set_layout() const { return mSetLayout; }
+	VkDescriptorSet get_set() const { return mSet; }
+	// TextureTable and TextureFeedback of texture_streaming.glsl for the frame slot being recorded
+	VkDeviceAddress get_table_address(uint32_t frameIndex) const { return mFrames[frameIndex].tableAddress; }
+	VkDeviceAddress get_feedback_address(uint32_t frameIndex) const { return mFrames[frameIndex].feedbackAddress; }
+	// counts begin_frame calls; picks the pixels that write feedback (is_feedback_pixel)
+	uint32_t get_frame_number() const { return (uint32_t)mFrameNumber; }
+	Stats get_stats() const;
+
+private:
+	enum class TextureState : uint32_t { Loading, Ready, Failed };
+
+	struct Texture {
+		std::string path;
+		TextureState state = TextureState::Loading;
+
+		// written by the load job
+		ktx2::TextureInfo info;
+		std::span<const uint8_t> source;
+		std::shared_ptr<const void> sourceOwner; // the archive or the file's bytes
+		uint32_t tailLevel = 0; // finest level of the always resident tail
+		uint32_t finestLevel = 0; // finest level an upload chunk can hold
+
+		// render thread only
+		AllocatedImage image{};
+		uint32_t residentLevel = 0;
+		uint32_t descriptor = 0;
+		VkDeviceSize residentBytes = 0;
+		// replacement image while it streams in
+		AllocatedImage pendingImage{};
+		uint32_t pendingLevel = 0;
+		uint32_t pendingDescriptor = 0;
+		uint32_t pendingUploads = 0;
+		VkDeviceSize pendingBytes = 0;
+		// finest level asked for by the latest feedback, and when any level was last asked for
+		uint32_t requestedLevel = UINT32_MAX;
+		uint64_t lastRequestFrame = 0;
+	};
+
+	struct FrameResources {
+		AllocatedBuffer table;
+		VkDeviceAddress tableAddress;
+		AllocatedBuffer feedback;
+		VkDeviceAddress feedbackAddress;
+	};
+
+	struct RetiredImage {
+		AllocatedImage image;
+		uint32_t descriptor;
+		VkDeviceSize bytes;
+		uint64_t frame;
+	};
+
+	void parse(Texture* texture);
+	// starts streaming the texture into a new image holding levels [level, end); returns false if no slot is free
+	bool stream_to_level(TextureHandle handle, uint32_t level);
+	void write_descriptor(uint32_t slot, VkImageView view);
+	// image and slot are freed once no frame in flight can sample them anymore
+	void retire(AllocatedImage& image, uint32_t descriptor, VkDeviceSize bytes);
+	VkDeviceSize get_image_bytes(const Texture& texture, uint32_t level) const;
+
+	VkDevice mDevice;
+	VkPhysicalDevice mPhysicalDevice;
+	VmaAllocator mAllocator;
+	StagingUploader* mUploader;
+	JobSystem* mJobSystem;
+	JobSystem::Counter mJobCounter;
+	std::shared_ptr<const AssetArchive> mArchive;
+
+	VkDescriptorPool mPool;
+	VkDescriptorSetLayout mSetLayout;
+	VkDescriptorSet mSet;
+	VkSampler mSampler;
+	AllocatedImage mFallbackImage;
+	std::vector<FrameResources> mFrames;
+
+	// textures are handed to load jobs by pointer, so they must not move
+	std::vector<std::unique_ptr<Texture>> mTextures;
+	std::mutex mParsedMutex;
+	std::vector<TextureHandle> mParsedTextures;
+	std::vector<uint32_t> mFreeDescriptors;
+	std::vector<RetiredImage> mRetiredImages;
+
+	uint64_t mFrameNumber = 0;
+	VkDeviceSize mMemoryBudget;
+	VkDeviceSize mResidentBytes = 0;
+	uint64_t mStreamedBytes = 0;
+	uint32_t mEvictedLevels = 0;
+	uint32_t mRequestedTextures = 0;
+};
\ No newline at end of file
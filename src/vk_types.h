@@ -9,4 +9,12 @@ struct AllocatedImage {
     VmaAllocation allocation;
     VkExtent3D imageExtent;
     VkFormat imageFormat;
+    uint32_t mipLevels = 1;
+};
+
+struct AllocatedBuffer {
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    // holds the persistently mapped pointer (pMappedData) of host visible buffers
+    VmaAllocationInfo info;
 };
\ No newline at end of file
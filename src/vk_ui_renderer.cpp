@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <imgui.h>
+#include "vk_check_macro.h"
+#include "vk_descriptors.h"
+#include "vk_initializers.h"
+#include "vk_ui_renderer.h"
+#include "vk_utils.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    float milliseconds_since(Clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+
+    uint64_t mix(uint64_t hash, uint64_t word)
+    {
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        return hash ^ (hash >> 32);
+    }
+
+    // vkutil::hash_bytes goes a byte at a time, which on a busy UI would cost about as much as the copy it is meant to
+    // save; this mixes four independent 64 bit lanes
+    uint64_t hash_words(const void* data, size_t size, uint64_t seed)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+        uint64_t lanes[4] = { seed, seed ^ 0x9e3779b97f4a7c15ull, seed ^ 0xc2b2ae3d27d4eb4full, seed ^ 0x165667b19e3779f9ull };
+        size_t offset = 0;
+        for (; offset + 32 <= size; offset += 32) {
+            uint64_t words[4];
+            std::memcpy(words, bytes + offset, 32);
+            for (int lane = 0; lane < 4; lane++) {
+                lanes[lane] = mix(lanes[lane], words[lane]);
+            }
+        }
+        uint64_t hash = mix(mix(mix(mix(lanes[0], lanes[1]), lanes[2]), lanes[3]), size);
+        for (; offset < size; offset += 8) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes + offset, std::min<size_t>(8, size - offset));
+            hash = mix(hash, word);
+        }
+        return hash;
+    }
+}
+
+void UiRenderer::init(VkDevice device, VmaAllocator allocator, PipelinePermutationCache& pipelineCache, VkFormat colorFormat, uint32_t framesInFlight)
+{
+    mDevice = device;
+    mAllocator = allocator;
+    mPipelineCache = &pipelineCache;
+    mFrames.resize(framesInFlight);
+
+    // the same single combined image sampler as ImGui's backend uses, so the descriptor sets it creates are compatible
+    DescriptorLayoutBuilder layoutBuilder;
+    layoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    mTextureSetLayout = layoutBuilder.build(mDevice, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    VkPushConstantRange pushConstants{};
+    pushConstants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstants.offset = 0;
+    pushConstants.size = sizeof(UiConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &mTextureSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstants;
+    VK_CHECK(vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &mPipelineLayout));
+
+    uint64_t vertexHash;
+    uint64_t fragmentHash;
+    VkShaderModule vertexShader = mPipelineCache->load_shader("ui.vert.spv", &vertexHash);
+    VkShaderModule fragmentShader = mPipelineCache->load_shader("ui.frag.spv", &fragmentHash);
+    PipelineBuilder builder;
+    builder.set_shaders(vertexShader, fragmentShader, vkutil::hash_combine(vertexHash, fragmentHash));
+    builder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    builder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    builder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+    builder.set_multisampling_none();
+    builder.enable_blending_alphablend();
+    builder.disable_depthtest();
+    builder.set_color_attachment_format(colorFormat);
+    builder.set_layout(mPipelineLayout);
+    mPipelineFamily = mPipelineCache->register_graphics_family("ui", builder);
+}
+
+void UiRenderer::destroy()
+{
+    for (FrameResources& frame : mFrames) {
+        if (frame.capacity > 0) {
+            vkutil::destroy_buffer(mAllocator, frame.buffer);
+        }
+    }
+    mFrames.clear();
+    vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mTextureSetLayout, nullptr);
+}
+
+void UiRenderer::draw(VkCommandBuffer cmd, uint32_t frameIndex, const ImDrawData* drawData, VkImageView target, VkExtent2D targetExtent)
+{
+    FrameResources& frame = mFrames[frameIndex];
+    mStats.vertexCount = (uint32_t)drawData->TotalVtxCount;
+    mStats.indexCount = (uint32_t)drawData->TotalIdxCount;
+    mStats.drawCalls = 0;
+    mStats.uploadedBytes = 0;
+    mStats.hashTime = 0.f;
+    mStats.uploadTime = 0.f;
+    mStats.recordTime = 0.f;
+
+    int framebufferWidth = (int)(drawData->DisplaySize.x * drawData->FramebufferScale.x);
+    int framebufferHeight = (int)(drawData->DisplaySize.y * drawData->FramebufferScale.y);
+    if (framebufferWidth <= 0 || framebufferHeight <= 0 || drawData->TotalVtxCount == 0) {
+        return;
+    }
+
+    // only the geometry is hashed: draw commands are recorded every frame anyway
+    auto start = Clock::now();
+    uint64_t contentHash = vkutil::hash_combine(drawData->TotalVtxCount, drawData->TotalIdxCount);
+    for (int list = 0; list < drawData->CmdListsCount; list++) {
+        const ImDrawList* drawList = drawData->CmdLists[list];
+        contentHash = hash_words(drawList->VtxBuffer.Data, drawList->VtxBuffer.Size * sizeof(ImDrawVert), contentHash);
+        contentHash = hash_words(drawList->IdxBuffer.Data, drawList->IdxBuffer.Size * sizeof(ImDrawIdx), contentHash);
+    }
+    mStats.hashTime = milliseconds_since(start);
+
+    start = Clock::now();
+    if (frame.capacity == 0 || contentHash != frame.contentHash) {
+        VkDeviceSize vertexBytes = drawData->TotalVtxCount * sizeof(ImDrawVert);
+        VkDeviceSize indexOffset = (vertexBytes + 3) & ~VkDeviceSize(3);
+        VkDeviceSize size = indexOffset + drawData->TotalIdxCount * sizeof(ImDrawIdx);
+        if (size > frame.capacity) {
+            // the frame slot's fence has been waited on, so the old buffer is free
+            if (frame.capacity > 0) {
+                vkutil::destroy_buffer(mAllocator, frame.buffer);
+            }
+            frame.capacity = std::max(size + size / 2, VkDeviceSize(64 * 1024));
+            frame.buffer = vkutil::create_buffer(mAllocator, frame.capacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_CPU_TO_GPU);
+            VkBufferDeviceAddressInfo addressInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+            addressInfo.buffer = frame.buffer.buffer;
+            frame.address = vkGetBufferDeviceAddress(mDevice, &addressInfo);
+        }
+
+        uint8_t* vertices = (uint8_t*)frame.buffer.info.pMappedData;
+        uint8_t* indices = vertices + indexOffset;
+        for (int list = 0; list < drawData->CmdListsCount; list++) {
+            const ImDrawList* drawList = drawData->CmdLists[list];
+            size_t listVertexBytes = drawList->VtxBuffer.Size * sizeof(ImDrawVert);
+            size_t listIndexBytes = drawList->IdxBuffer.Size * sizeof(ImDrawIdx);
+            std::memcpy(vertices, drawList->VtxBuffer.Data, listVertexBytes);
+            std::memcpy(indices, drawList->IdxBuffer.Data, listIndexBytes);
+            vertices += listVertexBytes;
+            indices += listIndexBytes;
+        }
+        vmaFlushAllocation(mAllocator, frame.buffer.allocation, 0, size);
+        frame.contentHash = contentHash;
+        frame.indexOffset = indexOffset;
+        mStats.uploadedBytes = (uint32_t)size;
+    }
+    else {
+        mStats.skippedUploads++;
+    }
+    mStats.uploadTime = milliseconds_since(start);
+
+    start = Clock::now();
+    VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(target, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    VkRenderingInfo renderInfo = vkinit::rendering_info(targetExtent, &colorAttachment);
+    vkCmdBeginRendering(cmd, &renderInfo);
+
+    VkExtent2D framebufferExtent{ (uint32_t)framebufferWidth, (uint32_t)framebufferHeight };
+    set_render_state(cmd, frame, drawData, framebufferExtent);
+
+    // clip rectangles are in display coordinates
+    ImVec2 clipOffset = drawData->DisplayPos;
+    ImVec2 clipScale = drawData->FramebufferScale;
+    VkDescriptorSet boundTexture = VK_NULL_HANDLE;
+    uint32_t listFirstVertex = 0;
+    uint32_t listFirstIndex = 0;
+    for (int list = 0; list < drawData->CmdListsCount; list++) {
+        const ImDrawList* drawList = drawData->CmdLists[list];
+        for (const ImDrawCmd& drawCommand : drawList->CmdBuffer) {
+            if (drawCommand.UserCallback) {
+                if (drawCommand.UserCallback == ImDrawCallback_ResetRenderState) {
+                    set_render_state(cmd, frame, drawData, framebufferExtent);
+                    boundTexture = VK_NULL_HANDLE;
+                }
+                else {
+                    drawCommand.UserCallback(drawList, &drawCommand);
+                }
+                continue;
+            }
+
+            float clipMinX = std::max((drawCommand.ClipRect.x - clipOffset.x) * clipScale.x, 0.f);
+            float clipMinY = std::max((drawCommand.ClipRect.y - clipOffset.y) * clipScale.y, 0.f);
+            float clipMaxX = std::min((drawCommand.ClipRect.z - clipOffset.x) * clipScale.x, (float)framebufferWidth);
+            float clipMaxY = std::min((drawCommand.ClipRect.w - clipOffset.y) * clipScale.y, (float)framebufferHeight);
+            if (clipMaxX <= clipMinX || clipMaxY <= clipMinY) {
+                continue;
+            }
+            VkRect2D scissor{};
+            scissor.offset = { (int32_t)clipMinX, (int32_t)clipMinY };
+            scissor.extent = { (uint32_t)(clipMaxX - clipMinX), (uint32_t)(clipMaxY - clipMinY) };
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+            VkDescriptorSet texture = (VkDescriptorSet)drawCommand.GetTexID();
+            if (texture != boundTexture) {
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &texture, 0, nullptr);
+                boundTexture = texture;
+            }
+            vkCmdDrawIndexed(cmd, drawCommand.ElemCount, 1, listFirstIndex + drawCommand.IdxOffset, (int32_t)(listFirstVertex + drawCommand.VtxOffset), 0);
+            mStats.drawCalls++;
+        }
+        listFirstVertex += (uint32_t)drawList->VtxBuffer.Size;
+        listFirstIndex += (uint32_t)drawList->IdxBuffer.Size;
+    }
+
+    vkCmdEndRendering(cmd);
+    mStats.recordTime = milliseconds_since(start);
+}
+
+void UiRenderer::set_render_state(VkCommandBuffer cmd, const FrameResources& frame, const ImDrawData* drawData, VkExtent2D framebufferExtent)
+{
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineCache->get_pipeline(mPipelineFamily, SpecializationData()));
+    vkCmdBindIndexBuffer(cmd, frame.buffer.buffer, frame.indexOffset, sizeof(ImDrawIdx) == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+    VkViewport viewport{};
+    viewport.width = (float)framebufferExtent.width;
+    viewport.height = (float)framebufferExtent.height;
+    viewport.minDepth = 0.f;
+    viewport.maxDepth = 1.f;
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+    UiConstants constants;
+    constants.scale[0] = 2.f / drawData->DisplaySize.x;
+    constants.scale[1] = 2.f / drawData->DisplaySize.y;
+    constants.translate[0] = -1.f - drawData->DisplayPos.x * constants.scale[0];
+    constants.translate[1] = -1.f - drawData->DisplayPos.y * constants.scale[1];
+    constants.vertices = frame.address;
+    vkCmdPushConstants(cmd, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(UiConstants), &constants);
+}
+
+void UiRenderer::render_platform_windows()
+{
+    mViewportCosts.clear();
+    if (!(ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable)) {
+        return;
+    }
+    ImGui::UpdatePlatformWindows();
+
+    // what ImGui::RenderPlatformWindowsDefault does, one viewport at a time; the main viewport (0) is drawn by draw()
+    ImGuiPlatformIO& platformIO = ImGui::GetPlatformIO();
+    for (int i = 1; i < platformIO.Viewports.Size; i++) {
+        ImGuiViewport* viewport = platformIO.Viewports[i];
+        if (viewport->Flags & ImGuiViewportFlags_IsMinimized) {
+            continue;
+        }
+        auto start = Clock::now();
+        if (platformIO.Platform_RenderWindow) {
+            platformIO.Platform_RenderWindow(viewport, nullptr);
+        }
+        if (platformIO.Renderer_RenderWindow) {
+            platformIO.Renderer_RenderWindow(viewport, nullptr);
+        }
+        float renderTime = milliseconds_since(start);
+
+        start = Clock::now();
+        if (platformIO.Platform_SwapBuffers) {
+            platformIO.Platform_SwapBuffers(viewport, nullptr);
+        }
+        if (platformIO.Renderer_SwapBuffers) {
+            platformIO.Renderer_SwapBuffers(viewport, nullptr);
+        }
+        mViewportCosts.push_back({ viewport->ID, renderTime, milliseconds_since(start) });
+    }
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "vk_pipelines.h"
+#include "vk_types.h"
+
+struct ImDrawData;
+
+// Draws ImGui's main viewport in place of ImGui_ImplVulkan_RenderDrawData, which maps, fills and unmaps its vertex and index
+// buffers every frame whether or not the UI changed. Here every frame slot has one persistently mapped buffer holding both
+// (vertices pulled through their device address, indices bound), and the slot's copy of the geometry is only rewritten when
+// a hash of the draw lists differs from what the slot holds, so a UI that stands still costs a hash and the draw calls.
+// Textures are the descriptor sets ImGui's Vulkan backend creates (its font atlas, or any added with
+// ImGui_ImplVulkan_AddTexture), whose layout the pipeline's matches. The backend itself still renders secondary viewports,
+// through render_platform_windows, which times every viewport
+class UiRenderer {
+public:
+	// of the most recent frame
+	struct Stats {
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t drawCalls;
+		// 0 when the frame slot already held the same geometry
+		uint32_t uploadedBytes;
+		// frames whose upload was skipped since init
+		uint64_t skippedUploads;
+		// CPU time, in ms: hashing the draw lists, copying them, recording the draws
+		float hashTime;
+		float uploadTime;
+		float recordTime;
+	};
+
+	// CPU time of rendering and presenting one secondary viewport (its own submit and present), in ms
+	struct ViewportCost {
+		uint32_t id;
+		float renderTime;
+		float presentTime;
+	};
+
+	void init(VkDevice device, VmaAllocator allocator, PipelinePermutationCache& pipelineCache, VkFormat colorFormat, uint32_t framesInFlight);
+	void destroy();
+
+	// draws drawData over target (in COLOR_ATTACHMENT_OPTIMAL, which it stays in) inside its own rendering pass. Call once the
+	// frame slot's fence has been waited on
+	void draw(VkCommandBuffer cmd, uint32_t frameIndex, const ImDrawData* drawData, VkImageView target, VkExtent2D targetExtent);
+	// ImGui::UpdatePlatformWindows and RenderPlatformWindowsDefault, timing each viewport; nothing when viewports are disabled
+	void render_platform_windows();
+
+	Stats get_stats() const { return mStats; }
+	const std::vector<ViewportCost>& get_viewport_costs() const { return mViewportCosts; }
+
+private:
+	struct UiConstants {
+		float scale[2];
+		float translate[2];
+		VkDeviceAddress vertices;
+	};
+
+	struct FrameResources {
+		AllocatedBuffer buffer{};
+		VkDeviceSize capacity = 0;
+		VkDeviceAddress address = 0;
+		// of the geometry in buffer, and where its indices start
+		uint64_t contentHash = 0;
+		VkDeviceSize indexOffset = 0;
+	};
+
+	void set_render_state(VkCommandBuffer cmd, const FrameResources& frame, const ImDrawData* drawData, VkExtent2D framebufferExtent);
+
+	VkDevice mDevice;
+	VmaAllocator mAllocator;
+	PipelinePermutationCache* mPipelineCache;
+
+	VkDescriptorSetLayout mTextureSetLayout;
+	VkPipelineLayout mPipelineLayout;
+	uint32_t mPipelineFamily;
+
+	std::vector<FrameResources> mFrames;
+	std::vector<ViewportCost> mViewportCosts;
+	Stats mStats{};
+};
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <cstring>
+#include "vk_check_macro.h"
+#include "vk_initializers.h"
+#include "vk_upload.h"
+#include "vk_utils.h"
+
+void StagingUploader::init(VkDevice device, VmaAllocator allocator, VkQueue queue, uint32_t queueFamily, VkDeviceSize chunkSize, uint32_t chunkCount)
+{
+    mDevice = device;
+    mAllocator = allocator;
+    mQueue = queue;
+    mChunkSize = chunkSize;
+
+    // command buffers are recorded once per fill, so each chunk's pool is simply reset wholesale
+    VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(queueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    VkFenceCreateInfo fenceInfo = vkinit::fence_create_info();
+
+    mChunks.resize(std::max(chunkCount, 1u));
+    for (Chunk& chunk : mChunks) {
+        chunk.staging = vkutil::create_buffer(mAllocator, mChunkSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+        VK_CHECK(vkCreateCommandPool(mDevice, &poolInfo, nullptr, &chunk.commandPool));
+        VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(chunk.commandPool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(mDevice, &allocInfo, &chunk.cmd));
+        VK_CHECK(vkCreateFence(mDevice, &fenceInfo, nullptr, &chunk.fence));
+    }
+}
+
+void StagingUploader::destroy()
+{
+    while (retire_oldest(true)) {
+    }
+
+    for (Chunk& chunk : mChunks) {
+        vkDestroyFence(mDevice, chunk.fence, nullptr);
+        vkDestroyCommandPool(mDevice, chunk.commandPool, nullptr);
+        vkutil::destroy_buffer(mAllocator, chunk.staging);
+    }
+    mChunks.clear();
+    mRequests.clear();
+}
+
+void StagingUploader::enqueue_buffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+    std::shared_ptr<const void> owner, std::function<void()>&& onComplete)
+{
+    mRequests.push_back({ dst, VK_NULL_HANDLE, 0, {}, dstOffset, (const uint8_t*)data, size, 0, std::move(owner), std::move(onComplete) });
+    mQueuedBytes += size;
+}
+
+bool StagingUploader::enqueue_image(VkImage dst, uint32_t mipLevel, VkExtent3D extent, const void* data, VkDeviceSize size,
+    std::shared_ptr<const void> owner, std::function<void()>&& onComplete)
+{
+    if (size > mChunkSize) {
+        return false;
+    }
+    mRequests.push_back({ VK_NULL_HANDLE, dst, mipLevel, extent, 0, (const uint8_t*)data, size, 0, std::move(owner), std::move(onComplete) });
+    mQueuedBytes += size;
+    return true;
+}
+
+void StagingUploader::update(VkDeviceSize byteBudget)
+{
+    while (retire_oldest(false)) {
+    }
+
+    Chunk* chunk = nullptr;
+    bool bStagedAny = false;
+    while (!mRequests.empty() && byteBudget > 0) {
+        if (!chunk) {
+            auto freeChunk = std::find_if(mChunks.begin(), mChunks.end(), [](const Chunk& candidate) { return !candidate.bSubmitted; });
+            if (freeChunk == mChunks.end()) {
+                // the whole ring is in flight; the rest waits for a later update
+                break;
+            }
+            chunk = &*freeChunk;
+            VK_CHECK(vkResetCommandPool(mDevice, chunk->commandPool, 0));
+            VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            VK_CHECK(vkBeginCommandBuffer(chunk->cmd, &beginInfo));
+        }
+
+        Request& request = mRequests.front();
+        if (request.dstImage != VK_NULL_HANDLE) {
+            // whole levels only; a level that would not fit waits for a fresh chunk, and one larger than the remaining budget
+            // still goes out if it is the first thing staged this update, so the budget cannot starve big levels
+            if (request.size > mChunkSize - chunk->usedBytes) {
+                submit(*chunk);
+                chunk = nullptr;
+                continue;
+            }
+            if (request.size > byteBudget && bStagedAny) {
+                break;
+            }
+            record_image_copy(*chunk, request);
+            byteBudget -= std::min(byteBudget, request.size);
+            bStagedAny = true;
+            chunk->completedRequests.push_back(std::move(request));
+            mRequests.pop_front();
+            if (chunk->usedBytes == mChunkSize) {
+                submit(*chunk);
+                chunk = nullptr;
+            }
+            continue;
+        }
+
+        VkDeviceSize copySize = std::min({ request.size - request.copiedBytes, mChunkSize - chunk->usedBytes, byteBudget });
+        if (copySize > 0) {
+            std::memcpy((uint8_t*)chunk->staging.info.pMappedData + chunk->usedBytes, request.data + request.copiedBytes, copySize);
+
+            VkBufferCopy region{};
+            region.srcOffset = chunk->usedBytes;
+            region.dstOffset = request.dstOffset + request.copiedBytes;
+            region.size = copySize;
+            vkCmdCopyBuffer(chunk->cmd, chunk->staging.buffer, request.dst, 1, &region);
+
+            // keeps every source offset 16 byte aligned, which is plenty for buffer copies
+            chunk->usedBytes = std::min((chunk->usedBytes + copySize + 15) & ~VkDeviceSize(15), mChunkSize);
+            request.copiedBytes += copySize;
+            byteBudget -= copySize;
+            bStagedAny = true;
+        }
+
+        if (request.copiedBytes == request.size) {
+            chunk->completedRequests.push_back(std::move(request));
+            mRequests.pop_front();
+        }
+        if (chunk->usedBytes == mChunkSize) {
+            submit(*chunk);
+            chunk = nullptr;
+        }
+    }
+
+    if (chunk) {
+        submit(*chunk);
+    }
+}
+
+void StagingUploader::flush()
+{
+    while (!mRequests.empty()) {
+        update(~VkDeviceSize(0));
+        // frees at least one chunk for the next round
+        retire_oldest(true);
+    }
+    while (retire_oldest(true)) {
+    }
+}
+
+StagingUploader::Stats StagingUploader::get_stats() const
+{
+    Stats stats{};
+    stats.uploadedBytes = mUploadedBytes;
+    stats.pendingBytes = mQueuedBytes;
+    stats.pendingUploads = (uint32_t)mRequests.size();
+    for (const Chunk& chunk : mChunks) {
+        if (chunk.bSubmitted) {
+            stats.chunksInFlight++;
+            stats.pendingUploads += (uint32_t)chunk.completedRequests.size();
+        }
+    }
+    return stats;
+}
+
+bool StagingUploader::retire_oldest(bool bWait)
+{
+    auto oldest = std::find_if(mChunks.begin(), mChunks.end(),
+        [&](const Chunk& chunk) { return chunk.bSubmitted && chunk.submitIndex == mNextRetireIndex; });
+    if (oldest == mChunks.end()) {
+        return false;
+    }
+
+    if (bWait) {
+        VK_CHECK(vkWaitForFences(mDevice, 1, &oldest->fence, true, UINT64_MAX));
+    }
+    else if (vkGetFenceStatus(mDevice, oldest->fence) != VK_SUCCESS) {
+        return false;
+    }
+    VK_CHECK(vkResetFences(mDevice, 1, &oldest->fence));
+
+    // callbacks may queue more uploads, which is why the list is moved out first
+    std::vector<Request> completedRequests = std::move(oldest->completedRequests);
+    oldest->completedRequests.clear();
+    oldest->usedBytes = 0;
+    oldest->bSubmitted = false;
+    mNextRetireIndex++;
+
+    for (Request& request : completedRequests) {
+        mUploadedBytes += request.size;
+        mQueuedBytes -= request.size;
+        if (request.onComplete) {
+            request.onComplete();
+        }
+    }
+    return true;
+}
+
+void StagingUploader::record_image_copy(Chunk& chunk, const Request& request)
+{
+    std::memcpy((uint8_t*)chunk.staging.info.pMappedData + chunk.usedBytes, request.data, request.size);
+
+    VkImageSubresourceRange range = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    range.baseMipLevel = request.mipLevel;
+    range.levelCount = 1;
+
+    VkImageMemoryBarrier2 toTransfer = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+    toTransfer.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    toTransfer.srcAccessMask = VK_ACCESS_2_NONE;
+    toTransfer.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    toTransfer.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toTransfer.image = request.dstImage;
+    toTransfer.subresourceRange = range;
+
+    VkDependencyInfo depInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    depInfo.imageMemoryBarrierCount = 1;
+    depInfo.pImageMemoryBarriers = &toTransfer;
+    vkCmdPipelineBarrier2(chunk.cmd, &depInfo);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = chunk.usedBytes;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = request.mipLevel;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = request.extent;
+    vkCmdCopyBufferToImage(chunk.cmd, chunk.staging.buffer, request.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // the end of chunk barrier in submit() makes the copy visible; only the layout change is recorded here
+    VkImageMemoryBarrier2 toShader = toTransfer;
+    toShader.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    toShader.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    toShader.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    toShader.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    toShader.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toShader.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    depInfo.pImageMemoryBarriers = &toShader;
+    vkCmdPipelineBarrier2(chunk.cmd, &depInfo);
+
+    // 16 byte source offsets satisfy the texel block size of every format, compressed or not
+    chunk.usedBytes = std::min((chunk.usedBytes + request.size + 15) & ~VkDeviceSize(15), mChunkSize);
+}
+
+void StagingUploader::submit(Chunk& chunk)
+{
+    // uploaded data is consumed in later submissions by any stage (vertex pulling, index fetch, compute, indirect)
+    VkMemoryBarrier2 uploadBarrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+    uploadBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    uploadBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    uploadBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    uploadBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+    VkDependencyInfo depInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &uploadBarrier;
+    vkCmdPipelineBarrier2(chunk.cmd, &depInfo);
+    VK_CHECK(vkEndCommandBuffer(chunk.cmd));
+
+    // CPU_ONLY memory is normally coherent, in which case this does nothing
+    vmaFlushAllocation(mAllocator, chunk.staging.allocation, 0, chunk.usedBytes);
+
+    VkCommandBufferSubmitInfo cmdInfo = vkinit::command_buffer_submit_info(chunk.cmd);
+    VkSubmitInfo2 submitInfo = vkinit::queue_submit_info(&cmdInfo, nullptr, nullptr);
+    VK_CHECK(vkQueueSubmit2(mQueue, 1, &submitInfo, chunk.fence));
+
+    chunk.bSubmitted = true;
+    chunk.submitIndex = mNextSubmitIndex++;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "vk_types.h"
+
+// Streams CPU data into device local buffers and images through a ring of persistently mapped staging chunks.
+// Requests are queued from anywhere on the render thread and copied a bounded number of bytes per update(), so large loads
+// never stall a frame; each filled chunk is submitted on its own with a fence, which is polled rather than waited on.
+// Buffer requests larger than a chunk are split across several. Completion callbacks run on the render thread inside update()
+class StagingUploader {
+public:
+	struct Stats {
+		uint64_t uploadedBytes; // since init
+		uint64_t pendingBytes; // queued or in flight
+		uint32_t pendingUploads;
+		uint32_t chunksInFlight;
+	};
+
+	void init(VkDevice device, VmaAllocator allocator, VkQueue queue, uint32_t queueFamily,
+		VkDeviceSize chunkSize = 16ull << 20, uint32_t chunkCount = 4);
+	// waits for in flight chunks; queued requests that never reached the GPU are dropped without their callbacks
+	void destroy();
+
+	// copies size bytes from data into dst at dstOffset. data must stay valid until onComplete runs, owner (if any) is kept
+	// alive until then, so a request can own the memory it uploads. Once onComplete runs, the GPU copy has finished and is
+	// visible to every later submission on the upload queue
+	void enqueue_buffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+		std::shared_ptr<const void> owner = nullptr, std::function<void()>&& onComplete = nullptr);
+
+	// copies one mip level of a 2D color image from data, which is tightly packed (block compressed levels as whole blocks).
+	// The level goes from UNDEFINED to SHADER_READ_ONLY_OPTIMAL, so every level of a new image is uploaded exactly once.
+	// Image uploads are never split: returns false if size exceeds the chunk size, in which case nothing is queued
+	bool enqueue_image(VkImage dst, uint32_t mipLevel, VkExtent3D extent, const void* data, VkDeviceSize size,
+		std::shared_ptr<const void> owner = nullptr, std::function<void()>&& onComplete = nullptr);
+
+	// retires finished chunks (running their callbacks), then stages and submits at most byteBudget bytes of queued requests
+	void update(VkDeviceSize byteBudget);
+	// blocks until everything queued so far is on the GPU; for loading screens and tools, not for the render loop
+	void flush();
+
+	VkDeviceSize get_chunk_size() const { return mChunkSize; }
+	bool is_idle() const { return mRequests.empty() && get_stats().chunksInFlight == 0; }
+	Stats get_stats() const;
+
+private:
+	struct Request {
+		VkBuffer dst;
+		// set instead of dst for image uploads
+		VkImage dstImage;
+		uint32_t mipLevel;
+		VkExtent3D extent;
+		VkDeviceSize dstOffset;
+		const uint8_t* data;
+		VkDeviceSize size;
+		VkDeviceSize copiedBytes;
+		std::shared_ptr<const void> owner;
+		std::function<void()> onComplete;
+	};
+
+	struct Chunk {
+		AllocatedBuffer staging;
+		VkCommandPool commandPool;
+		VkCommandBuffer cmd;
+		VkFence fence;
+		bool bSubmitted = false;
+		uint64_t submitIndex = 0;
+		VkDeviceSize usedBytes = 0;
+		// requests whose last bytes travel in this chunk; finished once its fence signals
+		std::vector<Request> completedRequests;
+	};
+
+	// chunks retire in submission order, so a request split over several completes only once all of them have
+	// returns false if the oldest submitted chunk is still running (or nothing is in flight)
+	bool retire_oldest(bool bWait);
+	void record_image_copy(Chunk& chunk, const Request& request);
+	void submit(Chunk& chunk);
+
+	VkDevice mDevice;
+	VmaAllocator mAllocator;
+	VkQueue mQueue;
+	VkDeviceSize mChunkSize;
+
+	std::vector<Chunk> mChunks;
+	std::deque<Request> mRequests;
+	uint64_t mNextSubmitIndex = 0;
+	uint64_t mNextRetireIndex = 0;
+	uint64_t mUploadedBytes = 0;
+	uint64_t mQueuedBytes = 0;
+};
\ No newline at end of file
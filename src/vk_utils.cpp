@@ -1,11 +1,13 @@
 #include <fstream>
 #include <vector>
+#include "vk_check_macro.h"
 #include "vk_utils.h"
 #include "vk_initializers.h"
 
 bool vkutil::load_shader_module(const char* filePath,
     VkDevice device,
-    VkShaderModule* outShaderModule)
+    VkShaderModule* outShaderModule,
+    uint64_t* outCodeHash)
 {
     // open the file. With cursor at the end
     std::ifstream file(filePath, std::ios::ate | std::ios::binary);
@@ -32,14 +34,18 @@ bool vkutil::load_shader_module(const char* filePath,
     file.close();
 
     // create a new shader module, using the buffer we loaded
+    return create_shader_module(buffer.data(), buffer.size() * sizeof(uint32_t), device, outShaderModule, outCodeHash);
+}
+
+bool vkutil::create_shader_module(const void* code, size_t codeSize, VkDevice device, VkShaderModule* outShaderModule, uint64_t* outCodeHash)
+{
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.pNext = nullptr;
 
-    // codeSize has to be in bytes, so multply the ints in the buffer by size of
-    // int to know the real size of the buffer
-    createInfo.codeSize = buffer.size() * sizeof(uint32_t);
-    createInfo.pCode = buffer.data();
+    // codeSize is in bytes, pCode must be 4 byte aligned
+    createInfo.codeSize = codeSize;
+    createInfo.pCode = (const uint32_t*)code;
 
     // check that the creation goes well.
     VkShaderModule shaderModule;
@@ -47,21 +53,31 @@ bool vkutil::load_shader_module(const char* filePath,
         return false;
     }
     *outShaderModule = shaderModule;
+    if (outCodeHash) {
+        *outCodeHash = hash_bytes(code, codeSize);
+    }
     return true;
 }
 
 void vkutil::transition_image(VkCommandBuffer cmd, VkImage image, int mipMapLevels, VkImageLayout currentLayout, VkImageLayout newLayout)
 {
-    VkImageMemoryBarrier2 imageBarrier{ .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
-    imageBarrier.pNext = nullptr;
-
     // conservatively make all commands before the barrier run before any commands after the barrier run (stage mask)
     // and make all resource writes before the barrier run before all resource reads and writes after the barrier (access mask)
     // this is a point of optimization if it bottleneckss the GPU
-    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    imageBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
-    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    imageBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+    transition_image(cmd, image, currentLayout, newLayout, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT);
+}
+
+void vkutil::transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+    VkImageMemoryBarrier2 imageBarrier{ .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+    imageBarrier.pNext = nullptr;
+
+    imageBarrier.srcStageMask = srcStage;
+    imageBarrier.srcAccessMask = srcAccess;
+    imageBarrier.dstStageMask = dstStage;
+    imageBarrier.dstAccessMask = dstAccess;
 
     imageBarrier.oldLayout = currentLayout;
     imageBarrier.newLayout = newLayout;
@@ -79,6 +95,44 @@ void vkutil::transition_image(VkCommandBuffer cmd, VkImage image, int mipMapLeve
     vkCmdPipelineBarrier2(cmd, &depInfo);
 }
 
+void vkutil::transfer_image_ownership(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout,
+    uint32_t srcQueueFamily, uint32_t dstQueueFamily, bool bRelease, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask)
+{
+    VkImageMemoryBarrier2 imageBarrier{ .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+    imageBarrier.pNext = nullptr;
+
+    // the release half only needs to make the writes available; the acquire half only needs to make them visible
+    // the semaphore between the two submissions orders the halves. On the acquire side the source stage must still overlap
+    // the semaphore's wait stage, so the layout transition is chained after the wait
+    if (bRelease) {
+        imageBarrier.srcStageMask = stageMask;
+        imageBarrier.srcAccessMask = accessMask;
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        imageBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+    }
+    else {
+        imageBarrier.srcStageMask = stageMask;
+        imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+        imageBarrier.dstStageMask = stageMask;
+        imageBarrier.dstAccessMask = accessMask;
+    }
+
+    imageBarrier.oldLayout = currentLayout;
+    imageBarrier.newLayout = newLayout;
+    imageBarrier.srcQueueFamilyIndex = srcQueueFamily;
+    imageBarrier.dstQueueFamilyIndex = dstQueueFamily;
+    imageBarrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    imageBarrier.image = image;
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.pNext = nullptr;
+    depInfo.imageMemoryBarrierCount = 1;
+    depInfo.pImageMemoryBarriers = &imageBarrier;
+
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
 void vkutil::copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D srcSize, VkExtent2D dstSize)
 {
 	VkImageBlit2 blitRegion{ .sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2, .pNext = nullptr };
@@ -111,4 +165,45 @@ void vkutil::copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage de
 	blitInfo.pRegions = &blitRegion;
 
 	vkCmdBlitImage2(cmd, &blitInfo);
+}
+
+AllocatedBuffer vkutil::create_buffer(VmaAllocator allocator, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage)
+{
+    VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.pNext = nullptr;
+    bufferInfo.size = allocSize;
+    bufferInfo.usage = usage;
+
+    VmaAllocationCreateInfo vmaAllocInfo = {};
+    vmaAllocInfo.usage = memoryUsage;
+    // keep host visible buffers mapped for their whole lifetime; mapping per upload costs a syscall on some drivers
+    if (memoryUsage != VMA_MEMORY_USAGE_GPU_ONLY) {
+        vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    }
+
+    AllocatedBuffer newBuffer;
+    VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &vmaAllocInfo, &newBuffer.buffer, &newBuffer.allocation, &newBuffer.info));
+    return newBuffer;
+}
+
+void vkutil::destroy_buffer(VmaAllocator allocator, const AllocatedBuffer& buffer)
+{
+    vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+}
+
+uint64_t vkutil::hash_bytes(const void* data, size_t size, uint64_t seed)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t vkutil::hash_combine(uint64_t seed, uint64_t value)
+{
+    // boost-style mixing, widened to 64 bits
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
 }
\ No newline at end of file
@@ -1,9 +1,31 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <volk.h>
+#include "vk_types.h"
 
 namespace vkutil {
-	bool load_shader_module(const char* filePath, VkDevice device, VkShaderModule* outShaderModule);
+	// outCodeHash, if given, receives a hash of the SPIR-V code so pipelines can be keyed on shader contents rather than module handles
+	bool load_shader_module(const char* filePath, VkDevice device, VkShaderModule* outShaderModule, uint64_t* outCodeHash = nullptr);
+	// creates a module from SPIR-V already in memory (code must be 4 byte aligned), e.g. mapped from an asset archive
+	bool create_shader_module(const void* code, size_t codeSize, VkDevice device, VkShaderModule* outShaderModule, uint64_t* outCodeHash = nullptr);
 	void transition_image(VkCommandBuffer cmd, VkImage image, int mipMapLevels, VkImageLayout currentLayout, VkImageLayout newLayout);
+	// same, limited to the given stages and accesses, for transitions that must not hold back unrelated work on the queue
+	void transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout,
+		VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess);
+	// queue family ownership transfer; record with bRelease on the source queue, then again with !bRelease on the destination queue
+	// (both halves must use the same layouts and families). stageMask/accessMask describe the accesses on the side being recorded,
+	// and on the acquire side stageMask must include the stage the semaphore between the halves is waited on
+	void transfer_image_ownership(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout,
+		uint32_t srcQueueFamily, uint32_t dstQueueFamily, bool bRelease, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask);
 	void copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D srcSize, VkExtent2D dstSize);
+
+	// host visible memory usages (CPU_ONLY, CPU_TO_GPU, GPU_TO_CPU) are created persistently mapped
+	AllocatedBuffer create_buffer(VmaAllocator allocator, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+	void destroy_buffer(VmaAllocator allocator, const AllocatedBuffer& buffer);
+
+	// 64 bit FNV-1a; fast and good enough for cache keys (not for anything adversarial)
+	uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+	uint64_t hash_combine(uint64_t seed, uint64_t value);
 }
\ No newline at end of file